@@ -0,0 +1,55 @@
+/* Timestamp alignment of several streams. The samples of each stream are
+ * stored in a ring by their sample index, derived from the VRT timestamp,
+ * so streams may arrive in any order and from different hosts. Aligned
+ * blocks are released once every stream has the samples, or with zeros
+ * for the streams that lag more than the ring can buffer. */
+
+#ifndef _VRTALIGN_H
+#define _VRTALIGN_H
+
+#include <stdint.h>
+
+#include <complex>
+
+struct vrt_align;
+
+/* Rings of at least capacity ci16 samples per stream (rounded up to a
+ * power of two), grown when packets or delays need more */
+vrt_align* vrt_align_create(uint32_t streams, double sample_rate, uint32_t capacity);
+
+/* Store n ci16 samples of a stream, the first at seconds + picoseconds/1e12.
+ * A gap after the previous packet is filled with zeros. */
+void vrt_align_push(vrt_align* align, uint32_t stream, uint64_t seconds, uint64_t picoseconds,
+    const uint32_t* samples, uint32_t n);
+
+// Grow the rings to hold at least samples per stream, keeping their contents
+void vrt_align_reserve(vrt_align* align, uint32_t samples);
+
+/* Samples that can be released at the read position, at most max. Stream s
+ * is read shift[s] samples before the read position (its delay in whole
+ * samples). 0 until every stream has started; the read position then
+ * starts at the first sample all streams have. */
+uint32_t vrt_align_ready(vrt_align* align, const uint32_t* shift, uint32_t max);
+
+// Sample index of the read position
+int64_t vrt_align_position(const vrt_align* align);
+
+/* Convert n samples of a stream from sample index on, samples that were
+ * not received (or are no longer in the ring) are zero */
+void vrt_align_read(const vrt_align* align, uint32_t stream, int64_t index, uint32_t n,
+    std::complex<double>* out, double scale);
+void vrt_align_read(const vrt_align* align, uint32_t stream, int64_t index, uint32_t n,
+    std::complex<float>* out, float scale);
+
+// Move the read position by n samples, after reading them
+void vrt_align_advance(vrt_align* align, uint32_t n);
+
+// Timestamp of a sample index
+void vrt_align_time(const vrt_align* align, int64_t index, int64_t* seconds, int64_t* picoseconds);
+
+// Samples of a stream released as zeros because they had not arrived
+uint64_t vrt_align_missing(const vrt_align* align, uint32_t stream);
+
+void vrt_align_destroy(vrt_align* align);
+
+#endif
@@ -0,0 +1,101 @@
+/* VRT sample conversion kernels */
+
+#ifndef _VRTCONVERT_H
+#define _VRTCONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <complex>
+
+/* Sample formats of a VRT data payload. All formats carry values in the
+ * units of ci16, the compact formats only have less range. Packed formats
+ * fill the words in byte order (I0 Q0 I1 Q1 ...), like the ci16_le words. */
+enum vrt_sample_format {
+    VRT_FORMAT_CI16 = 0,    // 16-bit I/Q, one sample per word
+    VRT_FORMAT_CI8,         // 8-bit I/Q, two samples per word
+    VRT_FORMAT_CI12,        // 12-bit I/Q, four samples in three words
+    VRT_FORMAT_CF32,        // 32-bit float I/Q, two words per sample
+    VRT_NUM_FORMATS
+};
+
+// Payload words of n samples, packed formats are padded to a full word
+inline uint32_t vrt_payload_words(uint32_t n, vrt_sample_format format) {
+    switch (format) {
+        case VRT_FORMAT_CI8:  return (n + 1)/2;
+        case VRT_FORMAT_CI12: return (3*n + 3)/4;
+        case VRT_FORMAT_CF32: return 2*n;
+        default:              return n;
+    }
+}
+
+// Samples in a payload of the given number of words
+inline uint32_t vrt_payload_samples(uint32_t words, vrt_sample_format format) {
+    switch (format) {
+        case VRT_FORMAT_CI8:  return 2*words;
+        case VRT_FORMAT_CI12: return 4*words/3;
+        case VRT_FORMAT_CF32: return words/2;
+        default:              return words;
+    }
+}
+
+enum vrt_simd_level {
+    VRT_SIMD_SCALAR = 0,
+    VRT_SIMD_NEON,
+    VRT_SIMD_AVX2,
+    VRT_SIMD_AVX512
+};
+
+// Kernel set selected at runtime (best supported by the CPU, can be
+// overridden with the VRT_SIMD environment variable: scalar, neon, avx2, avx512)
+vrt_simd_level vrt_convert_simd_level();
+const char* vrt_convert_simd_name(vrt_simd_level level);
+
+// Force a kernel set, returns false if the CPU does not support it
+bool vrt_convert_set_simd_level(vrt_simd_level level);
+
+/* Convert n ci16_le samples (one per 32-bit word, as in a VRT payload).
+ * Every output sample is multiplied by scale. With fftshift, sample i is
+ * additionally multiplied by (-1)^i; pass a negative scale to start the
+ * alternation on an odd sample. */
+void vrt_ci16_to_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale = 1.0f, bool fftshift = false);
+void vrt_ci16_to_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale = 1.0, bool fftshift = false);
+
+/* Convert to 8-bit samples: round(x*scale), saturated. The unsigned variant
+ * is offset by 128 (rtl_tcp style). out holds 2*n bytes. */
+void vrt_ci16_to_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale = 1.0f);
+void vrt_ci16_to_cs8(const uint32_t* in, int8_t* out, size_t n, float scale = 1.0f);
+
+/* Decode n samples of a compact payload to ci16 words. cf32 values are
+ * rounded and saturated. in and out must not overlap. */
+void vrt_ci8_to_ci16(const uint32_t* in, uint32_t* out, size_t n);
+void vrt_ci12_to_ci16(const uint32_t* in, uint32_t* out, size_t n);
+void vrt_cf32_to_ci16(const uint32_t* in, uint32_t* out, size_t n);
+void vrt_payload_to_ci16(const uint32_t* in, vrt_sample_format format, uint32_t* out, size_t n);
+
+// Like vrt_ci16_to_cf32/cf64, for a payload in any format
+void vrt_payload_to_cf32(const uint32_t* in, vrt_sample_format format, std::complex<float>* out, size_t n, float scale = 1.0f, bool fftshift = false);
+void vrt_payload_to_cf64(const uint32_t* in, vrt_sample_format format, std::complex<double>* out, size_t n, double scale = 1.0, bool fftshift = false);
+
+// acc[i] += |in[i]|^2, the power accumulation of a spectrum (in double precision)
+void vrt_accumulate_power(const std::complex<double>* in, double* acc, size_t n);
+void vrt_accumulate_power(const std::complex<float>* in, double* acc, size_t n);
+
+// acc[i] += w[i]*in[i], the weighted overlap-add of a WOLA filterbank (fused multiply-add where available)
+void vrt_accumulate_weighted(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n);
+
+/* acc[i] += p[i], acc2[i] += p[i]^2 and the max/min hold of the power p of
+ * one spectrum, the per bin statistics of an integration */
+void vrt_accumulate_moments(const double* p, double* acc, double* acc2, double* max, double* min, size_t n);
+
+/* acc[i] += x[i]*conj(y[i]) and mag[i] += |x[i]||y[i]|, the cross multiply
+ * and accumulate of a correlator baseline */
+void vrt_accumulate_cross(const std::complex<double>* x, const std::complex<double>* y, std::complex<double>* acc, double* mag, size_t n);
+void vrt_accumulate_cross(const std::complex<float>* x, const std::complex<float>* y, std::complex<double>* acc, double* mag, size_t n);
+
+/* Encode n ci16 samples as a payload of the given format (producer side),
+ * values outside the range of the format are saturated. Returns the number
+ * of payload words written, see vrt_payload_words. */
+uint32_t vrt_ci16_to_payload(const uint32_t* in, uint32_t* out, size_t n, vrt_sample_format format);
+
+#endif
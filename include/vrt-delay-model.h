@@ -0,0 +1,71 @@
+/* Geometric delay model of a baseline or of each station, read from a file
+ * and evaluated per FFT instead of asking the fringe stopper server.
+ *
+ * The file is text, '#' starts a comment. Two kinds of lines:
+ *   <unix time> <w> <u> <v>                    table row (m)
+ *   poly <mid time> <span> <w|u|v> <c0> <c1> ...
+ * A polynomial segment gives a quantity as sum(c_i*(t - mid)^i) for
+ * |t - mid| <= span/2 (s); segments (polycos) take precedence over the
+ * table. The table is interpolated with a cubic through the 4 nearest rows.
+ * Only w is required, u and v may be left out of the polycos.
+ * Times are kept relative to the integer second of the first entry.
+ *
+ * Without further structure the file models one baseline (track 0). A line
+ *   station <k>
+ * starts the model of station k (the k-th channel, from 0): w is then the
+ * delay of that station times c and u, v its position, all relative to a
+ * common reference; a baseline a-b has w_a - w_b, u_a - u_b and v_a - v_b.
+ * Every station up to the highest one needs a w. */
+
+#ifndef _VRTDELAYMODEL_H
+#define _VRTDELAYMODEL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+enum vrt_delay_quantity {
+    VRT_DELAY_W = 0,        // delta range, delay times c
+    VRT_DELAY_U,
+    VRT_DELAY_V,
+    VRT_DELAY_QUANTITIES
+};
+
+struct vrt_delay_segment {
+    double mid;             // s after the epoch
+    double span;
+    std::vector<double> coeffs;
+};
+
+// The model of the baseline or of one station
+struct vrt_delay_track {
+    std::vector<double> times;  // s after the epoch, ascending
+    std::vector<double> table[VRT_DELAY_QUANTITIES];
+    std::vector<vrt_delay_segment> segments[VRT_DELAY_QUANTITIES];
+};
+
+struct vrt_delay_model {
+    int64_t epoch = 0;      // unix seconds
+    bool per_station = false;
+    std::vector<vrt_delay_track> tracks;    // the baseline, or one per station
+};
+
+struct vrt_delay_value {
+    double w = 0;
+    double w_dot = 0;       // m/s
+    double u = 0;
+    double v = 0;
+};
+
+// Read a model file, false (with a message) when it cannot be read or defines no w
+bool vrt_delay_model_load(const std::string& path, vrt_delay_model* model);
+
+/* Evaluate track (the station of a per-station model) at seconds +
+ * picoseconds/1e12, false when w is not covered by a segment or the table
+ * (value is left unchanged). u and v are optional, NaN where they are not
+ * covered. */
+bool vrt_delay_model_eval(const vrt_delay_model* model, int64_t seconds, uint64_t picoseconds, vrt_delay_value* value,
+    uint32_t track = 0);
+
+#endif
@@ -0,0 +1,58 @@
+/* Multi-stream VRT demultiplexer */
+
+#ifndef _VRTDEMUX_H
+#define _VRTDEMUX_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "vrt-tools.h"
+
+struct vrt_stream_state;
+
+// Called for every context, data and extended context packet of a stream
+typedef void (*vrt_stream_handler)(vrt_stream_state* stream, const packet_type* vrt_packet, uint32_t* buffer, void* data);
+
+/* State of one selected stream. Streams are identified by their channel,
+ * the bit set in the stream id (stream id 1<<channel). */
+struct vrt_stream_state {
+    uint32_t channel;
+    context_type context;
+    bool first_frame;
+    uint64_t packets;
+    uint64_t samples;
+    uint64_t lost_frames;
+    vrt_stream_handler handler;
+    void* handler_data;
+};
+
+/* Dense table of the selected streams, in the order they were given.
+ * A packet is parsed once and routed by its stream id. */
+struct vrt_demux {
+    uint32_t channel_filt;
+    uint32_t num_streams;
+    int8_t slot[32];
+    vrt_stream_state streams[MAX_CHANNELS];
+};
+
+// Select the channels to receive, returns false for more than MAX_CHANNELS or a channel >= 32
+bool vrt_demux_init(vrt_demux* demux, const std::vector<size_t>& channel_nums);
+
+void vrt_demux_set_handler(vrt_demux* demux, uint32_t index, vrt_stream_handler handler, void* data);
+
+// Stream of a stream id (lowest selected channel bit), NULL if no channel of it is selected
+vrt_stream_state* vrt_demux_stream(vrt_demux* demux, uint32_t stream_id);
+
+// Index of a stream in the table
+inline uint32_t vrt_demux_index(const vrt_demux* demux, const vrt_stream_state* stream) {
+    return (uint32_t)(stream - demux->streams);
+}
+
+/* Parse a packet, update the state of its stream and fill vrt_packet like
+ * vrt_process (size in words). *stream is set to the packet's stream (NULL for packets of
+ * streams that are not selected), its handler is called if set. Returns
+ * false if the packet could not be parsed. */
+bool vrt_demux_process(vrt_demux* demux, uint32_t* buffer, uint32_t size, packet_type* vrt_packet, vrt_stream_state** stream);
+
+#endif
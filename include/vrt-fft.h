@@ -0,0 +1,144 @@
+/* FFT helpers: a plan factory with a wisdom cache, single FFTs in double or
+ * single precision, and a batched FFT engine with a worker pool */
+
+#ifndef _VRTFFT_H
+#define _VRTFFT_H
+
+#include <stdint.h>
+
+#include <complex>
+#include <string>
+
+#include <fftw3.h>
+
+#include "vrt-convert.h"
+
+// Default number of FFT blocks transformed at once
+#define VRT_FFT_BATCH 16
+
+enum vrt_fft_precision {
+    VRT_FFT_DOUBLE = 0,     // fftw plans and complex<double> buffers
+    VRT_FFT_FLOAT           // fftwf plans and complex<float> buffers
+};
+
+// Parse a --precision value (double, float)
+bool vrt_parse_fft_precision(const std::string& name, vrt_fft_precision* precision);
+
+enum vrt_fft_effort {
+    VRT_FFT_ESTIMATE = 0,   // FFTW_ESTIMATE, no measurements (default)
+    VRT_FFT_MEASURE,        // FFTW_MEASURE
+    VRT_FFT_PATIENT         // FFTW_PATIENT
+};
+
+// Parse a --fft-effort value (estimate, measure, patient)
+bool vrt_parse_fft_effort(const std::string& name, vrt_fft_effort* effort);
+
+/* Planner effort of all plans made after this call. The wisdom cache is in
+ * wisdom_dir, or when empty in $VRT_FFT_WISDOM, $XDG_CACHE_HOME/vrt-iq-tools
+ * or ~/.cache/vrt-iq-tools. */
+void vrt_fft_set_effort(vrt_fft_effort effort, const std::string& wisdom_dir = "");
+
+// Wisdom cache file of a precision, empty without a cache directory
+std::string vrt_fft_wisdom_file(vrt_fft_precision precision);
+
+/* Plan factory: howmany contiguous transforms of n points, in place when
+ * in == out. The cached wisdom is imported before the first plan of each
+ * precision, so a plan found before (by vrt_fft_wisdom or an earlier run)
+ * is made without measuring. New wisdom is saved to the cache. Unlike plain
+ * FFTW_MEASURE planning, the contents of in and out are kept. */
+fftw_plan vrt_fft_plan(int n, int howmany, fftw_complex* in, fftw_complex* out, int sign,
+    unsigned flags = 0);
+fftwf_plan vrt_fft_plan(int n, int howmany, fftwf_complex* in, fftwf_complex* out, int sign,
+    unsigned flags = 0);
+
+/* Forward FFT of n points, out of place. Only the buffers of the selected
+ * precision are allocated, the others are NULL. */
+struct vrt_fft {
+    vrt_fft_precision precision;
+    uint32_t n;
+    std::complex<double>* in;
+    std::complex<double>* out;
+    std::complex<float>* in_f;
+    std::complex<float>* out_f;
+    fftw_plan plan;
+    fftwf_plan plan_f;
+};
+
+vrt_fft* vrt_fft_create(uint32_t n, vrt_fft_precision precision = VRT_FFT_DOUBLE);
+void vrt_fft_execute(vrt_fft* fft);
+void vrt_fft_destroy(vrt_fft* fft);
+
+// Convert n payload samples to the input, starting at input sample offset
+void vrt_fft_load(vrt_fft* fft, uint32_t offset, const uint32_t* payload, vrt_sample_format format,
+    uint32_t n, double scale = 1.0, bool fftshift = false);
+
+// acc[i] += |out[i]|^2 for all n bins
+void vrt_fft_accumulate_power(const vrt_fft* fft, double* acc);
+
+inline std::complex<double> vrt_fft_input(const vrt_fft* fft, uint32_t i) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        return std::complex<double>(fft->in_f[i]);
+    return fft->in[i];
+}
+
+inline void vrt_fft_set_input(vrt_fft* fft, uint32_t i, std::complex<double> x) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        fft->in_f[i] = std::complex<float>(x);
+    else
+        fft->in[i] = x;
+}
+
+inline std::complex<double> vrt_fft_output(const vrt_fft* fft, uint32_t i) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        return std::complex<double>(fft->out_f[i]);
+    return fft->out[i];
+}
+
+inline double vrt_fft_power(const vrt_fft* fft, uint32_t i) {
+    return std::norm(vrt_fft_output(fft, i));
+}
+
+struct vrt_fft_engine;
+
+/* Forward FFTs of num_bins points. Blocks are collected in a batch that is
+ * transformed with fftw_plan_many_dft, split over threads (the calling
+ * thread is one of them). Every thread accumulates the power of its blocks
+ * in its own partial sums, with phase also the complex spectrum. The batch
+ * is rounded up to a multiple of the number of threads. The partial sums
+ * are double in both precisions, for long integrations. */
+vrt_fft_engine* vrt_fft_engine_create(uint32_t num_bins, uint32_t batch = VRT_FFT_BATCH,
+    uint32_t threads = 1, bool phase = false, vrt_fft_precision precision = VRT_FFT_DOUBLE);
+
+// Input block to fill next, num_bins samples (the one of the engine precision, the other is NULL)
+std::complex<double>* vrt_fft_engine_input(vrt_fft_engine* engine);
+std::complex<float>* vrt_fft_engine_input_f(vrt_fft_engine* engine);
+
+// The input block is complete, the batch is transformed once it is full
+void vrt_fft_engine_push(vrt_fft_engine* engine);
+
+// Per bin statistics of the power of the blocks of an integration
+struct vrt_fft_stats {
+    double* power2;     // sum of the squared power (spectral kurtosis)
+    double* max;        // max hold
+    double* min;        // min hold
+    double* median;     // approximate median, NULL when not estimated
+};
+
+/* Also keep the statistics of the power per bin, in the same pass as the
+ * power sums. The median is a stochastic estimate per thread: a step up or
+ * down of the log power, shrinking with the number of blocks; the threads
+ * are averaged. Call before the first push. */
+void vrt_fft_engine_enable_stats(vrt_fft_engine* engine, bool median);
+
+/* Transform the blocks pushed so far, then add the partial sums of all
+ * threads to magnitudes (and phases_r/phases_i, when not NULL) and reset
+ * them. With statistics enabled, the power2 sums are added to stats and
+ * max, min and median are set (overwritten). Call at the integration
+ * boundary. */
+void vrt_fft_engine_reduce(vrt_fft_engine* engine, double* magnitudes,
+    double* phases_r = NULL, double* phases_i = NULL, const vrt_fft_stats* stats = NULL);
+
+// Stop the worker threads and free the buffers
+void vrt_fft_engine_destroy(vrt_fft_engine* engine);
+
+#endif
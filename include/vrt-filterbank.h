@@ -0,0 +1,38 @@
+/* sigproc filterbank header (https://sigproc.sourceforge.net/): keyword,
+ * value pairs between HEADER_START and HEADER_END, strings prefixed with
+ * their int32 length. The header is followed by rows of nchans float32
+ * values, the channel of fch1 first. */
+
+#ifndef _VRTFILTERBANK_H
+#define _VRTFILTERBANK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+struct vrt_filterbank_header {
+    int32_t machine_id = 0;
+    int32_t telescope_id = 0;
+    int32_t data_type = 1;
+    std::string source_name = "not defined";
+    uint32_t nchans = 0;
+    double fch1 = 0;            // MHz
+    double foff = 0;            // MHz, negative with the highest channel first
+    double tstart = 0;          // MJD
+    double tsamp = 0;           // seconds
+    bool position = false;      // write src_raj, src_dej, az_start and za_start
+    double src_raj = 0, src_dej = 0, az_start = 0, za_start = 0;
+};
+
+/* Set nchans, fch1 and foff for FFT spectra of sample_rate around center_freq
+ * (Hz), the lowest channel first, or the highest with negative_foff */
+void vrt_filterbank_set_band(vrt_filterbank_header* h, double center_freq, double sample_rate,
+    uint32_t nchans, bool negative_foff);
+
+// MJD of a VRT timestamp
+double vrt_filterbank_mjd(uint64_t integer_seconds, uint64_t fractional_seconds);
+
+void vrt_filterbank_write_header(FILE* fp, const vrt_filterbank_header* h);
+
+#endif
@@ -0,0 +1,77 @@
+/* FX correlator of N stations: the input of each station is transformed
+ * once, corrected for the delay and phase of the station, and the cross
+ * spectra of all baselines (and the auto spectra) are accumulated. */
+
+#ifndef _VRTFX_H
+#define _VRTFX_H
+
+#include <stdint.h>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-fft.h"
+
+// Bins of all baselines accumulated per pass, so the spectra stay in the cache
+#define VRT_FX_TILE 512
+
+struct vrt_fx_baseline {
+    uint32_t a;
+    uint32_t b;             // a == b: auto spectrum
+};
+
+// The crosses (a < b) in order 0-1, 0-2, ..., 1-2, ..., then the autos 0-0, 1-1, ...
+std::vector<vrt_fx_baseline> vrt_fx_baselines(uint32_t stations, bool autos = true);
+
+/* Delay model of a station: delay + rate*(t - epoch) seconds, applied to its
+ * signal (a positive delay takes older samples), and a phase offset */
+struct vrt_fx_station {
+    double delay = 0;
+    double rate = 0;
+    double phase = 0;       // degrees
+};
+
+struct vrt_fx;
+
+/* Blocks of all stations are collected in a batch of batch blocks, with
+ * threads > 1 run by a pool of threads workers while the next batch is
+ * filled. The spectra are in precision, the accumulators always double. */
+vrt_fx* vrt_fx_create(uint32_t stations, uint32_t num_bins, bool autos = true,
+    vrt_fft_precision precision = VRT_FFT_DOUBLE, uint32_t batch = 1, uint32_t threads = 1);
+
+/* Time domain input of a station for the next block, num_bins samples (the
+ * one of the correlator precision, the other is NULL) */
+std::complex<double>* vrt_fx_input(vrt_fx* fx, uint32_t station);
+std::complex<float>* vrt_fx_input_f(vrt_fx* fx, uint32_t station);
+
+/* Set the delays (s) and phases (degrees) of the stations. The whole
+ * samples become the shift of each station's input, relative to the least
+ * delayed station (so all shifts are >= 0); the fraction and the fringe
+ * rotation at rf_freq are applied to the spectra of the blocks pushed after. */
+void vrt_fx_set_delays(vrt_fx* fx, const double* delay, const double* phase, double sample_rate, double rf_freq);
+
+// Samples the input of a station is to be taken from further back
+uint32_t vrt_fx_shift(const vrt_fx* fx, uint32_t station);
+
+// The inputs are complete, the batch is transformed and cross multiplied once it is full
+void vrt_fx_push(vrt_fx* fx);
+
+// Process the pushed blocks and wait for them, before the spectra are read
+void vrt_fx_flush(vrt_fx* fx);
+
+const std::vector<vrt_fx_baseline>& vrt_fx_baseline_list(const vrt_fx* fx);
+
+/* Accumulated spectra of baseline b (num_bins, in FFT order) and the sum
+ * of |Xa||Xb| per bin */
+std::complex<double>* vrt_fx_visibility(vrt_fx* fx, uint32_t b);
+const double* vrt_fx_magnitude(const vrt_fx* fx, uint32_t b);
+
+// Divide the cross spectra by the sum of the magnitudes (the autos are kept)
+void vrt_fx_normalize(vrt_fx* fx);
+
+// Clear the accumulated spectra, at the start of an integration
+void vrt_fx_reset(vrt_fx* fx);
+
+void vrt_fx_destroy(vrt_fx* fx);
+
+#endif
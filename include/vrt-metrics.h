@@ -0,0 +1,94 @@
+/* Process metrics in the Prometheus text format */
+
+#ifndef _VRTMETRICS_H
+#define _VRTMETRICS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "vrt-tools.h"
+
+// Interval of the metrics file rewrite in ms
+#define VRT_METRICS_INTERVAL 1000
+
+enum vrt_metrics_stage {
+    VRT_STAGE_RECEIVE = 0,
+    VRT_STAGE_CONVERT,
+    VRT_STAGE_FFT,
+    VRT_STAGE_OUTPUT,
+    VRT_NUM_STAGES
+};
+
+/* Counters of one process. Updated with relaxed atomics, so any thread can
+ * count while the exporter thread reads them. */
+struct vrt_metrics {
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> lost_packets;
+    std::atomic<uint64_t> lost_samples;
+    std::atomic<int64_t> queue_depth;
+    std::atomic<uint64_t> stage_ns[VRT_NUM_STAGES];
+    std::atomic<uint64_t> stage_calls[VRT_NUM_STAGES];
+    std::atomic<int64_t> latency_ns;
+};
+
+// Set by vrt_metrics_start, NULL while metrics are disabled
+extern vrt_metrics* vrt_metrics_global;
+
+/* Enable metrics and start the exporter thread. target is a TCP port
+ * (served over HTTP on all interfaces) or the path of a file that is
+ * rewritten every VRT_METRICS_INTERVAL ms. All metrics get a tool label. */
+bool vrt_metrics_start(const std::string& target, const std::string& tool);
+
+// Metrics in the Prometheus text exposition format
+std::string vrt_metrics_text(const vrt_metrics* metrics, const std::string& tool);
+
+inline uint64_t vrt_metrics_clock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Start of a processing stage, 0 (without reading the clock) when disabled
+inline uint64_t vrt_metrics_stage_begin() {
+    return vrt_metrics_global ? vrt_metrics_clock() : 0;
+}
+
+inline void vrt_metrics_stage_end(vrt_metrics_stage stage, uint64_t begin) {
+    if (vrt_metrics_global == NULL)
+        return;
+    vrt_metrics_global->stage_ns[stage].fetch_add(vrt_metrics_clock() - begin, std::memory_order_relaxed);
+    vrt_metrics_global->stage_calls[stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Count a received data packet and its losses
+inline void vrt_metrics_packet(const packet_type* vrt_packet) {
+    if (vrt_metrics_global == NULL)
+        return;
+    vrt_metrics_global->packets.fetch_add(1, std::memory_order_relaxed);
+    vrt_metrics_global->samples.fetch_add(vrt_packet->num_rx_samps, std::memory_order_relaxed);
+    if (vrt_packet->lost_packets > 0) {
+        vrt_metrics_global->lost_packets.fetch_add(vrt_packet->lost_packets, std::memory_order_relaxed);
+        vrt_metrics_global->lost_samples.fetch_add(vrt_packet->lost_samples, std::memory_order_relaxed);
+    }
+}
+
+// Packets waiting to be received or processed
+inline void vrt_metrics_queue_depth(int64_t depth) {
+    if (vrt_metrics_global)
+        vrt_metrics_global->queue_depth.store(depth, std::memory_order_relaxed);
+}
+
+// Latency of an output from the VRT timestamp of its samples to now
+inline void vrt_metrics_latency(uint64_t integer_seconds, uint64_t fractional_seconds) {
+    if (vrt_metrics_global == NULL)
+        return;
+    int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t timestamp_ns = (int64_t)integer_seconds*1000000000 + (int64_t)(fractional_seconds/1000);
+    vrt_metrics_global->latency_ns.store(now_ns - timestamp_ns, std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,59 @@
+/* Spectral peaks: sub-bin interpolation, the strongest local maxima and
+ * tracking of several peaks from FFT to FFT. */
+
+#ifndef _VRTPEAK_H
+#define _VRTPEAK_H
+
+#include <stdint.h>
+
+#include <complex>
+#include <string>
+#include <vector>
+
+enum vrt_peak_interp {
+    VRT_PEAK_NONE = 0,      // bin center
+    VRT_PEAK_QUADRATIC,     // parabola through the magnitudes
+    VRT_PEAK_GAUSSIAN,      // parabola through the log magnitudes
+    VRT_PEAK_JACOBSEN       // from the complex bins (rectangular window)
+};
+
+// Parse an --interpolation value (none, quadratic, gaussian, jacobsen)
+bool vrt_parse_peak_interp(const std::string& name, vrt_peak_interp* interp);
+
+/* Offset (-0.5 to 0.5 bin) of the peak from the middle of three complex
+ * bins X[0..2], *magnitude is set to the interpolated |X| of the peak */
+double vrt_peak_interpolate(vrt_peak_interp interp, const std::complex<double>* X, double* magnitude);
+
+struct vrt_peak {
+    double bin;             // fractional bin
+    double magnitude;
+};
+
+/* Bins of the count strongest local maxima of magnitude between min_bin and
+ * max_bin (inclusive), strongest first. With count 1 the maximum itself. */
+void vrt_peak_find(const double* magnitude, uint32_t num_bins, uint32_t min_bin, uint32_t max_bin,
+    uint32_t count, std::vector<uint32_t>* bins);
+
+struct vrt_peak_track {
+    bool active = false;    // the slot follows a peak
+    bool present = false;   // the peak was found in the last FFT
+    double bin = 0;
+    double magnitude = 0;
+    uint32_t missed = 0;
+};
+
+/* Peaks follow their track while they move at most max_jump bins per FFT.
+ * A track is kept for hold FFTs without its peak before the slot is given
+ * to a new peak, so a fading signal does not swap places with noise. */
+struct vrt_peak_tracker {
+    double max_jump = 1;
+    uint32_t hold = 0;
+    std::vector<vrt_peak_track> tracks;
+};
+
+void vrt_peak_tracker_init(vrt_peak_tracker* tracker, uint32_t count, double max_jump, uint32_t hold);
+
+// Match the peaks of the next FFT (strongest first) to the tracks
+void vrt_peak_tracker_update(vrt_peak_tracker* tracker, const std::vector<vrt_peak>& peaks);
+
+#endif
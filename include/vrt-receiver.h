@@ -0,0 +1,38 @@
+/* Receive thread with a lock-free single producer, single consumer queue */
+
+#ifndef _VRTRECEIVER_H
+#define _VRTRECEIVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vrt-shm.h"
+
+// Default number of packet slots, each holds a ZMQ_BUFFER_SIZE byte message
+#define VRT_RECEIVER_SLOTS 128
+
+struct vrt_receiver;
+
+/* Start a thread that receives from the ZMQ subscriber (or from shm when
+ * set) into a preallocated ring of num_slots packet slots. The thread waits
+ * for a free slot when the queue is full. With max_latency_ms > 0 packets
+ * that waited longer in the queue are dropped instead of processed. */
+vrt_receiver* vrt_receiver_start(void* subscriber, vrt_shm* shm,
+    uint32_t num_slots = VRT_RECEIVER_SLOTS, uint32_t max_latency_ms = 0);
+
+/* Copy the next packet to buffer (truncated to len like zmq_recv), blocks
+ * until one is available. Returns the packet length, or -1 if interrupted
+ * by a signal. */
+int vrt_receiver_recv(vrt_receiver* receiver, void* buffer, size_t len);
+
+// Packets waiting in the queue
+uint32_t vrt_receiver_occupancy(const vrt_receiver* receiver);
+// Highest number of packets waiting since the start
+uint32_t vrt_receiver_peak_occupancy(const vrt_receiver* receiver);
+// Packets dropped for waiting longer than max_latency_ms
+uint64_t vrt_receiver_dropped(const vrt_receiver* receiver);
+
+// Stop and join the thread, the sockets are not closed
+void vrt_receiver_stop(vrt_receiver* receiver);
+
+#endif
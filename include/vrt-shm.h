@@ -0,0 +1,53 @@
+/* Shared memory VRT packet ring (single producer, multiple consumers) */
+
+#ifndef _VRTSHM_H
+#define _VRTSHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zmq.h>
+
+#include "vrt-tools.h"
+#include "vrt-metrics.h"
+
+// Default ring geometry: slots hold one ZMQ-sized message each
+#define VRT_SHM_SLOT_SIZE ZMQ_BUFFER_SIZE
+#define VRT_SHM_NUM_SLOTS 256
+
+struct vrt_shm;
+
+/* Producer side. Creates (or replaces) the POSIX shared memory object
+ * /<name>. The producer never waits for readers, slow readers get overrun. */
+vrt_shm* vrt_shm_create(const char* name, uint32_t slot_size = VRT_SHM_SLOT_SIZE, uint32_t num_slots = VRT_SHM_NUM_SLOTS);
+// Returns len, or -1 if the packet does not fit in a slot
+int vrt_shm_write(vrt_shm* shm, const void* buffer, size_t len);
+
+/* Consumer side. Each reader keeps its own cursor and starts at the newest
+ * packet. The ring is attached lazily, so readers can start before the
+ * producer (like a ZMQ subscriber). */
+vrt_shm* vrt_shm_open(const char* name);
+/* Blocks until a packet is available, or at most timeout_ms when not
+ * negative. Returns the packet length (truncated to len like zmq_recv), 0 on
+ * a timeout, or -1 if interrupted by a signal. */
+int vrt_shm_read(vrt_shm* shm, void* buffer, size_t len, int timeout_ms = -1);
+// Number of packets this reader lost to overruns
+uint64_t vrt_shm_overruns(const vrt_shm* shm);
+// Number of packets written but not yet read by this reader
+uint64_t vrt_shm_backlog(const vrt_shm* shm);
+
+// Unmaps the ring, the producer also removes the shared memory object
+void vrt_shm_close(vrt_shm* shm);
+
+// Receive from the shared memory ring when shm is set, from the ZMQ socket otherwise
+inline int vrt_recv(void* subscriber, vrt_shm* shm, void* buffer, size_t len) {
+    uint64_t begin = vrt_metrics_stage_begin();
+    int rv = shm ? vrt_shm_read(shm, buffer, len) : zmq_recv(subscriber, buffer, len, 0);
+    vrt_metrics_stage_end(VRT_STAGE_RECEIVE, begin);
+    // ZMQ does not expose its queue length, only the ring backlog is known
+    if (shm and vrt_metrics_global)
+        vrt_metrics_queue_depth(vrt_shm_backlog(shm));
+    return rv;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/* Binary spectral file: a fixed header followed by the ECSV metadata, fixed
+ * size rows and a footer index. Rows are 8 byte aligned, so a reader can
+ * mmap the file and address row i at header_size + i*row_size. All values
+ * are little endian (the host order of all supported platforms). */
+
+#ifndef _VRTSPECTRALFILE_H
+#define _VRTSPECTRALFILE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#define VRT_SPECTRAL_MAGIC "VRTSPEC"
+#define VRT_SPECTRAL_INDEX_MAGIC "VRTINDEX"
+#define VRT_SPECTRAL_VERSION 1
+
+// On disk header, at the start of the file
+struct vrt_spectral_header {
+    char magic[8];              // VRT_SPECTRAL_MAGIC
+    uint32_t version;
+    uint32_t header_size;       // offset of the first row
+    uint32_t metadata_size;     // ECSV metadata text after this header
+    uint32_t row_size;          // bytes per row
+    uint32_t columns;           // float32 values per row (complex: pairs of re, im)
+    uint32_t complex;
+    uint32_t traces;            // float64 trace values per row
+    uint32_t integrations;
+    uint64_t rows;              // 0 until closed
+    uint64_t index_offset;      // offset of the footer index, 0 until closed
+    double sample_rate;
+    double center_freq;
+    double first_freq;          // frequency (or lag) of the first column
+    double column_step;         // frequency (or lag) step between columns
+    double integration_time;
+    char kind[16];              // spectrum, fftmax, xcorr or metadata
+};
+
+/* Row: timestamp, then traces float64 values and columns float32 values
+ * (twice with complex) per plane, padded to 8 bytes */
+struct vrt_spectral_row {
+    int64_t seconds;
+    uint64_t picoseconds;
+};
+
+/* Footer index: VRT_SPECTRAL_INDEX_MAGIC, the number of rows and per row
+ * its timestamp and offset */
+struct vrt_spectral_index_entry {
+    double timestamp;
+    uint64_t offset;
+};
+
+struct vrt_spectral_trace {
+    std::string name;
+    std::string unit;
+};
+
+// Contents of a new file
+struct vrt_spectral_layout {
+    std::string kind;
+    uint32_t columns = 0;
+    bool complex = false;
+    double sample_rate = 0;
+    double center_freq = 0;
+    double first_freq = 0;
+    double column_step = 0;
+    double integration_time = 0;
+    uint32_t integrations = 0;
+    std::vector<vrt_spectral_trace> traces;
+    // names of the planes of columns (e.g. mean, kurtosis), empty for one
+    std::vector<std::string> planes;
+    // extra ECSV meta data (key, value), e.g. the VRT context
+    std::vector<std::pair<std::string, std::string>> meta;
+};
+
+struct vrt_spectral_file;
+
+// Create (truncate) a file and write the header, NULL when it cannot be created
+vrt_spectral_file* vrt_spectral_file_create(const std::string& path, const vrt_spectral_layout& layout);
+
+// Trace and column values (plane after plane) of the next row, filled by the caller
+double* vrt_spectral_file_traces(vrt_spectral_file* file);
+float* vrt_spectral_file_values(vrt_spectral_file* file);
+
+// Write (and flush) the next row
+bool vrt_spectral_file_write(vrt_spectral_file* file, uint64_t seconds, uint64_t picoseconds);
+
+// Write the footer index, update the header and close
+void vrt_spectral_file_close(vrt_spectral_file* file);
+
+/* Read only mapping of a file. The rows of a file that was not closed
+ * (still written, or the writer stopped) follow from the file size, its
+ * index is empty. */
+struct vrt_spectral_map {
+    const vrt_spectral_header* header;
+    const char* metadata;
+    uint64_t rows;
+    const vrt_spectral_index_entry* index;     // NULL without an index
+    const uint8_t* data;
+    size_t size;
+};
+
+vrt_spectral_map* vrt_spectral_file_map(const std::string& path);
+void vrt_spectral_file_unmap(vrt_spectral_map* map);
+
+inline const vrt_spectral_row* vrt_spectral_map_row(const vrt_spectral_map* map, uint64_t row) {
+    return (const vrt_spectral_row*)(map->data + map->header->header_size + row*map->header->row_size);
+}
+
+inline const double* vrt_spectral_row_traces(const vrt_spectral_row* row) {
+    return (const double*)(row + 1);
+}
+
+inline const float* vrt_spectral_row_values(const vrt_spectral_map* map, const vrt_spectral_row* row) {
+    return (const float*)(vrt_spectral_row_traces(row) + map->header->traces);
+}
+
+// First row at or after timestamp, rows when there is none
+uint64_t vrt_spectral_map_find(const vrt_spectral_map* map, double timestamp);
+
+#endif
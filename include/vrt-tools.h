@@ -3,12 +3,20 @@
 #ifndef _VRTTOOLS_H
 #define _VRTTOOLS_H
 
+// Default samples per data packet, producers can choose another size at runtime
 #define VRT_SAMPLES_PER_PACKET 10000
 
-#define SIZE (VRT_SAMPLES_PER_PACKET+7)
-#define VRT_DATA_PACKET_SIZE (VRT_SAMPLES_PER_PACKET+7)
+// The packet_size field in the VRT header counts 32-bit words in 16 bits
+#define VRT_MAX_SAMPLES_PER_PACKET (65535-7)
 
-#define ZMQ_BUFFER_SIZE 100000
+// Data packet size in words (header, stream id, class id, timestamps)
+#define VRT_DATA_PACKET_WORDS(samples) ((samples)+7)
+
+#define SIZE VRT_DATA_PACKET_WORDS(VRT_SAMPLES_PER_PACKET)
+#define VRT_DATA_PACKET_SIZE VRT_DATA_PACKET_WORDS(VRT_SAMPLES_PER_PACKET)
+
+// Receive buffer, large enough for the largest VRT packet
+#define ZMQ_BUFFER_SIZE 262144
 
 #define MAX_CHANNELS    10
 
@@ -32,6 +40,9 @@
 #include <vrt/vrt_read.h>
 
 #include <complex>
+#include <string>
+
+#include "vrt-convert.h"
 
 struct context_type {
     bool context_received;
@@ -52,6 +63,18 @@ struct context_type {
     uint64_t integer_seconds_timestamp;
     uint32_t timestamp_calibration_time;
     int64_t timestamp_adjustment;
+    // previous data packet, for loss detection
+    uint64_t last_data_integer;
+    uint64_t last_data_fractional;
+    uint32_t last_num_samps;
+    uint64_t last_sample;
+    // loss totals of this stream
+    uint64_t lost_packets;
+    uint64_t lost_samples;
+    // payload format from the context
+    vrt_sample_format sample_format;
+    // formats the client takes as they are (bit per format), others are decoded to ci16
+    uint32_t accept_formats;
 };
 
 struct packet_type {
@@ -69,295 +92,118 @@ struct packet_type {
     uint32_t offset;
     uint64_t fractional_seconds_timestamp;
     uint64_t integer_seconds_timestamp;
+    // packets and samples lost before this data packet
+    uint32_t lost_packets;
+    uint64_t lost_samples;
+    // format of the payload in the buffer, ci16 unless accepted by the client
+    vrt_sample_format sample_format;
+    // last sample of the previous data packet (for VRT_LOSS_HOLD), raw payload words
+    uint64_t previous_sample;
+    // gap samples inserted in front of the payload by vrt_fill_loss
+    uint32_t fill_samples;
 };
 
-void init_context(context_type* context) {
-    context->context_received = false;
-    context->context_changed = false;
-    context->last_data_counter = -1;
-    context->rf_freq = 0;
-    context->sample_rate = 0;
-    context->gain = 0;
-    context->bandwidth = 0;
-    context->stream_id = 0;
-    context->starttime_integer = 0;
-    context->starttime_fractional = 0;
-    context->reflock = false;
-    context->time_cal = false;
-    context->timestamp_calibration_time = 0;
-    context->timestamp_adjustment = 0;
-}
+// What clients do with the samples of lost packets
+enum vrt_loss_policy {
+    VRT_LOSS_ABORT = 0,     // stop, unless --continue is given
+    VRT_LOSS_ZERO,          // insert zeros for the missing samples
+    VRT_LOSS_HOLD,          // repeat the last received sample
+    VRT_LOSS_INVALID        // insert zeros and mark the affected output invalid
+};
 
-bool check_packet_count(int8_t counter, context_type* vrt_context) {
-    if ( (vrt_context->last_data_counter > 0) and
-            ( (counter != (vrt_context->last_data_counter+1)%16) and
-              (counter != (vrt_context->last_data_counter  )%16) ) ) {
-        printf("# Error: lost frame (expected %i, received %i)\n", vrt_context->last_data_counter, counter);
-        vrt_context->last_data_counter = counter;
-        return false;
-    } else {
-        vrt_context->last_data_counter = counter;
-        return true;
-    }
-}
+/* Zero-copy view of a received VRT packet. Header and fields are decoded,
+ * the payload is referenced in place in the receive buffer. */
+struct vrt_packet_view {
+    const uint32_t* buffer;
+    int32_t words;
+    struct vrt_header header;
+    struct vrt_fields fields;
+    int32_t payload_offset;
+    int32_t payload_words;
+};
 
-void vrt_print_context(context_type* vrt_context) {
-
-    uint32_t ch=0;
-    while(not (vrt_context->stream_id & (1 << ch) ) )
-            ch++;
-
-    printf("# VRT Context:\n");
-    printf("#    Stream ID (channel): %u (%u)\n", vrt_context->stream_id, ch);
-    printf("#    Sample Rate [samples per second]: %i\n", vrt_context->sample_rate);
-    printf("#    RF Freq [Hz]: %lld\n", (long long int)vrt_context->rf_freq);
-    printf("#    RF frac. Freq [Hz]: %e\n", vrt_context->rf_frac_freq);
-    printf("#    Bandwidth [Hz]: %i\n", vrt_context->bandwidth);
-    printf("#    Gain [dB]: %i\n", vrt_context->gain);
-    printf("#    Ref lock: %s\n", vrt_context->reflock == 1 ? "external" : "internal");
-    printf("#    Time cal: %s\n", vrt_context->time_cal == 1? "pps" : "internal");
-    if (vrt_context->timestamp_calibration_time != 0)
-        printf("#    Cal time: %u\n", vrt_context->timestamp_calibration_time);
-    if (vrt_context->timestamp_adjustment != 0)
-        printf("#    Timestamp adjust: %.9f\n", (double)vrt_context->timestamp_adjustment/1e12);
+bool vrt_view_parse(const uint32_t* buffer, int32_t words, vrt_packet_view* view);
+bool vrt_view_read_if_context(const vrt_packet_view* view, struct vrt_if_context* if_context);
 
+inline const uint32_t* vrt_view_payload(const vrt_packet_view* view) {
+    return view->buffer + view->payload_offset;
 }
 
-bool vrt_process(uint32_t* buffer, uint32_t size, context_type* vrt_context, packet_type* vrt_packet) {
-
-    struct vrt_header h;
-    struct vrt_fields f;
-
-    int32_t offset = 0;
-    int32_t rv = vrt_read_header(buffer + offset, size - offset, &h, true);
-
-    vrt_packet->context = false;
-    vrt_packet->data = false;
-    vrt_packet->extended_context = false;
-
-    /* Parse header */
-    if (rv < 0) {
-        fprintf(stderr, "Failed to parse header: %s\n", vrt_string_error(rv));
-        return false;
-    }
-    offset += rv;
-
-    if (h.packet_type == VRT_PT_IF_CONTEXT) {
-        // Context
-
-        /* Parse fields */
-        rv = vrt_read_fields(&h, buffer + offset, size - offset, &f, true);
-        if (rv < 0) {
-            fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
-            return false;
-        }
-        offset += rv;
-
-        vrt_context->stream_id = f.stream_id;
-
-        if (f.stream_id & vrt_packet->channel_filt) {
-            struct vrt_if_context c;
-            rv = vrt_read_if_context(buffer + offset, ZMQ_BUFFER_SIZE - offset, &c, true);
-            if (rv < 0) {
-                fprintf(stderr, "Failed to parse IF context section: %s\n", vrt_string_error(rv));
-                return false;
-            }
-
-            vrt_context->integer_seconds_timestamp = f.integer_seconds_timestamp;
-            vrt_context->fractional_seconds_timestamp = f.fractional_seconds_timestamp;
-            if (c.has.sample_rate)
-                vrt_context->sample_rate = (uint32_t)round(c.sample_rate);
-
-            if (c.has.rf_reference_frequency) {
-                vrt_context->rf_freq = (int64_t)round(c.rf_reference_frequency);
-                vrt_context->rf_frac_freq = c.rf_reference_frequency - (double)vrt_context->rf_freq;
-            }
-
-            if (c.has.bandwidth)
-                vrt_context->bandwidth = c.bandwidth;
-
-            if (c.has.gain)
-                vrt_context->gain = c.gain.stage1;
-
-            if (c.state_and_event_indicators.has.reference_lock)
-                vrt_context->reflock = c.state_and_event_indicators.reference_lock;
-
-            if (c.state_and_event_indicators.has.calibrated_time)
-                vrt_context->time_cal = c.state_and_event_indicators.calibrated_time;
-
-            if (c.has.temperature)
-                vrt_context->temperature = c.temperature;
-
-            if (c.has.timestamp_calibration_time)
-                vrt_context->timestamp_calibration_time = c.timestamp_calibration_time;
-
-            if (c.has.timestamp_adjustment)
-                vrt_context->timestamp_adjustment = c.timestamp_adjustment;
-
-            vrt_context->context_changed = c.context_field_change_indicator;
-            vrt_packet->context = true;
-            vrt_context->context_received = true;
-            vrt_packet->stream_id = f.stream_id;
-
-            vrt_packet->oui = f.class_id.oui;
-            vrt_packet->information_class_code = f.class_id.information_class_code;
-            vrt_packet->packet_class_code = f.class_id.packet_class_code;
-
-        }
-    } else if (h.packet_type == VRT_PT_IF_DATA_WITH_STREAM_ID) {
-        // Data
-        /* Parse fields */
-        rv = vrt_read_fields(&h, buffer + offset, ZMQ_BUFFER_SIZE - offset, &f, true);
-        if (rv < 0) {
-            fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
-            return false;
-        }
-        offset += rv;
-        if (f.stream_id & vrt_packet->channel_filt) {
-
-            if (not check_packet_count(h.packet_count, vrt_context))
-                vrt_packet->lost_frame = true;
-            else
-                vrt_packet->lost_frame = false;
-
-            vrt_packet->integer_seconds_timestamp = f.integer_seconds_timestamp;
-            vrt_packet->fractional_seconds_timestamp = f.fractional_seconds_timestamp;
-            vrt_packet->num_rx_samps = (h.packet_size-offset);
-            vrt_packet->offset = offset;
-            vrt_packet->stream_id = f.stream_id;
-            vrt_packet->data = true;
-
-            vrt_packet->oui = f.class_id.oui;
-            vrt_packet->information_class_code = f.class_id.information_class_code;
-            vrt_packet->packet_class_code = f.class_id.packet_class_code;
-
-            if (vrt_packet->first_frame) {
-                vrt_context->starttime_integer = f.integer_seconds_timestamp;
-                vrt_context->starttime_fractional = f.fractional_seconds_timestamp;
-                vrt_packet->first_frame = false;
-            }
-        }
-    } else if (h.packet_type == VRT_PT_EXT_CONTEXT) {
-
-         /* Parse fields */
-        rv = vrt_read_fields(&h, buffer + offset, size - offset, &f, true);
-        if (rv < 0) {
-            fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
-            return false;
-        }
-        offset += rv;
-
-        vrt_packet->integer_seconds_timestamp = f.integer_seconds_timestamp;
-        vrt_packet->fractional_seconds_timestamp = f.fractional_seconds_timestamp;
-        vrt_packet->num_rx_samps = (h.packet_size-offset);
-        vrt_packet->offset = offset;
-        vrt_packet->stream_id = f.stream_id;
-
-        vrt_packet->oui = f.class_id.oui;
-        vrt_packet->information_class_code = f.class_id.information_class_code;
-        vrt_packet->packet_class_code = f.class_id.packet_class_code;
-
-        vrt_packet->extended_context = true;
-    }
-
-    return true;
+inline const std::complex<int16_t>* vrt_view_samples(const vrt_packet_view* view) {
+    return reinterpret_cast<const std::complex<int16_t>*>(view->buffer + view->payload_offset);
 }
 
-void vrt_init_data_packet(struct vrt_packet* p) {
+void init_context(context_type* context);
+
+bool check_packet_count(int8_t counter, context_type* vrt_context);
+
+/* Loss detection for a data packet from the 4-bit packet counter and the
+ * timestamp gap to the previous packet of the stream (which also catches
+ * losses of a multiple of 16 packets). Fills lost_packets, lost_samples and
+ * previous_sample, updates the stream totals. Returns true if packets were lost.
+ * Called after vrt_decode_payload, counts and keeps samples (the last sample
+ * of ci16 and cf32 payloads only, accepted packed payloads are not read). */
+bool vrt_check_loss(const vrt_packet_view* view, context_type* vrt_context, packet_type* vrt_packet);
+
+// Parse a --loss-policy value (abort, zero, hold, invalid)
+bool vrt_parse_loss_policy(const std::string& name, vrt_loss_policy* policy);
+
+// Parse a --format value (ci16, ci8, ci12, cf32)
+bool vrt_parse_sample_format(const std::string& name, vrt_sample_format* format);
+const char* vrt_sample_format_name(vrt_sample_format format);
+
+/* Decode the payload of a data packet (offset and num_rx_samps in words, as
+ * set by vrt_view_packet_info) in place to ci16 words, unless the format is in
+ * accept_formats of the context. Sets sample_format and num_rx_samps (now in
+ * samples) of the packet. Samples beyond buffer_words are dropped. */
+void vrt_decode_payload(uint32_t* buffer, uint32_t buffer_words, const context_type* vrt_context, packet_type* vrt_packet);
+
+/* Apply the loss policy to a data packet with lost samples: the payload is
+ * moved back in the receive buffer (buffer_words long) and the gap filled in
+ * front of it, offset, num_rx_samps and the timestamp then include the gap.
+ * Gaps larger than the free buffer space are only partly filled. Returns
+ * false if the client should stop (VRT_LOSS_ABORT). */
+bool vrt_fill_loss(uint32_t* buffer, uint32_t buffer_words, const context_type* vrt_context, packet_type* vrt_packet, vrt_loss_policy policy);
+
+// Sample i of a ci16 or cf32 payload as a ci16 word (for level statistics)
+inline uint32_t vrt_payload_sample(const uint32_t* payload, vrt_sample_format format, uint32_t i) {
+    if (format != VRT_FORMAT_CF32)
+        return payload[i];
+    uint32_t sample;
+    vrt_cf32_to_ci16(payload + 2*i, &sample, 1);
+    return sample;
+}
 
-    p->header.packet_type         = VRT_PT_IF_DATA_WITH_STREAM_ID;
+void vrt_print_context(context_type* vrt_context);
 
-    p->header.packet_size         = SIZE;
-    p->header.tsm                 = VRT_TSM_FINE;
-    p->header.tsi                 = VRT_TSI_OTHER; // unix time
-    p->header.tsf                 = VRT_TSF_REAL_TIME;
-    p->fields.stream_id           = 0;
-    p->words_body                 = VRT_SAMPLES_PER_PACKET;
+/* Parse a packet in buffer, size is the buffer length in words (ZMQ_BUFFER_SIZE
+ * for a receive buffer): compact payloads are decoded in place and grow up to
+ * that bound. */
+bool vrt_process(uint32_t* buffer, uint32_t size, context_type* vrt_context, packet_type* vrt_packet);
 
-    p->header.has.class_id        = true;
-    p->fields.class_id.oui        = 0xFF5454;
-    p->fields.class_id.information_class_code = 0;
-    p->fields.class_id.packet_class_code = 0;
+// Building blocks of vrt_process, shared with the multi-stream demux
+void vrt_apply_if_context(const vrt_packet_view* view, const struct vrt_if_context* c, context_type* vrt_context);
+void vrt_view_packet_info(const vrt_packet_view* view, packet_type* vrt_packet);
 
-    p->header.has.trailer         = false;
-}
+// The body holds vrt_payload_words(samples_per_packet, format) words, see vrt_ci16_to_payload
+void vrt_init_data_packet(struct vrt_packet* p, uint32_t samples_per_packet = VRT_SAMPLES_PER_PACKET,
+    vrt_sample_format format = VRT_FORMAT_CI16);
 
-void vrt_init_context_packet(struct vrt_packet* pc) {
-
-    pc->header.packet_type = VRT_PT_IF_CONTEXT;
-    pc->header.has.class_id = true;
-
-    pc->fields.class_id.oui        = 0xFF5454;
-    pc->fields.class_id.information_class_code = 0;
-    pc->fields.class_id.packet_class_code = 0;
-
-    pc->if_context.has.bandwidth   = true;
-    pc->if_context.has.sample_rate = true;
-    pc->if_context.has.reference_point_identifier = true;
-    pc->if_context.has.if_reference_frequency = true;
-    pc->if_context.has.rf_reference_frequency = true;
-    pc->if_context.has.if_band_offset = true;
-    pc->if_context.has.reference_level = true;
-    pc->if_context.has.gain = true;
-    pc->if_context.has.timestamp_adjustment = true;
-    pc->if_context.has.timestamp_calibration_time = true;
-    pc->if_context.has.state_and_event_indicators = true;
-    pc->if_context.has.data_packet_payload_format = true;
-
-    pc->if_context.data_packet_payload_format.packing_method = VRT_PM_LINK_EFFICIENT;
-    pc->if_context.data_packet_payload_format.real_or_complex = VRT_ROC_COMPLEX_CARTESIAN;
-    pc->if_context.data_packet_payload_format.data_item_format = VRT_DIF_SIGNED_FIXED_POINT;
-    pc->if_context.data_packet_payload_format.sample_component_repeat = false;
-    pc->if_context.data_packet_payload_format.item_packing_field_size = 31;
-    pc->if_context.data_packet_payload_format.data_item_size = 15;
-
-    pc->header.tsm                 = VRT_TSM_COARSE;
-    pc->header.tsi                 = VRT_TSI_OTHER; // unix time
-    pc->header.tsf                 = VRT_TSF_REAL_TIME;
-
-    pc->if_context.state_and_event_indicators.has.reference_lock = true;
-    pc->if_context.state_and_event_indicators.has.calibrated_time = true;
+/* Check a requested packet size (in samples), prints a message if it is out
+ * of range. Packed formats need a multiple of their samples per word group. */
+bool vrt_valid_packet_size(uint32_t samples_per_packet, vrt_sample_format format = VRT_FORMAT_CI16);
 
-}
+// Advertises the payload format in the data packet payload format field
+void vrt_init_context_packet(struct vrt_packet* pc, vrt_sample_format format = VRT_FORMAT_CI16);
 
+// Rate and level statistics, buffer holds num_rx_samps samples of the format
 void show_progress_stats(
     std::chrono::time_point<std::chrono::steady_clock> now,
     std::chrono::time_point<std::chrono::steady_clock> *last_update,
     uint64_t *last_update_samps,
     uint32_t *buffer,
     size_t num_rx_samps,
-    uint32_t channel) {
-
-    *last_update_samps += num_rx_samps;
-
-    const auto time_since_last_update = now - *last_update;
-    if (time_since_last_update > std::chrono::seconds(1)) {
-        const double time_since_last_update_s =
-            std::chrono::duration<double>(time_since_last_update).count();
-        const double rate = double(*last_update_samps) / time_since_last_update_s;
-        *last_update_samps = 0;
-        *last_update       = now;
-
-        double max_iq = 0;
-        uint32_t clip_iq = 0;
-
-        double datatype_max = 32767.;
-
-        for (int i=0; i < num_rx_samps; i++ ) {
-            std::complex<int16_t> sample = (std::complex<int16_t>)buffer[i];
-            max_iq = fmax(max_iq, fmax(fabs(sample.real()), fabs(sample.imag())));
-            if (fabs(sample.real()) > datatype_max*0.99 || fabs(sample.imag()) > datatype_max*0.99)
-                clip_iq++;
-        }
-        std::cout << "\t" << boost::format("%.6f") % (rate / 1e6) << " Msps, ";
-        std::cout << "CH" << boost::format("%u") % channel << ": ";
-        std::cout << boost::format("%3.0f") % (20*log10(max_iq/datatype_max)) << " dBFS (";
-        std::cout << boost::format("%2.0f") % ceil(log2(max_iq)+1) << "/";
-        std::cout << (int)ceil(log2(datatype_max)+1) << " bits), ";
-        std::cout << "" << boost::format("%2.0f") % (100.0*clip_iq/num_rx_samps) << "% clip. ";
-        std::cout << std::endl;
-    }
-
-}
+    uint32_t channel,
+    vrt_sample_format format = VRT_FORMAT_CI16);
 
 #endif
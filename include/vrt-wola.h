@@ -0,0 +1,54 @@
+/* Weighted overlap-add (WOLA) filterbank: the input of a polyphase FFT
+ * filterbank, kept in a ring buffer. With one partition it is a sliding
+ * window for overlapped, windowed FFT segments (Welch). */
+
+#ifndef _VRTWOLA_H
+#define _VRTWOLA_H
+
+#include <stdint.h>
+
+#include <complex>
+#include <string>
+
+enum vrt_window {
+    VRT_WINDOW_RECT = 0,
+    VRT_WINDOW_HANN,
+    VRT_WINDOW_BLACKMAN_HARRIS,
+    VRT_WINDOW_FLAT_TOP
+};
+
+// Parse a --window value (rect, hann, blackman-harris, flat-top)
+bool vrt_parse_window(const std::string& name, vrt_window* window);
+
+/* Taps of a frame of partitions*num_bins samples. One partition: the window,
+ * scaled to a mean power of 1 so the noise level of a spectrum does not
+ * depend on the window. More partitions: a sinc low pass of one bin wide
+ * times the window (unscaled). */
+void vrt_wola_taps(float* taps, uint32_t num_bins, uint32_t partitions, vrt_window window);
+
+struct vrt_wola;
+
+/* Frames of partitions*num_bins samples, weighted and folded to num_bins
+ * samples for an FFT of num_bins points. A new frame starts every hop
+ * samples (hop == num_bins: no overlap). taps holds partitions*num_bins
+ * weights, NULL selects vrt_wola_taps with a Blackman-Harris window. */
+vrt_wola* vrt_wola_create(uint32_t num_bins, uint32_t partitions, uint32_t hop = 0, const float* taps = NULL);
+
+// Input block to fill next, hop samples
+std::complex<float>* vrt_wola_input(vrt_wola* wola);
+
+// The input block is complete
+void vrt_wola_push(vrt_wola* wola);
+
+// A full frame of samples has been pushed since the start
+bool vrt_wola_full(const vrt_wola* wola);
+
+// Weighted sum of the last partitions*num_bins samples, num_bins samples to out
+void vrt_wola_output(const vrt_wola* wola, std::complex<float>* out);
+void vrt_wola_output(vrt_wola* wola, std::complex<double>* out);
+
+uint32_t vrt_wola_hop(const vrt_wola* wola);
+
+void vrt_wola_destroy(vrt_wola* wola);
+
+#endif
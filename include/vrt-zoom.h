@@ -0,0 +1,38 @@
+/* Zoom FFT front end: mix a band to baseband, low pass filter and decimate,
+ * so a narrow band can be transformed with a small FFT at the same bin size. */
+
+#ifndef _VRTZOOM_H
+#define _VRTZOOM_H
+
+#include <stdint.h>
+
+#include <complex>
+
+// Filter taps per unit of decimation
+#define VRT_ZOOM_TAPS 32
+
+// Usable fraction of the output sample rate (flat and free of aliases)
+#define VRT_ZOOM_PASSBAND 0.6
+
+/* Largest decimation whose usable band holds bandwidth. With an integer
+ * sample rate the decimation is a divisor, so the output rate is an integer
+ * too (1 Hz bins in a one second FFT). */
+uint32_t vrt_zoom_decimation(double sample_rate, double bandwidth);
+
+struct vrt_zoom;
+
+/* Shift offset (Hz) to 0 Hz and decimate. The low pass cuts off at 0.4 of
+ * the output sample rate and has unit gain, so a tone keeps its amplitude. */
+vrt_zoom* vrt_zoom_create(double sample_rate, double offset, uint32_t decimation);
+
+/* Mix, filter and decimate n input samples. Returns the number of output
+ * samples (at most n/decimation + 1); the filter state carries over to the
+ * next call, so the blocks may have any size. */
+uint32_t vrt_zoom_process(vrt_zoom* zoom, const std::complex<float>* in, uint32_t n, std::complex<float>* out);
+
+double vrt_zoom_sample_rate(const vrt_zoom* zoom);
+uint32_t vrt_zoom_factor(const vrt_zoom* zoom);
+
+void vrt_zoom_destroy(vrt_zoom* zoom);
+
+#endif
@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "dt-extended-context.h"
+
+bool dt_process(uint32_t* buffer, uint32_t size, packet_type* vrt_packet, dt_ext_context_type* dt_ext_context) {
+
+    if (vrt_packet->oui == 0xFF0042) { // add information and packet class checks
+
+        dt_ext_context->stream_id = vrt_packet->stream_id;
+        dt_ext_context->fractional_seconds_timestamp = vrt_packet->fractional_seconds_timestamp;
+        dt_ext_context->integer_seconds_timestamp = vrt_packet->integer_seconds_timestamp;
+
+        memcpy(&dt_ext_context->azimuth, (char*)&buffer[vrt_packet->offset], sizeof(float));
+        memcpy(&dt_ext_context->elevation, (char*)&buffer[vrt_packet->offset+1], sizeof(float));
+        memcpy(&dt_ext_context->azimuth_error, (char*)&buffer[vrt_packet->offset+2], sizeof(float));
+        memcpy(&dt_ext_context->elevation_error, (char*)&buffer[vrt_packet->offset+3], sizeof(float));
+        memcpy(&dt_ext_context->azimuth_speed, (char*)&buffer[vrt_packet->offset+4], sizeof(float));
+        memcpy(&dt_ext_context->elevation_speed, (char*)&buffer[vrt_packet->offset+5], sizeof(float));
+        memcpy(&dt_ext_context->focusbox, (char*)&buffer[vrt_packet->offset+6], sizeof(float));
+        memcpy(&dt_ext_context->azimuth_offset, (char*)&buffer[vrt_packet->offset+8], sizeof(float));
+        memcpy(&dt_ext_context->elevation_offset, (char*)&buffer[vrt_packet->offset+9], sizeof(float));
+        memcpy(&dt_ext_context->ra_setpoint, (char*)&buffer[vrt_packet->offset+10], sizeof(float));
+        memcpy(&dt_ext_context->dec_setpoint, (char*)&buffer[vrt_packet->offset+11], sizeof(float));
+        memcpy(&dt_ext_context->ra_current, (char*)&buffer[vrt_packet->offset+12], sizeof(float));
+        memcpy(&dt_ext_context->dec_current, (char*)&buffer[vrt_packet->offset+13], sizeof(float));
+        memcpy(&dt_ext_context->model_a0, (char*)&buffer[vrt_packet->offset+14], sizeof(float));
+        memcpy(&dt_ext_context->model_c1, (char*)&buffer[vrt_packet->offset+15], sizeof(float));
+        memcpy(&dt_ext_context->model_c2, (char*)&buffer[vrt_packet->offset+16], sizeof(float));
+        memcpy(&dt_ext_context->model_e0, (char*)&buffer[vrt_packet->offset+17], sizeof(float));
+        memcpy(&dt_ext_context->model_b, (char*)&buffer[vrt_packet->offset+18], sizeof(float));
+        memcpy(&dt_ext_context->model_za, (char*)&buffer[vrt_packet->offset+19], sizeof(float));
+        memcpy(&dt_ext_context->model_aa, (char*)&buffer[vrt_packet->offset+20], sizeof(float));
+
+        dt_ext_context->active_tracker = (buffer[vrt_packet->offset+7]) & 0x0F;
+        dt_ext_context->tracking_enabled = (buffer[vrt_packet->offset+7] >> 8) & (1<<7);
+        dt_ext_context->refraction = (buffer[vrt_packet->offset+7] >> 8) & (1<<6);
+        dt_ext_context->dt_model = (buffer[vrt_packet->offset+7] >> 8) & (1<<5);
+        dt_ext_context->refraction_j2000 = (buffer[vrt_packet->offset+7] >> 8) & (1<<1);
+        dt_ext_context->dt_model_j2000 = (buffer[vrt_packet->offset+7] >> 8) & (1<<0);
+
+        dt_ext_context->dt_ext_context_received = true;
+        return true;
+    } else
+        return false;
+}
+
+float haversine(float dec1, float dec2, float ra1, float ra2) {
+
+    float dec_delta = dec2 - dec1;
+    float ra_delta = ra2 - ra1;
+
+    float a =
+      pow(sin(dec_delta / 2), 2) + cos(dec1) * cos(dec2) * pow(sin(ra_delta / 2), 2);
+    float c = 2 * atan2(sqrt(a), sqrt(1 - a));
+    return(c);
+}
+
+float bearing(float dec1, float dec2, float ra1, float ra2) {
+
+    float b = atan2(cos(dec1)*sin(dec2)-sin(dec1)*cos(dec2)*cos(ra2-ra1), sin(ra2-ra1)*cos(dec2));
+    return b;
+}
+
+const char* const dt_trace_names[DT_TRACE_COLUMNS] = {
+    "current_az_deg", "current_el_deg", "current_az_error_deg", "current_el_error_deg",
+    "current_az_speed_deg", "current_el_speed_deg", "current_az_offset_deg", "current_el_offset_deg",
+    "current_ra_h", "current_dec_deg", "setpoint_ra_h", "setpoint_dec_deg",
+    "radec_error_angle_deg", "radec_error_bearing_deg", "focusbox_mm"
+};
+
+const char* const dt_trace_units[DT_TRACE_COLUMNS] = {
+    "deg", "deg", "deg", "deg", "deg", "deg", "deg", "deg",
+    "h", "deg", "h", "deg", "deg", "deg", "mm"
+};
+
+void dt_trace_values(const dt_ext_context_type* dt_ext_context, double* values) {
+    values[0] = (180.0/M_PI)*dt_ext_context->azimuth;
+    values[1] = (180.0/M_PI)*dt_ext_context->elevation;
+    values[2] = (180.0/M_PI)*dt_ext_context->azimuth_error;
+    values[3] = (180.0/M_PI)*dt_ext_context->elevation_error;
+    values[4] = (180.0/M_PI)*dt_ext_context->azimuth_speed;
+    values[5] = (180.0/M_PI)*dt_ext_context->elevation_speed;
+    values[6] = (180.0/M_PI)*dt_ext_context->azimuth_offset;
+    values[7] = (180.0/M_PI)*dt_ext_context->elevation_offset;
+    values[8] = (12.0/M_PI)*dt_ext_context->ra_current;
+    values[9] = (180.0/M_PI)*dt_ext_context->dec_current;
+    values[10] = (12.0/M_PI)*dt_ext_context->ra_setpoint;
+    values[11] = (180.0/M_PI)*dt_ext_context->dec_setpoint;
+    values[12] = (180.0/M_PI)*haversine(dt_ext_context->dec_setpoint, dt_ext_context->dec_current,
+        dt_ext_context->ra_setpoint, dt_ext_context->ra_current);
+    values[13] = (180.0/M_PI)*bearing(dt_ext_context->dec_setpoint, dt_ext_context->dec_current,
+        dt_ext_context->ra_setpoint, dt_ext_context->ra_current);
+    values[14] = dt_ext_context->focusbox;
+}
@@ -0,0 +1,265 @@
+/* Timestamp alignment
+ *
+ * Sample index i of a stream is at epoch + i/sample_rate, the epoch being
+ * the integer second of the first packet of any stream, and lives in slot
+ * i & mask of its ring. The valid samples of a stream are those of the
+ * last capacity indices before its head (one past its newest sample).
+ *
+ * A stream s is read at position - shift[s]. The read position is bounded
+ * by the stream that is furthest behind, unless the one furthest ahead
+ * would overwrite samples that have not been read yet: then the position
+ * is moved on and the missing samples are released as zeros, so a stalled
+ * station cannot block the others or grow the buffers. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "vrt-align.h"
+#include "vrt-convert.h"
+
+struct align_stream {
+    bool started;
+    int64_t first;          // index of the first sample
+    int64_t head;           // one past the newest sample
+    uint64_t missing;
+};
+
+struct vrt_align {
+    uint32_t streams;
+    double sample_rate;
+    uint32_t capacity;
+    uint32_t mask;
+    uint32_t max_packet;
+    bool has_epoch;
+    int64_t epoch;
+    bool aligned;
+    int64_t position;
+    std::vector<align_stream> state;
+    std::vector<uint32_t*> rings;
+    std::vector<uint32_t> shift;    // of the last vrt_align_ready
+};
+
+static uint32_t ring_size(uint32_t samples) {
+    uint32_t size = 1;
+    while (size < samples)
+        size <<= 1;
+    return size;
+}
+
+vrt_align* vrt_align_create(uint32_t streams, double sample_rate, uint32_t capacity) {
+
+    if (streams == 0 or sample_rate <= 0) {
+        printf("Invalid number of streams or sample rate for the alignment.\n");
+        return NULL;
+    }
+
+    vrt_align* align = new vrt_align();
+    align->streams = streams;
+    align->sample_rate = sample_rate;
+    align->capacity = ring_size(std::max<uint32_t>(capacity, 2));
+    align->mask = align->capacity - 1;
+    align->max_packet = 0;
+    align->has_epoch = false;
+    align->epoch = 0;
+    align->aligned = false;
+    align->position = 0;
+    align->state.assign(streams, align_stream());
+    align->shift.assign(streams, 0);
+    for (uint32_t s = 0; s < streams; s++) {
+        align->state[s] = {false, 0, 0, 0};
+        align->rings.push_back((uint32_t*) calloc(align->capacity, sizeof(uint32_t)));
+    }
+    return align;
+}
+
+void vrt_align_reserve(vrt_align* align, uint32_t samples) {
+
+    if (samples <= align->capacity)
+        return;
+    uint32_t capacity = ring_size(samples);
+    uint32_t mask = capacity - 1;
+    for (uint32_t s = 0; s < align->streams; s++) {
+        uint32_t* ring = (uint32_t*) calloc(capacity, sizeof(uint32_t));
+        const align_stream& stream = align->state[s];
+        if (stream.started)
+            for (int64_t i = std::max(stream.first, stream.head - (int64_t)align->capacity); i < stream.head; i++)
+                ring[i & mask] = align->rings[s][i & align->mask];
+        free(align->rings[s]);
+        align->rings[s] = ring;
+    }
+    align->capacity = capacity;
+    align->mask = mask;
+}
+
+// Store n samples (or zeros when samples is NULL) at index on
+static void store(vrt_align* align, uint32_t s, int64_t index, const uint32_t* samples, uint32_t n) {
+    uint32_t* ring = align->rings[s];
+    while (n > 0) {
+        uint32_t slot = index & align->mask;
+        uint32_t run = std::min(n, align->capacity - slot);
+        if (samples) {
+            memcpy(&ring[slot], samples, run*sizeof(uint32_t));
+            samples += run;
+        } else {
+            memset(&ring[slot], 0, run*sizeof(uint32_t));
+        }
+        index += run;
+        n -= run;
+    }
+}
+
+void vrt_align_push(vrt_align* align, uint32_t s, uint64_t seconds, uint64_t picoseconds,
+    const uint32_t* samples, uint32_t n) {
+
+    if (n == 0)
+        return;
+    if (not align->has_epoch) {
+        align->epoch = (int64_t)seconds;
+        align->has_epoch = true;
+    }
+
+    // a packet must fit several times, so the read position can lag one
+    align->max_packet = std::max(align->max_packet, n);
+    vrt_align_reserve(align, 4*align->max_packet);
+
+    double offset = (double)((int64_t)seconds - align->epoch) + (double)picoseconds/1e12;
+    int64_t index = llround(offset*align->sample_rate);
+    int64_t end = index + n;
+
+    align_stream& stream = align->state[s];
+    if (not stream.started) {
+        stream.started = true;
+        stream.first = index;
+        stream.head = index;
+    }
+
+    // older than the ring keeps
+    int64_t oldest = std::max(end, stream.head) - (int64_t)align->capacity;
+    if (end <= oldest)
+        return;
+    if (index < oldest) {
+        samples += oldest - index;
+        index = oldest;
+    }
+    if (index > stream.head) {
+        int64_t gap = std::max(stream.head, oldest);
+        store(align, s, gap, NULL, (uint32_t)(index - gap));
+    }
+    stream.first = std::min(stream.first, index);
+    store(align, s, index, samples, (uint32_t)(end - index));
+    stream.head = std::max(stream.head, end);
+}
+
+uint32_t vrt_align_ready(vrt_align* align, const uint32_t* shift, uint32_t max) {
+
+    for (uint32_t s = 0; s < align->streams; s++) {
+        if (not align->state[s].started)
+            return 0;
+        align->shift[s] = shift[s];
+    }
+
+    if (not align->aligned) {
+        align->position = INT64_MIN;
+        for (uint32_t s = 0; s < align->streams; s++)
+            align->position = std::max(align->position, align->state[s].first + shift[s]);
+        align->aligned = true;
+    }
+
+    int64_t behind = INT64_MAX, ahead = INT64_MIN;
+    for (uint32_t s = 0; s < align->streams; s++) {
+        int64_t available = align->state[s].head + shift[s] - align->position;
+        behind = std::min(behind, available);
+        ahead = std::max(ahead, available);
+    }
+
+    // room for the next packet of the stream furthest ahead
+    int64_t limit = (int64_t)align->capacity - align->max_packet;
+    int64_t ready = std::max(behind, ahead - limit);
+    return (uint32_t)std::max<int64_t>(0, std::min<int64_t>(ready, max));
+}
+
+int64_t vrt_align_position(const vrt_align* align) {
+    return align->position;
+}
+
+// Valid samples of index..index+n: [*begin, *end), relative to index
+static void valid_range(const vrt_align* align, uint32_t s, int64_t index, uint32_t n, uint32_t* begin, uint32_t* end) {
+    const align_stream& stream = align->state[s];
+    int64_t lo = std::max(stream.first, stream.head - (int64_t)align->capacity);
+    int64_t first = std::min<int64_t>(std::max<int64_t>(lo - index, 0), n);
+    int64_t last = std::min<int64_t>(std::max<int64_t>(stream.head - index, first), n);
+    *begin = (uint32_t)first;
+    *end = (uint32_t)last;
+}
+
+static void ci16_to_cf(const uint32_t* in, std::complex<double>* out, size_t n, double scale) {
+    vrt_ci16_to_cf64(in, out, n, scale);
+}
+
+static void ci16_to_cf(const uint32_t* in, std::complex<float>* out, size_t n, float scale) {
+    vrt_ci16_to_cf32(in, out, n, scale);
+}
+
+template <typename T>
+static void read_samples(const vrt_align* align, uint32_t s, int64_t index, uint32_t n, std::complex<T>* out, T scale) {
+
+    uint32_t begin, end;
+    valid_range(align, s, index, n, &begin, &end);
+    std::fill(out, out + begin, std::complex<T>(0));
+    std::fill(out + end, out + n, std::complex<T>(0));
+
+    for (uint32_t i = begin; i < end; ) {
+        uint32_t slot = (index + i) & align->mask;
+        uint32_t run = std::min(end - i, align->capacity - slot);
+        ci16_to_cf(&align->rings[s][slot], out + i, run, scale);
+        i += run;
+    }
+}
+
+void vrt_align_read(const vrt_align* align, uint32_t stream, int64_t index, uint32_t n,
+    std::complex<double>* out, double scale) {
+    read_samples(align, stream, index, n, out, scale);
+}
+
+void vrt_align_read(const vrt_align* align, uint32_t stream, int64_t index, uint32_t n,
+    std::complex<float>* out, float scale) {
+    read_samples(align, stream, index, n, out, scale);
+}
+
+void vrt_align_advance(vrt_align* align, uint32_t n) {
+    for (uint32_t s = 0; s < align->streams; s++) {
+        uint32_t begin, end;
+        valid_range(align, s, align->position - align->shift[s], n, &begin, &end);
+        align->state[s].missing += n - (end - begin);
+    }
+    align->position += n;
+}
+
+void vrt_align_time(const vrt_align* align, int64_t index, int64_t* seconds, int64_t* picoseconds) {
+    double offset = (double)index/align->sample_rate;
+    int64_t whole = (int64_t)floor(offset);
+    int64_t frac = llround((offset - (double)whole)*1e12);
+    if (frac >= (int64_t)1e12) {
+        frac -= (int64_t)1e12;
+        whole++;
+    }
+    *seconds = align->epoch + whole;
+    *picoseconds = frac;
+}
+
+uint64_t vrt_align_missing(const vrt_align* align, uint32_t stream) {
+    return align->state[stream].missing;
+}
+
+void vrt_align_destroy(vrt_align* align) {
+    if (align == NULL)
+        return;
+    for (uint32_t* ring : align->rings)
+        free(ring);
+    delete align;
+}
@@ -0,0 +1,918 @@
+/* VRT sample conversion kernels, with runtime CPU dispatch */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "vrt-convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VRT_CONVERT_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define VRT_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*cf32_kernel)(const uint32_t*, std::complex<float>*, size_t, float, bool);
+typedef void (*cf64_kernel)(const uint32_t*, std::complex<double>*, size_t, double, bool);
+typedef void (*cu8_kernel)(const uint32_t*, uint8_t*, size_t, float);
+typedef void (*cs8_kernel)(const uint32_t*, int8_t*, size_t, float);
+typedef void (*ci16_kernel)(const uint32_t*, uint32_t*, size_t);
+typedef void (*power64_kernel)(const std::complex<double>*, double*, size_t);
+typedef void (*power32_kernel)(const std::complex<float>*, double*, size_t);
+typedef void (*weighted32_kernel)(const float*, const std::complex<float>*, std::complex<float>*, size_t);
+typedef void (*moments_kernel)(const double*, double*, double*, double*, double*, size_t);
+typedef void (*cross64_kernel)(const std::complex<double>*, const std::complex<double>*, std::complex<double>*, double*, size_t);
+typedef void (*cross32_kernel)(const std::complex<float>*, const std::complex<float>*, std::complex<double>*, double*, size_t);
+
+struct convert_kernels {
+    vrt_simd_level level;
+    cf32_kernel to_cf32;
+    cf64_kernel to_cf64;
+    cu8_kernel to_cu8;
+    cs8_kernel to_cs8;
+    ci16_kernel ci8_to_ci16;
+    ci16_kernel ci12_to_ci16;
+    ci16_kernel cf32_to_ci16;
+    power64_kernel power64;
+    power32_kernel power32;
+    weighted32_kernel weighted32;
+    moments_kernel moments;
+    cross64_kernel cross64;
+    cross32_kernel cross32;
+};
+
+static inline void unpack_ci16(uint32_t word, int16_t* re, int16_t* img) {
+    memcpy(re, (char*)&word, 2);
+    memcpy(img, (char*)&word+2, 2);
+}
+
+static inline int32_t round_sat(float x, float lo, float hi) {
+    x = x < lo ? lo : x;
+    x = x > hi ? hi : x;
+    return (int32_t)lrintf(x);
+}
+
+static inline uint32_t pack_ci16(int32_t re, int32_t img) {
+    return (uint16_t)re | ((uint32_t)(uint16_t)img << 16);
+}
+
+// Sign extend a 12-bit component
+static inline int32_t ci12_component(uint32_t x) {
+    return (int32_t)(x << 20) >> 20;
+}
+
+/* Scalar kernels, also used for the tails of the vector kernels. first is the
+ * index of in[0] within the full block, to keep the fftshift sign. */
+
+static void ci16_to_cf32_scalar(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        int16_t re, img;
+        unpack_ci16(in[i], &re, &img);
+        float mult = (fftshift && (i & 1)) ? -scale : scale;
+        out[i] = std::complex<float>(mult*re, mult*img);
+    }
+}
+
+static void ci16_to_cf64_scalar(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        int16_t re, img;
+        unpack_ci16(in[i], &re, &img);
+        double mult = (fftshift && (i & 1)) ? -scale : scale;
+        out[i] = std::complex<double>(mult*re, mult*img);
+    }
+}
+
+static void ci16_to_cu8_scalar(const uint32_t* in, uint8_t* out, size_t n, float scale, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        int16_t re, img;
+        unpack_ci16(in[i], &re, &img);
+        out[2*i]   = (uint8_t)(round_sat(re*scale, -128.0f, 127.0f) + 128);
+        out[2*i+1] = (uint8_t)(round_sat(img*scale, -128.0f, 127.0f) + 128);
+    }
+}
+
+static void ci16_to_cs8_scalar(const uint32_t* in, int8_t* out, size_t n, float scale, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        int16_t re, img;
+        unpack_ci16(in[i], &re, &img);
+        out[2*i]   = (int8_t)round_sat(re*scale, -128.0f, 127.0f);
+        out[2*i+1] = (int8_t)round_sat(img*scale, -128.0f, 127.0f);
+    }
+}
+
+static void ci8_to_ci16_scalar(const uint32_t* in, uint32_t* out, size_t n, size_t first) {
+    const int8_t* p = (const int8_t*)in;
+    for (size_t i = first; i < n; i++)
+        out[i] = pack_ci16(p[2*i], p[2*i+1]);
+}
+
+// Sample i is in bytes 3i..3i+2, I in the low 12 bits
+static void ci12_to_ci16_scalar(const uint32_t* in, uint32_t* out, size_t n, size_t first) {
+    const uint8_t* p = (const uint8_t*)in;
+    for (size_t i = first; i < n; i++) {
+        const uint8_t* b = p + 3*i;
+        out[i] = pack_ci16(ci12_component(b[0] | (b[1] << 8)), ci12_component((b[1] >> 4) | (b[2] << 4)));
+    }
+}
+
+static void cf32_to_ci16_scalar(const uint32_t* in, uint32_t* out, size_t n, size_t first) {
+    const float* p = (const float*)in;
+    for (size_t i = first; i < n; i++)
+        out[i] = pack_ci16(round_sat(p[2*i], -32768.0f, 32767.0f), round_sat(p[2*i+1], -32768.0f, 32767.0f));
+}
+
+static void power64_scalar(const std::complex<double>* in, double* acc, size_t n, size_t first) {
+    for (size_t i = first; i < n; i++)
+        acc[i] += in[i].real()*in[i].real() + in[i].imag()*in[i].imag();
+}
+
+static void power32_scalar(const std::complex<float>* in, double* acc, size_t n, size_t first) {
+    for (size_t i = first; i < n; i++)
+        acc[i] += (double)in[i].real()*in[i].real() + (double)in[i].imag()*in[i].imag();
+}
+
+static void weighted32_scalar(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n, size_t first) {
+    for (size_t i = first; i < n; i++)
+        acc[i] += w[i]*in[i];
+}
+
+static void moments_scalar(const double* p, double* acc, double* acc2, double* max, double* min, size_t n, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        acc[i] += p[i];
+        acc2[i] += p[i]*p[i];
+        max[i] = std::max(max[i], p[i]);
+        min[i] = std::min(min[i], p[i]);
+    }
+}
+
+template <typename T>
+static void cross_scalar(const std::complex<T>* x, const std::complex<T>* y, std::complex<double>* acc, double* mag, size_t n, size_t first) {
+    for (size_t i = first; i < n; i++) {
+        double xr = x[i].real(), xi = x[i].imag(), yr = y[i].real(), yi = y[i].imag();
+        acc[i] += std::complex<double>(xr*yr + xi*yi, xi*yr - xr*yi);
+        mag[i] += sqrt((xr*xr + xi*xi)*(yr*yr + yi*yi));
+    }
+}
+
+static void scalar_cross64(const std::complex<double>* x, const std::complex<double>* y, std::complex<double>* acc, double* mag, size_t n) {
+    cross_scalar(x, y, acc, mag, n, 0);
+}
+
+static void scalar_cross32(const std::complex<float>* x, const std::complex<float>* y, std::complex<double>* acc, double* mag, size_t n) {
+    cross_scalar(x, y, acc, mag, n, 0);
+}
+
+static void scalar_moments(const double* p, double* acc, double* acc2, double* max, double* min, size_t n) {
+    moments_scalar(p, acc, acc2, max, min, n, 0);
+}
+
+static void scalar_weighted32(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n) {
+    weighted32_scalar(w, in, acc, n, 0);
+}
+
+static void scalar_power64(const std::complex<double>* in, double* acc, size_t n) {
+    power64_scalar(in, acc, n, 0);
+}
+
+static void scalar_power32(const std::complex<float>* in, double* acc, size_t n) {
+    power32_scalar(in, acc, n, 0);
+}
+
+static void scalar_ci8_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    ci8_to_ci16_scalar(in, out, n, 0);
+}
+
+static void scalar_ci12_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    ci12_to_ci16_scalar(in, out, n, 0);
+}
+
+static void scalar_cf32_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    cf32_to_ci16_scalar(in, out, n, 0);
+}
+
+static void scalar_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    ci16_to_cf32_scalar(in, out, n, scale, fftshift, 0);
+}
+
+static void scalar_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    ci16_to_cf64_scalar(in, out, n, scale, fftshift, 0);
+}
+
+static void scalar_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale) {
+    ci16_to_cu8_scalar(in, out, n, scale, 0);
+}
+
+static void scalar_cs8(const uint32_t* in, int8_t* out, size_t n, float scale) {
+    ci16_to_cs8_scalar(in, out, n, scale, 0);
+}
+
+#ifdef VRT_CONVERT_X86
+
+/* AVX2: 8 samples per iteration. The fftshift sign pattern repeats every two
+ * samples, so it is a constant vector for even-sized steps. */
+
+__attribute__((target("avx2")))
+static void avx2_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    const __m256 mult = fftshift ? _mm256_setr_ps(scale, scale, -scale, -scale, scale, scale, -scale, -scale)
+                                 : _mm256_set1_ps(scale);
+    float* o = reinterpret_cast<float*>(out);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+        _mm256_storeu_ps(o + 2*i, _mm256_mul_ps(lo, mult));
+        _mm256_storeu_ps(o + 2*i + 8, _mm256_mul_ps(hi, mult));
+    }
+    ci16_to_cf32_scalar(in, out, n, scale, fftshift, i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    const __m256d mult = fftshift ? _mm256_setr_pd(scale, scale, -scale, -scale)
+                                  : _mm256_set1_pd(scale);
+    double* o = reinterpret_cast<double*>(out);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+        _mm256_storeu_pd(o + 2*i, _mm256_mul_pd(lo, mult));
+        _mm256_storeu_pd(o + 2*i + 4, _mm256_mul_pd(hi, mult));
+    }
+    ci16_to_cf64_scalar(in, out, n, scale, fftshift, i);
+}
+
+// 16 samples (32 components) to 32 saturated int16 values in two registers
+__attribute__((target("avx2")))
+static inline void avx2_scale_to_i16(const uint32_t* in, __m256 mult, __m256i* a, __m256i* b) {
+    const __m256 lo_clip = _mm256_set1_ps(-32768.0f);
+    const __m256 hi_clip = _mm256_set1_ps(32767.0f);
+    __m256i r[4];
+    for (int k = 0; k < 2; k++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + 8*k));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+        lo = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(lo, mult), lo_clip), hi_clip);
+        hi = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(hi, mult), lo_clip), hi_clip);
+        r[2*k] = _mm256_cvtps_epi32(lo);
+        r[2*k+1] = _mm256_cvtps_epi32(hi);
+    }
+    // packs works per 128-bit lane, restore sample order afterwards
+    *a = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), 0xD8);
+    *b = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[2], r[3]), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static void avx2_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale) {
+    const __m256 mult = _mm256_set1_ps(scale);
+    const __m256i offset = _mm256_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a, b;
+        avx2_scale_to_i16(in + i, mult, &a, &b);
+        __m256i lo_clip = _mm256_set1_epi16(-128);
+        __m256i hi_clip = _mm256_set1_epi16(127);
+        a = _mm256_add_epi16(_mm256_min_epi16(_mm256_max_epi16(a, lo_clip), hi_clip), offset);
+        b = _mm256_add_epi16(_mm256_min_epi16(_mm256_max_epi16(b, lo_clip), hi_clip), offset);
+        __m256i u8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*)(out + 2*i), u8);
+    }
+    ci16_to_cu8_scalar(in, out, n, scale, i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_cs8(const uint32_t* in, int8_t* out, size_t n, float scale) {
+    const __m256 mult = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a, b;
+        avx2_scale_to_i16(in + i, mult, &a, &b);
+        __m256i s8 = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*)(out + 2*i), s8);
+    }
+    ci16_to_cs8_scalar(in, out, n, scale, i);
+}
+
+// 16 samples per iteration, sign extension of the bytes
+__attribute__((target("avx2")))
+static void avx2_ci8_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    const int8_t* p = (const int8_t*)in;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + 2*i));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_cvtepi8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256((__m256i*)(out + i + 8), _mm256_cvtepi8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    ci8_to_ci16_scalar(in, out, n, i);
+}
+
+/* 8 samples per iteration, 12 bytes per 128-bit lane. The shuffle puts the
+ * two bytes holding each component in a 16-bit element; I is in the low 12
+ * bits, Q in the high 12 bits, so one shift pair or one shift extends them. */
+__attribute__((target("avx2")))
+static void avx2_ci12_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+                                             0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const uint8_t* p = (const uint8_t*)in;
+    size_t i = 0;
+    // the second load reads 4 bytes beyond the 8 samples
+    for (; i + 10 <= n; i += 8) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + 3*i))),
+                                            _mm_loadu_si128((const __m128i*)(p + 3*i + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuffle);
+        __m256i re = _mm256_srai_epi16(_mm256_slli_epi16(v, 4), 4);
+        __m256i img = _mm256_srai_epi16(v, 4);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_blend_epi16(re, img, 0xAA));
+    }
+    ci12_to_ci16_scalar(in, out, n, i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_cf32_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    const __m256 lo_clip = _mm256_set1_ps(-32768.0f);
+    const __m256 hi_clip = _mm256_set1_ps(32767.0f);
+    const float* p = (const float*)in;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(p + 2*i), lo_clip), hi_clip);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(p + 2*i + 8), lo_clip), hi_clip);
+        __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(v, 0xD8));
+    }
+    cf32_to_ci16_scalar(in, out, n, i);
+}
+
+// 4 bins per iteration, hadd leaves them in 0 2 1 3 order
+__attribute__((target("avx2")))
+static void avx2_power64(const std::complex<double>* in, double* acc, size_t n) {
+    const double* p = reinterpret_cast<const double*>(in);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(p + 2*i);
+        __m256d b = _mm256_loadu_pd(p + 2*i + 4);
+        __m256d power = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+        power = _mm256_permute4x64_pd(power, 0xD8);
+        _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), power));
+    }
+    power64_scalar(in, acc, n, i);
+}
+
+// Widened to double before squaring, like the scalar kernel
+__attribute__((target("avx2")))
+static void avx2_power32(const std::complex<float>* in, double* acc, size_t n) {
+    const float* p = reinterpret_cast<const float*>(in);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 v = _mm256_loadu_ps(p + 2*i);
+        __m256d a = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        __m256d b = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+        __m256d power = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+        power = _mm256_permute4x64_pd(power, 0xD8);
+        _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), power));
+    }
+    power32_scalar(in, acc, n, i);
+}
+
+// Multiply and add (not fused), like the scalar kernel
+__attribute__((target("avx2")))
+static void avx2_moments(const double* p, double* acc, double* acc2, double* max, double* min, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(p + i);
+        _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), v));
+        _mm256_storeu_pd(acc2 + i, _mm256_add_pd(_mm256_loadu_pd(acc2 + i), _mm256_mul_pd(v, v)));
+        _mm256_storeu_pd(max + i, _mm256_max_pd(v, _mm256_loadu_pd(max + i)));
+        _mm256_storeu_pd(min + i, _mm256_min_pd(v, _mm256_loadu_pd(min + i)));
+    }
+    moments_scalar(p, acc, acc2, max, min, n, i);
+}
+
+/* 2 bins: x*conj(y) as re(x)*conj(y) -/+ im(x)*swap(conj(y)) with addsub,
+ * the magnitudes from the hadd of |x|^2 and |y|^2 */
+__attribute__((target("avx2")))
+static inline void avx2_cross2(__m256d a, __m256d y, double* pa, double* mag) {
+    const __m256d conj = _mm256_setr_pd(1.0, -1.0, 1.0, -1.0);
+    __m256d b = _mm256_mul_pd(y, conj);
+    __m256d re = _mm256_mul_pd(_mm256_movedup_pd(a), b);
+    __m256d im = _mm256_mul_pd(_mm256_permute_pd(a, 0xF), _mm256_permute_pd(b, 0x5));
+    _mm256_storeu_pd(pa, _mm256_add_pd(_mm256_loadu_pd(pa), _mm256_addsub_pd(re, im)));
+    // |x0|^2 |y0|^2 |x1|^2 |y1|^2, then the products of the pairs in lanes 0 and 2
+    __m256d power = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+    __m256d product = _mm256_sqrt_pd(_mm256_mul_pd(power, _mm256_permute_pd(power, 0x5)));
+    __m128d m = _mm256_castpd256_pd128(_mm256_permute4x64_pd(product, 0x08));
+    _mm_storeu_pd(mag, _mm_add_pd(_mm_loadu_pd(mag), m));
+}
+
+__attribute__((target("avx2")))
+static void avx2_cross64(const std::complex<double>* x, const std::complex<double>* y, std::complex<double>* acc, double* mag, size_t n) {
+    const double* px = reinterpret_cast<const double*>(x);
+    const double* py = reinterpret_cast<const double*>(y);
+    double* pa = reinterpret_cast<double*>(acc);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        avx2_cross2(_mm256_loadu_pd(px + 2*i), _mm256_loadu_pd(py + 2*i), pa + 2*i, mag + i);
+    cross_scalar(x, y, acc, mag, n, i);
+}
+
+// Widened to double before multiplying, like the scalar kernel
+__attribute__((target("avx2")))
+static void avx2_cross32(const std::complex<float>* x, const std::complex<float>* y, std::complex<double>* acc, double* mag, size_t n) {
+    const float* px = reinterpret_cast<const float*>(x);
+    const float* py = reinterpret_cast<const float*>(y);
+    double* pa = reinterpret_cast<double*>(acc);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        avx2_cross2(_mm256_cvtps_pd(_mm_loadu_ps(px + 2*i)), _mm256_cvtps_pd(_mm_loadu_ps(py + 2*i)), pa + 2*i, mag + i);
+    cross_scalar(x, y, acc, mag, n, i);
+}
+
+// 4 samples per iteration, each weight duplicated for re and im
+__attribute__((target("avx2,fma")))
+static void avx2_weighted32(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n) {
+    const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const float* p = reinterpret_cast<const float*>(in);
+    float* a = reinterpret_cast<float*>(acc);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 weight = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(w + i)), dup);
+        _mm256_storeu_ps(a + 2*i, _mm256_fmadd_ps(weight, _mm256_loadu_ps(p + 2*i), _mm256_loadu_ps(a + 2*i)));
+    }
+    weighted32_scalar(w, in, acc, n, i);
+}
+
+/* AVX-512: 16 samples per iteration */
+
+__attribute__((target("avx512f")))
+static void avx512_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    const __m512 mult = fftshift ? _mm512_setr_ps(scale, scale, -scale, -scale, scale, scale, -scale, -scale,
+                                                  scale, scale, -scale, -scale, scale, scale, -scale, -scale)
+                                 : _mm512_set1_ps(scale);
+    float* o = reinterpret_cast<float*>(out);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 lo = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i))));
+        __m512 hi = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i + 8))));
+        _mm512_storeu_ps(o + 2*i, _mm512_mul_ps(lo, mult));
+        _mm512_storeu_ps(o + 2*i + 16, _mm512_mul_ps(hi, mult));
+    }
+    ci16_to_cf32_scalar(in, out, n, scale, fftshift, i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    const __m512d mult = fftshift ? _mm512_setr_pd(scale, scale, -scale, -scale, scale, scale, -scale, -scale)
+                                  : _mm512_set1_pd(scale);
+    double* o = reinterpret_cast<double*>(out);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i)));
+        __m512d lo = _mm512_cvtepi32_pd(_mm512_castsi512_si256(v));
+        __m512d hi = _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1));
+        _mm512_storeu_pd(o + 2*i, _mm512_mul_pd(lo, mult));
+        _mm512_storeu_pd(o + 2*i + 8, _mm512_mul_pd(hi, mult));
+    }
+    ci16_to_cf64_scalar(in, out, n, scale, fftshift, i);
+}
+
+// 8 samples (16 components) to 16 rounded, clipped int32 values
+__attribute__((target("avx512f")))
+static inline __m512i avx512_scale_to_i32(const uint32_t* in, __m512 mult) {
+    __m512 v = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)in)));
+    v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(v, mult), _mm512_set1_ps(-128.0f)), _mm512_set1_ps(127.0f));
+    return _mm512_cvtps_epi32(v);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale) {
+    const __m512 mult = _mm512_set1_ps(scale);
+    const __m512i offset = _mm512_set1_epi32(128);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_add_epi32(avx512_scale_to_i32(in + i, mult), offset);
+        _mm_storeu_si128((__m128i*)(out + 2*i), _mm512_cvtepi32_epi8(v));
+    }
+    ci16_to_cu8_scalar(in, out, n, scale, i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_cs8(const uint32_t* in, int8_t* out, size_t n, float scale) {
+    const __m512 mult = _mm512_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*)(out + 2*i), _mm512_cvtepi32_epi8(avx512_scale_to_i32(in + i, mult)));
+    }
+    ci16_to_cs8_scalar(in, out, n, scale, i);
+}
+
+#endif
+
+#ifdef VRT_CONVERT_NEON
+
+/* NEON: 4 samples per iteration */
+
+static void neon_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    const float m[4] = { scale, scale, fftshift ? -scale : scale, fftshift ? -scale : scale };
+    const float32x4_t mult = vld1q_f32(m);
+    float* o = reinterpret_cast<float*>(out);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int16x8_t v = vld1q_s16((const int16_t*)(in + i));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(o + 2*i, vmulq_f32(lo, mult));
+        vst1q_f32(o + 2*i + 4, vmulq_f32(hi, mult));
+    }
+    ci16_to_cf32_scalar(in, out, n, scale, fftshift, i);
+}
+
+static void neon_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    const float64x2_t mult_even = vdupq_n_f64(scale);
+    const float64x2_t mult_odd = vdupq_n_f64(fftshift ? -scale : scale);
+    double* o = reinterpret_cast<double*>(out);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int32x4_t v = vmovl_s16(vld1_s16((const int16_t*)(in + i)));
+        float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(v)));
+        float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(v)));
+        vst1q_f64(o + 2*i, vmulq_f64(lo, mult_even));
+        vst1q_f64(o + 2*i + 2, vmulq_f64(hi, mult_odd));
+    }
+    ci16_to_cf64_scalar(in, out, n, scale, fftshift, i);
+}
+
+// 4 samples to 8 saturated int16 values
+static inline int16x8_t neon_scale_to_i16(const uint32_t* in, float32x4_t mult) {
+    int16x8_t v = vld1q_s16((const int16_t*)in);
+    float32x4_t lo = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), mult);
+    float32x4_t hi = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), mult);
+    return vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(lo)), vqmovn_s32(vcvtnq_s32_f32(hi)));
+}
+
+static void neon_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale) {
+    const float32x4_t mult = vdupq_n_f32(scale);
+    const int16x8_t lo_clip = vdupq_n_s16(-128);
+    const int16x8_t hi_clip = vdupq_n_s16(127);
+    const int16x8_t offset = vdupq_n_s16(128);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int16x8_t v = vminq_s16(vmaxq_s16(neon_scale_to_i16(in + i, mult), lo_clip), hi_clip);
+        vst1_u8(out + 2*i, vqmovun_s16(vaddq_s16(v, offset)));
+    }
+    ci16_to_cu8_scalar(in, out, n, scale, i);
+}
+
+static void neon_cs8(const uint32_t* in, int8_t* out, size_t n, float scale) {
+    const float32x4_t mult = vdupq_n_f32(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1_s8(out + 2*i, vqmovn_s16(neon_scale_to_i16(in + i, mult)));
+    }
+    ci16_to_cs8_scalar(in, out, n, scale, i);
+}
+
+static void neon_ci8_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    const int8_t* p = (const int8_t*)in;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int8x16_t v = vld1q_s8(p + 2*i);
+        vst1q_s16((int16_t*)(out + i), vmovl_s8(vget_low_s8(v)));
+        vst1q_s16((int16_t*)(out + i + 4), vmovl_s8(vget_high_s8(v)));
+    }
+    ci8_to_ci16_scalar(in, out, n, i);
+}
+
+static void neon_power64(const std::complex<double>* in, double* acc, size_t n) {
+    const double* p = reinterpret_cast<const double*>(in);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t a = vld1q_f64(p + 2*i);
+        float64x2_t b = vld1q_f64(p + 2*i + 2);
+        float64x2_t power = vpaddq_f64(vmulq_f64(a, a), vmulq_f64(b, b));
+        vst1q_f64(acc + i, vaddq_f64(vld1q_f64(acc + i), power));
+    }
+    power64_scalar(in, acc, n, i);
+}
+
+static void neon_power32(const std::complex<float>* in, double* acc, size_t n) {
+    const float* p = reinterpret_cast<const float*>(in);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t v = vld1q_f32(p + 2*i);
+        float64x2_t a = vcvt_f64_f32(vget_low_f32(v));
+        float64x2_t b = vcvt_high_f64_f32(v);
+        float64x2_t power = vpaddq_f64(vmulq_f64(a, a), vmulq_f64(b, b));
+        vst1q_f64(acc + i, vaddq_f64(vld1q_f64(acc + i), power));
+    }
+    power32_scalar(in, acc, n, i);
+}
+
+static void neon_weighted32(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n) {
+    const float* p = reinterpret_cast<const float*>(in);
+    float* a = reinterpret_cast<float*>(acc);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t weight = vld1q_f32(w + i);
+        vst1q_f32(a + 2*i, vfmaq_f32(vld1q_f32(a + 2*i), vld1q_f32(p + 2*i), vzip1q_f32(weight, weight)));
+        vst1q_f32(a + 2*i + 4, vfmaq_f32(vld1q_f32(a + 2*i + 4), vld1q_f32(p + 2*i + 4), vzip2q_f32(weight, weight)));
+    }
+    weighted32_scalar(w, in, acc, n, i);
+}
+
+static void neon_moments(const double* p, double* acc, double* acc2, double* max, double* min, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t v = vld1q_f64(p + i);
+        vst1q_f64(acc + i, vaddq_f64(vld1q_f64(acc + i), v));
+        vst1q_f64(acc2 + i, vaddq_f64(vld1q_f64(acc2 + i), vmulq_f64(v, v)));
+        vst1q_f64(max + i, vmaxq_f64(v, vld1q_f64(max + i)));
+        vst1q_f64(min + i, vminq_f64(v, vld1q_f64(min + i)));
+    }
+    moments_scalar(p, acc, acc2, max, min, n, i);
+}
+
+// 2 bins (one per register), the products of each bin summed pairwise
+static inline void neon_cross2(float64x2_t x0, float64x2_t x1, float64x2_t y0, float64x2_t y1, double* pa, double* mag) {
+    const float64x2_t sign = {-1.0, 1.0};
+    float64x2_t re = vpaddq_f64(vmulq_f64(x0, y0), vmulq_f64(x1, y1));
+    float64x2_t im = vpaddq_f64(vmulq_f64(vmulq_f64(x0, vextq_f64(y0, y0, 1)), sign),
+                                vmulq_f64(vmulq_f64(x1, vextq_f64(y1, y1, 1)), sign));
+    vst1q_f64(pa, vaddq_f64(vld1q_f64(pa), vzip1q_f64(re, im)));
+    vst1q_f64(pa + 2, vaddq_f64(vld1q_f64(pa + 2), vzip2q_f64(re, im)));
+    float64x2_t power_x = vpaddq_f64(vmulq_f64(x0, x0), vmulq_f64(x1, x1));
+    float64x2_t power_y = vpaddq_f64(vmulq_f64(y0, y0), vmulq_f64(y1, y1));
+    vst1q_f64(mag, vaddq_f64(vld1q_f64(mag), vsqrtq_f64(vmulq_f64(power_x, power_y))));
+}
+
+static void neon_cross64(const std::complex<double>* x, const std::complex<double>* y, std::complex<double>* acc, double* mag, size_t n) {
+    const double* px = reinterpret_cast<const double*>(x);
+    const double* py = reinterpret_cast<const double*>(y);
+    double* pa = reinterpret_cast<double*>(acc);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        neon_cross2(vld1q_f64(px + 2*i), vld1q_f64(px + 2*i + 2), vld1q_f64(py + 2*i), vld1q_f64(py + 2*i + 2), pa + 2*i, mag + i);
+    cross_scalar(x, y, acc, mag, n, i);
+}
+
+static void neon_cross32(const std::complex<float>* x, const std::complex<float>* y, std::complex<double>* acc, double* mag, size_t n) {
+    const float* px = reinterpret_cast<const float*>(x);
+    const float* py = reinterpret_cast<const float*>(y);
+    double* pa = reinterpret_cast<double*>(acc);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float32x4_t a = vld1q_f32(px + 2*i), b = vld1q_f32(py + 2*i);
+        neon_cross2(vcvt_f64_f32(vget_low_f32(a)), vcvt_high_f64_f32(a), vcvt_f64_f32(vget_low_f32(b)), vcvt_high_f64_f32(b),
+            pa + 2*i, mag + i);
+    }
+    cross_scalar(x, y, acc, mag, n, i);
+}
+
+static void neon_cf32_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    const float* p = (const float*)in;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t a = vcvtnq_s32_f32(vld1q_f32(p + 2*i));
+        int32x4_t b = vcvtnq_s32_f32(vld1q_f32(p + 2*i + 4));
+        vst1q_s16((int16_t*)(out + i), vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+    cf32_to_ci16_scalar(in, out, n, i);
+}
+
+#endif
+
+static bool cpu_supports(vrt_simd_level level) {
+    switch (level) {
+        case VRT_SIMD_SCALAR:
+            return true;
+#ifdef VRT_CONVERT_X86
+        case VRT_SIMD_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case VRT_SIMD_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef VRT_CONVERT_NEON
+        case VRT_SIMD_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static convert_kernels kernels_for(vrt_simd_level level) {
+    switch (level) {
+#ifdef VRT_CONVERT_X86
+        case VRT_SIMD_AVX2:
+            return { level, avx2_cf32, avx2_cf64, avx2_cu8, avx2_cs8,
+                     avx2_ci8_to_ci16, avx2_ci12_to_ci16, avx2_cf32_to_ci16, avx2_power64, avx2_power32,
+                     avx2_weighted32, avx2_moments, avx2_cross64, avx2_cross32 };
+        case VRT_SIMD_AVX512:
+            return { level, avx512_cf32, avx512_cf64, avx512_cu8, avx512_cs8,
+                     avx2_ci8_to_ci16, avx2_ci12_to_ci16, avx2_cf32_to_ci16, avx2_power64, avx2_power32,
+                     avx2_weighted32, avx2_moments, avx2_cross64, avx2_cross32 };
+#endif
+#ifdef VRT_CONVERT_NEON
+        case VRT_SIMD_NEON:
+            return { level, neon_cf32, neon_cf64, neon_cu8, neon_cs8,
+                     neon_ci8_to_ci16, scalar_ci12_to_ci16, neon_cf32_to_ci16, neon_power64, neon_power32,
+                     neon_weighted32, neon_moments, neon_cross64, neon_cross32 };
+#endif
+        default:
+            return { VRT_SIMD_SCALAR, scalar_cf32, scalar_cf64, scalar_cu8, scalar_cs8,
+                     scalar_ci8_to_ci16, scalar_ci12_to_ci16, scalar_cf32_to_ci16, scalar_power64, scalar_power32,
+                     scalar_weighted32, scalar_moments, scalar_cross64, scalar_cross32 };
+    }
+}
+
+static convert_kernels detect_kernels() {
+    const char* env = getenv("VRT_SIMD");
+    if (env) {
+        for (int l = VRT_SIMD_SCALAR; l <= VRT_SIMD_AVX512; l++) {
+            if (strcmp(env, vrt_convert_simd_name((vrt_simd_level)l)) == 0 && cpu_supports((vrt_simd_level)l))
+                return kernels_for((vrt_simd_level)l);
+        }
+        fprintf(stderr, "# Warning: VRT_SIMD=%s not supported, using autodetection\n", env);
+    }
+    for (int l = VRT_SIMD_AVX512; l > VRT_SIMD_SCALAR; l--) {
+        if (cpu_supports((vrt_simd_level)l))
+            return kernels_for((vrt_simd_level)l);
+    }
+    return kernels_for(VRT_SIMD_SCALAR);
+}
+
+static convert_kernels& active_kernels() {
+    static convert_kernels k = detect_kernels();
+    return k;
+}
+
+vrt_simd_level vrt_convert_simd_level() {
+    return active_kernels().level;
+}
+
+const char* vrt_convert_simd_name(vrt_simd_level level) {
+    switch (level) {
+        case VRT_SIMD_NEON:   return "neon";
+        case VRT_SIMD_AVX2:   return "avx2";
+        case VRT_SIMD_AVX512: return "avx512";
+        default:              return "scalar";
+    }
+}
+
+bool vrt_convert_set_simd_level(vrt_simd_level level) {
+    if (not cpu_supports(level))
+        return false;
+    active_kernels() = kernels_for(level);
+    return true;
+}
+
+void vrt_ci16_to_cf32(const uint32_t* in, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    active_kernels().to_cf32(in, out, n, scale, fftshift);
+}
+
+void vrt_ci16_to_cf64(const uint32_t* in, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    active_kernels().to_cf64(in, out, n, scale, fftshift);
+}
+
+void vrt_ci16_to_cu8(const uint32_t* in, uint8_t* out, size_t n, float scale) {
+    active_kernels().to_cu8(in, out, n, scale);
+}
+
+void vrt_ci16_to_cs8(const uint32_t* in, int8_t* out, size_t n, float scale) {
+    active_kernels().to_cs8(in, out, n, scale);
+}
+
+void vrt_ci8_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    active_kernels().ci8_to_ci16(in, out, n);
+}
+
+void vrt_ci12_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    active_kernels().ci12_to_ci16(in, out, n);
+}
+
+void vrt_cf32_to_ci16(const uint32_t* in, uint32_t* out, size_t n) {
+    active_kernels().cf32_to_ci16(in, out, n);
+}
+
+void vrt_accumulate_power(const std::complex<double>* in, double* acc, size_t n) {
+    active_kernels().power64(in, acc, n);
+}
+
+void vrt_accumulate_power(const std::complex<float>* in, double* acc, size_t n) {
+    active_kernels().power32(in, acc, n);
+}
+
+void vrt_accumulate_weighted(const float* w, const std::complex<float>* in, std::complex<float>* acc, size_t n) {
+    active_kernels().weighted32(w, in, acc, n);
+}
+
+void vrt_accumulate_moments(const double* p, double* acc, double* acc2, double* max, double* min, size_t n) {
+    active_kernels().moments(p, acc, acc2, max, min, n);
+}
+
+void vrt_accumulate_cross(const std::complex<double>* x, const std::complex<double>* y, std::complex<double>* acc, double* mag, size_t n) {
+    active_kernels().cross64(x, y, acc, mag, n);
+}
+
+void vrt_accumulate_cross(const std::complex<float>* x, const std::complex<float>* y, std::complex<double>* acc, double* mag, size_t n) {
+    active_kernels().cross32(x, y, acc, mag, n);
+}
+
+void vrt_payload_to_ci16(const uint32_t* in, vrt_sample_format format, uint32_t* out, size_t n) {
+    switch (format) {
+        case VRT_FORMAT_CI8:  vrt_ci8_to_ci16(in, out, n); break;
+        case VRT_FORMAT_CI12: vrt_ci12_to_ci16(in, out, n); break;
+        case VRT_FORMAT_CF32: vrt_cf32_to_ci16(in, out, n); break;
+        default:              memcpy(out, in, n*sizeof(uint32_t)); break;
+    }
+}
+
+// Packed formats are decoded in blocks that stay in the L1 cache
+#define VRT_DECODE_BLOCK 1024
+
+template <typename T>
+static void cf32_to_complex(const uint32_t* in, std::complex<T>* out, size_t n, T scale, bool fftshift) {
+    const float* p = (const float*)in;
+    for (size_t i = 0; i < n; i++) {
+        T mult = (fftshift && (i & 1)) ? -scale : scale;
+        out[i] = std::complex<T>(mult*p[2*i], mult*p[2*i+1]);
+    }
+}
+
+void vrt_payload_to_cf32(const uint32_t* in, vrt_sample_format format, std::complex<float>* out, size_t n, float scale, bool fftshift) {
+    if (format == VRT_FORMAT_CI16) {
+        vrt_ci16_to_cf32(in, out, n, scale, fftshift);
+    } else if (format == VRT_FORMAT_CF32) {
+        cf32_to_complex(in, out, n, scale, fftshift);
+    } else {
+        uint32_t block[VRT_DECODE_BLOCK];
+        for (size_t i = 0; i < n; i += VRT_DECODE_BLOCK) {
+            size_t m = std::min<size_t>(VRT_DECODE_BLOCK, n - i);
+            // block boundaries are even, the fftshift sign continues
+            vrt_payload_to_ci16(in + vrt_payload_words(i, format), format, block, m);
+            vrt_ci16_to_cf32(block, out + i, m, scale, fftshift);
+        }
+    }
+}
+
+void vrt_payload_to_cf64(const uint32_t* in, vrt_sample_format format, std::complex<double>* out, size_t n, double scale, bool fftshift) {
+    if (format == VRT_FORMAT_CI16) {
+        vrt_ci16_to_cf64(in, out, n, scale, fftshift);
+    } else if (format == VRT_FORMAT_CF32) {
+        cf32_to_complex(in, out, n, scale, fftshift);
+    } else {
+        uint32_t block[VRT_DECODE_BLOCK];
+        for (size_t i = 0; i < n; i += VRT_DECODE_BLOCK) {
+            size_t m = std::min<size_t>(VRT_DECODE_BLOCK, n - i);
+            vrt_payload_to_ci16(in + vrt_payload_words(i, format), format, block, m);
+            vrt_ci16_to_cf64(block, out + i, m, scale, fftshift);
+        }
+    }
+}
+
+uint32_t vrt_ci16_to_payload(const uint32_t* in, uint32_t* out, size_t n, vrt_sample_format format) {
+
+    uint32_t words = vrt_payload_words(n, format);
+    if (words == 0)
+        return 0;
+
+    switch (format) {
+        case VRT_FORMAT_CI8:
+            // padding of an odd sample count
+            out[words-1] = 0;
+            vrt_ci16_to_cs8(in, (int8_t*)out, n, 1.0f);
+            break;
+        case VRT_FORMAT_CI12: {
+            out[words-1] = 0;
+            uint8_t* p = (uint8_t*)out;
+            for (size_t i = 0; i < n; i++) {
+                int16_t re, img;
+                unpack_ci16(in[i], &re, &img);
+                uint32_t a = (uint32_t)std::max<int32_t>(-2048, std::min<int32_t>(2047, re)) & 0xFFF;
+                uint32_t b = (uint32_t)std::max<int32_t>(-2048, std::min<int32_t>(2047, img)) & 0xFFF;
+                p[3*i] = a & 0xFF;
+                p[3*i+1] = (a >> 8) | ((b & 0xF) << 4);
+                p[3*i+2] = b >> 4;
+            }
+            break;
+        }
+        case VRT_FORMAT_CF32: {
+            float* p = (float*)out;
+            for (size_t i = 0; i < n; i++) {
+                int16_t re, img;
+                unpack_ci16(in[i], &re, &img);
+                p[2*i] = re;
+                p[2*i+1] = img;
+            }
+            break;
+        }
+        default:
+            memcpy(out, in, n*sizeof(uint32_t));
+            break;
+    }
+    return words;
+}
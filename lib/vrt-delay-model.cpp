@@ -0,0 +1,218 @@
+/* Delay model
+ *
+ * A baseline model is track 0, a per-station model has one track per
+ * station, from the station lines.
+ *
+ * The table is interpolated with the Lagrange polynomial through the 4
+ * rows around t (all rows of a shorter table), w_dot is its
+ * derivative. Polynomial segments are evaluated with Horner's rule. A
+ * model of w only (delay polycos) leaves u and v NaN. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "vrt-delay-model.h"
+
+static const char* quantity_names[VRT_DELAY_QUANTITIES] = {"w", "u", "v"};
+
+// Time of a line relative to the epoch, set from the first time of the file
+static double relative_time(vrt_delay_model* model, bool* first, const char* text) {
+    double t = strtod(text, NULL);
+    if (*first) {
+        model->epoch = (int64_t)floor(t);
+        *first = false;
+    }
+    // the digits after the point are parsed on their own, so they keep their precision
+    double whole = floor(t);
+    const char* dot = strchr(text, '.');
+    double fraction = (dot and not strpbrk(text, "eE-")) ? strtod(dot, NULL) : t - whole;
+    return (whole - (double)model->epoch) + fraction;
+}
+
+bool vrt_delay_model_load(const std::string& path, vrt_delay_model* model) {
+
+    FILE* fp = fopen(path.c_str(), "r");
+    if (fp == NULL) {
+        printf("Failed to open the delay model %s.\n", path.c_str());
+        return false;
+    }
+
+    *model = vrt_delay_model();
+    model->tracks.resize(1);
+    size_t current = 0;
+    bool baseline_lines = false;
+    bool first = true;
+    char line[4096];
+    uint32_t number = 0;
+    bool ok = true;
+
+    while (ok and fgets(line, sizeof(line), fp)) {
+        number++;
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        std::vector<char*> fields;
+        for (char* field = strtok(line, " \t\r\n,"); field; field = strtok(NULL, " \t\r\n,"))
+            fields.push_back(field);
+        if (fields.empty())
+            continue;
+
+        if (strcmp(fields[0], "station") == 0) {
+            char* end = NULL;
+            long k = fields.size() == 2 ? strtol(fields[1], &end, 10) : -1;
+            if (k < 0 or k > 1023 or *end != 0) {
+                printf("%s:%u: expected station <channel index>.\n", path.c_str(), number);
+                ok = false;
+            } else if (baseline_lines) {
+                printf("%s:%u: a station line after the lines of a baseline model.\n", path.c_str(), number);
+                ok = false;
+            } else {
+                if (not model->per_station)
+                    model->tracks.clear();
+                model->per_station = true;
+                current = k;
+                if (model->tracks.size() <= current)
+                    model->tracks.resize(current + 1);
+            }
+            continue;
+        }
+        baseline_lines = not model->per_station;
+        vrt_delay_track& track = model->tracks[current];
+
+        if (strcmp(fields[0], "poly") == 0) {
+            int quantity = -1;
+            if (fields.size() >= 5)
+                for (int q = 0; q < VRT_DELAY_QUANTITIES; q++)
+                    if (strcmp(fields[3], quantity_names[q]) == 0)
+                        quantity = q;
+            if (quantity < 0) {
+                printf("%s:%u: expected poly <mid time> <span> <w|u|v> <coefficients>.\n", path.c_str(), number);
+                ok = false;
+                break;
+            }
+            vrt_delay_segment segment;
+            segment.mid = relative_time(model, &first, fields[1]);
+            segment.span = strtod(fields[2], NULL);
+            for (size_t i = 4; i < fields.size(); i++)
+                segment.coeffs.push_back(strtod(fields[i], NULL));
+            track.segments[quantity].push_back(segment);
+        } else if (fields.size() == 4) {
+            double t = relative_time(model, &first, fields[0]);
+            if (not track.times.empty() and t <= track.times.back()) {
+                printf("%s:%u: the table rows are not in time order.\n", path.c_str(), number);
+                ok = false;
+                break;
+            }
+            track.times.push_back(t);
+            for (int q = 0; q < VRT_DELAY_QUANTITIES; q++)
+                track.table[q].push_back(strtod(fields[q + 1], NULL));
+        } else {
+            printf("%s:%u: expected <time> <w> <u> <v>, a poly or a station line.\n", path.c_str(), number);
+            ok = false;
+        }
+    }
+    fclose(fp);
+
+    if (ok and first) {
+        printf("The delay model %s is empty.\n", path.c_str());
+        return false;
+    }
+    for (size_t k = 0; ok and k < model->tracks.size(); k++) {
+        if (model->tracks[k].times.empty() and model->tracks[k].segments[VRT_DELAY_W].empty()) {
+            if (model->per_station)
+                printf("Station %zu of the delay model %s defines no w.\n", k, path.c_str());
+            else
+                printf("The delay model %s defines no w.\n", path.c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Segment of a quantity covering t (the one with the nearest middle), NULL if none
+static const vrt_delay_segment* find_segment(const std::vector<vrt_delay_segment>& segments, double t) {
+    const vrt_delay_segment* best = NULL;
+    for (const vrt_delay_segment& segment : segments)
+        if (fabs(t - segment.mid) <= segment.span/2
+            and (best == NULL or fabs(t - segment.mid) < fabs(t - best->mid)))
+            best = &segment;
+    return best;
+}
+
+static double eval_segment(const vrt_delay_segment& segment, double t, double* derivative) {
+    double x = t - segment.mid;
+    double value = 0, slope = 0;
+    for (size_t i = segment.coeffs.size(); i-- > 0; ) {
+        slope = slope*x + value;
+        value = value*x + segment.coeffs[i];
+    }
+    *derivative = slope;
+    return value;
+}
+
+// Lagrange interpolation through rows first..last (inclusive) and its derivative
+static double eval_table(const vrt_delay_track& track, int q, size_t first, size_t last, double t, double* derivative) {
+    const std::vector<double>& x = track.times;
+    const std::vector<double>& y = track.table[q];
+    double value = 0, slope = 0;
+    for (size_t j = first; j <= last; j++) {
+        double basis = 1, basis_slope = 0;
+        for (size_t m = first; m <= last; m++) {
+            if (m == j)
+                continue;
+            double d = x[j] - x[m];
+            basis_slope = basis_slope*(t - x[m])/d + basis/d;
+            basis *= (t - x[m])/d;
+        }
+        value += y[j]*basis;
+        slope += y[j]*basis_slope;
+    }
+    *derivative = slope;
+    return value;
+}
+
+bool vrt_delay_model_eval(const vrt_delay_model* model, int64_t seconds, uint64_t picoseconds, vrt_delay_value* value,
+    uint32_t track_index) {
+
+    if (track_index >= model->tracks.size())
+        return false;
+    const vrt_delay_track& track = model->tracks[track_index];
+    double t = (double)(seconds - model->epoch) + (double)picoseconds/1e12;
+
+    // the 4 rows around t for the table
+    bool in_table = track.times.size() >= 2 and t >= track.times.front() and t <= track.times.back();
+    size_t first = 0, last = 0;
+    if (in_table) {
+        size_t i = std::upper_bound(track.times.begin(), track.times.end(), t) - track.times.begin();
+        size_t rows = std::min<size_t>(4, track.times.size());
+        // two rows before and after t, shifted inwards at the ends
+        first = std::min(i >= 2 ? i - 2 : 0, track.times.size() - rows);
+        last = first + rows - 1;
+    }
+
+    double result[VRT_DELAY_QUANTITIES], w_dot = 0;
+    for (int q = 0; q < VRT_DELAY_QUANTITIES; q++) {
+        double derivative;
+        const vrt_delay_segment* segment = find_segment(track.segments[q], t);
+        if (segment)
+            result[q] = eval_segment(*segment, t, &derivative);
+        else if (in_table)
+            result[q] = eval_table(track, q, first, last, t, &derivative);
+        else if (q == VRT_DELAY_W)
+            return false;
+        else
+            result[q] = NAN;    // u and v are optional
+        if (q == VRT_DELAY_W)
+            w_dot = derivative;
+    }
+
+    value->w = result[VRT_DELAY_W];
+    value->w_dot = w_dot;
+    value->u = result[VRT_DELAY_U];
+    value->v = result[VRT_DELAY_V];
+    return true;
+}
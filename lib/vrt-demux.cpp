@@ -0,0 +1,127 @@
+/* Multi-stream VRT demultiplexer */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vrt-demux.h"
+#include "vrt-metrics.h"
+
+bool vrt_demux_init(vrt_demux* demux, const std::vector<size_t>& channel_nums) {
+
+    if (channel_nums.size() > MAX_CHANNELS) {
+        printf("At most %d channels are supported.\n", MAX_CHANNELS);
+        return false;
+    }
+
+    demux->channel_filt = 0;
+    demux->num_streams = 0;
+    memset(demux->slot, -1, sizeof(demux->slot));
+
+    for (size_t i = 0; i < channel_nums.size(); i++) {
+        size_t channel = channel_nums[i];
+        if (channel >= 32) {
+            printf("Channel %zu out of range.\n", channel);
+            return false;
+        }
+        if (demux->slot[channel] >= 0)
+            continue;
+
+        vrt_stream_state* stream = &demux->streams[demux->num_streams];
+        stream->channel = channel;
+        init_context(&stream->context);
+        stream->first_frame = true;
+        stream->packets = 0;
+        stream->samples = 0;
+        stream->lost_frames = 0;
+        stream->handler = NULL;
+        stream->handler_data = NULL;
+
+        demux->slot[channel] = demux->num_streams++;
+        demux->channel_filt |= 1u << channel;
+    }
+    return true;
+}
+
+void vrt_demux_set_handler(vrt_demux* demux, uint32_t index, vrt_stream_handler handler, void* data) {
+    demux->streams[index].handler = handler;
+    demux->streams[index].handler_data = data;
+}
+
+vrt_stream_state* vrt_demux_stream(vrt_demux* demux, uint32_t stream_id) {
+    uint32_t selected = stream_id & demux->channel_filt;
+    if (selected == 0)
+        return NULL;
+    return &demux->streams[demux->slot[__builtin_ctz(selected)]];
+}
+
+bool vrt_demux_process(vrt_demux* demux, uint32_t* buffer, uint32_t size, packet_type* vrt_packet, vrt_stream_state** stream) {
+
+    vrt_packet_view view;
+
+    vrt_packet->context = false;
+    vrt_packet->data = false;
+    vrt_packet->extended_context = false;
+    vrt_packet->channel_filt = demux->channel_filt;
+    *stream = NULL;
+
+    if (not vrt_view_parse(buffer, (int32_t)size, &view))
+        return false;
+
+    const struct vrt_header& h = view.header;
+    vrt_stream_state* s = vrt_demux_stream(demux, view.fields.stream_id);
+
+    if (h.packet_type == VRT_PT_IF_CONTEXT) {
+        if (s == NULL)
+            return true;
+
+        struct vrt_if_context c;
+        if (not vrt_view_read_if_context(&view, &c))
+            return false;
+
+        s->context.stream_id = view.fields.stream_id;
+        vrt_apply_if_context(&view, &c, &s->context);
+        vrt_packet->context = true;
+        vrt_packet->stream_id = view.fields.stream_id;
+
+        vrt_packet->oui = view.fields.class_id.oui;
+        vrt_packet->information_class_code = view.fields.class_id.information_class_code;
+        vrt_packet->packet_class_code = view.fields.class_id.packet_class_code;
+
+    } else if (h.packet_type == VRT_PT_IF_DATA_WITH_STREAM_ID) {
+        if (s == NULL)
+            return true;
+
+        vrt_view_packet_info(&view, vrt_packet);
+        vrt_decode_payload(buffer, size, &s->context, vrt_packet);
+
+        // packet counters are tracked per stream
+        vrt_packet->lost_frame = vrt_check_loss(&view, &s->context, vrt_packet);
+        if (vrt_packet->lost_frame)
+            s->lost_frames++;
+        vrt_packet->data = true;
+
+        vrt_packet->first_frame = s->first_frame;
+        if (s->first_frame) {
+            s->context.starttime_integer = view.fields.integer_seconds_timestamp;
+            s->context.starttime_fractional = view.fields.fractional_seconds_timestamp;
+            s->first_frame = false;
+        }
+        s->packets++;
+        s->samples += vrt_packet->num_rx_samps;
+        vrt_metrics_packet(vrt_packet);
+
+    } else if (h.packet_type == VRT_PT_EXT_CONTEXT) {
+
+        vrt_view_packet_info(&view, vrt_packet);
+        vrt_packet->extended_context = true;
+
+    } else {
+        return true;
+    }
+
+    *stream = s;
+    if (s != NULL and s->handler != NULL)
+        s->handler(s, vrt_packet, buffer, s->handler_data);
+
+    return true;
+}
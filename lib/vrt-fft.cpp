@@ -0,0 +1,633 @@
+/* FFT helpers, the plan factory and the batched FFT engine
+ *
+ * FFTW keys wisdom by the full problem (size, batch, strides, in or out of
+ * place, alignment), so one cache file per precision holds the plans of
+ * all sizes and batches. The cache is written to a temporary file that is
+ * renamed, so tools starting at the same time never read a partial file.
+ *
+ * The batch buffer of the engine holds batch blocks of num_bins samples.
+ * Thread t owns blocks t*slice .. (t+1)*slice-1, with its own plan for the
+ * full slice and its own partial sums, so the threads share nothing while
+ * they run. The FFT is in place. A partial batch (at the integration
+ * boundary) is transformed block by block with a single block plan.
+ *
+ * With statistics the power of each block is first written to a scratch
+ * row of the thread, then added to the sums and holds in one kernel. */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vrt-fft.h"
+#include "vrt-metrics.h"
+
+bool vrt_parse_fft_precision(const std::string& name, vrt_fft_precision* precision) {
+    if (name == "double")
+        *precision = VRT_FFT_DOUBLE;
+    else if (name == "float")
+        *precision = VRT_FFT_FLOAT;
+    else {
+        printf("Unknown precision %s (double or float).\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool vrt_parse_fft_effort(const std::string& name, vrt_fft_effort* effort) {
+    if (name == "estimate")
+        *effort = VRT_FFT_ESTIMATE;
+    else if (name == "measure")
+        *effort = VRT_FFT_MEASURE;
+    else if (name == "patient")
+        *effort = VRT_FFT_PATIENT;
+    else {
+        printf("Unknown FFT effort %s (estimate, measure or patient).\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+static vrt_fft_effort planner_effort = VRT_FFT_ESTIMATE;
+static std::string wisdom_dir;
+static bool wisdom_loaded[2] = {false, false};
+static std::string wisdom_saved[2];
+
+void vrt_fft_set_effort(vrt_fft_effort effort, const std::string& dir) {
+    planner_effort = effort;
+    wisdom_dir = dir;
+}
+
+static std::string cache_dir() {
+    if (!wisdom_dir.empty())
+        return wisdom_dir;
+    const char* env = getenv("VRT_FFT_WISDOM");
+    if (env and env[0])
+        return env;
+    env = getenv("XDG_CACHE_HOME");
+    if (env and env[0])
+        return std::string(env) + "/vrt-iq-tools";
+    env = getenv("HOME");
+    if (env and env[0])
+        return std::string(env) + "/.cache/vrt-iq-tools";
+    return "";
+}
+
+std::string vrt_fft_wisdom_file(vrt_fft_precision precision) {
+    std::string dir = cache_dir();
+    if (dir.empty())
+        return "";
+    return dir + (precision == VRT_FFT_FLOAT ? "/wisdom-float" : "/wisdom-double");
+}
+
+static bool make_dirs(const std::string& dir) {
+    for (size_t pos = 1; pos != std::string::npos; ) {
+        pos = dir.find('/', pos + 1);
+        std::string part = dir.substr(0, pos);
+        if (mkdir(part.c_str(), 0755) != 0 and errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+static std::string export_wisdom(vrt_fft_precision precision) {
+    char* text = precision == VRT_FFT_FLOAT ? fftwf_export_wisdom_to_string() : fftw_export_wisdom_to_string();
+    if (text == NULL)
+        return "";
+    std::string wisdom(text);
+    free(text);
+    return wisdom;
+}
+
+static void load_wisdom(vrt_fft_precision precision) {
+    if (wisdom_loaded[precision])
+        return;
+    wisdom_loaded[precision] = true;
+    std::string file = vrt_fft_wisdom_file(precision);
+    if (!file.empty() and access(file.c_str(), R_OK) == 0) {
+        int ok = precision == VRT_FFT_FLOAT ? fftwf_import_wisdom_from_filename(file.c_str())
+                                            : fftw_import_wisdom_from_filename(file.c_str());
+        if (!ok)
+            printf("Ignoring unreadable FFT wisdom %s.\n", file.c_str());
+    }
+    wisdom_saved[precision] = export_wisdom(precision);
+}
+
+static void save_wisdom(vrt_fft_precision precision) {
+    std::string wisdom = export_wisdom(precision);
+    if (wisdom == wisdom_saved[precision])
+        return;
+    std::string file = vrt_fft_wisdom_file(precision);
+    if (file.empty())
+        return;
+    std::string tmp = file + "." + std::to_string(getpid());
+    FILE* f = NULL;
+    if (make_dirs(file.substr(0, file.rfind('/'))))
+        f = fopen(tmp.c_str(), "w");
+    bool ok = f != NULL and fputs(wisdom.c_str(), f) >= 0;
+    if (f != NULL)
+        ok = fclose(f) == 0 and ok;
+    if (ok and rename(tmp.c_str(), file.c_str()) == 0) {
+        wisdom_saved[precision] = wisdom;
+        return;
+    }
+    printf("Failed to store FFT wisdom in %s.\n", file.c_str());
+    unlink(tmp.c_str());
+    // don't retry for every plan
+    wisdom_saved[precision] = wisdom;
+}
+
+static unsigned effort_flags() {
+    switch (planner_effort) {
+        case VRT_FFT_MEASURE: return FFTW_MEASURE;
+        case VRT_FFT_PATIENT: return FFTW_PATIENT;
+        default: return FFTW_ESTIMATE;
+    }
+}
+
+// Measuring overwrites the arrays, they are restored after planning
+template <typename Plan, typename Planner>
+static Plan make_plan(vrt_fft_precision precision, void* in, void* out, size_t bytes, Planner planner) {
+
+    load_wisdom(precision);
+
+    bool measure = planner_effort != VRT_FFT_ESTIMATE;
+    std::vector<char> saved_in, saved_out;
+    if (measure) {
+        saved_in.assign((char*)in, (char*)in + bytes);
+        if (out != in)
+            saved_out.assign((char*)out, (char*)out + bytes);
+    }
+
+    Plan plan = planner(effort_flags());
+
+    if (measure) {
+        memcpy(in, saved_in.data(), bytes);
+        if (out != in)
+            memcpy(out, saved_out.data(), bytes);
+        save_wisdom(precision);
+    }
+    return plan;
+}
+
+fftw_plan vrt_fft_plan(int n, int howmany, fftw_complex* in, fftw_complex* out, int sign, unsigned flags) {
+    return make_plan<fftw_plan>(VRT_FFT_DOUBLE, in, out, sizeof(fftw_complex)*n*howmany,
+        [&](unsigned effort) {
+            return fftw_plan_many_dft(1, &n, howmany, in, NULL, 1, n, out, NULL, 1, n, sign, effort | flags);
+        });
+}
+
+fftwf_plan vrt_fft_plan(int n, int howmany, fftwf_complex* in, fftwf_complex* out, int sign, unsigned flags) {
+    return make_plan<fftwf_plan>(VRT_FFT_FLOAT, in, out, sizeof(fftwf_complex)*n*howmany,
+        [&](unsigned effort) {
+            return fftwf_plan_many_dft(1, &n, howmany, in, NULL, 1, n, out, NULL, 1, n, sign, effort | flags);
+        });
+}
+
+vrt_fft* vrt_fft_create(uint32_t n, vrt_fft_precision precision) {
+
+    vrt_fft* fft = new vrt_fft();
+    fft->precision = precision;
+    fft->n = n;
+    fft->in = fft->out = NULL;
+    fft->in_f = fft->out_f = NULL;
+    fft->plan = NULL;
+    fft->plan_f = NULL;
+
+    if (precision == VRT_FFT_FLOAT) {
+        fft->in_f = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * n);
+        fft->out_f = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * n);
+        memset((void*)fft->in_f, 0, sizeof(fftwf_complex) * n);
+        fft->plan_f = vrt_fft_plan(n, 1, reinterpret_cast<fftwf_complex*>(fft->in_f),
+            reinterpret_cast<fftwf_complex*>(fft->out_f), FFTW_FORWARD);
+    } else {
+        fft->in = (std::complex<double>*) fftw_malloc(sizeof(fftw_complex) * n);
+        fft->out = (std::complex<double>*) fftw_malloc(sizeof(fftw_complex) * n);
+        memset((void*)fft->in, 0, sizeof(fftw_complex) * n);
+        fft->plan = vrt_fft_plan(n, 1, reinterpret_cast<fftw_complex*>(fft->in),
+            reinterpret_cast<fftw_complex*>(fft->out), FFTW_FORWARD);
+    }
+    return fft;
+}
+
+void vrt_fft_execute(vrt_fft* fft) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        fftwf_execute(fft->plan_f);
+    else
+        fftw_execute(fft->plan);
+}
+
+void vrt_fft_load(vrt_fft* fft, uint32_t offset, const uint32_t* payload, vrt_sample_format format,
+    uint32_t n, double scale, bool fftshift) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        vrt_payload_to_cf32(payload, format, fft->in_f + offset, n, scale, fftshift);
+    else
+        vrt_payload_to_cf64(payload, format, fft->in + offset, n, scale, fftshift);
+}
+
+void vrt_fft_accumulate_power(const vrt_fft* fft, double* acc) {
+    if (fft->precision == VRT_FFT_FLOAT)
+        vrt_accumulate_power(fft->out_f, acc, fft->n);
+    else
+        vrt_accumulate_power(fft->out, acc, fft->n);
+}
+
+void vrt_fft_destroy(vrt_fft* fft) {
+    if (!fft)
+        return;
+    if (fft->precision == VRT_FFT_FLOAT) {
+        fftwf_destroy_plan(fft->plan_f);
+        fftwf_free(fft->in_f);
+        fftwf_free(fft->out_f);
+    } else {
+        fftw_destroy_plan(fft->plan);
+        fftw_free(fft->in);
+        fftw_free(fft->out);
+    }
+    delete fft;
+}
+
+struct fft_worker {
+    fftw_plan slice_plan;
+    fftwf_plan slice_plan_f;
+    double* power;
+    std::complex<double>* phase;
+    // statistics
+    uint32_t blocks;
+    std::vector<double> block_power;
+    std::vector<double> power2;
+    std::vector<double> max;
+    std::vector<double> min;
+    std::vector<double> median;
+};
+
+// Smallest relative step of the median estimate
+#define VRT_FFT_MEDIAN_STEP 0.002
+
+struct vrt_fft_engine {
+    uint32_t num_bins;
+    uint32_t threads;
+    uint32_t slice;
+    uint32_t batch;
+    uint32_t pending;
+    bool phase;
+    bool stats;
+    bool median;
+    vrt_fft_precision precision;
+    std::complex<double>* data;
+    std::complex<float>* data_f;
+    fftw_plan block_plan;
+    fftwf_plan block_plan_f;
+    std::vector<fft_worker> workers;
+    std::vector<std::thread> pool;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    uint64_t generation;
+    uint32_t running;
+    uint32_t run_blocks;
+    bool stop;
+};
+
+template <typename T>
+static void accumulate_phase(const std::complex<T>* block, std::complex<double>* phase, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        phase[i] += std::complex<double>(block[i]);
+}
+
+static void reset_stats(fft_worker& worker) {
+    worker.blocks = 0;
+    std::fill(worker.power2.begin(), worker.power2.end(), 0);
+    std::fill(worker.max.begin(), worker.max.end(), 0);
+    std::fill(worker.min.begin(), worker.min.end(), HUGE_VAL);
+    std::fill(worker.median.begin(), worker.median.end(), 0);
+}
+
+/* Power sums and statistics of one block. The median estimate moves by a
+ * factor 1 + step towards the power, so it converges to the median of the
+ * log power, which is the log of the median power. */
+template <typename T>
+static void accumulate_stats(fft_worker& worker, const std::complex<T>* block, uint32_t n, bool median) {
+    double* p = worker.block_power.data();
+    std::fill(p, p + n, 0);
+    vrt_accumulate_power(block, p, n);
+    vrt_accumulate_moments(p, worker.power, worker.power2.data(), worker.max.data(), worker.min.data(), n);
+    worker.blocks++;
+    if (not median)
+        return;
+    double step = std::max(VRT_FFT_MEDIAN_STEP, 1/sqrt((double)worker.blocks));
+    double up = 1 + step, down = 1/(1 + step);
+    double* m = worker.median.data();
+    for (uint32_t i = 0; i < n; i++) {
+        double estimate = m[i] > 0 ? m[i] : p[i];
+        m[i] = p[i] > estimate ? estimate*up : (p[i] < estimate ? estimate*down : estimate);
+    }
+}
+
+// Transform and accumulate the blocks of thread t in a run of blocks
+static void run_slice(vrt_fft_engine* engine, uint32_t t, uint32_t blocks) {
+
+    fft_worker& worker = engine->workers[t];
+    uint32_t first = t*engine->slice;
+    uint32_t last = std::min(blocks, first + engine->slice);
+    if (first >= last)
+        return;
+
+    bool single = engine->precision == VRT_FFT_FLOAT;
+
+    if (last - first == engine->slice) {
+        if (single)
+            fftwf_execute(worker.slice_plan_f);
+        else
+            fftw_execute(worker.slice_plan);
+    } else {
+        for (uint32_t k = first; k < last; k++) {
+            size_t offset = (size_t)k*engine->num_bins;
+            if (single) {
+                fftwf_complex* block = reinterpret_cast<fftwf_complex*>(engine->data_f + offset);
+                fftwf_execute_dft(engine->block_plan_f, block, block);
+            } else {
+                fftw_complex* block = reinterpret_cast<fftw_complex*>(engine->data + offset);
+                fftw_execute_dft(engine->block_plan, block, block);
+            }
+        }
+    }
+
+    for (uint32_t k = first; k < last; k++) {
+        size_t offset = (size_t)k*engine->num_bins;
+        if (engine->stats) {
+            if (single)
+                accumulate_stats(worker, engine->data_f + offset, engine->num_bins, engine->median);
+            else
+                accumulate_stats(worker, engine->data + offset, engine->num_bins, engine->median);
+            if (engine->phase) {
+                if (single)
+                    accumulate_phase(engine->data_f + offset, worker.phase, engine->num_bins);
+                else
+                    accumulate_phase(engine->data + offset, worker.phase, engine->num_bins);
+            }
+        } else if (single) {
+            vrt_accumulate_power(engine->data_f + offset, worker.power, engine->num_bins);
+            if (engine->phase)
+                accumulate_phase(engine->data_f + offset, worker.phase, engine->num_bins);
+        } else {
+            vrt_accumulate_power(engine->data + offset, worker.power, engine->num_bins);
+            if (engine->phase)
+                accumulate_phase(engine->data + offset, worker.phase, engine->num_bins);
+        }
+    }
+}
+
+static void worker_loop(vrt_fft_engine* engine, uint32_t t) {
+
+    uint64_t generation = 0;
+
+    while (true) {
+        uint32_t blocks;
+        {
+            std::unique_lock<std::mutex> lock(engine->mutex);
+            engine->start_cv.wait(lock, [&] { return engine->stop or engine->generation != generation; });
+            if (engine->stop)
+                return;
+            generation = engine->generation;
+            blocks = engine->run_blocks;
+        }
+
+        run_slice(engine, t, blocks);
+
+        std::lock_guard<std::mutex> lock(engine->mutex);
+        if (--engine->running == 0)
+            engine->done_cv.notify_one();
+    }
+}
+
+// Transform the pending blocks on all threads
+static void run_batch(vrt_fft_engine* engine) {
+
+    if (engine->pending == 0)
+        return;
+
+    uint64_t stage_begin = vrt_metrics_stage_begin();
+
+    if (engine->threads > 1) {
+        {
+            std::lock_guard<std::mutex> lock(engine->mutex);
+            engine->run_blocks = engine->pending;
+            engine->running = engine->threads - 1;
+            engine->generation++;
+        }
+        engine->start_cv.notify_all();
+    }
+
+    run_slice(engine, 0, engine->pending);
+
+    if (engine->threads > 1) {
+        std::unique_lock<std::mutex> lock(engine->mutex);
+        engine->done_cv.wait(lock, [&] { return engine->running == 0; });
+    }
+
+    engine->pending = 0;
+    vrt_metrics_stage_end(VRT_STAGE_FFT, stage_begin);
+}
+
+vrt_fft_engine* vrt_fft_engine_create(uint32_t num_bins, uint32_t batch, uint32_t threads, bool phase,
+    vrt_fft_precision precision) {
+
+    if (num_bins == 0 or batch == 0 or threads == 0) {
+        printf("Invalid FFT size, batch or number of threads.\n");
+        return NULL;
+    }
+
+    vrt_fft_engine* engine = new vrt_fft_engine();
+    engine->num_bins = num_bins;
+    engine->threads = threads;
+    engine->slice = (batch + threads - 1)/threads;
+    engine->batch = engine->slice*threads;
+    engine->pending = 0;
+    engine->phase = phase;
+    engine->stats = false;
+    engine->median = false;
+    engine->precision = precision;
+    engine->data = NULL;
+    engine->data_f = NULL;
+    engine->block_plan = NULL;
+    engine->block_plan_f = NULL;
+    engine->generation = 0;
+    engine->running = 0;
+    engine->run_blocks = 0;
+    engine->stop = false;
+
+    size_t samples = (size_t)num_bins * engine->batch;
+    if (precision == VRT_FFT_FLOAT) {
+        engine->data_f = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * samples);
+        if (engine->data_f)
+            memset((void*)engine->data_f, 0, sizeof(fftwf_complex) * samples);
+    } else {
+        engine->data = (std::complex<double>*) fftw_malloc(sizeof(fftw_complex) * samples);
+        if (engine->data)
+            memset((void*)engine->data, 0, sizeof(fftw_complex) * samples);
+    }
+    if (engine->data == NULL and engine->data_f == NULL) {
+        printf("Failed to allocate an FFT batch of %u x %u bins.\n", engine->batch, num_bins);
+        delete engine;
+        return NULL;
+    }
+
+    // the planner is not thread safe, all plans are made here
+    fftw_complex* data = reinterpret_cast<fftw_complex*>(engine->data);
+    fftwf_complex* data_f = reinterpret_cast<fftwf_complex*>(engine->data_f);
+    if (precision == VRT_FFT_FLOAT)
+        engine->block_plan_f = vrt_fft_plan(num_bins, 1, data_f, data_f, FFTW_FORWARD, FFTW_UNALIGNED);
+    else
+        engine->block_plan = vrt_fft_plan(num_bins, 1, data, data, FFTW_FORWARD, FFTW_UNALIGNED);
+
+    engine->workers.resize(threads);
+    for (uint32_t t = 0; t < threads; t++) {
+        fft_worker& worker = engine->workers[t];
+        size_t offset = (size_t)t*engine->slice*num_bins;
+        worker.slice_plan = NULL;
+        worker.slice_plan_f = NULL;
+        if (precision == VRT_FFT_FLOAT)
+            worker.slice_plan_f = vrt_fft_plan(num_bins, engine->slice, data_f + offset, data_f + offset, FFTW_FORWARD);
+        else
+            worker.slice_plan = vrt_fft_plan(num_bins, engine->slice, data + offset, data + offset, FFTW_FORWARD);
+        worker.power = (double*) fftw_malloc(sizeof(double) * num_bins);
+        memset(worker.power, 0, sizeof(double) * num_bins);
+        worker.phase = NULL;
+        if (phase) {
+            worker.phase = (std::complex<double>*) fftw_malloc(sizeof(fftw_complex) * num_bins);
+            memset((void*)worker.phase, 0, sizeof(fftw_complex) * num_bins);
+        }
+    }
+
+    for (uint32_t t = 1; t < threads; t++)
+        engine->pool.emplace_back(worker_loop, engine, t);
+
+    return engine;
+}
+
+std::complex<double>* vrt_fft_engine_input(vrt_fft_engine* engine) {
+    if (engine->data == NULL)
+        return NULL;
+    return engine->data + (size_t)engine->pending*engine->num_bins;
+}
+
+std::complex<float>* vrt_fft_engine_input_f(vrt_fft_engine* engine) {
+    if (engine->data_f == NULL)
+        return NULL;
+    return engine->data_f + (size_t)engine->pending*engine->num_bins;
+}
+
+void vrt_fft_engine_push(vrt_fft_engine* engine) {
+    if (++engine->pending == engine->batch)
+        run_batch(engine);
+}
+
+void vrt_fft_engine_enable_stats(vrt_fft_engine* engine, bool median) {
+    engine->stats = true;
+    engine->median = median;
+    for (fft_worker& worker : engine->workers) {
+        worker.block_power.resize(engine->num_bins);
+        worker.power2.resize(engine->num_bins);
+        worker.max.resize(engine->num_bins);
+        worker.min.resize(engine->num_bins);
+        if (median)
+            worker.median.resize(engine->num_bins);
+        reset_stats(worker);
+    }
+}
+
+void vrt_fft_engine_reduce(vrt_fft_engine* engine, double* magnitudes, double* phases_r, double* phases_i,
+    const vrt_fft_stats* stats) {
+
+    run_batch(engine);
+
+    if (engine->stats) {
+        uint32_t n = engine->num_bins;
+        uint32_t threads = 0;
+        if (stats) {
+            std::fill(stats->max, stats->max + n, 0);
+            std::fill(stats->min, stats->min + n, HUGE_VAL);
+            if (stats->median)
+                std::fill(stats->median, stats->median + n, 0);
+        }
+        for (fft_worker& worker : engine->workers) {
+            if (stats and worker.blocks > 0) {
+                threads++;
+                for (uint32_t i = 0; i < n; i++) {
+                    stats->power2[i] += worker.power2[i];
+                    stats->max[i] = std::max(stats->max[i], worker.max[i]);
+                    stats->min[i] = std::min(stats->min[i], worker.min[i]);
+                }
+                if (stats->median and engine->median)
+                    for (uint32_t i = 0; i < n; i++)
+                        stats->median[i] += worker.median[i];
+            }
+            reset_stats(worker);
+        }
+        if (stats and threads == 0)
+            std::fill(stats->min, stats->min + n, 0);
+        if (stats and stats->median and threads > 1)
+            for (uint32_t i = 0; i < n; i++)
+                stats->median[i] /= threads;
+    }
+
+    for (fft_worker& worker : engine->workers) {
+        for (uint32_t i = 0; i < engine->num_bins; i++)
+            magnitudes[i] += worker.power[i];
+        memset(worker.power, 0, sizeof(double) * engine->num_bins);
+
+        if (engine->phase) {
+            if (phases_r and phases_i) {
+                for (uint32_t i = 0; i < engine->num_bins; i++) {
+                    phases_r[i] += worker.phase[i].real();
+                    phases_i[i] += worker.phase[i].imag();
+                }
+            }
+            memset((void*)worker.phase, 0, sizeof(fftw_complex) * engine->num_bins);
+        }
+    }
+}
+
+void vrt_fft_engine_destroy(vrt_fft_engine* engine) {
+
+    if (!engine)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(engine->mutex);
+        engine->stop = true;
+    }
+    engine->start_cv.notify_all();
+    for (std::thread& thread : engine->pool)
+        thread.join();
+
+    for (fft_worker& worker : engine->workers) {
+        if (worker.slice_plan)
+            fftw_destroy_plan(worker.slice_plan);
+        if (worker.slice_plan_f)
+            fftwf_destroy_plan(worker.slice_plan_f);
+        fftw_free(worker.power);
+        if (worker.phase)
+            fftw_free(worker.phase);
+    }
+    if (engine->block_plan)
+        fftw_destroy_plan(engine->block_plan);
+    if (engine->block_plan_f)
+        fftwf_destroy_plan(engine->block_plan_f);
+    if (engine->data)
+        fftw_free(engine->data);
+    if (engine->data_f)
+        fftwf_free(engine->data_f);
+    delete engine;
+}
@@ -0,0 +1,69 @@
+/* sigproc filterbank header writer, shared by vrt_to_filterbank and the
+ * filterbank sink of vrt_spectral_hub */
+
+#include <string.h>
+
+#include "vrt-filterbank.h"
+
+static void fb_keyword(FILE* fp, const char* keyword) {
+    int32_t len = strlen(keyword);
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(keyword, len, 1, fp);
+}
+
+static void fb_int(FILE* fp, const char* keyword, int32_t value) {
+    fb_keyword(fp, keyword);
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+static void fb_double(FILE* fp, const char* keyword, double value) {
+    fb_keyword(fp, keyword);
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+static void fb_string(FILE* fp, const char* keyword, const std::string& value) {
+    fb_keyword(fp, keyword);
+    fb_keyword(fp, value.c_str());
+}
+
+void vrt_filterbank_set_band(vrt_filterbank_header* h, double center_freq, double sample_rate,
+    uint32_t nchans, bool negative_foff) {
+
+    h->nchans = nchans;
+    if (negative_foff) {
+        h->fch1 = center_freq/1e6 + sample_rate/2e6;
+        h->foff = -(sample_rate/1e6)/nchans;
+    } else {
+        h->fch1 = center_freq/1e6 - sample_rate/2e6;
+        h->foff = (sample_rate/1e6)/nchans;
+    }
+}
+
+double vrt_filterbank_mjd(uint64_t integer_seconds, uint64_t fractional_seconds) {
+    return ((double)integer_seconds + (double)fractional_seconds/1e12)/86400.0 + 40587.0;
+}
+
+void vrt_filterbank_write_header(FILE* fp, const vrt_filterbank_header* h) {
+
+    fb_keyword(fp, "HEADER_START");
+    fb_int(fp, "machine_id", h->machine_id);
+    fb_int(fp, "telescope_id", h->telescope_id);
+    fb_int(fp, "data_type", h->data_type);
+    fb_int(fp, "ibeam", 1);
+    fb_string(fp, "source_name", h->source_name);
+    fb_int(fp, "nchans", h->nchans);
+    fb_int(fp, "nbeams", 1);
+    fb_int(fp, "nbits", 32);
+    fb_int(fp, "nifs", 1);
+    fb_double(fp, "fch1", h->fch1);
+    fb_double(fp, "foff", h->foff);
+    fb_double(fp, "tstart", h->tstart);
+    fb_double(fp, "tsamp", h->tsamp);
+    if (h->position) {
+        fb_double(fp, "src_raj", h->src_raj);
+        fb_double(fp, "src_dej", h->src_dej);
+        fb_double(fp, "az_start", h->az_start);
+        fb_double(fp, "za_start", h->za_start);
+    }
+    fb_keyword(fp, "HEADER_END");
+}
@@ -0,0 +1,411 @@
+/* FX correlator
+ *
+ * Blocks are collected per station in a batch. A batch runs in two stages:
+ * the FFT and delay correction of each block of each station, then the
+ * cross multiply of all baselines. The visibilities are baseline-major,
+ * num_bins contiguous per baseline, so the cross multiply of a baseline is
+ * one vrt_accumulate_cross run. The bins are done in tiles of VRT_FX_TILE
+ * for all baselines and blocks, so the tile of each station is read from
+ * the cache by the stations-1 baselines it is part of.
+ *
+ * With more than one thread, both stages are split over a worker pool:
+ * the blocks in the first stage, the tiles in the second, so every thread
+ * owns the accumulators of its tiles and nothing is reduced afterwards. The
+ * pool runs a batch while the calling thread fills the other one. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <fftw3.h>
+
+#include "vrt-fx.h"
+#include "vrt-convert.h"
+#include "vrt-metrics.h"
+
+struct fx_batch {
+    std::complex<double>* data;         // stations x batch blocks of num_bins
+    std::complex<float>* data_f;
+    std::vector<double> fractional;     // per block and station, samples
+    std::vector<std::complex<double>> rotation;
+    uint32_t blocks;
+};
+
+struct vrt_fx {
+    uint32_t stations;
+    uint32_t num_bins;
+    uint32_t batch;
+    uint32_t threads;
+    vrt_fft_precision precision;
+    std::vector<vrt_fx_baseline> baselines;
+    fx_batch sets[2];
+    uint32_t fill;                      // set being filled
+    fftw_plan plan;                     // one block, in place
+    fftwf_plan plan_f;
+    std::vector<uint32_t> shift;
+    std::vector<double> fractional;     // samples
+    std::vector<std::complex<double>> rotation;
+    std::vector<std::complex<double>> visibility;   // baselines*num_bins
+    std::vector<double> magnitude;
+
+    std::vector<std::thread> pool;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable stage_cv;
+    std::condition_variable done_cv;
+    uint64_t generation;
+    uint32_t run_set;
+    uint32_t running;                   // workers in the batch
+    uint32_t transforming;              // workers in the FFT stage
+    std::atomic<uint32_t> next_block;
+    std::atomic<uint32_t> next_tile;
+    bool stop;
+};
+
+std::vector<vrt_fx_baseline> vrt_fx_baselines(uint32_t stations, bool autos) {
+    std::vector<vrt_fx_baseline> baselines;
+    for (uint32_t a = 0; a < stations; a++)
+        for (uint32_t b = a + 1; b < stations; b++)
+            baselines.push_back({a, b});
+    if (autos)
+        for (uint32_t a = 0; a < stations; a++)
+            baselines.push_back({a, a});
+    return baselines;
+}
+
+/* Rotation times the phase slope of the fractional delay. The bins are in
+ * FFT order: the upper half are the negative frequencies, so the slope
+ * restarts at -N/2 there. Each half is a geometric sequence, kept in double
+ * for float spectra too. */
+template <typename T>
+static void correct_station(std::complex<T>* X, uint32_t n, double fractional, std::complex<double> rotation) {
+
+    if (fractional == 0 and rotation == 1.0)
+        return;
+    std::complex<double> step = std::polar(1.0, -2*M_PI*fractional/n);
+    std::complex<double> c = rotation;
+    for (uint32_t i = 0; i < n/2; i++) {
+        X[i] = std::complex<T>(std::complex<double>(X[i])*c);
+        c *= step;
+    }
+    c *= std::polar(1.0, 2*M_PI*fractional);
+    for (uint32_t i = n/2; i < n; i++) {
+        X[i] = std::complex<T>(std::complex<double>(X[i])*c);
+        c *= step;
+    }
+}
+
+// Transform and correct blocks until none are left
+static void run_transforms(vrt_fx* fx, fx_batch& set) {
+
+    uint32_t n = fx->num_bins;
+    uint32_t jobs = fx->stations*set.blocks;
+    for (uint32_t j = fx->next_block++; j < jobs; j = fx->next_block++) {
+        uint32_t s = j/set.blocks, k = j%set.blocks;
+        size_t offset = ((size_t)s*fx->batch + k)*n;
+        size_t model = (size_t)k*fx->stations + s;
+        if (fx->precision == VRT_FFT_FLOAT) {
+            fftwf_complex* block = reinterpret_cast<fftwf_complex*>(set.data_f + offset);
+            fftwf_execute_dft(fx->plan_f, block, block);
+            correct_station(set.data_f + offset, n, set.fractional[model], set.rotation[model]);
+        } else {
+            fftw_complex* block = reinterpret_cast<fftw_complex*>(set.data + offset);
+            fftw_execute_dft(fx->plan, block, block);
+            correct_station(set.data + offset, n, set.fractional[model], set.rotation[model]);
+        }
+    }
+}
+
+template <typename T>
+static void cross_tile(vrt_fx* fx, const std::complex<T>* data, uint32_t blocks, uint32_t first, uint32_t m) {
+    uint32_t n = fx->num_bins;
+    for (size_t b = 0; b < fx->baselines.size(); b++) {
+        const vrt_fx_baseline& baseline = fx->baselines[b];
+        size_t offset = b*n + first;
+        for (uint32_t k = 0; k < blocks; k++)
+            vrt_accumulate_cross(data + ((size_t)baseline.a*fx->batch + k)*n + first,
+                data + ((size_t)baseline.b*fx->batch + k)*n + first,
+                &fx->visibility[offset], &fx->magnitude[offset], m);
+    }
+}
+
+// Cross multiply tiles until none are left
+static void run_crosses(vrt_fx* fx, fx_batch& set) {
+
+    uint32_t n = fx->num_bins;
+    uint32_t tiles = (n + VRT_FX_TILE - 1)/VRT_FX_TILE;
+    for (uint32_t j = fx->next_tile++; j < tiles; j = fx->next_tile++) {
+        uint32_t first = j*VRT_FX_TILE;
+        uint32_t m = std::min<uint32_t>(VRT_FX_TILE, n - first);
+        if (fx->precision == VRT_FFT_FLOAT)
+            cross_tile(fx, set.data_f, set.blocks, first, m);
+        else
+            cross_tile(fx, set.data, set.blocks, first, m);
+    }
+}
+
+static void worker_loop(vrt_fx* fx, uint32_t t) {
+
+    uint64_t generation = 0;
+
+    while (true) {
+        uint32_t run_set;
+        {
+            std::unique_lock<std::mutex> lock(fx->mutex);
+            fx->start_cv.wait(lock, [&] { return fx->stop or fx->generation != generation; });
+            if (fx->stop)
+                return;
+            generation = fx->generation;
+            run_set = fx->run_set;
+        }
+
+        fx_batch& set = fx->sets[run_set];
+        uint64_t stage_begin = t == 0 ? vrt_metrics_stage_begin() : 0;
+
+        run_transforms(fx, set);
+        {
+            // all spectra of the batch are needed by every tile
+            std::unique_lock<std::mutex> lock(fx->mutex);
+            if (--fx->transforming == 0)
+                fx->stage_cv.notify_all();
+            else
+                fx->stage_cv.wait(lock, [&] { return fx->transforming == 0; });
+        }
+        run_crosses(fx, set);
+
+        if (t == 0)
+            vrt_metrics_stage_end(VRT_STAGE_FFT, stage_begin);
+
+        std::lock_guard<std::mutex> lock(fx->mutex);
+        if (--fx->running == 0)
+            fx->done_cv.notify_all();
+    }
+}
+
+static void wait_batch(vrt_fx* fx) {
+    if (fx->threads < 2)
+        return;
+    std::unique_lock<std::mutex> lock(fx->mutex);
+    fx->done_cv.wait(lock, [&] { return fx->running == 0; });
+}
+
+// Run the filled set, on the pool while the other set is filled next
+static void run_batch(vrt_fx* fx) {
+
+    fx_batch& set = fx->sets[fx->fill];
+    if (set.blocks == 0)
+        return;
+
+    wait_batch(fx);
+    fx->next_block = 0;
+    fx->next_tile = 0;
+
+    if (fx->threads < 2) {
+        uint64_t stage_begin = vrt_metrics_stage_begin();
+        run_transforms(fx, set);
+        run_crosses(fx, set);
+        vrt_metrics_stage_end(VRT_STAGE_FFT, stage_begin);
+        set.blocks = 0;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fx->mutex);
+        fx->run_set = fx->fill;
+        fx->running = fx->threads;
+        fx->transforming = fx->threads;
+        fx->generation++;
+    }
+    fx->start_cv.notify_all();
+    fx->fill = 1 - fx->fill;
+    fx->sets[fx->fill].blocks = 0;
+}
+
+vrt_fx* vrt_fx_create(uint32_t stations, uint32_t num_bins, bool autos, vrt_fft_precision precision,
+    uint32_t batch, uint32_t threads) {
+
+    if (stations < 2 or num_bins < 2) {
+        printf("A correlator needs at least 2 stations and 2 bins.\n");
+        return NULL;
+    }
+    if (batch == 0 or threads == 0) {
+        printf("Invalid correlator batch or number of threads.\n");
+        return NULL;
+    }
+
+    vrt_fx* fx = new vrt_fx();
+    fx->stations = stations;
+    fx->num_bins = num_bins;
+    fx->batch = batch;
+    fx->threads = threads;
+    fx->precision = precision;
+    fx->baselines = vrt_fx_baselines(stations, autos);
+    fx->fill = 0;
+    fx->plan = NULL;
+    fx->plan_f = NULL;
+    fx->generation = 0;
+    fx->run_set = 0;
+    fx->running = 0;
+    fx->transforming = 0;
+    fx->stop = false;
+
+    // the pool needs a second set to fill while it runs
+    size_t samples = (size_t)stations*batch*num_bins;
+    uint32_t sets = threads > 1 ? 2 : 1;
+    bool allocated = true;
+    for (uint32_t i = 0; i < 2; i++) {
+        fx_batch& set = fx->sets[i];
+        set.data = NULL;
+        set.data_f = NULL;
+        set.blocks = 0;
+        if (i >= sets)
+            continue;
+        if (precision == VRT_FFT_FLOAT) {
+            set.data_f = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * samples);
+            if (set.data_f)
+                memset((void*)set.data_f, 0, sizeof(fftwf_complex) * samples);
+        } else {
+            set.data = (std::complex<double>*) fftw_malloc(sizeof(fftw_complex) * samples);
+            if (set.data)
+                memset((void*)set.data, 0, sizeof(fftw_complex) * samples);
+        }
+        allocated = allocated and (set.data or set.data_f);
+        set.fractional.assign((size_t)batch*stations, 0);
+        set.rotation.assign((size_t)batch*stations, 1);
+    }
+    if (not allocated) {
+        printf("Failed to allocate a correlator batch of %u x %u x %u bins.\n", stations, batch, num_bins);
+        vrt_fx_destroy(fx);
+        return NULL;
+    }
+
+    // the planner is not thread safe, the plan is made here
+    if (precision == VRT_FFT_FLOAT) {
+        fftwf_complex* data = reinterpret_cast<fftwf_complex*>(fx->sets[0].data_f);
+        fx->plan_f = vrt_fft_plan(num_bins, 1, data, data, FFTW_FORWARD, FFTW_UNALIGNED);
+    } else {
+        fftw_complex* data = reinterpret_cast<fftw_complex*>(fx->sets[0].data);
+        fx->plan = vrt_fft_plan(num_bins, 1, data, data, FFTW_FORWARD, FFTW_UNALIGNED);
+    }
+
+    fx->shift.assign(stations, 0);
+    fx->fractional.assign(stations, 0);
+    fx->rotation.assign(stations, 1);
+    fx->visibility.assign(fx->baselines.size()*num_bins, 0);
+    fx->magnitude.assign(fx->baselines.size()*num_bins, 0);
+
+    if (threads > 1)
+        for (uint32_t t = 0; t < threads; t++)
+            fx->pool.emplace_back(worker_loop, fx, t);
+
+    return fx;
+}
+
+std::complex<double>* vrt_fx_input(vrt_fx* fx, uint32_t station) {
+    fx_batch& set = fx->sets[fx->fill];
+    if (set.data == NULL)
+        return NULL;
+    return set.data + ((size_t)station*fx->batch + set.blocks)*fx->num_bins;
+}
+
+std::complex<float>* vrt_fx_input_f(vrt_fx* fx, uint32_t station) {
+    fx_batch& set = fx->sets[fx->fill];
+    if (set.data_f == NULL)
+        return NULL;
+    return set.data_f + ((size_t)station*fx->batch + set.blocks)*fx->num_bins;
+}
+
+void vrt_fx_set_delays(vrt_fx* fx, const double* delay, const double* phase, double sample_rate, double rf_freq) {
+
+    std::vector<int64_t> whole(fx->stations);
+    for (uint32_t s = 0; s < fx->stations; s++) {
+        double samples = delay[s]*sample_rate;
+        whole[s] = (int64_t)floor(samples + 0.5);
+        fx->fractional[s] = samples - (double)whole[s];
+        fx->rotation[s] = std::polar(1.0, -2*M_PI*(rf_freq*delay[s] + phase[s]/360.0));
+    }
+    int64_t least = *std::min_element(whole.begin(), whole.end());
+    for (uint32_t s = 0; s < fx->stations; s++)
+        fx->shift[s] = (uint32_t)(whole[s] - least);
+}
+
+uint32_t vrt_fx_shift(const vrt_fx* fx, uint32_t station) {
+    return fx->shift[station];
+}
+
+void vrt_fx_push(vrt_fx* fx) {
+
+    fx_batch& set = fx->sets[fx->fill];
+    size_t model = (size_t)set.blocks*fx->stations;
+    std::copy(fx->fractional.begin(), fx->fractional.end(), set.fractional.begin() + model);
+    std::copy(fx->rotation.begin(), fx->rotation.end(), set.rotation.begin() + model);
+    if (++set.blocks == fx->batch)
+        run_batch(fx);
+}
+
+void vrt_fx_flush(vrt_fx* fx) {
+    run_batch(fx);
+    wait_batch(fx);
+}
+
+const std::vector<vrt_fx_baseline>& vrt_fx_baseline_list(const vrt_fx* fx) {
+    return fx->baselines;
+}
+
+std::complex<double>* vrt_fx_visibility(vrt_fx* fx, uint32_t b) {
+    return &fx->visibility[(size_t)b*fx->num_bins];
+}
+
+const double* vrt_fx_magnitude(const vrt_fx* fx, uint32_t b) {
+    return &fx->magnitude[(size_t)b*fx->num_bins];
+}
+
+void vrt_fx_normalize(vrt_fx* fx) {
+    for (size_t b = 0; b < fx->baselines.size(); b++) {
+        if (fx->baselines[b].a == fx->baselines[b].b)
+            continue;
+        std::complex<double>* v = vrt_fx_visibility(fx, b);
+        const double* m = vrt_fx_magnitude(fx, b);
+        for (uint32_t i = 0; i < fx->num_bins; i++)
+            if (m[i] > 0)
+                v[i] /= m[i];
+    }
+}
+
+void vrt_fx_reset(vrt_fx* fx) {
+    std::fill(fx->visibility.begin(), fx->visibility.end(), 0);
+    std::fill(fx->magnitude.begin(), fx->magnitude.end(), 0);
+}
+
+void vrt_fx_destroy(vrt_fx* fx) {
+
+    if (fx == NULL)
+        return;
+
+    wait_batch(fx);
+    {
+        std::lock_guard<std::mutex> lock(fx->mutex);
+        fx->stop = true;
+    }
+    fx->start_cv.notify_all();
+    for (std::thread& thread : fx->pool)
+        thread.join();
+
+    if (fx->plan)
+        fftw_destroy_plan(fx->plan);
+    if (fx->plan_f)
+        fftwf_destroy_plan(fx->plan_f);
+    for (fx_batch& set : fx->sets) {
+        if (set.data)
+            fftw_free(set.data);
+        if (set.data_f)
+            fftwf_free(set.data_f);
+    }
+    delete fx;
+}
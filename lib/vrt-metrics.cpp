@@ -0,0 +1,161 @@
+/* Process metrics in the Prometheus text format
+ *
+ * The counters are plain atomics updated inline by the tools. A detached
+ * exporter thread serves them over HTTP or rewrites a file, so a stalled
+ * processing loop still shows up in the metrics. */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <thread>
+
+#include "vrt-metrics.h"
+
+vrt_metrics* vrt_metrics_global = NULL;
+
+static const char* stage_names[VRT_NUM_STAGES] = {"receive", "convert", "fft", "output"};
+
+static void metric_header(std::string& text, const char* name, const char* type, const char* help) {
+    text += std::string("# HELP ") + name + " " + help + "\n";
+    text += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+static void metric_value(std::string& text, const char* name, const std::string& labels, double value) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s{%s} %.17g\n", name, labels.c_str(), value);
+    text += line;
+}
+
+std::string vrt_metrics_text(const vrt_metrics* metrics, const std::string& tool) {
+
+    std::string text;
+    std::string labels = "tool=\"" + tool + "\"";
+    const std::memory_order relaxed = std::memory_order_relaxed;
+
+    metric_header(text, "vrt_packets_total", "counter", "Data packets received.");
+    metric_value(text, "vrt_packets_total", labels, metrics->packets.load(relaxed));
+    metric_header(text, "vrt_samples_total", "counter", "Samples received.");
+    metric_value(text, "vrt_samples_total", labels, metrics->samples.load(relaxed));
+    metric_header(text, "vrt_lost_packets_total", "counter", "Data packets lost.");
+    metric_value(text, "vrt_lost_packets_total", labels, metrics->lost_packets.load(relaxed));
+    metric_header(text, "vrt_lost_samples_total", "counter", "Samples lost.");
+    metric_value(text, "vrt_lost_samples_total", labels, metrics->lost_samples.load(relaxed));
+    metric_header(text, "vrt_queue_depth", "gauge", "Packets waiting to be received or processed.");
+    metric_value(text, "vrt_queue_depth", labels, metrics->queue_depth.load(relaxed));
+
+    metric_header(text, "vrt_stage_seconds_total", "counter", "Time spent per processing stage.");
+    for (int s = 0; s < VRT_NUM_STAGES; s++)
+        metric_value(text, "vrt_stage_seconds_total", labels + ",stage=\"" + stage_names[s] + "\"",
+            metrics->stage_ns[s].load(relaxed)*1e-9);
+    metric_header(text, "vrt_stage_calls_total", "counter", "Executions per processing stage.");
+    for (int s = 0; s < VRT_NUM_STAGES; s++)
+        metric_value(text, "vrt_stage_calls_total", labels + ",stage=\"" + stage_names[s] + "\"",
+            metrics->stage_calls[s].load(relaxed));
+
+    metric_header(text, "vrt_latency_seconds", "gauge", "Latency of the last output from the VRT timestamp of its samples.");
+    metric_value(text, "vrt_latency_seconds", labels, metrics->latency_ns.load(relaxed)*1e-9);
+
+    return text;
+}
+
+static void write_file(const std::string& path, const std::string& tool) {
+    // write and rename, readers never see a partial file
+    std::string tmp = path + ".tmp";
+    while (true) {
+        std::string text = vrt_metrics_text(vrt_metrics_global, tool);
+        FILE* file = fopen(tmp.c_str(), "w");
+        if (file) {
+            fwrite(text.data(), 1, text.size(), file);
+            fclose(file);
+            rename(tmp.c_str(), path.c_str());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(VRT_METRICS_INTERVAL));
+    }
+}
+
+static void serve_http(int sock, const std::string& tool) {
+    while (true) {
+        int client = accept(sock, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        // the request is not parsed, every path returns the metrics
+        struct pollfd pfd = {client, POLLIN, 0};
+        char request[1024];
+        if (poll(&pfd, 1, 1000) > 0)
+            recv(client, request, sizeof(request), 0);
+
+        std::string text = vrt_metrics_text(vrt_metrics_global, tool);
+        std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(text.size()) + "\r\n\r\n" + text;
+        send(client, response.data(), response.size(), MSG_NOSIGNAL);
+        close(client);
+    }
+}
+
+static bool is_port(const std::string& target) {
+    return not target.empty() and target.size() <= 5
+        and target.find_first_not_of("0123456789") == std::string::npos;
+}
+
+bool vrt_metrics_start(const std::string& target, const std::string& tool) {
+
+    if (vrt_metrics_global) {
+        printf("Metrics are already enabled.\n");
+        return false;
+    }
+
+    vrt_metrics* metrics = new vrt_metrics();
+    metrics->packets = 0;
+    metrics->samples = 0;
+    metrics->lost_packets = 0;
+    metrics->lost_samples = 0;
+    metrics->queue_depth = 0;
+    for (int s = 0; s < VRT_NUM_STAGES; s++) {
+        metrics->stage_ns[s] = 0;
+        metrics->stage_calls[s] = 0;
+    }
+    metrics->latency_ns = 0;
+
+    // tool name without the path
+    std::string name = tool.substr(tool.find_last_of('/') + 1);
+
+    if (is_port(target)) {
+        int port = std::stoi(target);
+        if (port == 0 or port > 65535) {
+            printf("Invalid metrics port %s.\n", target.c_str());
+            delete metrics;
+            return false;
+        }
+
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (sock < 0 or bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 or listen(sock, 4) < 0) {
+            printf("Failed to serve metrics on port %s: %s\n", target.c_str(), strerror(errno));
+            if (sock >= 0)
+                close(sock);
+            delete metrics;
+            return false;
+        }
+        vrt_metrics_global = metrics;
+        std::thread(serve_http, sock, name).detach();
+    } else {
+        vrt_metrics_global = metrics;
+        std::thread(write_file, target, name).detach();
+    }
+
+    return true;
+}
@@ -0,0 +1,164 @@
+/* Spectral peaks
+ *
+ * Quadratic: vertex of the parabola through |X| of the three bins.
+ * Gaussian: the same through ln|X|, exact for a Gaussian window.
+ * Jacobsen: Re((X[-1] - X[+1])/(2X[0] - X[-1] - X[+1])) of the complex
+ * bins, for the rectangular window of the fftmax tools; its magnitude is
+ * corrected for the sinc scalloping loss. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "vrt-peak.h"
+
+bool vrt_parse_peak_interp(const std::string& name, vrt_peak_interp* interp) {
+    if (name == "none")
+        *interp = VRT_PEAK_NONE;
+    else if (name == "quadratic")
+        *interp = VRT_PEAK_QUADRATIC;
+    else if (name == "gaussian")
+        *interp = VRT_PEAK_GAUSSIAN;
+    else if (name == "jacobsen")
+        *interp = VRT_PEAK_JACOBSEN;
+    else {
+        printf("Unknown interpolation %s (none, quadratic, gaussian or jacobsen).\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+double vrt_peak_interpolate(vrt_peak_interp interp, const std::complex<double>* X, double* magnitude) {
+
+    double a = std::abs(X[0]), b = std::abs(X[1]), c = std::abs(X[2]);
+    double delta = 0;
+    *magnitude = b;
+
+    switch (interp) {
+        case VRT_PEAK_NONE:
+            return 0;
+
+        case VRT_PEAK_QUADRATIC: {
+            double d = a - 2*b + c;
+            if (d < 0) {
+                delta = 0.5*(a - c)/d;
+                *magnitude = b - 0.25*(a - c)*delta;
+            }
+            break;
+        }
+
+        case VRT_PEAK_GAUSSIAN: {
+            if (a <= 0 or b <= 0 or c <= 0)
+                return 0;
+            double la = log(a), lb = log(b), lc = log(c);
+            double d = la - 2*lb + lc;
+            if (d < 0) {
+                delta = 0.5*(la - lc)/d;
+                *magnitude = exp(lb - 0.25*(la - lc)*delta);
+            }
+            break;
+        }
+
+        case VRT_PEAK_JACOBSEN: {
+            std::complex<double> d = 2.0*X[1] - X[0] - X[2];
+            if (std::abs(d) > 0)
+                delta = std::real((X[0] - X[2])/d);
+            if (delta != 0 and fabs(delta) < 1)
+                *magnitude = b*M_PI*fabs(delta)/sin(M_PI*fabs(delta));
+            break;
+        }
+    }
+
+    // a peak between the neighbours, not beyond them
+    return std::max(-0.5, std::min(0.5, delta));
+}
+
+void vrt_peak_find(const double* magnitude, uint32_t num_bins, uint32_t min_bin, uint32_t max_bin,
+    uint32_t count, std::vector<uint32_t>* bins) {
+
+    bins->clear();
+    if (num_bins == 0 or count == 0)
+        return;
+    max_bin = std::min(max_bin, num_bins - 1);
+
+    if (count == 1) {
+        uint32_t max_i = min_bin;
+        for (uint32_t i = min_bin; i <= max_bin; i++)
+            if (magnitude[i] > magnitude[max_i])
+                max_i = i;
+        if (min_bin <= max_bin)
+            bins->push_back(max_i);
+        return;
+    }
+
+    // a plateau counts once, at its first bin
+    for (uint32_t i = min_bin; i <= max_bin; i++) {
+        if ((i == 0 or magnitude[i] > magnitude[i - 1])
+            and (i == num_bins - 1 or magnitude[i] >= magnitude[i + 1]))
+            bins->push_back(i);
+    }
+    auto stronger = [magnitude](uint32_t x, uint32_t y) { return magnitude[x] > magnitude[y]; };
+    if (bins->size() > count) {
+        std::partial_sort(bins->begin(), bins->begin() + count, bins->end(), stronger);
+        bins->resize(count);
+    } else {
+        std::sort(bins->begin(), bins->end(), stronger);
+    }
+}
+
+void vrt_peak_tracker_init(vrt_peak_tracker* tracker, uint32_t count, double max_jump, uint32_t hold) {
+    tracker->max_jump = max_jump;
+    tracker->hold = hold;
+    tracker->tracks.assign(count, vrt_peak_track());
+}
+
+void vrt_peak_tracker_update(vrt_peak_tracker* tracker, const std::vector<vrt_peak>& peaks) {
+
+    std::vector<vrt_peak_track>& tracks = tracker->tracks;
+    std::vector<bool> matched(tracks.size(), false);
+    std::vector<const vrt_peak*> unmatched;
+
+    // strongest peaks pick the nearest track first
+    for (const vrt_peak& peak : peaks) {
+        int32_t best = -1;
+        for (size_t t = 0; t < tracks.size(); t++) {
+            if (not tracks[t].active or matched[t])
+                continue;
+            double jump = fabs(peak.bin - tracks[t].bin);
+            if (jump <= tracker->max_jump and (best < 0 or jump < fabs(peak.bin - tracks[best].bin)))
+                best = t;
+        }
+        if (best < 0) {
+            unmatched.push_back(&peak);
+            continue;
+        }
+        matched[best] = true;
+        tracks[best].present = true;
+        tracks[best].bin = peak.bin;
+        tracks[best].magnitude = peak.magnitude;
+        tracks[best].missed = 0;
+    }
+
+    for (size_t t = 0; t < tracks.size(); t++) {
+        if (not tracks[t].active or matched[t])
+            continue;
+        tracks[t].present = false;
+        if (++tracks[t].missed > tracker->hold)
+            tracks[t].active = false;
+    }
+
+    // new peaks take the free slots
+    size_t t = 0;
+    for (const vrt_peak* peak : unmatched) {
+        while (t < tracks.size() and tracks[t].active)
+            t++;
+        if (t == tracks.size())
+            break;
+        tracks[t].active = true;
+        tracks[t].present = true;
+        tracks[t].bin = peak->bin;
+        tracks[t].magnitude = peak->magnitude;
+        tracks[t].missed = 0;
+    }
+}
@@ -0,0 +1,190 @@
+/* Receive thread with a lock-free single producer, single consumer queue
+ *
+ * The receive thread only copies messages from the socket (or shared memory
+ * ring) into a preallocated slot and publishes it by advancing head. The
+ * processing thread copies the slot out and advances tail. Each index is
+ * written by one side only, so acquire/release ordering is all the
+ * synchronization needed. Bursts and slow processing steps are absorbed by
+ * the queue instead of the ZMQ high water mark. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+
+#include "vrt-receiver.h"
+
+// Timeout of a single receive, the thread checks the stop flag in between (ms)
+#define VRT_RECEIVER_POLL_TIMEOUT 100
+
+struct vrt_receiver_slot {
+    uint32_t len;
+    uint64_t received_ns;
+    // packet data follows
+};
+
+struct vrt_receiver {
+    void* subscriber;
+    vrt_shm* shm;
+    uint32_t num_slots;
+    uint64_t slot_stride;
+    uint64_t max_latency_ns;
+    uint8_t* slots;
+    std::thread thread;
+    std::atomic<bool> stop;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> peak_occupancy;
+    std::atomic<uint64_t> dropped;
+};
+
+static inline vrt_receiver_slot* receiver_slot(vrt_receiver* receiver, uint64_t index) {
+    return (vrt_receiver_slot*)(receiver->slots + (index % receiver->num_slots) * receiver->slot_stride);
+}
+
+static inline uint8_t* slot_data(vrt_receiver_slot* slot) {
+    return (uint8_t*)slot + sizeof(vrt_receiver_slot);
+}
+
+// Sleep between polls, returns false if interrupted by a signal
+static bool receiver_wait(uint32_t idle_polls) {
+    if (idle_polls < 64)
+        return true;
+    struct timespec ts = {0, (idle_polls < 1024) ? 10000 : 100000};
+    return nanosleep(&ts, NULL) == 0;
+}
+
+static void receive_loop(vrt_receiver* receiver) {
+
+    // signals go to the processing thread, which owns the stop flag of the tool
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    while (not receiver->stop.load(std::memory_order_relaxed)) {
+
+        uint64_t head = receiver->head.load(std::memory_order_relaxed);
+        uint64_t tail = receiver->tail.load(std::memory_order_acquire);
+
+        if (head - tail >= receiver->num_slots) {
+            // queue full, wait for the processing thread
+            struct timespec ts = {0, 10000};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        vrt_receiver_slot* slot = receiver_slot(receiver, head);
+        int len = receiver->shm
+            ? vrt_shm_read(receiver->shm, slot_data(slot), ZMQ_BUFFER_SIZE, VRT_RECEIVER_POLL_TIMEOUT)
+            : zmq_recv(receiver->subscriber, slot_data(slot), ZMQ_BUFFER_SIZE, 0);
+        if (len <= 0)
+            continue;
+
+        slot->len = len < ZMQ_BUFFER_SIZE ? len : ZMQ_BUFFER_SIZE;
+        slot->received_ns = vrt_metrics_clock();
+        receiver->head.store(head + 1, std::memory_order_release);
+
+        uint32_t occupancy = head + 1 - tail;
+        if (occupancy > receiver->peak_occupancy.load(std::memory_order_relaxed))
+            receiver->peak_occupancy.store(occupancy, std::memory_order_relaxed);
+    }
+}
+
+vrt_receiver* vrt_receiver_start(void* subscriber, vrt_shm* shm, uint32_t num_slots, uint32_t max_latency_ms) {
+
+    if (num_slots == 0) {
+        printf("Invalid receive queue size.\n");
+        return NULL;
+    }
+
+    vrt_receiver* receiver = new vrt_receiver();
+    receiver->subscriber = subscriber;
+    receiver->shm = shm;
+    receiver->num_slots = num_slots;
+    receiver->slot_stride = (sizeof(vrt_receiver_slot) + ZMQ_BUFFER_SIZE + 63) & ~(uint64_t)63;
+    receiver->max_latency_ns = (uint64_t)max_latency_ms * 1000000;
+    receiver->slots = (uint8_t*)aligned_alloc(64, receiver->slot_stride * num_slots);
+    if (receiver->slots == NULL) {
+        printf("Failed to allocate a receive queue of %u packets.\n", num_slots);
+        delete receiver;
+        return NULL;
+    }
+    receiver->stop = false;
+    receiver->head = 0;
+    receiver->tail = 0;
+    receiver->peak_occupancy = 0;
+    receiver->dropped = 0;
+
+    if (shm == NULL) {
+        // return from zmq_recv now and then to see the stop flag
+        int timeout = VRT_RECEIVER_POLL_TIMEOUT;
+        zmq_setsockopt(subscriber, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    receiver->thread = std::thread(receive_loop, receiver);
+    return receiver;
+}
+
+int vrt_receiver_recv(vrt_receiver* receiver, void* buffer, size_t len) {
+
+    uint64_t begin = vrt_metrics_stage_begin();
+    uint64_t tail = receiver->tail.load(std::memory_order_relaxed);
+    uint32_t idle_polls = 0;
+
+    while (true) {
+        uint64_t head = receiver->head.load(std::memory_order_acquire);
+
+        if (head == tail) {
+            if (not receiver_wait(idle_polls++))
+                return -1;
+            continue;
+        }
+
+        vrt_receiver_slot* slot = receiver_slot(receiver, tail);
+
+        if (receiver->max_latency_ns > 0 and head - tail > 1
+            and vrt_metrics_clock() - slot->received_ns > receiver->max_latency_ns) {
+            // too old, the newest packet is always kept
+            receiver->dropped.fetch_add(1, std::memory_order_relaxed);
+            receiver->tail.store(++tail, std::memory_order_release);
+            continue;
+        }
+
+        size_t packet_len = slot->len;
+        memcpy(buffer, slot_data(slot), packet_len < len ? packet_len : len);
+        receiver->tail.store(tail + 1, std::memory_order_release);
+
+        vrt_metrics_stage_end(VRT_STAGE_RECEIVE, begin);
+        vrt_metrics_queue_depth(head - tail - 1);
+        return packet_len;
+    }
+}
+
+uint32_t vrt_receiver_occupancy(const vrt_receiver* receiver) {
+    // tail first, head never falls behind it
+    uint64_t tail = receiver->tail.load(std::memory_order_acquire);
+    return receiver->head.load(std::memory_order_acquire) - tail;
+}
+
+uint32_t vrt_receiver_peak_occupancy(const vrt_receiver* receiver) {
+    return receiver->peak_occupancy.load(std::memory_order_relaxed);
+}
+
+uint64_t vrt_receiver_dropped(const vrt_receiver* receiver) {
+    return receiver->dropped.load(std::memory_order_relaxed);
+}
+
+void vrt_receiver_stop(vrt_receiver* receiver) {
+    if (!receiver)
+        return;
+    receiver->stop = true;
+    receiver->thread.join();
+    free(receiver->slots);
+    delete receiver;
+}
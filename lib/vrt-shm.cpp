@@ -0,0 +1,297 @@
+/* Shared memory VRT packet ring (single producer, multiple consumers)
+ *
+ * Every slot carries a sequence number, written as a seqlock: odd while the
+ * producer is writing packet n (2n+1), even once it is complete (2n+2).
+ * Readers copy the packet and check the slot sequence before and after, so
+ * a slot overwritten while being read is detected as an overrun. */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "vrt-shm.h"
+
+#define VRT_SHM_MAGIC   0x56525453  // "VRTS"
+#define VRT_SHM_VERSION 1
+
+// Readers recheck the shared memory object after this much idle time (ms)
+#define VRT_SHM_REATTACH_INTERVAL 1000
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+struct vrt_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t num_slots;
+    uint64_t slot_stride;
+    alignas(64) std::atomic<uint64_t> write_seq;
+};
+
+struct vrt_shm_slot {
+    std::atomic<uint64_t> seq;
+    uint32_t len;
+    uint32_t reserved;
+    // packet data follows
+};
+
+struct vrt_shm {
+    std::string name;
+    bool producer;
+    vrt_shm_header* header;
+    size_t map_size;
+    ino_t inode;
+    uint64_t cursor;
+    uint64_t overruns;
+};
+
+static inline vrt_shm_slot* shm_slot(vrt_shm_header* header, uint64_t seq) {
+    return (vrt_shm_slot*)((char*)header + sizeof(vrt_shm_header)
+        + (seq % header->num_slots) * header->slot_stride);
+}
+
+static inline uint8_t* slot_data(vrt_shm_slot* slot) {
+    return (uint8_t*)slot + sizeof(vrt_shm_slot);
+}
+
+static std::string shm_path(const char* name) {
+    return (name[0] == '/') ? std::string(name) : "/" + std::string(name);
+}
+
+vrt_shm* vrt_shm_create(const char* name, uint32_t slot_size, uint32_t num_slots) {
+
+    std::string path = shm_path(name);
+    uint64_t stride = (sizeof(vrt_shm_slot) + slot_size + 63) & ~(uint64_t)63;
+    size_t map_size = sizeof(vrt_shm_header) + stride*num_slots;
+
+    // replace a ring left behind by a previous producer
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create shared memory %s: %s\n", path.c_str(), strerror(errno));
+        return NULL;
+    }
+    if (ftruncate(fd, map_size) < 0) {
+        fprintf(stderr, "Failed to size shared memory %s: %s\n", path.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(path.c_str());
+        return NULL;
+    }
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map shared memory %s: %s\n", path.c_str(), strerror(errno));
+        shm_unlink(path.c_str());
+        return NULL;
+    }
+
+    vrt_shm_header* header = (vrt_shm_header*)map;
+    header->version = VRT_SHM_VERSION;
+    header->slot_size = slot_size;
+    header->num_slots = num_slots;
+    header->slot_stride = stride;
+    header->write_seq.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < num_slots; i++)
+        shm_slot(header, i)->seq.store(0, std::memory_order_relaxed);
+    // readers only trust the geometry once the magic is visible
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = VRT_SHM_MAGIC;
+
+    vrt_shm* shm = new vrt_shm();
+    shm->name = path;
+    shm->producer = true;
+    shm->header = header;
+    shm->map_size = map_size;
+    shm->inode = 0;
+    shm->cursor = 0;
+    shm->overruns = 0;
+    return shm;
+}
+
+int vrt_shm_write(vrt_shm* shm, const void* buffer, size_t len) {
+
+    vrt_shm_header* header = shm->header;
+    if (len > header->slot_size)
+        return -1;
+
+    uint64_t seq = header->write_seq.load(std::memory_order_relaxed);
+    vrt_shm_slot* slot = shm_slot(header, seq);
+
+    slot->seq.store(2*seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->len = len;
+    memcpy(slot_data(slot), buffer, len);
+    slot->seq.store(2*seq + 2, std::memory_order_release);
+
+    header->write_seq.store(seq + 1, std::memory_order_release);
+    return len;
+}
+
+static void shm_detach(vrt_shm* shm) {
+    if (shm->header)
+        munmap(shm->header, shm->map_size);
+    shm->header = NULL;
+}
+
+// Map the ring if it exists and is initialized, returns true when attached
+static bool shm_attach(vrt_shm* shm) {
+
+    int fd = shm_open(shm->name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(vrt_shm_header)) {
+        close(fd);
+        return false;
+    }
+    if (shm->header && st.st_ino == shm->inode) {
+        // still the same ring
+        close(fd);
+        return true;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    vrt_shm_header* header = (vrt_shm_header*)map;
+    if (header->magic != VRT_SHM_MAGIC || header->version != VRT_SHM_VERSION
+        || sizeof(vrt_shm_header) + header->slot_stride*header->num_slots > (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (shm->header)
+        fprintf(stderr, "Shared memory %s was recreated, reattaching\n", shm->name.c_str());
+    shm_detach(shm);
+    shm->header = header;
+    shm->map_size = st.st_size;
+    shm->inode = st.st_ino;
+    // start with the newest packet, like a ZMQ subscriber
+    shm->cursor = header->write_seq.load(std::memory_order_acquire);
+    return true;
+}
+
+vrt_shm* vrt_shm_open(const char* name) {
+    vrt_shm* shm = new vrt_shm();
+    shm->name = shm_path(name);
+    shm->producer = false;
+    shm->header = NULL;
+    shm->map_size = 0;
+    shm->inode = 0;
+    shm->cursor = 0;
+    shm->overruns = 0;
+    // attach right away if the producer is already running
+    shm_attach(shm);
+    return shm;
+}
+
+// Sleep between polls, returns false if interrupted by a signal
+static bool shm_wait(uint32_t idle_polls) {
+    if (idle_polls < 64)
+        return true;
+    struct timespec ts = {0, (idle_polls < 1024) ? 10000 : 100000};
+    return nanosleep(&ts, NULL) == 0;
+}
+
+int vrt_shm_read(vrt_shm* shm, void* buffer, size_t len, int timeout_ms) {
+
+    uint32_t idle_polls = 0;
+    auto idle_since = std::chrono::steady_clock::now();
+    auto deadline = idle_since + std::chrono::milliseconds(timeout_ms);
+
+    while (true) {
+
+        if (!shm->header) {
+            if (!shm_attach(shm)) {
+                struct timespec ts = {0, 100000000};
+                if (nanosleep(&ts, NULL) < 0)
+                    return -1;
+                if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+                    return 0;
+                continue;
+            }
+        }
+
+        vrt_shm_header* header = shm->header;
+        uint64_t write_seq = header->write_seq.load(std::memory_order_acquire);
+
+        if (write_seq == shm->cursor) {
+            // nothing new, check now and then if the producer restarted
+            if (timeout_ms >= 0 && idle_polls >= 64 && std::chrono::steady_clock::now() >= deadline)
+                return 0;
+            if (idle_polls++ % 1024 == 1023) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - idle_since > std::chrono::milliseconds(VRT_SHM_REATTACH_INTERVAL)) {
+                    shm_attach(shm);
+                    idle_since = now;
+                }
+            }
+            if (!shm_wait(idle_polls))
+                return -1;
+            continue;
+        }
+
+        if (write_seq - shm->cursor >= header->num_slots) {
+            // fell behind a full ring, skip to the middle of the ring
+            uint64_t skip_to = write_seq - header->num_slots/2;
+            shm->overruns += skip_to - shm->cursor;
+            shm->cursor = skip_to;
+        }
+
+        vrt_shm_slot* slot = shm_slot(header, shm->cursor);
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq != 2*shm->cursor + 2) {
+            // already overwritten by a newer packet
+            shm->overruns++;
+            shm->cursor++;
+            continue;
+        }
+
+        size_t packet_len = slot->len;
+        memcpy(buffer, slot_data(slot), packet_len < len ? packet_len : len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (slot->seq.load(std::memory_order_relaxed) != seq) {
+            // overwritten while copying
+            shm->overruns++;
+            shm->cursor++;
+            continue;
+        }
+
+        shm->cursor++;
+        return packet_len;
+    }
+}
+
+uint64_t vrt_shm_overruns(const vrt_shm* shm) {
+    return shm->overruns;
+}
+
+uint64_t vrt_shm_backlog(const vrt_shm* shm) {
+    if (!shm->header)
+        return 0;
+    uint64_t write_seq = shm->header->write_seq.load(std::memory_order_relaxed);
+    return (write_seq > shm->cursor) ? write_seq - shm->cursor : 0;
+}
+
+void vrt_shm_close(vrt_shm* shm) {
+    if (!shm)
+        return;
+    shm_detach(shm);
+    if (shm->producer)
+        shm_unlink(shm->name.c_str());
+    delete shm;
+}
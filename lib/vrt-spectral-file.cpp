@@ -0,0 +1,245 @@
+/* Binary spectral file writer and reader
+ *
+ * The writer keeps the index in memory and writes it after the last row at
+ * close, then fills in rows and index_offset in the header. Until then a
+ * reader (tail -f style) takes the rows from the file size. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "vrt-spectral-file.h"
+
+static_assert(sizeof(vrt_spectral_header) == 112, "vrt_spectral_header layout");
+static_assert(sizeof(vrt_spectral_row) == 16, "vrt_spectral_row layout");
+static_assert(sizeof(vrt_spectral_index_entry) == 16, "vrt_spectral_index_entry layout");
+
+struct vrt_spectral_file {
+    FILE* fp;
+    vrt_spectral_header header;
+    std::vector<uint8_t> row;
+    std::vector<vrt_spectral_index_entry> index;
+};
+
+static std::string ecsv_metadata(const vrt_spectral_layout& layout) {
+
+    std::string text;
+    char line[256];
+
+    text += "# %ECSV 1.0\n";
+    text += "# ---\n";
+    text += "# delimiter: ','\n";
+    text += "# meta: !!omap\n";
+    text += "# - spectral_file: !!omap\n";
+    text += "#   - {kind: " + layout.kind + "}\n";
+    snprintf(line, sizeof(line), "#   - {sample_rate: %.1f}\n", layout.sample_rate);
+    text += line;
+    snprintf(line, sizeof(line), "#   - {frequency: %.1f}\n", layout.center_freq);
+    text += line;
+    if (layout.columns > 0) {
+        snprintf(line, sizeof(line), "#   - {bins: %u}\n", layout.columns);
+        text += line;
+        snprintf(line, sizeof(line), "#   - {first_bin: %.6e}\n", layout.first_freq);
+        text += line;
+        snprintf(line, sizeof(line), "#   - {bin_size: %.6e}\n", layout.column_step);
+        text += line;
+    }
+    if (layout.integrations > 0) {
+        snprintf(line, sizeof(line), "#   - {integrations: %u}\n", layout.integrations);
+        text += line;
+    }
+    if (layout.integration_time > 0) {
+        snprintf(line, sizeof(line), "#   - {integration_time: %.6f}\n", layout.integration_time);
+        text += line;
+    }
+    if (not layout.planes.empty()) {
+        text += "#   - {planes: [";
+        for (size_t p = 0; p < layout.planes.size(); p++)
+            text += (p ? ", " : "") + layout.planes[p];
+        text += "]}\n";
+    }
+    for (const auto& meta : layout.meta)
+        text += "#   - {" + meta.first + ": " + meta.second + "}\n";
+
+    text += "# datatype:\n";
+    text += "# - {name: timestamp, datatype: float64}\n";
+    for (const vrt_spectral_trace& trace : layout.traces) {
+        if (trace.unit.empty())
+            text += "# - {name: " + trace.name + ", datatype: float64}\n";
+        else
+            text += "# - {name: " + trace.name + ", unit: " + trace.unit + ", datatype: float64}\n";
+    }
+    if (layout.columns > 0 and layout.planes.size() > 1) {
+        snprintf(line, sizeof(line), "# - {name: values, datatype: %s, shape: [%zu, %u]}\n",
+            layout.complex ? "complex64" : "float32", layout.planes.size(), layout.columns);
+        text += line;
+    } else if (layout.columns > 0) {
+        snprintf(line, sizeof(line), "# - {name: values, datatype: %s, shape: [%u]}\n",
+            layout.complex ? "complex64" : "float32", layout.columns);
+        text += line;
+    }
+    text += "# schema: astropy-2.0\n";
+    return text;
+}
+
+vrt_spectral_file* vrt_spectral_file_create(const std::string& path, const vrt_spectral_layout& layout) {
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (fp == NULL) {
+        printf("Failed to create %s.\n", path.c_str());
+        return NULL;
+    }
+
+    vrt_spectral_file* file = new vrt_spectral_file();
+    file->fp = fp;
+
+    std::string metadata = ecsv_metadata(layout);
+
+    vrt_spectral_header& header = file->header;
+    memset((void*)&header, 0, sizeof(header));
+    memcpy(header.magic, VRT_SPECTRAL_MAGIC, sizeof(VRT_SPECTRAL_MAGIC));
+    header.version = VRT_SPECTRAL_VERSION;
+    header.metadata_size = metadata.size();
+    header.header_size = (sizeof(header) + metadata.size() + 1 + 63) & ~63;
+    header.columns = layout.columns;
+    header.complex = layout.complex;
+    header.traces = layout.traces.size();
+    header.integrations = layout.integrations;
+    size_t values = (size_t)layout.columns*(layout.complex ? 2 : 1)*std::max<size_t>(1, layout.planes.size());
+    header.row_size = (sizeof(vrt_spectral_row) + header.traces*sizeof(double) + values*sizeof(float) + 7) & ~7;
+    header.sample_rate = layout.sample_rate;
+    header.center_freq = layout.center_freq;
+    header.first_freq = layout.first_freq;
+    header.column_step = layout.column_step;
+    header.integration_time = layout.integration_time;
+    strncpy(header.kind, layout.kind.c_str(), sizeof(header.kind) - 1);
+
+    // header, metadata (NUL terminated) and zero padding up to the first row
+    std::vector<char> head(header.header_size, 0);
+    memcpy(head.data(), &header, sizeof(header));
+    memcpy(head.data() + sizeof(header), metadata.c_str(), metadata.size());
+    file->row.assign(header.row_size, 0);
+
+    if (fwrite(head.data(), head.size(), 1, fp) != 1 or fflush(fp) != 0) {
+        printf("Failed to write %s.\n", path.c_str());
+        fclose(fp);
+        delete file;
+        return NULL;
+    }
+    return file;
+}
+
+double* vrt_spectral_file_traces(vrt_spectral_file* file) {
+    return (double*)(file->row.data() + sizeof(vrt_spectral_row));
+}
+
+float* vrt_spectral_file_values(vrt_spectral_file* file) {
+    return (float*)(vrt_spectral_file_traces(file) + file->header.traces);
+}
+
+bool vrt_spectral_file_write(vrt_spectral_file* file, uint64_t seconds, uint64_t picoseconds) {
+
+    vrt_spectral_row* row = (vrt_spectral_row*)file->row.data();
+    row->seconds = seconds;
+    row->picoseconds = picoseconds;
+
+    vrt_spectral_index_entry entry;
+    entry.timestamp = (double)seconds + (double)picoseconds/1e12;
+    entry.offset = file->header.header_size + file->index.size()*file->header.row_size;
+    file->index.push_back(entry);
+
+    return fwrite(file->row.data(), file->row.size(), 1, file->fp) == 1 and fflush(file->fp) == 0;
+}
+
+void vrt_spectral_file_close(vrt_spectral_file* file) {
+
+    vrt_spectral_header& header = file->header;
+    header.rows = file->index.size();
+    header.index_offset = header.header_size + header.rows*header.row_size;
+
+    uint64_t rows = header.rows;
+    fwrite(VRT_SPECTRAL_INDEX_MAGIC, 8, 1, file->fp);
+    fwrite(&rows, sizeof(rows), 1, file->fp);
+    if (rows > 0)
+        fwrite(file->index.data(), sizeof(vrt_spectral_index_entry), rows, file->fp);
+
+    // the header goes last, a complete index_offset means a complete index
+    fseek(file->fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file->fp);
+    fclose(file->fp);
+    delete file;
+}
+
+vrt_spectral_map* vrt_spectral_file_map(const std::string& path) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("Failed to open %s.\n", path.c_str());
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 or (size_t)st.st_size < sizeof(vrt_spectral_header)) {
+        printf("%s is not a spectral file.\n", path.c_str());
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Failed to map %s.\n", path.c_str());
+        return NULL;
+    }
+
+    vrt_spectral_map* map = new vrt_spectral_map();
+    map->data = (const uint8_t*)data;
+    map->size = st.st_size;
+    map->header = (const vrt_spectral_header*)data;
+    map->metadata = (const char*)data + sizeof(vrt_spectral_header);
+    map->index = NULL;
+
+    const vrt_spectral_header* header = map->header;
+    if (memcmp(header->magic, VRT_SPECTRAL_MAGIC, sizeof(VRT_SPECTRAL_MAGIC)) != 0
+        or header->version != VRT_SPECTRAL_VERSION or header->row_size == 0
+        or header->header_size > map->size) {
+        printf("%s is not a spectral file.\n", path.c_str());
+        vrt_spectral_file_unmap(map);
+        return NULL;
+    }
+
+    map->rows = (map->size - header->header_size)/header->row_size;
+    if (header->index_offset != 0 and header->index_offset + 16 + header->rows*sizeof(vrt_spectral_index_entry) <= map->size
+        and memcmp(map->data + header->index_offset, VRT_SPECTRAL_INDEX_MAGIC, 8) == 0) {
+        map->rows = header->rows;
+        map->index = (const vrt_spectral_index_entry*)(map->data + header->index_offset + 16);
+    }
+    return map;
+}
+
+void vrt_spectral_file_unmap(vrt_spectral_map* map) {
+    munmap((void*)map->data, map->size);
+    delete map;
+}
+
+static double row_timestamp(const vrt_spectral_map* map, uint64_t i) {
+    if (map->index)
+        return map->index[i].timestamp;
+    const vrt_spectral_row* row = vrt_spectral_map_row(map, i);
+    return (double)row->seconds + (double)row->picoseconds/1e12;
+}
+
+uint64_t vrt_spectral_map_find(const vrt_spectral_map* map, double timestamp) {
+    uint64_t low = 0, high = map->rows;
+    while (low < high) {
+        uint64_t mid = low + (high - low)/2;
+        if (row_timestamp(map, mid) < timestamp)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
@@ -0,0 +1,540 @@
+/* VRT tools helper functions */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "vrt-tools.h"
+#include "vrt-metrics.h"
+
+bool vrt_view_parse(const uint32_t* buffer, int32_t words, vrt_packet_view* view) {
+
+    view->buffer = buffer;
+
+    int32_t rv = vrt_read_header(buffer, words, &view->header, true);
+    if (rv < 0) {
+        fprintf(stderr, "Failed to parse header: %s\n", vrt_string_error(rv));
+        return false;
+    }
+    int32_t offset = rv;
+
+    // never look beyond the end of this packet
+    view->words = (view->header.packet_size < words) ? view->header.packet_size : words;
+
+    rv = vrt_read_fields(&view->header, buffer + offset, view->words - offset, &view->fields, true);
+    if (rv < 0) {
+        fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
+        return false;
+    }
+    offset += rv;
+
+    view->payload_offset = offset;
+    view->payload_words = view->words - offset;
+
+    return true;
+}
+
+bool vrt_view_read_if_context(const vrt_packet_view* view, struct vrt_if_context* if_context) {
+
+    int32_t rv = vrt_read_if_context(view->buffer + view->payload_offset, view->payload_words, if_context, true);
+    if (rv < 0) {
+        fprintf(stderr, "Failed to parse IF context section: %s\n", vrt_string_error(rv));
+        return false;
+    }
+    return true;
+}
+
+void init_context(context_type* context) {
+    context->context_received = false;
+    context->context_changed = false;
+    context->last_data_counter = -1;
+    context->rf_freq = 0;
+    context->sample_rate = 0;
+    context->gain = 0;
+    context->bandwidth = 0;
+    context->stream_id = 0;
+    context->starttime_integer = 0;
+    context->starttime_fractional = 0;
+    context->reflock = false;
+    context->time_cal = false;
+    context->timestamp_calibration_time = 0;
+    context->timestamp_adjustment = 0;
+    context->last_data_integer = 0;
+    context->last_data_fractional = 0;
+    context->last_num_samps = 0;
+    context->last_sample = 0;
+    context->lost_packets = 0;
+    context->lost_samples = 0;
+    context->sample_format = VRT_FORMAT_CI16;
+    context->accept_formats = 1 << VRT_FORMAT_CI16;
+}
+
+bool check_packet_count(int8_t counter, context_type* vrt_context) {
+    if ( (vrt_context->last_data_counter > 0) and
+            ( (counter != (vrt_context->last_data_counter+1)%16) and
+              (counter != (vrt_context->last_data_counter  )%16) ) ) {
+        printf("# Error: lost frame (expected %i, received %i)\n", vrt_context->last_data_counter, counter);
+        vrt_context->last_data_counter = counter;
+        return false;
+    } else {
+        vrt_context->last_data_counter = counter;
+        return true;
+    }
+}
+
+bool vrt_check_loss(const vrt_packet_view* view, context_type* vrt_context, packet_type* vrt_packet) {
+
+    int32_t counter = view->header.packet_count;
+    uint32_t lost = 0;
+
+    vrt_packet->previous_sample = vrt_context->last_sample;
+    vrt_packet->fill_samples = 0;
+
+    // the same counter is accepted, channels of one frame share it
+    if (vrt_context->last_data_counter >= 0 and vrt_context->last_num_samps > 0
+            and counter != vrt_context->last_data_counter) {
+
+        lost = (counter - vrt_context->last_data_counter - 1) & 0xF;
+
+        if (vrt_context->sample_rate > 0) {
+            // packets that fit in the timestamp gap, more than half a counter
+            // cycle beyond the counter means the counter wrapped
+            int64_t gap_ps = (int64_t)(view->fields.integer_seconds_timestamp - vrt_context->last_data_integer)*(int64_t)1e12
+                + (int64_t)view->fields.fractional_seconds_timestamp - (int64_t)vrt_context->last_data_fractional;
+            double packets = (double)gap_ps*1e-12*(double)vrt_context->sample_rate/(double)vrt_context->last_num_samps - 1;
+            if (packets > lost + 8)
+                lost += 16*(uint32_t)round((packets - lost)/16.0);
+        }
+    }
+
+    vrt_packet->lost_packets = lost;
+    vrt_packet->lost_samples = (uint64_t)lost*vrt_context->last_num_samps;
+
+    if (lost > 0) {
+        printf("# Error: lost %u frame(s), %llu samples (expected %i, received %i)\n", lost,
+            (unsigned long long)vrt_packet->lost_samples, (vrt_context->last_data_counter+1)%16, counter);
+        vrt_context->lost_packets += lost;
+        vrt_context->lost_samples += vrt_packet->lost_samples;
+    }
+
+    vrt_context->last_data_counter = counter;
+    vrt_context->last_data_integer = view->fields.integer_seconds_timestamp;
+    vrt_context->last_data_fractional = view->fields.fractional_seconds_timestamp;
+    if (vrt_packet->num_rx_samps > 0) {
+        vrt_context->last_num_samps = vrt_packet->num_rx_samps;
+        // raw words of a ci16 or cf32 sample, the packed formats are not filled
+        const uint32_t* payload = view->buffer + vrt_packet->offset;
+        if (vrt_packet->sample_format == VRT_FORMAT_CF32)
+            memcpy(&vrt_context->last_sample, payload + 2*(vrt_packet->num_rx_samps-1), sizeof(uint64_t));
+        else if (vrt_packet->sample_format == VRT_FORMAT_CI16)
+            vrt_context->last_sample = payload[vrt_packet->num_rx_samps-1];
+    }
+
+    return lost > 0;
+}
+
+bool vrt_parse_loss_policy(const std::string& name, vrt_loss_policy* policy) {
+    if (name == "abort")
+        *policy = VRT_LOSS_ABORT;
+    else if (name == "zero")
+        *policy = VRT_LOSS_ZERO;
+    else if (name == "hold")
+        *policy = VRT_LOSS_HOLD;
+    else if (name == "invalid")
+        *policy = VRT_LOSS_INVALID;
+    else {
+        printf("Unknown loss policy %s (abort, zero, hold or invalid).\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool vrt_parse_sample_format(const std::string& name, vrt_sample_format* format) {
+    for (int f = VRT_FORMAT_CI16; f < VRT_NUM_FORMATS; f++) {
+        if (name == vrt_sample_format_name((vrt_sample_format)f)) {
+            *format = (vrt_sample_format)f;
+            return true;
+        }
+    }
+    printf("Unknown sample format %s (ci16, ci8, ci12 or cf32).\n", name.c_str());
+    return false;
+}
+
+const char* vrt_sample_format_name(vrt_sample_format format) {
+    switch (format) {
+        case VRT_FORMAT_CI8:  return "ci8";
+        case VRT_FORMAT_CI12: return "ci12";
+        case VRT_FORMAT_CF32: return "cf32";
+        default:              return "ci16";
+    }
+}
+
+void vrt_decode_payload(uint32_t* buffer, uint32_t buffer_words, const context_type* vrt_context, packet_type* vrt_packet) {
+
+    vrt_sample_format format = vrt_context->sample_format;
+    uint32_t words = vrt_packet->num_rx_samps;
+    uint32_t samples = vrt_payload_samples(words, format);
+
+    if (format == VRT_FORMAT_CI16 or (vrt_context->accept_formats & (1 << format))) {
+        vrt_packet->sample_format = format;
+        vrt_packet->num_rx_samps = samples;
+        return;
+    }
+
+    if (vrt_packet->offset + samples > buffer_words)
+        samples = (buffer_words > vrt_packet->offset) ? buffer_words - vrt_packet->offset : 0;
+
+    // the decoded payload can be larger, decode from a copy
+    static thread_local std::vector<uint32_t> compact;
+    compact.assign(buffer + vrt_packet->offset, buffer + vrt_packet->offset + words);
+    vrt_payload_to_ci16(compact.data(), format, buffer + vrt_packet->offset, samples);
+
+    vrt_packet->sample_format = VRT_FORMAT_CI16;
+    vrt_packet->num_rx_samps = samples;
+}
+
+bool vrt_fill_loss(uint32_t* buffer, uint32_t buffer_words, const context_type* vrt_context, packet_type* vrt_packet, vrt_loss_policy policy) {
+
+    if (policy == VRT_LOSS_ABORT)
+        return false;
+
+    if (vrt_packet->sample_format != VRT_FORMAT_CI16 and vrt_packet->sample_format != VRT_FORMAT_CF32)
+        return true;
+    uint32_t sample_words = (vrt_packet->sample_format == VRT_FORMAT_CF32) ? 2 : 1;
+
+    uint64_t space = (buffer_words - vrt_packet->offset)/sample_words - vrt_packet->num_rx_samps;
+    uint32_t fill = (uint32_t)std::min<uint64_t>(vrt_packet->lost_samples, space);
+    if (fill < vrt_packet->lost_samples)
+        printf("# Error: gap of %llu samples, only %u filled\n", (unsigned long long)vrt_packet->lost_samples, fill);
+    if (fill == 0)
+        return true;
+
+    uint32_t* payload = &buffer[vrt_packet->offset];
+    memmove(payload + fill*sample_words, payload, vrt_packet->num_rx_samps*sample_words*sizeof(uint32_t));
+
+    uint64_t value = (policy == VRT_LOSS_HOLD) ? vrt_packet->previous_sample : 0;
+    if (sample_words == 1) {
+        std::fill(payload, payload + fill, (uint32_t)value);
+    } else {
+        for (uint32_t i = 0; i < fill; i++)
+            memcpy(payload + 2*i, &value, sizeof(uint64_t));
+    }
+
+    vrt_packet->num_rx_samps += fill;
+    vrt_packet->fill_samples = fill;
+
+    // the packet now starts at the first missing sample
+    if (vrt_context->sample_rate > 0) {
+        int64_t frac = (int64_t)vrt_packet->fractional_seconds_timestamp
+            - (int64_t)round((double)fill*1e12/(double)vrt_context->sample_rate);
+        while (frac < 0) {
+            frac += (int64_t)1e12;
+            vrt_packet->integer_seconds_timestamp--;
+        }
+        vrt_packet->fractional_seconds_timestamp = frac;
+    }
+
+    return true;
+}
+
+void vrt_print_context(context_type* vrt_context) {
+
+    uint32_t ch=0;
+    while(not (vrt_context->stream_id & (1 << ch) ) )
+            ch++;
+
+    printf("# VRT Context:\n");
+    printf("#    Stream ID (channel): %u (%u)\n", vrt_context->stream_id, ch);
+    printf("#    Sample Rate [samples per second]: %i\n", vrt_context->sample_rate);
+    printf("#    RF Freq [Hz]: %lld\n", (long long int)vrt_context->rf_freq);
+    printf("#    RF frac. Freq [Hz]: %e\n", vrt_context->rf_frac_freq);
+    printf("#    Bandwidth [Hz]: %i\n", vrt_context->bandwidth);
+    printf("#    Gain [dB]: %i\n", vrt_context->gain);
+    printf("#    Ref lock: %s\n", vrt_context->reflock == 1 ? "external" : "internal");
+    printf("#    Time cal: %s\n", vrt_context->time_cal == 1? "pps" : "internal");
+    if (vrt_context->timestamp_calibration_time != 0)
+        printf("#    Cal time: %u\n", vrt_context->timestamp_calibration_time);
+    if (vrt_context->timestamp_adjustment != 0)
+        printf("#    Timestamp adjust: %.9f\n", (double)vrt_context->timestamp_adjustment/1e12);
+    if (vrt_context->sample_format != VRT_FORMAT_CI16)
+        printf("#    Payload format: %s\n", vrt_sample_format_name(vrt_context->sample_format));
+
+}
+
+// Sample format of an advertised payload format, false if not supported
+static bool payload_sample_format(const struct vrt_data_packet_payload_format* f, vrt_sample_format* format) {
+    if (f->real_or_complex != VRT_ROC_COMPLEX_CARTESIAN)
+        return false;
+    if (f->data_item_format == VRT_DIF_IEEE_754_SINGLE_PRECISION_FLOATING_POINT and f->data_item_size == 31)
+        *format = VRT_FORMAT_CF32;
+    else if (f->data_item_format != VRT_DIF_SIGNED_FIXED_POINT)
+        return false;
+    else if (f->data_item_size == 15)
+        *format = VRT_FORMAT_CI16;
+    else if (f->data_item_size == 7)
+        *format = VRT_FORMAT_CI8;
+    else if (f->data_item_size == 11 and f->packing_method == VRT_PM_LINK_EFFICIENT)
+        *format = VRT_FORMAT_CI12;
+    else
+        return false;
+    return true;
+}
+
+void vrt_apply_if_context(const vrt_packet_view* view, const struct vrt_if_context* c, context_type* vrt_context) {
+
+    vrt_context->integer_seconds_timestamp = view->fields.integer_seconds_timestamp;
+    vrt_context->fractional_seconds_timestamp = view->fields.fractional_seconds_timestamp;
+    if (c->has.sample_rate)
+        vrt_context->sample_rate = (uint32_t)round(c->sample_rate);
+
+    if (c->has.rf_reference_frequency) {
+        vrt_context->rf_freq = (int64_t)round(c->rf_reference_frequency);
+        vrt_context->rf_frac_freq = c->rf_reference_frequency - (double)vrt_context->rf_freq;
+    }
+
+    if (c->has.bandwidth)
+        vrt_context->bandwidth = c->bandwidth;
+
+    if (c->has.gain)
+        vrt_context->gain = c->gain.stage1;
+
+    if (c->state_and_event_indicators.has.reference_lock)
+        vrt_context->reflock = c->state_and_event_indicators.reference_lock;
+
+    if (c->state_and_event_indicators.has.calibrated_time)
+        vrt_context->time_cal = c->state_and_event_indicators.calibrated_time;
+
+    if (c->has.temperature)
+        vrt_context->temperature = c->temperature;
+
+    if (c->has.timestamp_calibration_time)
+        vrt_context->timestamp_calibration_time = c->timestamp_calibration_time;
+
+    if (c->has.timestamp_adjustment)
+        vrt_context->timestamp_adjustment = c->timestamp_adjustment;
+
+    if (c->has.data_packet_payload_format
+            and not payload_sample_format(&c->data_packet_payload_format, &vrt_context->sample_format)
+            and not vrt_context->context_received)
+        printf("# Warning: unsupported payload format, assuming %s\n", vrt_sample_format_name(vrt_context->sample_format));
+
+    vrt_context->context_changed = c->context_field_change_indicator;
+    vrt_context->context_received = true;
+}
+
+void vrt_view_packet_info(const vrt_packet_view* view, packet_type* vrt_packet) {
+
+    const struct vrt_fields& f = view->fields;
+
+    vrt_packet->integer_seconds_timestamp = f.integer_seconds_timestamp;
+    vrt_packet->fractional_seconds_timestamp = f.fractional_seconds_timestamp;
+    vrt_packet->num_rx_samps = view->payload_words;
+    vrt_packet->offset = view->payload_offset;
+    vrt_packet->stream_id = f.stream_id;
+
+    vrt_packet->oui = f.class_id.oui;
+    vrt_packet->information_class_code = f.class_id.information_class_code;
+    vrt_packet->packet_class_code = f.class_id.packet_class_code;
+}
+
+bool vrt_process(uint32_t* buffer, uint32_t size, context_type* vrt_context, packet_type* vrt_packet) {
+
+    vrt_packet_view view;
+
+    vrt_packet->context = false;
+    vrt_packet->data = false;
+    vrt_packet->extended_context = false;
+
+    if (not vrt_view_parse(buffer, (int32_t)size, &view))
+        return false;
+
+    const struct vrt_header& h = view.header;
+    const struct vrt_fields& f = view.fields;
+
+    if (h.packet_type == VRT_PT_IF_CONTEXT) {
+        // Context
+        vrt_context->stream_id = f.stream_id;
+
+        if (f.stream_id & vrt_packet->channel_filt) {
+            struct vrt_if_context c;
+            if (not vrt_view_read_if_context(&view, &c))
+                return false;
+
+            vrt_apply_if_context(&view, &c, vrt_context);
+            vrt_packet->context = true;
+            vrt_packet->stream_id = f.stream_id;
+
+            vrt_packet->oui = f.class_id.oui;
+            vrt_packet->information_class_code = f.class_id.information_class_code;
+            vrt_packet->packet_class_code = f.class_id.packet_class_code;
+        }
+    } else if (h.packet_type == VRT_PT_IF_DATA_WITH_STREAM_ID) {
+        // Data
+        if (f.stream_id & vrt_packet->channel_filt) {
+
+            vrt_view_packet_info(&view, vrt_packet);
+            vrt_decode_payload(buffer, size, vrt_context, vrt_packet);
+            vrt_packet->lost_frame = vrt_check_loss(&view, vrt_context, vrt_packet);
+            vrt_packet->data = true;
+            vrt_metrics_packet(vrt_packet);
+
+            if (vrt_packet->first_frame) {
+                vrt_context->starttime_integer = f.integer_seconds_timestamp;
+                vrt_context->starttime_fractional = f.fractional_seconds_timestamp;
+                vrt_packet->first_frame = false;
+            }
+        }
+    } else if (h.packet_type == VRT_PT_EXT_CONTEXT) {
+
+        vrt_view_packet_info(&view, vrt_packet);
+        vrt_packet->extended_context = true;
+    }
+
+    return true;
+}
+
+void vrt_init_data_packet(struct vrt_packet* p, uint32_t samples_per_packet, vrt_sample_format format) {
+
+    uint32_t payload_words = vrt_payload_words(samples_per_packet, format);
+
+    p->header.packet_type         = VRT_PT_IF_DATA_WITH_STREAM_ID;
+
+    p->header.packet_size         = VRT_DATA_PACKET_WORDS(payload_words);
+    p->header.tsm                 = VRT_TSM_FINE;
+    p->header.tsi                 = VRT_TSI_OTHER; // unix time
+    p->header.tsf                 = VRT_TSF_REAL_TIME;
+    p->fields.stream_id           = 0;
+    p->words_body                 = payload_words;
+
+    p->header.has.class_id        = true;
+    p->fields.class_id.oui        = 0xFF5454;
+    p->fields.class_id.information_class_code = 0;
+    p->fields.class_id.packet_class_code = 0;
+
+    p->header.has.trailer         = false;
+}
+
+bool vrt_valid_packet_size(uint32_t samples_per_packet, vrt_sample_format format) {
+    // samples that fill whole words
+    uint32_t group = (format == VRT_FORMAT_CI8) ? 2 : (format == VRT_FORMAT_CI12) ? 4 : 1;
+    uint32_t max_samples = vrt_payload_samples(VRT_MAX_SAMPLES_PER_PACKET, format) / group * group;
+    if (samples_per_packet == 0 || samples_per_packet > max_samples) {
+        printf("Packet size needs to be between 1 and %u samples.\n", max_samples);
+        return false;
+    }
+    if (samples_per_packet % group != 0) {
+        printf("Packet size needs to be a multiple of %u samples for %s.\n", group, vrt_sample_format_name(format));
+        return false;
+    }
+    return true;
+}
+
+void vrt_init_context_packet(struct vrt_packet* pc, vrt_sample_format format) {
+
+    pc->header.packet_type = VRT_PT_IF_CONTEXT;
+    pc->header.has.class_id = true;
+
+    pc->fields.class_id.oui        = 0xFF5454;
+    pc->fields.class_id.information_class_code = 0;
+    pc->fields.class_id.packet_class_code = 0;
+
+    pc->if_context.has.bandwidth   = true;
+    pc->if_context.has.sample_rate = true;
+    pc->if_context.has.reference_point_identifier = true;
+    pc->if_context.has.if_reference_frequency = true;
+    pc->if_context.has.rf_reference_frequency = true;
+    pc->if_context.has.if_band_offset = true;
+    pc->if_context.has.reference_level = true;
+    pc->if_context.has.gain = true;
+    pc->if_context.has.timestamp_adjustment = true;
+    pc->if_context.has.timestamp_calibration_time = true;
+    pc->if_context.has.state_and_event_indicators = true;
+    pc->if_context.has.data_packet_payload_format = true;
+
+    pc->if_context.data_packet_payload_format.packing_method = VRT_PM_LINK_EFFICIENT;
+    pc->if_context.data_packet_payload_format.real_or_complex = VRT_ROC_COMPLEX_CARTESIAN;
+    pc->if_context.data_packet_payload_format.data_item_format = VRT_DIF_SIGNED_FIXED_POINT;
+    pc->if_context.data_packet_payload_format.sample_component_repeat = false;
+    pc->if_context.data_packet_payload_format.item_packing_field_size = 31;
+    pc->if_context.data_packet_payload_format.data_item_size = 15;
+
+    // sizes of a complex sample (packing field) and of one component (item)
+    switch (format) {
+        case VRT_FORMAT_CI8:
+            pc->if_context.data_packet_payload_format.item_packing_field_size = 15;
+            pc->if_context.data_packet_payload_format.data_item_size = 7;
+            break;
+        case VRT_FORMAT_CI12:
+            pc->if_context.data_packet_payload_format.item_packing_field_size = 23;
+            pc->if_context.data_packet_payload_format.data_item_size = 11;
+            break;
+        case VRT_FORMAT_CF32:
+            pc->if_context.data_packet_payload_format.data_item_format = VRT_DIF_IEEE_754_SINGLE_PRECISION_FLOATING_POINT;
+            pc->if_context.data_packet_payload_format.item_packing_field_size = 63;
+            pc->if_context.data_packet_payload_format.data_item_size = 31;
+            break;
+        default:
+            break;
+    }
+
+    pc->header.tsm                 = VRT_TSM_COARSE;
+    pc->header.tsi                 = VRT_TSI_OTHER; // unix time
+    pc->header.tsf                 = VRT_TSF_REAL_TIME;
+
+    pc->if_context.state_and_event_indicators.has.reference_lock = true;
+    pc->if_context.state_and_event_indicators.has.calibrated_time = true;
+
+}
+
+void show_progress_stats(
+    std::chrono::time_point<std::chrono::steady_clock> now,
+    std::chrono::time_point<std::chrono::steady_clock> *last_update,
+    uint64_t *last_update_samps,
+    uint32_t *buffer,
+    size_t num_rx_samps,
+    uint32_t channel,
+    vrt_sample_format format) {
+
+    *last_update_samps += num_rx_samps;
+
+    const auto time_since_last_update = now - *last_update;
+    if (time_since_last_update > std::chrono::seconds(1)) {
+        const double time_since_last_update_s =
+            std::chrono::duration<double>(time_since_last_update).count();
+        const double rate = double(*last_update_samps) / time_since_last_update_s;
+        *last_update_samps = 0;
+        *last_update       = now;
+
+        double max_iq = 0;
+        uint32_t clip_iq = 0;
+
+        double datatype_max = 32767.;
+
+        // payloads forwarded undecoded, decode a copy
+        static thread_local std::vector<uint32_t> decoded;
+        if (format != VRT_FORMAT_CI16) {
+            decoded.resize(num_rx_samps);
+            vrt_payload_to_ci16(buffer, format, decoded.data(), num_rx_samps);
+            buffer = decoded.data();
+        }
+
+        for (size_t i=0; i < num_rx_samps; i++ ) {
+            std::complex<int16_t> sample = (std::complex<int16_t>)buffer[i];
+            max_iq = fmax(max_iq, fmax(fabs(sample.real()), fabs(sample.imag())));
+            if (fabs(sample.real()) > datatype_max*0.99 || fabs(sample.imag()) > datatype_max*0.99)
+                clip_iq++;
+        }
+        std::cout << "\t" << boost::format("%.6f") % (rate / 1e6) << " Msps, ";
+        std::cout << "CH" << boost::format("%u") % channel << ": ";
+        std::cout << boost::format("%3.0f") % (20*log10(max_iq/datatype_max)) << " dBFS (";
+        std::cout << boost::format("%2.0f") % ceil(log2(max_iq)+1) << "/";
+        std::cout << (int)ceil(log2(datatype_max)+1) << " bits), ";
+        std::cout << "" << boost::format("%2.0f") % (100.0*clip_iq/num_rx_samps) << "% clip. ";
+        std::cout << std::endl;
+    }
+
+}
@@ -0,0 +1,167 @@
+/* Weighted overlap-add filterbank
+ *
+ * The ring holds the last frame of partitions*num_bins samples, rounded up
+ * to a whole number of hops so an input block never wraps. Pushing a block
+ * only moves the write position. The output walks the frame from the
+ * oldest sample in runs that end at the ring end or a partition boundary,
+ * each run is one vrt_accumulate_weighted call. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "vrt-wola.h"
+#include "vrt-convert.h"
+
+struct vrt_wola {
+    uint32_t num_bins;
+    uint32_t hop;
+    size_t frame;
+    size_t ring_size;
+    size_t head;
+    size_t pushed;
+    std::vector<float> taps;
+    std::vector<std::complex<float>> ring;
+    std::vector<std::complex<float>> sum;
+};
+
+bool vrt_parse_window(const std::string& name, vrt_window* window) {
+    if (name == "rect")
+        *window = VRT_WINDOW_RECT;
+    else if (name == "hann")
+        *window = VRT_WINDOW_HANN;
+    else if (name == "blackman-harris")
+        *window = VRT_WINDOW_BLACKMAN_HARRIS;
+    else if (name == "flat-top")
+        *window = VRT_WINDOW_FLAT_TOP;
+    else {
+        printf("Unknown window %s (rect, hann, blackman-harris or flat-top).\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Cosine sum window a0 - a1 cos(x) + a2 cos(2x) - ...
+static double cosine_window(const double* a, int terms, size_t i, size_t frame) {
+    double x = 2*M_PI*i/((double)frame-1);
+    double w = 0;
+    for (int k = 0; k < terms; k++)
+        w += ((k & 1) ? -a[k] : a[k])*cos(k*x);
+    return w;
+}
+
+static double window_value(vrt_window window, size_t i, size_t frame) {
+
+    static const double hann[] = {0.5, 0.5};
+    static const double blackman_harris[] = {0.35875, 0.48829, 0.14128, 0.01168};
+    static const double flat_top[] = {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368};
+
+    if (frame < 2)
+        return 1;
+    switch (window) {
+        case VRT_WINDOW_HANN:            return cosine_window(hann, 2, i, frame);
+        case VRT_WINDOW_BLACKMAN_HARRIS: return cosine_window(blackman_harris, 4, i, frame);
+        case VRT_WINDOW_FLAT_TOP:        return cosine_window(flat_top, 5, i, frame);
+        default:                         return 1;
+    }
+}
+
+void vrt_wola_taps(float* taps, uint32_t num_bins, uint32_t partitions, vrt_window window) {
+
+    size_t frame = (size_t)partitions*num_bins;
+
+    if (partitions == 1) {
+        double power = 0;
+        for (size_t i = 0; i < frame; i++)
+            power += window_value(window, i, frame)*window_value(window, i, frame);
+        double scale = sqrt(frame/power);
+        for (size_t i = 0; i < frame; i++)
+            taps[i] = window_value(window, i, frame)*scale;
+        return;
+    }
+
+    for (size_t i = 0; i < frame; i++) {
+        double j = (double)i - (double)(frame/2);
+        double x = partitions*M_PI*j/(double)frame;
+        double w = window_value(window, i, frame);
+        taps[i] = x != 0 ? w*sin(x)/x : w;
+    }
+}
+
+vrt_wola* vrt_wola_create(uint32_t num_bins, uint32_t partitions, uint32_t hop, const float* taps) {
+
+    if (hop == 0)
+        hop = num_bins;
+    if (num_bins == 0 or partitions == 0 or hop > num_bins) {
+        printf("Invalid WOLA size, partitions or hop.\n");
+        return NULL;
+    }
+
+    vrt_wola* wola = new vrt_wola();
+    wola->num_bins = num_bins;
+    wola->hop = hop;
+    wola->frame = (size_t)partitions*num_bins;
+    wola->ring_size = (wola->frame + hop - 1)/hop*hop;
+    wola->head = 0;
+    wola->pushed = 0;
+
+    wola->taps.resize(wola->frame);
+    if (taps)
+        memcpy(wola->taps.data(), taps, sizeof(float)*wola->frame);
+    else
+        vrt_wola_taps(wola->taps.data(), num_bins, partitions, VRT_WINDOW_BLACKMAN_HARRIS);
+
+    wola->ring.assign(wola->ring_size, 0);
+    wola->sum.resize(num_bins);
+    return wola;
+}
+
+std::complex<float>* vrt_wola_input(vrt_wola* wola) {
+    return &wola->ring[wola->head];
+}
+
+void vrt_wola_push(vrt_wola* wola) {
+    wola->head += wola->hop;
+    if (wola->head == wola->ring_size)
+        wola->head = 0;
+    if (wola->pushed < wola->frame)
+        wola->pushed += wola->hop;
+}
+
+bool vrt_wola_full(const vrt_wola* wola) {
+    return wola->pushed >= wola->frame;
+}
+
+void vrt_wola_output(const vrt_wola* wola, std::complex<float>* out) {
+
+    memset((void*)out, 0, sizeof(std::complex<float>)*wola->num_bins);
+
+    // the frame ends at the write position
+    size_t r = (wola->head + wola->ring_size - wola->frame) % wola->ring_size;
+    for (size_t k = 0; k < wola->frame; ) {
+        size_t bin = k % wola->num_bins;
+        size_t m = std::min(wola->frame - k, std::min(wola->ring_size - r, wola->num_bins - bin));
+        vrt_accumulate_weighted(&wola->taps[k], &wola->ring[r], out + bin, m);
+        k += m;
+        r += m;
+        if (r == wola->ring_size)
+            r = 0;
+    }
+}
+
+void vrt_wola_output(vrt_wola* wola, std::complex<double>* out) {
+    vrt_wola_output(wola, wola->sum.data());
+    for (uint32_t i = 0; i < wola->num_bins; i++)
+        out[i] = std::complex<double>(wola->sum[i]);
+}
+
+uint32_t vrt_wola_hop(const vrt_wola* wola) {
+    return wola->hop;
+}
+
+void vrt_wola_destroy(vrt_wola* wola) {
+    delete wola;
+}
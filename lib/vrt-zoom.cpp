@@ -0,0 +1,117 @@
+/* Zoom FFT front end
+ *
+ * The mixer is a phasor in double precision, renormalized every block. The
+ * low pass is a Blackman-Harris windowed sinc of VRT_ZOOM_TAPS*decimation
+ * taps, evaluated only for the output samples (the polyphase form of a
+ * decimating FIR). The input is kept behind the last taps-1 samples of the
+ * previous block. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "vrt-zoom.h"
+
+struct vrt_zoom {
+    double sample_rate;
+    uint32_t decimation;
+    std::vector<float> taps;    // reversed, oldest sample first
+    std::vector<std::complex<float>> x;
+    size_t next;                // newest input sample of the next output
+    std::complex<double> phasor;
+    std::complex<double> step;
+};
+
+uint32_t vrt_zoom_decimation(double sample_rate, double bandwidth) {
+
+    if (bandwidth <= 0)
+        return 1;
+    uint32_t decimation = (uint32_t)(sample_rate*VRT_ZOOM_PASSBAND/bandwidth);
+    if (decimation < 1)
+        return 1;
+    if (sample_rate == floor(sample_rate))
+        while (decimation > 1 and fmod(sample_rate, decimation) != 0)
+            decimation--;
+    return decimation;
+}
+
+vrt_zoom* vrt_zoom_create(double sample_rate, double offset, uint32_t decimation) {
+
+    if (sample_rate <= 0 or decimation == 0) {
+        printf("Invalid zoom decimation %u.\n", decimation);
+        return NULL;
+    }
+
+    vrt_zoom* zoom = new vrt_zoom();
+    zoom->sample_rate = sample_rate;
+    zoom->decimation = decimation;
+
+    size_t num_taps = (size_t)VRT_ZOOM_TAPS*decimation;
+    double cutoff = 0.4/decimation;
+    std::vector<double> taps(num_taps);
+    double sum = 0;
+    for (size_t k = 0; k < num_taps; k++) {
+        double t = (double)k - (num_taps - 1)/2.0;
+        double x = 2*M_PI*k/(num_taps - 1);
+        double window = 0.35875 - 0.48829*cos(x) + 0.14128*cos(2*x) - 0.01168*cos(3*x);
+        double sinc = t == 0 ? 1 : sin(2*M_PI*cutoff*t)/(2*M_PI*cutoff*t);
+        taps[k] = window*sinc;
+        sum += taps[k];
+    }
+    zoom->taps.resize(num_taps);
+    for (size_t k = 0; k < num_taps; k++)
+        zoom->taps[num_taps - 1 - k] = taps[k]/sum;
+
+    zoom->x.assign(num_taps - 1, 0);
+    zoom->next = num_taps - 1;
+    zoom->phasor = 1;
+    zoom->step = std::polar(1.0, -2*M_PI*offset/sample_rate);
+    return zoom;
+}
+
+uint32_t vrt_zoom_process(vrt_zoom* zoom, const std::complex<float>* in, uint32_t n, std::complex<float>* out) {
+
+    size_t history = zoom->taps.size() - 1;
+    std::vector<std::complex<float>>& x = zoom->x;
+    x.resize(history + n);
+
+    std::complex<double> phasor = zoom->phasor;
+    for (uint32_t i = 0; i < n; i++) {
+        x[history + i] = std::complex<float>(std::complex<double>(in[i])*phasor);
+        phasor *= zoom->step;
+    }
+    zoom->phasor = phasor/std::abs(phasor);
+
+    uint32_t m = 0;
+    const float* taps = zoom->taps.data();
+    size_t num_taps = zoom->taps.size();
+    for (; zoom->next < history + n; zoom->next += zoom->decimation) {
+        const std::complex<float>* s = &x[zoom->next - history];
+        float re = 0, im = 0;
+        for (size_t k = 0; k < num_taps; k++) {
+            re += taps[k]*s[k].real();
+            im += taps[k]*s[k].imag();
+        }
+        out[m++] = std::complex<float>(re, im);
+    }
+
+    // keep the last taps-1 samples in front of the next block
+    memmove((void*)x.data(), (void*)&x[n], history*sizeof(std::complex<float>));
+    x.resize(history);
+    zoom->next -= n;
+    return m;
+}
+
+double vrt_zoom_sample_rate(const vrt_zoom* zoom) {
+    return zoom->sample_rate/zoom->decimation;
+}
+
+uint32_t vrt_zoom_factor(const vrt_zoom* zoom) {
+    return zoom->decimation;
+}
+
+void vrt_zoom_destroy(vrt_zoom* zoom) {
+    delete zoom;
+}
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+
+# Copyright 2026 by Thomas Telkamp
+#
+# SPDX-License-Identifier: MIT
+
+# Throughput benchmark: every tool reads a vrt_synth stream, sent as fast as
+# possible over a shared memory ring, and the processed samples are taken
+# from the tool's metrics file. Msps per core divides by the CPU time of the
+# tool, so it does not depend on the rate vrt_synth manages to send.
+
+import os
+import sys
+import time
+import signal
+import subprocess
+import tempfile
+from argparse import ArgumentParser
+
+# tool: (channels, options)
+BENCHMARKS = {
+    'vrt_spectrum': (1, ['--num-bins', '4096', '--integration-time', '0.1']),
+    'vrt_channelizer': (1, ['--decimation', '8', '--pub-port', '50990']),
+    'vrt_tuner': (1, ['--decimation', '8', '--pub-port', '50991']),
+    'vrt_correlate': (2, ['--channel', '0,1', '--num-bins', '4096', '--integration-time', '0.1']),
+    'vrt_to_filterbank': (1, ['--num-bins', '1024', '--null']),
+    'vrt_pulsar': (1, ['--num-bins', '1024', '--quiet', '--no-stdout']),
+}
+
+parser = ArgumentParser(description="Throughput benchmark of the VRT tools")
+parser.add_argument('--bin-dir', default='.', help='directory with the tool binaries')
+parser.add_argument('--rate', type=float, default=10e6, help='sample rate of the synthetic stream')
+parser.add_argument('--packet-size', type=int, default=10000, help='samples per VRT data packet')
+parser.add_argument('--signal', default='noise', help='vrt_synth signal (noise, tone, chirp, pulsar)')
+parser.add_argument('--warmup', type=float, default=2, help='seconds before measuring')
+parser.add_argument('--duration', type=float, default=10, help='seconds to measure per tool')
+parser.add_argument('tools', nargs='*', default=list(BENCHMARKS), help='tools to benchmark')
+
+args = parser.parse_args()
+
+CLOCK_TICKS = os.sysconf('SC_CLK_TCK')
+
+
+def cpu_seconds(pid):
+    # utime and stime of all threads, fields 14 and 15 of /proc/<pid>/stat
+    with open('/proc/%d/stat' % pid) as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / CLOCK_TICKS
+
+
+def read_metrics(path):
+    metrics = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                if line.startswith('#') or not line.strip():
+                    continue
+                name, value = line.rsplit(' ', 1)
+                metrics[name.split('{')[0]] = float(value)
+    except (OSError, ValueError):
+        pass
+    return metrics
+
+
+def measure(tool, workdir):
+    channels, options = BENCHMARKS[tool]
+    ring = 'vrt_benchmark_%d' % os.getpid()
+    metrics_file = os.path.join(workdir, tool + '.prom')
+
+    synth = subprocess.Popen([os.path.join(args.bin_dir, 'vrt_synth'), '--max-rate', '--setup', '0',
+                              '--rate', str(args.rate), '--channels', str(channels),
+                              '--packet-size', str(args.packet_size), '--signal', args.signal,
+                              '--port', '50980', '--shm', ring],
+                             stdout=subprocess.DEVNULL, cwd=workdir)
+    client = subprocess.Popen([os.path.join(args.bin_dir, tool), '--shm', ring, '--continue',
+                               '--metrics', metrics_file] + options,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, cwd=workdir)
+    try:
+        time.sleep(args.warmup)
+        if client.poll() is not None:
+            return None
+        m0, c0, t0 = read_metrics(metrics_file), cpu_seconds(client.pid), time.monotonic()
+        time.sleep(args.duration)
+        if client.poll() is not None:
+            return None
+        # the metrics file is rewritten every second
+        time.sleep(1.1)
+        m1, c1, t1 = read_metrics(metrics_file), cpu_seconds(client.pid), time.monotonic()
+    finally:
+        for p in (client, synth):
+            p.send_signal(signal.SIGINT)
+        for p in (client, synth):
+            try:
+                p.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                p.kill()
+
+    samples = m1.get('vrt_samples_total', 0) - m0.get('vrt_samples_total', 0)
+    lost = m1.get('vrt_lost_samples_total', 0) - m0.get('vrt_lost_samples_total', 0)
+    cpu = c1 - c0
+    return {
+        'msps': samples / (t1 - t0) / 1e6 / channels,
+        'cores': cpu / (t1 - t0),
+        'msps_core': samples / cpu / 1e6 if cpu > 0 else 0,
+        'lost': 100.0 * lost / (samples + lost) if samples + lost > 0 else 0,
+    }
+
+
+print('# %-18s %10s %8s %12s %8s' % ('tool', 'Msps/ch', 'cores', 'Msps/core', 'lost %'))
+failed = False
+with tempfile.TemporaryDirectory() as workdir:
+    for tool in args.tools:
+        if tool not in BENCHMARKS:
+            print('Unknown tool %s' % tool)
+            failed = True
+            continue
+        result = measure(tool, workdir)
+        if result is None:
+            print('  %-18s failed to run' % tool)
+            failed = True
+            continue
+        print('  %-18s %10.2f %8.2f %12.2f %8.1f' % (tool, result['msps'], result['cores'], result['msps_core'], result['lost']))
+        sys.stdout.flush()
+
+sys.exit(1 if failed else 0)
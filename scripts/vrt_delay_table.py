@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Copyright 2026 by Thomas Telkamp
+#
+# SPDX-License-Identifier: MIT
+
+# Write a delay table for vrt_correlate --delay-model by querying one of the
+# fringe stopper servers (vrt_correlate_fringe_stop*.py) ahead of time, one
+# row (time, w, u, v) per step. vrt_correlate interpolates the rows per FFT,
+# so the server is not needed while correlating.
+#
+# For more than 2 channels write a section per station with --station and
+# --append, each queried against the same reference site as --s2, e.g.
+#   vrt_delay_table.py model.txt --s1 dish0 --s2 ref --object X --station 0
+#   vrt_delay_table.py model.txt --s1 dish1 --s2 ref --object X --station 1 --append
+
+import sys
+import time
+import zmq
+from argparse import ArgumentParser
+
+from astropy.time import Time
+
+parser = ArgumentParser(description="Delay table for vrt_correlate --delay-model from a fringe stopper server")
+parser.add_argument('output', help='delay table file')
+parser.add_argument('--s1', required=True, help='name of site 1')
+parser.add_argument('--s2', required=True, help='name of site 2')
+parser.add_argument('--object', required=True, help='name of object')
+parser.add_argument('--start', default=None, help='start time (ISO or unix seconds, default: now)')
+parser.add_argument('--duration', type=float, default=3600, help='duration (s)')
+parser.add_argument('--step', type=float, default=10, help='time between rows (s)')
+parser.add_argument('--host', default='127.0.0.1', help='fringe stopper host/address')
+parser.add_argument('--port', type=int, default=70001, help='fringe stopper port')
+parser.add_argument('--timeout', type=float, default=10, help='time to wait for a reply (s)')
+parser.add_argument('--station', type=int, default=None, help='write the rows as the section of this station (channel index)')
+parser.add_argument('--append', action='store_true', help='append to the output file (further stations)')
+args = parser.parse_args()
+
+if args.start is None:
+    start = int(time.time())
+else:
+    try:
+        start = float(args.start)
+    except ValueError:
+        start = Time(args.start).unix
+
+context = zmq.Context()
+socket = context.socket(zmq.DEALER)
+socket.setsockopt(zmq.RCVTIMEO, int(args.timeout*1000))
+socket.connect(f"tcp://{args.host}:{args.port}")
+
+# the same messages as vrt_correlate: initialize, then a request per time
+socket.send_string(f"0 {args.s1} {args.s2} {args.object}")
+
+rows = int(args.duration/args.step) + 1
+with open(args.output, 'a' if args.append else 'w') as f:
+    f.write(f"# delay table of {args.s1}-{args.s2}, {args.object}\n")
+    if args.station is not None:
+        f.write(f"station {args.station}\n")
+    f.write("# unix time, w (m), u (m), v (m)\n")
+    for i in range(rows):
+        t = start + i*args.step
+        seconds = int(t)
+        picoseconds = int(round((t - seconds)*1e12))
+        socket.send_string(f"1 {seconds} {picoseconds}")
+        try:
+            fields = socket.recv_string().split(',')
+        except zmq.Again:
+            sys.exit("No reply from the fringe stopper")
+        if int(fields[0]) != 0:
+            sys.exit("The fringe stopper is not initialized (unknown site or object)")
+        w, u, v = float(fields[3]), float(fields[5]), float(fields[6])
+        f.write(f"{seconds}.{picoseconds:012d} {w:.12e} {u:.12e} {v:.12e}\n")
+
+print(f"{rows} rows written to {args.output}")
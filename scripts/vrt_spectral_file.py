@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+
+# Copyright 2026 by Thomas Telkamp
+#
+# SPDX-License-Identifier: MIT
+
+# Reader of the binary spectral files of vrt_spectrum, vrt_fftmax,
+# vrt_metadata and vrt_correlate (--bin-file). The rows are a numpy memmap,
+# so large files are not read into memory. As a script it prints the
+# metadata and the rows as CSV.
+
+import sys
+import numpy as np
+from argparse import ArgumentParser
+
+HEADER = np.dtype([
+    ('magic', 'S8'), ('version', '<u4'), ('header_size', '<u4'), ('metadata_size', '<u4'),
+    ('row_size', '<u4'), ('columns', '<u4'), ('complex', '<u4'), ('traces', '<u4'),
+    ('integrations', '<u4'), ('rows', '<u8'), ('index_offset', '<u8'),
+    ('sample_rate', '<f8'), ('center_freq', '<f8'), ('first_freq', '<f8'),
+    ('column_step', '<f8'), ('integration_time', '<f8'), ('kind', 'S16'),
+])
+
+INDEX = np.dtype([('timestamp', '<f8'), ('offset', '<u8')])
+
+
+def trace_names(metadata):
+    """Names of the trace columns, from the ECSV datatype list"""
+    names = []
+    for line in metadata.splitlines():
+        if line.startswith('# - {name: '):
+            name = line[len('# - {name: '):].split(',')[0]
+            if name not in ('timestamp', 'values'):
+                names.append(name)
+    return names
+
+
+def meta(metadata, key):
+    """Value (string) of a key of the ECSV metadata, None when missing"""
+    prefix = '#   - {' + key + ': '
+    for line in metadata.splitlines():
+        if line.startswith(prefix):
+            return line[len(prefix):].rstrip('}')
+    return None
+
+
+def planes(metadata):
+    """Names of the planes of values (spectrum --planes), [] for one plane"""
+    for line in metadata.splitlines():
+        if line.startswith('#   - {planes: ['):
+            return [name.strip() for name in line.split('[')[1].split(']')[0].split(',')]
+    return []
+
+
+def open_spectral_file(path):
+    """Header (dict), ECSV metadata, rows (numpy memmap) and index (None until closed)"""
+    header = np.fromfile(path, dtype=HEADER, count=1)
+    if len(header) == 0 or header['magic'][0] != b'VRTSPEC' or header['version'][0] != 1:
+        raise ValueError(f"{path} is not a spectral file")
+    header = {name: header[name][0] for name in HEADER.names}
+    header['kind'] = header['kind'].decode()
+
+    with open(path, 'rb') as f:
+        f.seek(HEADER.itemsize)
+        metadata = f.read(header['metadata_size']).decode()
+
+    names = trace_names(metadata)
+    shape = (header['columns'],)
+    if len(planes(metadata)) > 1:
+        shape = (len(planes(metadata)), header['columns'])
+    fields = [('seconds', '<i8'), ('picoseconds', '<u8')]
+    fields += [(name, '<f8') for name in names]
+    if header['columns'] > 0:
+        fields.append(('values', '<c8' if header['complex'] else '<f4', shape))
+    row = np.dtype({'names': [f[0] for f in fields],
+                    'formats': [f[1] if len(f) == 2 else (f[1], f[2]) for f in fields],
+                    'itemsize': header['row_size']}, align=False)
+
+    size = np.memmap(path, dtype=np.uint8, mode='r').size
+    rows = (size - header['header_size']) // header['row_size']
+    index = None
+    if header['index_offset'] != 0:
+        rows = header['rows']
+        index = np.memmap(path, dtype=INDEX, mode='r', offset=header['index_offset'] + 16, shape=(rows,))
+    data = np.memmap(path, dtype=row, mode='r', offset=header['header_size'], shape=(rows,))
+    return header, metadata, data, index
+
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description="Print a binary spectral file as CSV, after its ECSV metadata")
+    parser.add_argument('file', help='spectral file (--bin-file output)')
+    parser.add_argument('--first', type=int, default=0, help='first row')
+    parser.add_argument('--rows', type=int, default=-1, help='number of rows (default: all)')
+    args = parser.parse_args()
+
+    header, metadata, data, index = open_spectral_file(args.file)
+
+    print(metadata, end='')
+    names = ['timestamp'] + [name for name in data.dtype.names[2:] if name != 'values']
+    # column names: the frequency (or lag) of each bin
+    fmt = '{:.0f}' if header['column_step'] >= 1 else '{:.4e}'
+    columns = [fmt.format(header['first_freq'] + i*header['column_step']) for i in range(header['columns'])]
+    # further planes as <plane>_<frequency>, after the first
+    for p, plane in enumerate(planes(metadata) or ['']):
+        names += [f"{plane}_{c}" if p > 0 else c for c in columns]
+    print(', '.join(names))
+    last = len(data) if args.rows < 0 else min(len(data), args.first + args.rows)
+    for r in range(args.first, last):
+        row = data[r]
+        fields = [f"{row['seconds']}.{row['picoseconds'] // 1000:09d}"]
+        fields += [f"{row[name]:.7e}" for name in data.dtype.names[2:] if name != 'values']
+        if header['complex']:
+            fields += [f"({v.real:.6e}{v.imag:+.6e}j)" for v in row['values'].flat]
+        elif header['columns'] > 0:
+            fields += [f"{v:.7e}" for v in row['values'].flat]
+        print(', '.join(fields))
+    sys.stdout.flush()
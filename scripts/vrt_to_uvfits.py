@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+
+# Copyright 2026 by Thomas Telkamp
+#
+# SPDX-License-Identifier: MIT
+
+# Convert the binary output of vrt_correlate (--bin-file, cross-spectrum
+# mode) to a UVFITS file: one random group per row (baseline and
+# integration), u, v, w in light seconds, the spectrum in ascending
+# frequency, and an AN table of the stations. Rows without modeled u, v, w
+# (NaN, the crosses other than the first baseline) are left out; a file
+# without any geometry is refused unless --allow-unmodeled is given.
+
+import sys
+import os
+import numpy as np
+from argparse import ArgumentParser
+
+from astropy.io import fits
+from astropy.time import Time
+import astropy.constants
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from vrt_spectral_file import open_spectral_file, meta
+
+
+def meta_list(metadata, key):
+    value = meta(metadata, key)
+    if value is None:
+        return []
+    return [item.strip() for item in value.strip('[]').split(',')]
+
+
+def product_stations(products, channels):
+    """Station indices (a, b) of each product: xy names with two stations, else channel pairs"""
+    pairs = []
+    for name in products:
+        if '-' in name:
+            a, b = name.split('-')
+            pairs.append((channels.index(a), channels.index(b)))
+        else:
+            pairs.append(('xy'.index(name[0]), 'xy'.index(name[1])))
+    return pairs
+
+
+def station_positions(names):
+    """Geocentric positions (m) of the named stations, zero when unknown"""
+    try:
+        from antennas import ANTENNA_TABLE
+    except ImportError:
+        ANTENNA_TABLE = {}
+    positions = []
+    for name in names:
+        location = ANTENNA_TABLE.get(name)
+        if location is None:
+            positions.append([0.0, 0.0, 0.0])
+        else:
+            positions.append([location.x.value, location.y.value, location.z.value])
+    return np.array(positions)
+
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description="Convert a vrt_correlate binary file to UVFITS")
+    parser.add_argument('file', help='vrt_correlate --bin-file output')
+    parser.add_argument('output', help='UVFITS file')
+    parser.add_argument('--ra', type=float, default=0.0, help='right ascension of the phase center (degrees)')
+    parser.add_argument('--dec', type=float, default=0.0, help='declination of the phase center (degrees)')
+    parser.add_argument('--telescope', default='VRT', help='array name')
+    parser.add_argument('--allow-unmodeled', action='store_true',
+                        help='export a file without geometry (u, v, w are zero)')
+    args = parser.parse_args()
+
+    header, metadata, data, index = open_spectral_file(args.file)
+    if header['kind'] != 'xcorr' or meta(metadata, 'mode') != 'cross-spectrum':
+        sys.exit(f"{args.file} is not a vrt_correlate cross-spectrum file")
+
+    stations = int(meta(metadata, 'stations') or 2)
+    channels = meta_list(metadata, 'channels') or [str(s) for s in range(stations)]
+    pairs = product_stations(meta_list(metadata, 'products'), channels)
+    names = [meta(metadata, 'site_1') or '', meta(metadata, 'site_2') or ''][:stations]
+    names += [f"ch{channels[s]}" for s in range(len(names), stations)]
+    names = [name or f"ch{channels[s]}" for s, name in enumerate(names)]
+
+    geometry = meta(metadata, 'geometry')
+    if geometry in (None, 'none') and not args.allow_unmodeled:
+        sys.exit(f"{args.file} has no modeled u, v, w (no fringe stopper or delay model), "
+                 "use --allow-unmodeled to export it anyway")
+
+    # u, v, w are only modeled for the first baseline (and zero for the autos)
+    modeled = np.isfinite(data['u']) & np.isfinite(data['v']) & np.isfinite(data['w'])
+    if not modeled.all():
+        print(f"Warning: {np.count_nonzero(~modeled)} rows without modeled u, v, w are left out", file=sys.stderr)
+        data = data[modeled]
+    rows = len(data)
+    if rows == 0:
+        sys.exit(f"{args.file} has no rows with modeled u, v, w")
+    nchan = header['columns']
+    c = astropy.constants.c.value
+
+    # the columns ascend in frequency, the center frequency in column nchan//2
+    spectra = np.asarray(data['values'])
+    visibilities = np.zeros((rows, 1, 1, 1, nchan, 1, 3), dtype=np.float32)
+    visibilities[..., 0, 0] = spectra.real[:, None, None, None, :]
+    visibilities[..., 0, 1] = spectra.imag[:, None, None, None, :]
+    visibilities[..., 0, 2] = 1.0
+
+    seconds = data['seconds'] + data['picoseconds']/1e12
+    jd = Time(seconds, format='unix', scale='utc').jd
+    jd1 = np.floor(jd - 0.5) + 0.5
+    product = data['product'].astype(int)
+    baseline = np.array([256*(pairs[p][0] + 1) + pairs[p][1] + 1 for p in product], dtype=np.float32)
+
+    groups = fits.GroupData(visibilities, bitpix=-32,
+        parnames=['UU', 'VV', 'WW', 'DATE', 'DATE', 'BASELINE', 'INTTIM'],
+        pardata=[data['u']/c, data['v']/c, data['w']/c, jd1 - jd1[0], jd - jd1,
+                 baseline, np.full(rows, header['integration_time'])])
+    hdu = fits.GroupsHDU(groups)
+    hdu.header['PZERO4'] = jd1[0]
+    axes = [('COMPLEX', 1.0, 1.0, 1.0),
+            ('STOKES', 1.0, 1.0, 1.0),
+            ('FREQ', header['center_freq'], header['column_step'], nchan//2 + 1),
+            ('IF', 1.0, 1.0, 1.0),
+            ('RA', args.ra, 1.0, 1.0),
+            ('DEC', args.dec, 1.0, 1.0)]
+    for i, (name, value, step, pixel) in enumerate(axes, start=2):
+        hdu.header[f'CTYPE{i}'] = name
+        hdu.header[f'CRVAL{i}'] = value
+        hdu.header[f'CDELT{i}'] = step
+        hdu.header[f'CRPIX{i}'] = pixel
+    hdu.header['OBJECT'] = meta(metadata, 'object') or 'unknown'
+    hdu.header['TELESCOP'] = args.telescope
+    hdu.header['INSTRUME'] = 'vrt_correlate'
+    hdu.header['DATE-OBS'] = Time(jd1[0], format='jd').isot[:10]
+    hdu.header['EPOCH'] = 2000.0
+    hdu.header['BUNIT'] = 'UNCALIB'
+
+    positions = station_positions(names)
+    an = fits.BinTableHDU.from_columns([
+        fits.Column(name='ANNAME', format='8A', array=np.array(names)),
+        fits.Column(name='STABXYZ', format='3D', unit='METERS', array=positions),
+        fits.Column(name='NOSTA', format='1J', array=np.arange(1, stations + 1)),
+        fits.Column(name='MNTSTA', format='1J', array=np.zeros(stations)),
+        fits.Column(name='STAXOF', format='1E', unit='METERS', array=np.zeros(stations)),
+        fits.Column(name='POLTYA', format='1A', array=np.array(['X']*stations)),
+        fits.Column(name='POLAA', format='1E', unit='DEGREES', array=np.zeros(stations)),
+        fits.Column(name='POLCALA', format='2E', array=np.zeros((stations, 2))),
+        fits.Column(name='POLTYB', format='1A', array=np.array(['Y']*stations)),
+        fits.Column(name='POLAB', format='1E', unit='DEGREES', array=np.zeros(stations)),
+        fits.Column(name='POLCALB', format='2E', array=np.zeros((stations, 2))),
+    ], name='AIPS AN')
+    an.header['EXTVER'] = 1
+    an.header['ARRNAM'] = args.telescope
+    an.header['ARRAYX'] = 0.0
+    an.header['ARRAYY'] = 0.0
+    an.header['ARRAYZ'] = 0.0
+    an.header['FREQ'] = header['center_freq']
+    an.header['RDATE'] = hdu.header['DATE-OBS']
+    an.header['TIMSYS'] = 'UTC'
+    an.header['FRAME'] = 'ITRF'
+    an.header['NOPCAL'] = 2
+    an.header['POLTYPE'] = 'APPROX'
+    an.header['XYZHAND'] = 'RIGHT'
+
+    fits.HDUList([hdu, an]).writeto(args.output, overwrite=True)
+    print(f"{rows} visibilities of {len(pairs)} baselines, {nchan} channels written to {args.output}")
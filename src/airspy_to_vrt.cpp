@@ -196,7 +196,7 @@ int main(int argc, char* argv[])
     std::string merge_address, dev_given;
     size_t total_num_samps = 0;
     uint16_t instance, port, merge_port;
-    uint32_t stream_id;
+    uint32_t stream_id, samples_per_packet;
     int hwm, gain;
     double rate, freq, total_time, setup_time, if_freq;
     bool merge;
@@ -229,6 +229,7 @@ int main(int argc, char* argv[])
         ("serial", po::value<std::string>(&dev_given), "device serial")
         ("if-freq", po::value<double>(&if_freq)->default_value(0.0), "IF center frequency in Hz")
         ("setup", po::value<double>(&setup_time)->default_value(1.0), "seconds of setup time")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
         ("vga", po::value<uint32_t>(&vga_gain)->default_value(DEFAULT_VGA_IF_GAIN), "VGA gain for the RF chain")
         ("lna", po::value<uint32_t>(&lna_gain)->default_value(DEFAULT_LNA_GAIN), "LNA gain for the RF chain")
         ("mixer", po::value<uint32_t>(&mixer_gain)->default_value(DEFAULT_MIXER_GAIN), "MIXER gain for the RF chain")
@@ -264,6 +265,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (not vrt_valid_packet_size(samples_per_packet))
+        return 1;
+
     bool bw_summary             = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -312,7 +316,7 @@ int main(int argc, char* argv[])
     /* VRT init */
     struct vrt_packet p;
     vrt_init_packet(&p);
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet);
     
     p.fields.stream_id = 1;
 
@@ -547,13 +551,13 @@ int main(int argc, char* argv[])
         std::cout << "Press Ctrl + C to stop streaming..." << std::endl;
     }
 
-	size_t samps_per_buff = VRT_SAMPLES_PER_PACKET;
+	size_t samps_per_buff = samples_per_packet;
 
 	unsigned long long num_requested_samples = total_num_samps;
     double time_requested = total_time;
     bool int_second             = (bool)vm.count("int-second");
 
-    uint32_t buffer[SIZE];
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
    
     bool first_frame = true;
     bool context_changed = true;
@@ -596,7 +600,7 @@ int main(int argc, char* argv[])
 
     // flush merge queue
     if (merge)
-        while ( zmq_recv(merge_zmq, buffer, 100000, ZMQ_NOBLOCK) > 0 ) { }
+        while ( zmq_recv(merge_zmq, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK) > 0 ) { }
 
     while (not stop_signal_called) {
  
@@ -634,9 +638,9 @@ int main(int argc, char* argv[])
     	        p.fields.fractional_seconds_timestamp = 1e6*time_now.tv_usec;
     	
     	        zmq_msg_t msg;
-    	        int rc = zmq_msg_init_size (&msg, SIZE*4);
+    	        int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
 
-    	        int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), SIZE, true);
+    	        int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
 
     	        frame_count++;
 
@@ -709,17 +713,17 @@ int main(int argc, char* argv[])
 
     	                double datatype_max = 32767.;
 
-    	                for (int i=0; i<10000; i++ ) {
+    	                for (int i=0; i<samps_per_buff; i++ ) {
     	                    auto sample_i = get_abs_val(bodydata[2*i]);
     	                    sum_i += sample_i;
     	                    if (sample_i > datatype_max*0.99)
     	                        clip_i++;
     	                }
-    	                sum_i = sum_i/10000;
+    	                sum_i = sum_i/samps_per_buff;
     	                std::cout << boost::format("%.0f") % (100.0*log2(sum_i)/log2(datatype_max)) << "% I (";
     	                std::cout << boost::format("%.0f") % ceil(log2(sum_i)+1) << " of ";
     	                std::cout << (int)ceil(log2(datatype_max)+1) << " bits), ";
-    	                std::cout << "" << boost::format("%.0f") % (100.0*clip_i/10000) << "% I clip.";
+    	                std::cout << "" << boost::format("%.0f") % (100.0*clip_i/samps_per_buff) << "% I clip.";
     	                std::cout << std::endl;
 
     	            }
@@ -730,7 +734,7 @@ int main(int argc, char* argv[])
         // Merge
         if (merge) {
             int mergelen;
-            while ( (mergelen = zmq_recv(merge_zmq, buffer, 100000, ZMQ_NOBLOCK)) > 0  ) {
+            while ( (mergelen = zmq_recv(merge_zmq, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK)) > 0  ) {
                 zmq_msg_t msg;
                 zmq_msg_init_size (&msg, mergelen);
                 memcpy (zmq_msg_data(&msg), buffer, mergelen);
@@ -28,6 +28,7 @@
 
 // VRT
 #include <iostream>
+#include <vector>
 #include <vrt/vrt_init.h>
 #include <vrt/vrt_string.h>
 #include <vrt/vrt_types.h>
@@ -234,6 +235,7 @@ int main(int argc, char** argv)
 	char date_time[DATE_TIME_MAX_LEN];
 	std::string path;
 	std::string serial_number;
+	std::string format_name;
 	char* endptr = NULL;
 	int result;
 	time_t rawtime;
@@ -248,6 +250,7 @@ int main(int argc, char** argv)
 
 	uint16_t instance, port;
 	int hwm;
+	uint32_t samples_per_packet;
 
 	po::options_description desc("hackrf_to_vrt options");
 	desc.add_options()
@@ -294,6 +297,8 @@ int main(int argc, char** argv)
 	("stats", "display stats")
 	("bw", po::value<double>(&baseband_filter_bw_hz), "baseband filter bandwidth in Hz")
 	("crystal-correct", po::value<uint32_t>(&crystal_correct_ppm), "crystal correction in ppm")
+	("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
+	("format", po::value<std::string>(&format_name)->default_value("ci16"), "payload sample format: ci16, ci8, ci12 or cf32")
 	("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
 	;
@@ -307,6 +312,12 @@ int main(int argc, char** argv)
 	    return EXIT_SUCCESS;
 	}
 
+	vrt_sample_format sample_format;
+	if (!vrt_parse_sample_format(format_name, &sample_format))
+		return EXIT_FAILURE;
+	if (!vrt_valid_packet_size(samples_per_packet, sample_format))
+		return EXIT_FAILURE;
+
 	// Boolean flags
 	bool hw_sync        = vm.count("hw-sync") > 0;
 	bool force_ranges   = vm.count("force-ranges") > 0;
@@ -328,7 +339,7 @@ int main(int argc, char** argv)
 	/* VRT init */
 	struct vrt_packet p;
 	vrt_init_packet(&p);
-	vrt_init_data_packet(&p);
+	vrt_init_data_packet(&p, samples_per_packet, sample_format);
 
 	p.fields.stream_id = 1;
 
@@ -639,10 +650,11 @@ int main(int argc, char** argv)
 
 	fprintf(stderr, "Stop with Ctrl-C\n");
 
-	size_t samps_per_buff = VRT_SAMPLES_PER_PACKET;
+	size_t samps_per_buff = samples_per_packet;
 
-	uint32_t buffer[SIZE];
+	uint32_t buffer[ZMQ_BUFFER_SIZE];
 	int16_t bodydata[samps_per_buff * 2];
+	std::vector<uint32_t> payload(vrt_payload_words(samples_per_packet, sample_format));
 
 	uint32_t frame_count = 0;
 	bool first_frame = true;
@@ -676,14 +688,19 @@ int main(int argc, char** argv)
 					cb.pop_front();
 				}
 
-				p.body = bodydata;
+				if (sample_format == VRT_FORMAT_CI16) {
+					p.body = bodydata;
+				} else {
+					vrt_ci16_to_payload((const uint32_t*)bodydata, payload.data(), samples_per_packet, sample_format);
+					p.body = payload.data();
+				}
 				p.header.packet_count = (uint8_t)(frame_count % 16);
 				p.fields.integer_seconds_timestamp = time_now.tv_sec;
 				p.fields.fractional_seconds_timestamp = 1e6 * time_now.tv_usec;
 
 				zmq_msg_t msg;
-				zmq_msg_init_size(&msg, SIZE * 4);
-				int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), SIZE, true);
+				zmq_msg_init_size(&msg, p.header.packet_size * 4);
+				int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), p.header.packet_size, true);
 				zmq_msg_send(&msg, zmq_server, 0);
 				zmq_msg_close(&msg);
 
@@ -697,7 +714,7 @@ int main(int argc, char** argv)
 
 					struct vrt_packet pc;
 					vrt_init_packet(&pc);
-					vrt_init_context_packet(&pc);
+					vrt_init_context_packet(&pc, sample_format);
 
 					gettimeofday(&time_now, NULL);
 					pc.fields.integer_seconds_timestamp = time_now.tv_sec;
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include <zmq.h>
 #include <assert.h>
@@ -83,10 +84,10 @@ inline float get_abs_val(std::complex<int8_t> t)
 int main(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string merge_address, dev_given;
+    std::string merge_address, dev_given, format_name;
     size_t total_num_samps = 0;
     uint16_t instance, port, merge_port;
-    uint32_t stream_id;
+    uint32_t stream_id, samples_per_packet;
     int hwm, gain;
     double rate, freq, total_time, setup_time, if_freq;
     bool context_changed;
@@ -103,6 +104,8 @@ int main(int argc, char* argv[])
         ("if-freq", po::value<double>(&if_freq)->default_value(0.0), "IF center frequency in Hz")
         ("gain", po::value<int>(&gain)->default_value(0), "gain for the RF chain (default AGC)")
         ("setup", po::value<double>(&setup_time)->default_value(1.0), "seconds of setup time")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
+        ("format", po::value<std::string>(&format_name)->default_value("ci16"), "payload sample format: ci16, ci8, ci12 or cf32")
         ("progress", "periodically display short-term bandwidth")
         ("stats", "show average bandwidth on exit")
         ("int-second", "align start of reception to integer second")
@@ -132,6 +135,12 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    vrt_sample_format sample_format;
+    if (not vrt_parse_sample_format(format_name, &sample_format))
+        return 1;
+    if (not vrt_valid_packet_size(samples_per_packet, sample_format))
+        return 1;
+
     bool bw_summary             = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -141,7 +150,7 @@ int main(int argc, char* argv[])
     /* VRT init */
     struct vrt_packet p;
     vrt_init_packet(&p);
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet, sample_format);
 
     p.fields.stream_id = 1;
 
@@ -261,13 +270,13 @@ int main(int argc, char* argv[])
         std::cout << "Press Ctrl + C to stop streaming..." << std::endl;
     }
 
-    size_t samps_per_buff = VRT_SAMPLES_PER_PACKET;
+    size_t samps_per_buff = samples_per_packet;
 
     unsigned long long num_requested_samples = total_num_samps;
     double time_requested = total_time;
     bool int_second = (bool)vm.count("int-second");
 
-    uint32_t buffer[SIZE];
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
 
     bool first_frame = true;
 
@@ -306,13 +315,14 @@ int main(int argc, char* argv[])
     uint32_t num_words_read=0;
 
     int16_t bodydata[samps_per_buff*2];
+    std::vector<uint32_t> payload(vrt_payload_words(samples_per_packet, sample_format));
 
     // Create a circular buffer with a capacity for xxx.
     boost::circular_buffer<int8_t> cb(samps_per_buff*3*2);
 
     // flush merge queue
     if (merge)
-        while ( zmq_recv(merge_zmq, buffer, 100000, ZMQ_NOBLOCK) > 0 ) { }
+        while ( zmq_recv(merge_zmq, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK) > 0 ) { }
 
     while (not stop_signal_called) {
 
@@ -353,15 +363,20 @@ int main(int argc, char* argv[])
 
             num_total_samps += num_words_read;
 
-            p.body = bodydata;
+            if (sample_format == VRT_FORMAT_CI16) {
+                p.body = bodydata;
+            } else {
+                vrt_ci16_to_payload((const uint32_t*)bodydata, payload.data(), samples_per_packet, sample_format);
+                p.body = payload.data();
+            }
             p.header.packet_count = (uint8_t)frame_count%16;
             p.fields.integer_seconds_timestamp = time_now.tv_sec;
             p.fields.fractional_seconds_timestamp = 1e6*time_now.tv_usec;
 
             zmq_msg_t msg;
-            int rc = zmq_msg_init_size (&msg, SIZE*4);
+            int rc = zmq_msg_init_size (&msg, p.header.packet_size*4);
 
-            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), SIZE, true);
+            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), p.header.packet_size, true);
 
             frame_count++;
 
@@ -380,7 +395,7 @@ int main(int argc, char* argv[])
                 vrt_init_packet(&pc);
 
                 /* VRT Configure. Note that context packets cannot have a trailer word. */
-                vrt_init_context_packet(&pc);
+                vrt_init_context_packet(&pc, sample_format);
 
                 gettimeofday(&time_now, nullptr);
                 pc.fields.integer_seconds_timestamp = time_now.tv_sec;
@@ -411,7 +426,7 @@ int main(int argc, char* argv[])
             }
 
             // Control
-            int len = zmq_recv(zmq_control, buffer, 100000, ZMQ_NOBLOCK);
+            int len = zmq_recv(zmq_control, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK);
             if (len > 0) {
                 printf("-> Control context received\n");
 
@@ -501,17 +516,17 @@ int main(int argc, char* argv[])
 
                     double datatype_max = 128.;
 
-                    for (int i=0; i<10000; i++ ) {
+                    for (int i=0; i<samps_per_buff; i++ ) {
                         auto sample_i = get_abs_val(bodydata[2*i]);
                         sum_i += sample_i;
                         if (sample_i > datatype_max*0.99)
                             clip_i++;
                     }
-                    sum_i = sum_i/10000;
+                    sum_i = sum_i/samps_per_buff;
                     std::cout << boost::format("%.0f") % (100.0*log2(sum_i)/log2(datatype_max)) << "% I (";
                     std::cout << boost::format("%.0f") % ceil(log2(sum_i)+1) << " of ";
                     std::cout << (int)ceil(log2(datatype_max)+1) << " bits), ";
-                    std::cout << "" << boost::format("%.0f") % (100.0*clip_i/10000) << "% I clip.";
+                    std::cout << "" << boost::format("%.0f") % (100.0*clip_i/samps_per_buff) << "% I clip.";
                     std::cout << std::endl;
                 }
             }
@@ -520,7 +535,7 @@ int main(int argc, char* argv[])
         // Merge
         if (merge) {
             int mergelen;
-            while ( (mergelen = zmq_recv(merge_zmq, buffer, 100000, ZMQ_NOBLOCK)) > 0  ) {
+            while ( (mergelen = zmq_recv(merge_zmq, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK)) > 0  ) {
                 // zmq_send (zmq_server, buffer, mergelen, 0);
                 zmq_msg_t msg;
                 zmq_msg_init_size (&msg, mergelen);
@@ -11,12 +11,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/circular_buffer.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <complex>
 #include <csignal>
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include <sys/time.h>
 
@@ -51,6 +53,7 @@ namespace pt = boost::property_tree;
 
 // VRT tools functions
 #include "vrt-tools.h"
+#include "vrt-shm.h"
 
 unsigned long long num_total_samps = 0;
 
@@ -82,10 +85,11 @@ inline float get_abs_val(std::complex<int8_t> t)
 int main(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string udp_forward, ref, file, file2, time_cal, type, start_time_str, merge_address_list, merge_port_list, start_at_str;
+    std::string udp_forward, ref, file, file2, time_cal, type, start_time_str, merge_address_list, merge_port_list, start_at_str, shm_name;
     std::string ref2, time_cal2, type2, start_time_str2;
     uint16_t port, instance;
     uint32_t stream_id, stream_id2;
+    uint32_t samples_per_packet;
     int hwm;
     int16_t gain, gain2;
     double datarate;
@@ -108,6 +112,7 @@ int main(int argc, char* argv[])
         ("setup", po::value<double>(&setup_time)->default_value(1.0), "seconds of setup time")
         ("start-time", po::value<std::string>(&start_at_str), "start streaming at given timestamp")
         ("datarate", po::value<double>(&datarate)->default_value(0), "rate of outgoing samples")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
         ("dual-chan", "use two SigMF files for dual channel stream (chan0+chan1)")
         ("progress", "periodically display short-term bandwidth")
         ("stats", "show average bandwidth on exit")
@@ -121,6 +126,7 @@ int main(int argc, char* argv[])
         ("merge-address", po::value<std::string>(&merge_address_list)->default_value("localhost"), "VRT ZMQ merge address")
         ("port", po::value<uint16_t>(&port)->default_value(50100), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("shm", po::value<std::string>(&shm_name), "also publish to this shared memory ring")
     ;
 
     // clang-format on
@@ -141,6 +147,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (not vrt_valid_packet_size(samples_per_packet))
+        return 1;
+
     bool bw_summary             = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -310,11 +319,11 @@ int main(int argc, char* argv[])
         }
     }
 
-    size_t samps_per_buff = VRT_SAMPLES_PER_PACKET;
+    size_t samps_per_buff = samples_per_packet;
 
     double time_requested = total_time;
 
-    uint32_t buffer[VRT_DATA_PACKET_SIZE];
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
 
     bool first_frame = true;
 
@@ -327,7 +336,7 @@ int main(int argc, char* argv[])
     }
 
     /* VRT init */
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet);
 
     // p.fields.stream_id = stream_id;
 
@@ -348,6 +357,14 @@ int main(int argc, char* argv[])
     assert (rc == 0);
     zmq_server = responder;
 
+    // Shared memory ring for local clients, next to the ZMQ stream
+    vrt_shm *shm_server = NULL;
+    if (vm.count("shm")) {
+        shm_server = vrt_shm_create(shm_name.c_str());
+        if (shm_server == NULL)
+            return EXIT_FAILURE;
+    }
+
     // Sleep setup time
     std::this_thread::sleep_for(std::chrono::milliseconds(int64_t(1000 * setup_time)));
 
@@ -370,7 +387,8 @@ int main(int argc, char* argv[])
     uint32_t num_words_read=0;
 
     uint32_t first_word;
-    std::complex<short> samples[VRT_SAMPLES_PER_PACKET];
+    // also holds a complete packet when replaying a VRT file
+    std::vector<std::complex<short>> samples(std::max<size_t>(samps_per_buff, ZMQ_BUFFER_SIZE/4));
 
     timeval time_first_sample;
 
@@ -467,7 +485,7 @@ int main(int argc, char* argv[])
     // flush merge queue
     if (merge)
         for (size_t m = 0; m < merge_zmq.size(); m++)
-            while ( zmq_recv(merge_zmq[m], buffer, 100000, ZMQ_NOBLOCK) > 0 ) { }
+            while ( zmq_recv(merge_zmq[m], buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK) > 0 ) { }
 
     while (not stop_signal_called) {
 
@@ -532,6 +550,8 @@ int main(int argc, char* argv[])
                 fprintf(stderr, "Failed to write packet: %s\n", vrt_string_error(rv));
             }
             zmq_send (zmq_server, buffer, rv*4, 0);
+            if (shm_server)
+                vrt_shm_write(shm_server, buffer, rv*4);
 
             if (dual_chan) {
                 struct vrt_packet pc2;
@@ -571,6 +591,8 @@ int main(int argc, char* argv[])
                     fprintf(stderr, "Failed to write packet: %s\n", vrt_string_error(rv));
                 }
                 zmq_send(zmq_server, buffer, rv*4, 0);
+                if (shm_server)
+                    vrt_shm_write(shm_server, buffer, rv*4);
             }
 
         }
@@ -579,18 +601,20 @@ int main(int argc, char* argv[])
         if (merge) {
             int mergelen;
             for (size_t m = 0; m < merge_zmq.size(); m++) {
-                while ( (mergelen = zmq_recv(merge_zmq[m], buffer, 100000, ZMQ_NOBLOCK)) > 0  ) {
+                while ( (mergelen = zmq_recv(merge_zmq[m], buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK)) > 0  ) {
                     zmq_msg_t msg;
                     zmq_msg_init_size (&msg, mergelen);
                     memcpy (zmq_msg_data(&msg), buffer, mergelen);
                     zmq_msg_send(&msg, zmq_server, 0);
                     zmq_msg_close(&msg);
+                    if (shm_server)
+                        vrt_shm_write(shm_server, buffer, mergelen);
                 }
             }
         }
 
         // Read
-        if (not vrt and fread(samples, sizeof(samples), 1, read_ptr) == 1) {
+        if (not vrt and fread(samples.data(), samps_per_buff*sizeof(std::complex<short>), 1, read_ptr) == 1) {
 
             num_words_read = samps_per_buff;
 
@@ -613,32 +637,36 @@ int main(int argc, char* argv[])
             }
 
             p.fields.stream_id = 1;
-            p.body = samples;
+            p.body = samples.data();
             p.header.packet_count = (uint8_t)frame_count%16;
             p.fields.integer_seconds_timestamp = vrt_time.tv_sec;
             p.fields.fractional_seconds_timestamp = 1e6*vrt_time.tv_usec;
 
             zmq_msg_t msg;
-            int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_SIZE*4);
+            int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
 
-            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE, true);
+            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
 
+            if (shm_server)
+                vrt_shm_write(shm_server, zmq_msg_data(&msg), rv*4);
             zmq_msg_send(&msg, zmq_server, 0);
             zmq_msg_close(&msg);
 
             if (dual_chan) {
-                if (fread(samples, sizeof(samples), 1, read_ptr_2) == 1) {
+                if (fread(samples.data(), samps_per_buff*sizeof(std::complex<short>), 1, read_ptr_2) == 1) {
                     p.fields.stream_id = 2;
-                    p.body = samples;
+                    p.body = samples.data();
                     p.header.packet_count = (uint8_t)frame_count%16;
                     p.fields.integer_seconds_timestamp = vrt_time.tv_sec;
                     p.fields.fractional_seconds_timestamp = 1e6*vrt_time.tv_usec;
 
                     zmq_msg_t msg;
-                    int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_SIZE*4);
+                    int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
 
-                    int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE, true);
+                    int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
 
+                    if (shm_server)
+                        vrt_shm_write(shm_server, zmq_msg_data(&msg), rv*4);
                     zmq_msg_send(&msg, zmq_server, 0);
                     zmq_msg_close(&msg);
                 } else {
@@ -675,11 +703,11 @@ int main(int argc, char* argv[])
                         if (sample_i > datatype_max*0.99)
                             clip_i++;
                     }
-                    sum_i = sum_i/10000;
+                    sum_i = sum_i/samps_per_buff;
                     std::cout << boost::format("%.0f") % (100.0*log2(sum_i)/log2(datatype_max)) << "% I (";
                     std::cout << boost::format("%.0f") % ceil(log2(sum_i)+1) << " of ";
                     std::cout << (int)ceil(log2(datatype_max)+1) << " bits), ";
-                    std::cout << "" << boost::format("%.0f") % (100.0*clip_i/10000) << "% I clip.";
+                    std::cout << "" << boost::format("%.0f") % (100.0*clip_i/samps_per_buff) << "% I clip.";
                     std::cout << std::endl;
 
                 }
@@ -690,8 +718,11 @@ int main(int argc, char* argv[])
             if (type == 1)
                 frame_count++;
             fseek(read_ptr, -sizeof(uint32_t), SEEK_CUR );
-            if (fread(samples, words*sizeof(uint32_t), 1, read_ptr) == 1)
-                zmq_send (zmq_server, samples, words*sizeof(uint32_t), 0);
+            if (fread(samples.data(), words*sizeof(uint32_t), 1, read_ptr) == 1) {
+                zmq_send (zmq_server, samples.data(), words*sizeof(uint32_t), 0);
+                if (shm_server)
+                    vrt_shm_write(shm_server, samples.data(), words*sizeof(uint32_t));
+            }
         } else {
             printf("no more samples in data file\n");
             if (repeat) {
@@ -722,6 +753,7 @@ int main(int argc, char* argv[])
 
     /* clean up */
     fclose(read_ptr);
+    vrt_shm_close(shm_server);
 
     // Sleep setup time
     std::this_thread::sleep_for(std::chrono::milliseconds(int64_t(1000 * setup_time)));
@@ -42,6 +42,7 @@
 
 // VRT tools functions
 #include "vrt-tools.h"
+#include "vrt-shm.h"
 
 unsigned long long num_total_samps = 0;
 
@@ -113,11 +114,11 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
                      double gpio_delay)
    {
 
+    // grown to the size of the received packets
     std::vector<std::complex<short>> buff(VRT_SAMPLES_PER_PACKET);
     std::vector<std::complex<short>*> buffs(1, &buff.front());
 
-    size_t samps_per_buff = VRT_SAMPLES_PER_PACKET; // spb
-    uint32_t tx_zmq_buffer[VRT_DATA_PACKET_SIZE];
+    std::vector<uint32_t> tx_zmq_buffer(ZMQ_BUFFER_SIZE);
 
     uhd::tx_metadata_t metadata;
     metadata.start_of_burst = true;
@@ -153,7 +154,7 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
     while (not stop_signal_called) {
 
         // Receive data
-        int len = zmq_recv(zmq_transmit, tx_zmq_buffer, 100000, ZMQ_NOBLOCK);
+        int len = zmq_recv(zmq_transmit, tx_zmq_buffer.data(), ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK);
 
         if (len > 0) {
 
@@ -164,7 +165,7 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
 
             int32_t offset = 0;
             int32_t size = ZMQ_BUFFER_SIZE;
-            int32_t rv = vrt_read_header(tx_zmq_buffer + offset, size - offset, &h, true);
+            int32_t rv = vrt_read_header(tx_zmq_buffer.data() + offset, size - offset, &h, true);
 
             /* Parse header */
             if (rv < 0) {
@@ -176,7 +177,7 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
             if (h.packet_type == VRT_PT_IF_DATA_WITH_STREAM_ID) {
 
                 /* Parse fields */
-                rv = vrt_read_fields(&h, tx_zmq_buffer + offset, size - offset, &f, true);
+                rv = vrt_read_fields(&h, tx_zmq_buffer.data() + offset, size - offset, &f, true);
                 if (rv < 0) {
                     fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
                     break;
@@ -189,30 +190,32 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
 
                 uint32_t stream_id = f.stream_id;
 
-                if (num_rx_samps <= VRT_SAMPLES_PER_PACKET) {
+                if (num_rx_samps > buff.size()) {
+                    buff.resize(num_rx_samps);
+                    buffs[0] = &buff.front();
+                }
 
-                    for (uint32_t i = 0; i < num_rx_samps; i++) {
-                        int16_t re;
-                        memcpy(&re, (char*)&tx_zmq_buffer[offset+i], 2);
-                        int16_t img;
-                        memcpy(&img, (char*)&tx_zmq_buffer[offset+i]+2, 2);
+                for (uint32_t i = 0; i < num_rx_samps; i++) {
+                    int16_t re;
+                    memcpy(&re, (char*)&tx_zmq_buffer[offset+i], 2);
+                    int16_t img;
+                    memcpy(&img, (char*)&tx_zmq_buffer[offset+i]+2, 2);
 
-                        buff[i] = std::complex<short>(re, img);
-                    }
+                    buff[i] = std::complex<short>(re, img);
+                }
 
-                    // send the entire contents of the ZMQ buffer
-                    tx_streamer->send(buffs, num_rx_samps, metadata);
+                // send the entire contents of the ZMQ buffer
+                tx_streamer->send(buffs, num_rx_samps, metadata);
 
-                    metadata.start_of_burst = false;
-                    metadata.has_time_spec  = false;
-                    metadata.end_of_burst   = false;
-                }
+                metadata.start_of_burst = false;
+                metadata.has_time_spec  = false;
+                metadata.end_of_burst   = false;
 
             } else if (h.packet_type == VRT_PT_IF_CONTEXT) {
                 // Context
 
                 /* Parse fields */
-                rv = vrt_read_fields(&h, tx_zmq_buffer + offset, size - offset, &f, true);
+                rv = vrt_read_fields(&h, tx_zmq_buffer.data() + offset, size - offset, &f, true);
                 if (rv < 0) {
                     fprintf(stderr, "Failed to parse fields section: %s\n", vrt_string_error(rv));
                     break;
@@ -220,7 +223,7 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
                 offset += rv;
 
                 struct vrt_if_context c;
-                rv = vrt_read_if_context(tx_zmq_buffer + offset, ZMQ_BUFFER_SIZE - offset, &c, true);
+                rv = vrt_read_if_context(tx_zmq_buffer.data() + offset, ZMQ_BUFFER_SIZE - offset, &c, true);
                 if (rv < 0) {
                     fprintf(stderr, "Failed to parse IF context section: %s\n", vrt_string_error(rv));
                     break;
@@ -333,12 +336,12 @@ void transmit_worker(uhd::usrp::multi_usrp::sptr usrp,
 int UHD_SAFE_MAIN(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string file, type, ant_list, subdev, ref, channel_list, gain_list, freq_list, udp_forward, merge_address_list, merge_port_list;
+    std::string file, type, ant_list, subdev, ref, channel_list, gain_list, freq_list, udp_forward, merge_address_list, merge_port_list, shm_name;
     size_t total_num_samps, spb;
     uint16_t instance, port;
     uint16_t tx_gain;
     int hwm, io_threads;
-    uint32_t stream_id;
+    uint32_t stream_id, samples_per_packet;
     double rate, freq, bw, total_time, setup_time, lo_offset, tx_freq, if_freq, pps_offset, gpio_delay, master_clock_rate;
     uint32_t timestamp_calibration_time = 0;
 
@@ -359,6 +362,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         ("nsamps", po::value<size_t>(&total_num_samps)->default_value(0), "total number of samples to receive")
         ("duration", po::value<double>(&total_time)->default_value(0), "total number of seconds to receive")
         // ("spb", po::value<size_t>(&spb)->default_value(10000), "samples per buffer")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
         ("rate", po::value<double>(&rate)->default_value(1e6), "rate of incoming samples")
         ("master-clock-rate", po::value<double>(&master_clock_rate), "master clock rate")
         ("freq", po::value<std::string>(&freq_list)->required(), "RF center frequency (list) in Hz")
@@ -397,6 +401,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         ("merge-address", po::value<std::string>(&merge_address_list)->default_value("localhost"), "VRT ZMQ merge address")
         ("io-threads", po::value<int>(&io_threads)->default_value(1), "ZMQ IO threads")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("shm", po::value<std::string>(&shm_name), "also publish to a shared memory ring (with zmq-split one ring per channel: <name>_<ch>)")
     ;
     // clang-format on
     po::variables_map vm;
@@ -414,6 +419,9 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     }
     po::notify(vm);
 
+    if (not vrt_valid_packet_size(samples_per_packet))
+        return 1;
+
     bool bw_summary             = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -435,7 +443,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     }
 
     /* VRT init */
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet);
 
     p.fields.stream_id = 0;
 
@@ -483,6 +491,19 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         zmq_server[0] = responder;
     }
 
+    // Shared memory rings for local clients, next to the ZMQ streams
+    vrt_shm *shm_server[MAX_CHANNELS] = {};
+    bool shm = vm.count("shm") > 0;
+    if (shm) {
+        size_t rings = split ? channel_strings.size() : 1;
+        for (size_t ch = 0; ch < rings; ch++) {
+            std::string ring_name = split ? shm_name + "_" + std::to_string(ch) : shm_name;
+            shm_server[ch] = vrt_shm_create(ring_name.c_str());
+            if (shm_server[ch] == NULL)
+                return EXIT_FAILURE;
+        }
+    }
+
     responder = zmq_socket(context, ZMQ_SUB);
     std::string control_string = "tcp://*:" + std::to_string(main_port+200);
     rc = zmq_bind(responder, control_string.c_str());
@@ -908,9 +929,9 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     bool int_second             = (bool)vm.count("int-second");
 
     // fixed buffer size
-    size_t samps_per_buff = VRT_SAMPLES_PER_PACKET; // spb
+    size_t samps_per_buff = samples_per_packet; // spb
 
-    uint32_t buffer[VRT_DATA_PACKET_SIZE];
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
 
     uhd::rx_metadata_t md;
     std::vector<std::vector<std::complex<short>>> buffs(
@@ -971,7 +992,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     // flush merge queue
     if (merge)
         for (size_t m = 0; m < merge_zmq.size(); m++)
-            while ( zmq_recv(merge_zmq[m], buffer, 100000, ZMQ_NOBLOCK) > 0 ) { }
+            while ( zmq_recv(merge_zmq[m], buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK) > 0 ) { }
 
     while (not stop_signal_called
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)) {
@@ -1110,6 +1131,9 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                 else
                     zmq_send (zmq_server[0], buffer, rv*4, 0);
 
+                if (shm)
+                    vrt_shm_write(shm_server[split ? ch : 0], buffer, rv*4);
+
                 if (enable_udp) {
                     if (sendto(sockfd, buffer, rv*4, 0,
                          (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0)
@@ -1135,8 +1159,12 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                 else
                 p.fields.stream_id = 1<<i;
             zmq_msg_t msg;
-            int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_SIZE*4);
-            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE, true);
+            int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
+            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
+
+            // shared memory, before zmq_msg_send hands the message over
+            if (shm)
+                vrt_shm_write(shm_server[split ? i : 0], zmq_msg_data(&msg), rv*4);
 
             // VRT
             if (split)
@@ -1147,7 +1175,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
 
             // UDP
             if (enable_udp) {
-                if (sendto(sockfd, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE*4, 0,
+                if (sendto(sockfd, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet)*4, 0,
                              (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0)
                 {
                    printf("UDP fail\n");
@@ -1159,7 +1187,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         if (merge) {
             int mergelen;
             for (size_t m = 0; m < merge_zmq.size(); m++) {
-                while ( (mergelen = zmq_recv(merge_zmq[m], buffer, 100000, ZMQ_NOBLOCK)) > 0  ) {
+                while ( (mergelen = zmq_recv(merge_zmq[m], buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK)) > 0  ) {
 
                     if (split) {
                         for (size_t ch = 0; ch < channel_nums.size(); ch++) {
@@ -1168,6 +1196,8 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                             memcpy (zmq_msg_data(&msg), buffer, mergelen);
                             zmq_msg_send(&msg, zmq_server[ch], 0);
                             zmq_msg_close(&msg);
+                            if (shm)
+                                vrt_shm_write(shm_server[ch], buffer, mergelen);
                         }
                     } else {
                         zmq_msg_t msg;
@@ -1175,6 +1205,8 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                         memcpy (zmq_msg_data(&msg), buffer, mergelen);
                         zmq_msg_send(&msg, zmq_server[0], 0);
                         zmq_msg_close(&msg);
+                        if (shm)
+                            vrt_shm_write(shm_server[0], buffer, mergelen);
                     }
                 }
             }
@@ -1183,7 +1215,7 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         frame_count++;
 
         // Control
-        int len = zmq_recv(zmq_control, buffer, 100000, ZMQ_NOBLOCK);
+        int len = zmq_recv(zmq_control, buffer, ZMQ_BUFFER_SIZE, ZMQ_NOBLOCK);
         if (len > 0) {
             printf("-> Control context received\n");
 
@@ -1319,6 +1351,9 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
 
     usrp.reset();
 
+    for (size_t ch = 0; ch < MAX_CHANNELS; ch++)
+        vrt_shm_close(shm_server[ch]);
+
     if (stats) {
         std::cout << std::endl;
         const double actual_duration_seconds =
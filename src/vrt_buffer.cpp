@@ -10,8 +10,10 @@
 #include <deque>
 #include <csignal>
 #include <iostream>
+#include <vector>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
 
 namespace po = boost::program_options;
 
@@ -23,7 +25,7 @@ void sig_int_handler(int)
 
 struct TimestampedMessage {
     std::chrono::time_point<std::chrono::steady_clock> timestamp;
-    uint32_t data[VRT_DATA_PACKET_SIZE];
+    std::vector<uint32_t> data;  // sized to the received packet
     int len;  // actual received length in bytes
 };
 
@@ -31,7 +33,7 @@ struct TimestampedMessage {
 int main(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, metrics_target;
     uint16_t pub_instance, instance, main_port, port, pub_port;
     int hwm;
 
@@ -51,6 +53,7 @@ int main(int argc, char* argv[])
         ("pub-port", po::value<uint16_t>(&pub_port), "VRT ZMQ PUB port")
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
     ;
     // clang-format on
     po::variables_map vm;
@@ -66,6 +69,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress = vm.count("progress") > 0;
 
     if (vm.count("port") > 0) {
@@ -79,6 +85,7 @@ int main(int argc, char* argv[])
     }
 
     std::deque<TimestampedMessage> delay_buffer;
+    static uint32_t rx_buffer[ZMQ_BUFFER_SIZE];
 
     void *context = zmq_ctx_new();
 
@@ -99,6 +106,8 @@ int main(int argc, char* argv[])
 
     context_type vrt_context;
     init_context(&vrt_context);
+    // packets are forwarded as they are
+    vrt_context.accept_formats = ~0u;
     packet_type vrt_packet;
 
     vrt_packet.channel_filt = 1;
@@ -117,16 +126,17 @@ int main(int argc, char* argv[])
 
     while (not stop_signal_called) {
         while (true) {
+            int len = zmq_recv(subscriber, rx_buffer, sizeof(rx_buffer), ZMQ_NOBLOCK);
+            if (len < 0) break;
+
             delay_buffer.emplace_back();
             TimestampedMessage& msg = delay_buffer.back();
-            int len = zmq_recv(subscriber, msg.data, sizeof(msg.data), ZMQ_NOBLOCK);
-            if (len < 0) { delay_buffer.pop_back(); break; }
-
+            msg.data.assign(rx_buffer, rx_buffer + (len + 3)/4);
             msg.timestamp = std::chrono::steady_clock::now();
             msg.len = len;
 
             if (not start_rx) {
-                if (not vrt_process(msg.data, len, &vrt_context, &vrt_packet)) {
+                if (not vrt_process(msg.data.data(), msg.data.size(), &vrt_context, &vrt_packet)) {
                     printf("Not a Vita49 packet?\n");
                     continue;
                 }
@@ -138,7 +148,7 @@ int main(int argc, char* argv[])
             }
 
             if (progress) {
-                if (not vrt_process(msg.data, len, &vrt_context, &vrt_packet)) {
+                if (not vrt_process(msg.data.data(), msg.data.size(), &vrt_context, &vrt_packet)) {
                     printf("Not a Vita49 packet?\n");
                     continue;
                 }
@@ -148,7 +158,7 @@ int main(int argc, char* argv[])
                         &last_update,
                         &last_update_samps,
                         &msg.data[vrt_packet.offset],
-                        vrt_packet.num_rx_samps, 0
+                        vrt_packet.num_rx_samps, 0, vrt_packet.sample_format
                     );
                 }
             }
@@ -161,16 +171,16 @@ int main(int argc, char* argv[])
             if (now - front.timestamp < delay_duration) break;  // rest are newer
 
             if (first_frame) {
-                vrt_context.last_data_counter = 0;
-                vrt_process(front.data, front.len, &vrt_context, &vrt_packet);
+                vrt_context.last_data_counter = -1;
+                vrt_process(front.data.data(), front.data.size(), &vrt_context, &vrt_packet);
                 if (vrt_packet.data) {
                     printf("# Start forwarding at %llu full secs, %.09f frac secs\n", vrt_packet.integer_seconds_timestamp, (double)vrt_packet.fractional_seconds_timestamp/1e12);
                     first_frame = false;
-                    vrt_context.last_data_counter = 0;
+                    vrt_context.last_data_counter = -1;
                 }
             }
 
-            zmq_send(publisher, front.data, front.len, 0);
+            zmq_send(publisher, front.data.data(), front.len, 0);
             delay_buffer.pop_front();
         }
 
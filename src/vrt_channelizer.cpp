@@ -11,6 +11,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <algorithm>
 #include <chrono>
 // #include <complex>
 #include <csignal>
@@ -35,6 +36,10 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
 #include "tracker-extended-context.h"
 
 const double pi = std::acos(-1.0);
@@ -67,7 +72,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, pub_shm_name, metrics_target, effort_name;
     uint16_t pub_instance, instance, main_port, port, pub_port;
     uint32_t channel;
     int hwm, io_threads;
@@ -78,15 +83,18 @@ int main(int argc, char* argv[])
     float channel_bw;
 
     uint32_t decimation, osr, taps_per_decimation, num_taps;
+    uint32_t samples_per_packet;
 
     double *taps;
     float *hh2;
 
-    std::complex<int16_t> **iq_buff;
+    // filter bank buffers, sized from the received packets
+    std::complex<int16_t> **iq_buff = NULL;
 
-    std::complex<float> *shift_reg;
-    std::complex<float> *poly_filter_out;
-    std::complex<float> *ifft_out;
+    std::complex<float> *shift_reg = NULL;
+    std::complex<float> *poly_filter_out = NULL;
+    std::complex<float> *ifft_out = NULL;
+    uint32_t frame_samples = 0;
 
     std::complex<float> tmp[100]; // TODO max decimation
 
@@ -107,6 +115,7 @@ int main(int argc, char* argv[])
         ("continue", "don't abort on a bad packet")
         ("decimation", po::value<uint32_t>(&decimation)->default_value(2), "decimation factor")
         ("osr", po::value<uint32_t>(&osr)->default_value(1), "channel oversampling rate")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per output VRT data packet")
         ("taps-per-decimation", po::value<uint32_t>(&taps_per_decimation)->default_value(20), "taps per decimation")
         ("rate", po::value<float>(&rate)->default_value(0), "channel rate")
         ("channel-bw", po::value<float>(&channel_bw)->default_value(0.97), "channel bandwidth as fraction of rate")
@@ -119,6 +128,10 @@ int main(int argc, char* argv[])
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("io-threads", po::value<int>(&io_threads)->default_value(1), "ZMQ IO threads")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("pub-shm", po::value<std::string>(&pub_shm_name), "also publish to a shared memory ring")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
     ;
     // clang-format on
     po::variables_map vm;
@@ -134,6 +147,17 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
+    if (not vrt_valid_packet_size(samples_per_packet))
+        return 1;
+
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -185,6 +209,7 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
 
     if (pub_zmq_split) {
         for (size_t ch = 0; ch < decimation; ch++) {
@@ -206,6 +231,19 @@ int main(int argc, char* argv[])
         zmq_server[0] = responder;
     }
 
+    // with pub-zmq-split one ring per channel: <name>_<ch>
+    vrt_shm *shm_server[100] = {};
+    bool pub_shm = vm.count("pub-shm") > 0;
+    if (pub_shm) {
+        size_t rings = pub_zmq_split ? decimation : 1;
+        for (size_t ch = 0; ch < rings; ch++) {
+            std::string ring_name = pub_zmq_split ? pub_shm_name + "_" + std::to_string(ch) : pub_shm_name;
+            shm_server[ch] = vrt_shm_create(ring_name.c_str());
+            if (shm_server[ch] == NULL)
+                return 1;
+        }
+    }
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -230,7 +268,7 @@ int main(int argc, char* argv[])
     /* VRT init */
     struct vrt_packet p;
     vrt_init_packet(&p);
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet);
     p.fields.stream_id = 1;
 
     uint32_t iq_counter = 0;
@@ -248,11 +286,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, rx_buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, rx_buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(rx_buffer, sizeof(rx_buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(rx_buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -348,33 +386,6 @@ int main(int argc, char* argv[])
                 hh2[i] = taps[i]/norm_sum;
             }
 
-            iq_buff = (std::complex<int16_t> **)malloc(sizeof(std::complex<int16_t> *) * decimation);
-
-            for (size_t dec=0; dec < decimation; dec++)
-                iq_buff[dec] = (std::complex<int16_t> *)malloc(sizeof(std::complex<int16_t>) * 2 * VRT_SAMPLES_PER_PACKET);
-
-            shift_reg = (std::complex<float>*)calloc((buffer_frames+1)*VRT_SAMPLES_PER_PACKET, sizeof(std::complex<float>));
-
-            poly_filter_out = (std::complex<float>*)calloc(buffer_frames*VRT_SAMPLES_PER_PACKET*osr, sizeof(std::complex<float>));
-            ifft_out = (std::complex<float>*)calloc(buffer_frames*VRT_SAMPLES_PER_PACKET*osr, sizeof(std::complex<float>));
-
-            int rank = 1;
-            int n[] = {(int)decimation};
-            int howmany = buffer_frames*osr*VRT_SAMPLES_PER_PACKET/decimation;
-            int idist = decimation, odist = decimation;
-            int istride = 1, ostride = 1; // array is contiguous in memory
-            int *inembed = n, *onembed = n;
-
-            // FFT
-            plan = fftwf_plan_many_dft(rank, n, howmany,
-                reinterpret_cast<fftwf_complex*>(poly_filter_out), inembed,
-                istride, idist,
-                reinterpret_cast<fftwf_complex*>(ifft_out), onembed,
-                ostride, odist,
-                FFTW_BACKWARD,
-                FFTW_ESTIMATE
-            );
-
         }
 
         if (start_rx and vrt_packet.context) {
@@ -431,6 +442,9 @@ int main(int argc, char* argv[])
                     zmq_send (zmq_server[dec], tx_buffer, rv*4, 0);
                 else
                     zmq_send (zmq_server[0], tx_buffer, rv*4, 0);
+
+                if (pub_shm)
+                    vrt_shm_write(shm_server[pub_zmq_split ? dec : 0], tx_buffer, rv*4);
             }
 
         }
@@ -456,22 +470,64 @@ int main(int argc, char* argv[])
 
             // Assumes ci16_le
 
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&rx_buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&rx_buffer[vrt_packet.offset+i]+2, 2);
+            // (re)allocate the filter bank for the received packet size
+            if (vrt_packet.num_rx_samps != frame_samples) {
+
+                if (frame_samples != 0) {
+                    printf("# Packet size changed to %u samples, restarting channelizer.\n", vrt_packet.num_rx_samps);
+                    for (size_t dec=0; dec < decimation; dec++)
+                        free(iq_buff[dec]);
+                    free(iq_buff);
+                    free(shift_reg);
+                    free(poly_filter_out);
+                    free(ifft_out);
+                    fftwf_destroy_plan(plan);
+                }
+
+                frame_samples = vrt_packet.num_rx_samps;
+
+                if ((buffer_frames*osr*frame_samples) % decimation != 0) {
+                    printf("decimation needs to be a divisor of %u.\n", buffer_frames*osr*frame_samples);
+                    exit(1);
+                }
+
+                int howmany = buffer_frames*osr*frame_samples/decimation;
 
-                shift_reg[(buffer_frames-frame_counter-1)*VRT_SAMPLES_PER_PACKET+vrt_packet.num_rx_samps-i-1] = std::complex<float>(re,img);
+                // room for a full output packet plus the output of one block
+                iq_buff = (std::complex<int16_t> **)malloc(sizeof(std::complex<int16_t> *) * decimation);
+
+                for (size_t dec=0; dec < decimation; dec++)
+                    iq_buff[dec] = (std::complex<int16_t> *)malloc(sizeof(std::complex<int16_t>) * (samples_per_packet + howmany));
+
+                // block plus the filter overlap
+                shift_reg = (std::complex<float>*)calloc(buffer_frames*frame_samples + std::max(frame_samples, decimation*taps_per_decimation), sizeof(std::complex<float>));
+
+                poly_filter_out = (std::complex<float>*)calloc(buffer_frames*frame_samples*osr, sizeof(std::complex<float>));
+                ifft_out = (std::complex<float>*)calloc(buffer_frames*frame_samples*osr, sizeof(std::complex<float>));
+
+                // FFT, howmany contiguous blocks of decimation points
+                plan = vrt_fft_plan(decimation, howmany,
+                    reinterpret_cast<fftwf_complex*>(poly_filter_out),
+                    reinterpret_cast<fftwf_complex*>(ifft_out),
+                    FFTW_BACKWARD
+                );
+
+                frame_counter = 0;
+                iq_counter = 0;
             }
 
+            // shift register holds samples in reversed order
+            std::complex<float> *frame = &shift_reg[(buffer_frames-frame_counter-1)*frame_samples];
+            vrt_ci16_to_cf32(&rx_buffer[vrt_packet.offset], frame, vrt_packet.num_rx_samps);
+            std::reverse(frame, frame + vrt_packet.num_rx_samps);
+
             frame_counter += 1;
 
             if (frame_counter == buffer_frames) {
 
-                int samples_per_channel_out = buffer_frames*osr*VRT_SAMPLES_PER_PACKET/decimation;
+                int samples_per_channel_out = buffer_frames*osr*frame_samples/decimation;
 
-                int block_samples_in = buffer_frames*VRT_SAMPLES_PER_PACKET;
+                int block_samples_in = buffer_frames*frame_samples;
 
                 int bins = decimation;
 
@@ -517,37 +573,37 @@ int main(int argc, char* argv[])
                 int noverlap = bins * pfb_filter_taps / 2;
                 memcpy(&shift_reg[block_samples_in], shift_reg, noverlap * sizeof(std::complex<float>));
 
-                iq_counter += samples_per_channel_out;
-
-                if (next_integer_seconds_timestamp == 0) {
+                if (iq_counter == 0) {
                     next_integer_seconds_timestamp = vrt_packet.integer_seconds_timestamp;
                     next_fractional_seconds_timestamp = vrt_packet.fractional_seconds_timestamp;
                 }
 
+                iq_counter += samples_per_channel_out;
+
                 frame_counter = 0;
 
-                while (iq_counter>=VRT_SAMPLES_PER_PACKET) {
+                uint32_t packet_start = 0;
 
-                    iq_counter -= VRT_SAMPLES_PER_PACKET;
+                while (iq_counter - packet_start >= samples_per_packet) {
 
                     p.fields.integer_seconds_timestamp = next_integer_seconds_timestamp;
                     p.fields.fractional_seconds_timestamp = next_fractional_seconds_timestamp;
                     p.header.packet_count = (uint8_t)frame_count%16;
                     frame_count++;
 
-                    next_integer_seconds_timestamp = 0;
-                    next_fractional_seconds_timestamp = 0;
-
                     for (int dec = 0; dec < decimation; dec++) {
-                        p.body = (char*)iq_buff[dec];
+                        p.body = (char*)&iq_buff[dec][packet_start];
                         if (pub_zmq_split)
                             p.fields.stream_id = 1;
                         else 
                             p.fields.stream_id = 1<<dec;
 
                         zmq_msg_t msg;
-                        int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_SIZE*4);
-                        int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE, true);
+                        int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
+                        int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
+
+                        if (pub_shm)
+                            vrt_shm_write(shm_server[pub_zmq_split ? dec : 0], zmq_msg_data(&msg), rv*4);
 
                         if (pub_zmq_split)
                             zmq_msg_send(&msg, zmq_server[dec], 0);
@@ -556,7 +612,21 @@ int main(int argc, char* argv[])
                         zmq_msg_close(&msg);
                     }
 
-                    num_total_samps += vrt_packet.num_rx_samps;
+                    packet_start += samples_per_packet;
+                    num_total_samps += samples_per_packet;
+
+                    // timestamp of the first sample of the next output packet
+                    uint64_t frac_seconds = p.fields.fractional_seconds_timestamp
+                        + (uint64_t)((double)samples_per_packet*decimation/osr*1e12/(double)vrt_context.sample_rate);
+                    next_integer_seconds_timestamp = p.fields.integer_seconds_timestamp + frac_seconds/(uint64_t)1e12;
+                    next_fractional_seconds_timestamp = frac_seconds%(uint64_t)1e12;
+                }
+
+                // keep the remainder for the next output packet
+                if (packet_start > 0) {
+                    iq_counter -= packet_start;
+                    for (uint32_t dec = 0; dec < decimation; dec++)
+                        memmove(iq_buff[dec], &iq_buff[dec][packet_start], iq_counter*sizeof(std::complex<int16_t>));
                 }
 
             }
@@ -578,6 +648,8 @@ int main(int argc, char* argv[])
             memcpy (zmq_msg_data(&msg), rx_buffer, len);
             zmq_msg_send(&msg, zmq_server[0], 0); // TODO send to all channels
             zmq_msg_close(&msg);
+            if (pub_shm)
+                vrt_shm_write(shm_server[0], rx_buffer, len);
         }
 
         if (progress && vrt_packet.data)
@@ -590,6 +662,10 @@ int main(int argc, char* argv[])
             );           
     }
 
+    vrt_shm_close(shm);
+    for (size_t ch = 0; ch < 100; ch++)
+        vrt_shm_close(shm_server[ch]);
+
     zmq_close(subscriber);
     if (pub_zmq_split)
         for (size_t ch = 0; ch < decimation; ch++)
@@ -11,6 +11,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <complex>
 #include <csignal>
@@ -35,6 +36,16 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-receiver.h"
+#include "vrt-demux.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
+#include "vrt-fx.h"
+#include "vrt-delay-model.h"
+#include "vrt-align.h"
+#include "vrt-spectral-file.h"
 #include "dt-extended-context.h"
 #include "tracker-extended-context.h"
 
@@ -64,17 +75,88 @@ inline float get_abs_val(std::complex<int8_t> t)
     return std::fabs(t.real());
 }
 
+// Parse a comma separated value per station, all zero when the list is empty
+static bool parse_station_values(const std::string& list, size_t stations, const char* name, std::vector<double>* values)
+{
+    values->assign(stations, 0);
+    if (list.empty())
+        return true;
+    std::vector<std::string> items;
+    boost::split(items, list, boost::is_any_of(","));
+    if (items.size() != stations) {
+        printf("--%s needs %zu values, one per channel.\n", name, stations);
+        return false;
+    }
+    for (size_t s = 0; s < stations; s++)
+        (*values)[s] = std::stod(items[s]);
+    return true;
+}
+
+/* Delay (s) and phase (degrees) of each station dt seconds after the start,
+ * geometric (s) is the delay of a per-station delay model. The first station
+ * also carries the delay and phase between the first two stations of the
+ * fringe stopper, cable delay and clock offset options; the geometry of one
+ * baseline, so that is refused for more than 2 stations. */
+static void station_model(const std::vector<vrt_fx_station>& stations, double dt, double first_delay, double first_phase,
+                          const std::vector<double>& geometric, std::vector<double>* delay, std::vector<double>* phase)
+{
+    for (size_t s = 0; s < stations.size(); s++) {
+        (*delay)[s] = stations[s].delay + stations[s].rate*dt + geometric[s];
+        (*phase)[s] = stations[s].phase;
+    }
+    (*delay)[0] += first_delay;
+    (*phase)[0] += first_phase;
+}
+
+// Text row: timestamp, product, u, v, w and the spectrum
+static void print_row(uint64_t seconds, int64_t frac_seconds, const std::string& product,
+                      double u, double v, double w, const std::complex<double>* spectrum, uint32_t num_bins)
+{
+    printf("%llu.%09lli", (long long unsigned int)seconds, (long long int)(frac_seconds/1e3));
+    printf(",%s", product.c_str()); // no space(s)
+    printf(", %.12e, %.12e, %.12e", u, v, w);
+    for (uint32_t i = 0; i < num_bins; i++) {
+        printf(", (%.6e%s%.6ej)", spectrum[i].real(), (spectrum[i].imag() > 0) ? "+" : "-", abs(spectrum[i].imag()) );
+    }
+    printf("\n");
+}
+
+/* Row of the binary output: product (index in the products list), u, v, w,
+ * the delay model of the baseline (delay and phase of a minus those of b)
+ * and the spectrum (or lags), fftshifted so the columns ascend from first_freq
+ * of the header */
+static void write_row(vrt_spectral_file* outfile, uint64_t seconds, uint64_t frac_seconds, int product,
+                      double u, double v, double w, double delay, double phase,
+                      const std::complex<double>* spectrum, uint32_t num_bins)
+{
+    double* traces = vrt_spectral_file_traces(outfile);
+    traces[0] = product;
+    traces[1] = u;
+    traces[2] = v;
+    traces[3] = w;
+    traces[4] = delay;
+    traces[5] = phase;
+    float* values = vrt_spectral_file_values(outfile);
+    for (uint32_t i = 0; i < num_bins; i++) {
+        uint32_t column = (i + num_bins/2) % num_bins;
+        values[2*column] = spectrum[i].real();
+        values[2*column+1] = spectrum[i].imag();
+    }
+    if (not vrt_spectral_file_write(outfile, seconds, frac_seconds))
+        printf("Failed to write the binary output.\n");
+}
+
 int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_plan fft_plan[2];
     fftw_plan ifft_plan;
 
     uint32_t num_bins;
 
     // variables to be set by po
-    std::string file, type, zmq_address, fringe_stop_address, channel_list, site1, site2, object;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, fringe_stop_address, channel_list, site1, site2, object, metrics_target, effort_name, precision_name;
+    std::string station_delay_list, station_rate_list, station_phase_list, delay_model_file, connect_list;
     size_t num_requested_samples;
     uint32_t bins;
     int gain;
@@ -84,6 +166,8 @@ int main(int argc, char* argv[])
     uint32_t channel;
     uint32_t integrations;
     int hwm;
+    uint32_t queue_slots, max_latency;
+    uint32_t threads, fft_batch;
     float amplitude;
     float bin_size, integration_time = 0.0;
 
@@ -113,21 +197,23 @@ int main(int argc, char* argv[])
     double t_ephem = 0;
 
     double current_delay;
-    double fractional_delay;
-    double current_delay_samples;
-    int32_t current_sample_delay;
-
-    std::complex<int16_t> **iq_samples;
-    uint32_t write_head[2];
-    uint32_t buf_size, buf_mask;
-    std::complex<double> **signal;
-    std::complex<double> **fft_result;
-    std::complex<double> *xcorr;
+
+    // input of all stations by timestamp, released in aligned blocks
+    vrt_align* align = NULL;
+    uint32_t align_depth = 0;
     std::complex<double> *xcorr_integrated;
     std::complex<double> *xcorr_time;
-    std::complex<double> *fft_x_integrated;
-    std::complex<double> *fft_y_integrated;
-    double *signal_mag;
+
+    // FX engine: all stations transformed once, all baselines accumulated
+    vrt_fx* fx = NULL;
+    std::vector<vrt_fx_station> stations;
+    std::vector<double> station_delay, station_phase;
+    // per-station delay model: last value and its time per station, the geometric delay (s)
+    std::vector<vrt_delay_value> station_value;
+    std::vector<double> station_value_t, station_geometric;
+    // output order: the crosses, then the autos (--all-hands)
+    std::vector<uint32_t> products;
+    std::vector<std::string> product_names;
 
     // setup the program options
     po::options_description desc("Allowed options");
@@ -137,33 +223,48 @@ int main(int argc, char* argv[])
         ("help", "help message")
         ("nsamps", po::value<size_t>(&num_requested_samples)->default_value(0), "total number of samples to receive")
         ("duration", po::value<double>(&total_time)->default_value(0), "total number of seconds to receive")
-        ("channel", po::value<std::string>(&channel_list)->default_value("0,1"), "which VRT channel(s) to use (specify \"0\", \"1\", \"0,1\", etc)")
+        ("channel", po::value<std::string>(&channel_list)->default_value("0,1"), "which VRT channels (stations) to correlate (specify \"0,1\", \"0,1,2,3\", etc)")
         ("int-second", "align start of reception to integer second")
         ("num-bins", po::value<uint32_t>(&num_bins)->default_value(1000), "number of bins")
         ("integration-time", po::value<float>(&integration_time)->default_value(1.0), "integration time (seconds)")
         ("amplitude", po::value<float>(&amplitude)->default_value(1), "amplitude correction of first channel")
-        ("delta-range", po::value<double>(&delta_range)->default_value(0), "delta range (m)")
-        ("delta-range-dot", po::value<double>(&delta_range_dot)->default_value(0), "delate range dot (m/s)")
+        ("delta-range", po::value<double>(&delta_range)->default_value(0), "delta range (m), 2 channels only")
+        ("delta-range-dot", po::value<double>(&delta_range_dot)->default_value(0), "delate range dot (m/s), 2 channels only")
         ("cable-delay", po::value<double>(&cable_delay)->default_value(0), "delay offset (s)")
         ("clock-offset", po::value<double>(&clock_offset)->default_value(0), "total clock offset")
         ("c1", po::value<double>(&clock_offset_1)->default_value(0), "clock offset site 1")
         ("c2", po::value<double>(&clock_offset_2)->default_value(0), "clock offset site 2")
-        ("s1", po::value<std::string>(&site1), "name of site 1")
-        ("s2", po::value<std::string>(&site2), "name of site 2")
-        ("object", po::value<std::string>(&object), "name of object")
+        ("s1", po::value<std::string>(&site1), "name of site 1 (fringe stopper, 2 channels only)")
+        ("s2", po::value<std::string>(&site2), "name of site 2 (fringe stopper, 2 channels only)")
+        ("object", po::value<std::string>(&object), "name of object (fringe stopper, 2 channels only)")
         ("phase-offset", po::value<double>(&phase_offset)->default_value(0), "phase offset between channels (degrees)")
+        ("station-delay", po::value<std::string>(&station_delay_list), "delay per channel (s), comma separated")
+        ("station-rate", po::value<std::string>(&station_rate_list), "clock rate per channel (s/s), comma separated")
+        ("station-phase", po::value<std::string>(&station_phase_list), "phase offset per channel (degrees), comma separated")
         ("buffer-depth", po::value<uint16_t>(&buffer_depth)->default_value(10), "Correlation buffer depth in VRT frames")
         ("fringe-host", po::value<std::string>(&fringe_stop_address)->default_value("127.0.0.1"), "fringe stopper host/address")
+        ("delay-model", po::value<std::string>(&delay_model_file), "delay table or polynomials (w, u, v) evaluated per FFT, instead of the fringe stopper (2 channels, or any number with station sections)")
         ("correlation", "output cross-correlation instead of cross-spectrum")
-        ("all-hands", "output all hands (xy, xx, yy)")
+        ("all-hands", "output all hands (the autos xx, yy, ... after the crosses)")
         ("normalize", po::value<bool>(&normalize)->default_value(true), "normalize cross-spectrum/cross-correlation")
         ("null", "run without writing to file")
         ("ecsv", po::value<bool>(&ecsv)->default_value(true)->implicit_value(true), "output in ECSV format (Astropy)")
+        ("bin-file", po::value<std::string>(&file), "output binary data to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("instance", po::value<uint16_t>(&instance), "VRT ZMQ instance")
         ("address", po::value<std::string>(&zmq_address)->default_value("127.0.0.1"), "VRT ZMQ address")
         ("port", po::value<uint16_t>(&port)->default_value(50100), "VRT ZMQ port")
+        ("connect", po::value<std::string>(&connect_list), "further VRT ZMQ publishers (address:port, comma separated), e.g. stations streaming from other hosts")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("queue-slots", po::value<uint32_t>(&queue_slots)->default_value(VRT_RECEIVER_SLOTS), "packets buffered by the receive thread")
+        ("max-latency", po::value<uint32_t>(&max_latency)->default_value(0), "drop packets that waited longer in the receive queue (ms), 0 keeps all")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
+        ("threads", po::value<uint32_t>(&threads)->default_value(1), "number of correlator threads (FFT and cross multiply, besides the receiving thread)")
+        ("fft-batch", po::value<uint32_t>(&fft_batch)->default_value(VRT_FFT_BATCH), "number of FFT blocks per station correlated at once")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT and cross multiply precision: double or float (accumulated in double)")
 
     ;
     // clang-format on
@@ -176,11 +277,14 @@ int main(int argc, char* argv[])
         std::cout << boost::format("VRT correlator. %s") % desc << std::endl;
         std::cout << std::endl
                   << "This application correlates data from "
-                     "a dual channel VRT stream.\n"
+                     "a multi channel VRT stream (all baselines).\n"
                   << std::endl;
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
     bool continue_on_bad_packet = vm.count("continue") > 0;
@@ -188,13 +292,31 @@ int main(int argc, char* argv[])
     // bool dt_trace               = vm.count("dt-trace") > 0;
     bool correlation            = vm.count("correlation") > 0;
     bool all_hands              = vm.count("all-hands") > 0;
-    bool use_fringe_stopper     = (vm.count("object") > 0) && (vm.count("s1") > 0) && (vm.count("s2") > 0);
-
-    context_type vrt_context[2];
-    init_context(&vrt_context[0]);
-    init_context(&vrt_context[1]);
-    context_type vrt_context_proc;
-    init_context(&vrt_context_proc);
+    bool binary                 = vm.count("bin-file") > 0;
+
+    vrt_spectral_file* outfile = NULL;
+    bool use_delay_model        = vm.count("delay-model") > 0;
+    bool use_fringe_stopper     = (vm.count("object") > 0) && (vm.count("s1") > 0) && (vm.count("s2") > 0) && not use_delay_model;
+
+    vrt_delay_model delay_model;
+    bool delay_model_covered = true;
+    if (use_delay_model and not vrt_delay_model_load(delay_model_file, &delay_model))
+        return 1;
+
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+    bool single = precision == VRT_FFT_FLOAT;
+
+    vrt_demux demux;
+    context_type* vrt_context[MAX_CHANNELS];
     uint32_t contexts_received = 0;
 
     dt_ext_context_type dt_ext_context;
@@ -209,14 +331,55 @@ int main(int argc, char* argv[])
     for (size_t ch = 0; ch < channel_strings.size(); ch++) {
         size_t chan = std::stoi(channel_strings[ch]);
         channel_nums.push_back(std::stoi(channel_strings[ch]));
-        vrt_packet.channel_filt |= 1<<std::stoi(channel_strings[ch]);
     }
 
-    if (channel_nums.size() != 2) {
-        printf("Only 2 channels supported.\n");
+    if (channel_nums.size() < 2) {
+        printf("At least 2 channels needed.\n");
         exit(1);
     }
 
+    if (not vrt_demux_init(&demux, channel_nums))
+        exit(1);
+    uint32_t num_stations = channel_nums.size();
+    for (uint32_t s = 0; s < num_stations; s++)
+        vrt_context[s] = &demux.streams[s].context;
+
+    // a per-station delay model covers all baselines, the other geometry is that of one baseline
+    bool station_geometry = use_delay_model and delay_model.per_station;
+    if (station_geometry and delay_model.tracks.size() != num_stations) {
+        printf("The delay model has %zu stations, %u channels are correlated.\n", delay_model.tracks.size(), num_stations);
+        exit(1);
+    }
+    bool geometry = use_fringe_stopper or use_delay_model or vm["delta-range"].as<double>() != 0
+        or vm["delta-range-dot"].as<double>() != 0;
+    if (geometry and not station_geometry and num_stations > 2) {
+        printf("The fringe stopper, --delta-range and a --delay-model without station sections model the first baseline only; "
+               "with more than 2 channels give the delay model per station, or the delay per channel with --station-delay and --station-rate.\n");
+        exit(1);
+    }
+
+    std::vector<double> values;
+    stations.resize(num_stations);
+    if (not parse_station_values(station_delay_list, num_stations, "station-delay", &values))
+        exit(1);
+    for (uint32_t s = 0; s < num_stations; s++)
+        stations[s].delay = values[s];
+    if (not parse_station_values(station_rate_list, num_stations, "station-rate", &values))
+        exit(1);
+    for (uint32_t s = 0; s < num_stations; s++)
+        stations[s].rate = values[s];
+    if (not parse_station_values(station_phase_list, num_stations, "station-phase", &values))
+        exit(1);
+    for (uint32_t s = 0; s < num_stations; s++)
+        stations[s].phase = values[s];
+    station_delay.resize(num_stations);
+    station_phase.resize(num_stations);
+    station_value.resize(num_stations);
+    for (vrt_delay_value& value : station_value)
+        value.u = value.v = NAN;
+    station_value_t.resize(num_stations);
+    station_geometric.resize(num_stations);
+
     // ZMQ
     if ((vm.count("instance") > 0)) {
         port = DEFAULT_MAIN_PORT + MAX_CHANNELS*instance;
@@ -229,8 +392,24 @@ int main(int argc, char* argv[])
     std::string connect_string = "tcp://" + zmq_address + ":" + std::to_string(port);
     rc = zmq_connect(subscriber, connect_string.c_str());
     assert(rc == 0);
+    if (not connect_list.empty()) {
+        // the streams of all publishers are aligned by their timestamps
+        std::vector<std::string> publishers;
+        boost::split(publishers, connect_list, boost::is_any_of(","));
+        for (const std::string& publisher : publishers) {
+            if (zmq_connect(subscriber, ("tcp://" + publisher).c_str()) != 0) {
+                printf("Failed to connect to %s.\n", publisher.c_str());
+                return 1;
+            }
+        }
+    }
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+    vrt_receiver* receiver = vrt_receiver_start(subscriber, shm, queue_slots, max_latency);
+    if (receiver == NULL)
+        return 1;
+
     int data_port = 70001;
 
     void *zmq_client = zmq_socket(context, ZMQ_DEALER);
@@ -282,19 +461,18 @@ int main(int argc, char* argv[])
 
     uint32_t signal_pointer = 0;
 
-    bool first_block = true;
     uint32_t integration_counter = 0;
 
     while (not stop_signal_called
            and (num_requested_samples > num_total_samps or num_requested_samples == 0) ) {
 
-        zmq_pollitem_t items[2] = {
-            { subscriber,  0, ZMQ_POLLIN, 0 },
+        // packets are queued by the receive thread, only wait when there are none
+        zmq_pollitem_t items[1] = {
             { zmq_client,  0, ZMQ_POLLIN, 0 }
         };
-        zmq_poll(items, 2, 1);
+        zmq_poll(items, 1, vrt_receiver_occupancy(receiver) > 0 ? 0 : 1);
 
-        if (use_fringe_stopper & items[1].revents & ZMQ_POLLIN) {
+        if (use_fringe_stopper & items[0].revents & ZMQ_POLLIN) {
             int fringe_stop_len = zmq_recv(zmq_client, fringe_stop_buffer, sizeof(fringe_stop_buffer) - 1, 0);
             if (fringe_stop_len > 0) {
                 fringe_stop_buffer[fringe_stop_len] = 0;
@@ -318,22 +496,20 @@ int main(int argc, char* argv[])
                     printf("# ERROR: fringe stopper not initialized\n");
                     exit(1);
                 }
-
-                // for next FFT
-                current_delay_samples = (double)vrt_context[0].sample_rate*(current_delta_range/c + cable_delay + clock_delay);
-                current_sample_delay = (int32_t)floor(current_delay_samples+0.5);
-                fractional_delay = current_delay_samples - (double)current_sample_delay;
             }
         }
 
-        if (not (items[0].revents & ZMQ_POLLIN))
+        if (vrt_receiver_occupancy(receiver) == 0)
             continue;
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_receiver_recv(receiver, buffer, ZMQ_BUFFER_SIZE);
+        if (len < 0)
+            continue;
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context_proc, &vrt_packet)) {
+        vrt_stream_state* stream;
+        if (not vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -341,15 +517,10 @@ int main(int argc, char* argv[])
         if (not vrt_packet.context and not vrt_packet.data)
             continue;
 
-        uint32_t ch = 0;
-        for(ch = 0; ch<channel_nums.size(); ch++)
-            if (vrt_packet.stream_id & (1 << channel_nums[ch]) )
-                break;
-
-        uint32_t channel = channel_nums[ch];
+        uint32_t ch = vrt_demux_index(&demux, stream);
+        uint32_t channel = stream->channel;
 
         if (vrt_packet.context) {
-            vrt_context[ch] = vrt_context_proc;
             contexts_received |= (1 << ch);
         }
 
@@ -357,122 +528,104 @@ int main(int argc, char* argv[])
             dt_process(buffer, sizeof(buffer), &vrt_packet, &dt_ext_context);
         }
 
-        if (not start_rx and (contexts_received == 0x3)) {
+        if (not start_rx and (contexts_received == (1u << num_stations) - 1)) {
 
             if (!ecsv) {
-                vrt_print_context(&vrt_context[0]);
-                vrt_print_context(&vrt_context[1]);
+                for (uint32_t s = 0; s < num_stations; s++)
+                    vrt_print_context(vrt_context[s]);
             }
             start_rx = true;
 
-            integrations = (uint32_t)round((double)integration_time/((double)num_bins/(double)vrt_context[0].sample_rate));
+            integrations = (uint32_t)round((double)integration_time/((double)num_bins/(double)vrt_context[0]->sample_rate));
 
             if (total_time > 0)
-                num_requested_samples = 2 * total_time * vrt_context[0].sample_rate; // 2 channels
+                num_requested_samples = num_stations * total_time * vrt_context[0]->sample_rate; // all channels
 
-            iq_samples = (std::complex<int16_t> **) malloc(sizeof(std::complex<int16_t>*)*channel_nums.size());
-            signal = (std::complex<double> **) malloc(sizeof(std::complex<double>*)*channel_nums.size());
-            fft_result = (std::complex<double> **) malloc(sizeof(std::complex<double>*)*channel_nums.size());
-
-            for (size_t ch=0; ch < channel_nums.size(); ch++)
-                signal[ch] = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
-
-            uint32_t buf_needed = VRT_SAMPLES_PER_PACKET * (buffer_depth + 1);
-            buf_size = 1;
-            while (buf_size < buf_needed) buf_size <<= 1;
-            buf_mask = buf_size - 1;
-            write_head[0] = write_head[1] = 0;
+            // sized for the default packet size, grown for larger packets and delays
+            align_depth = VRT_SAMPLES_PER_PACKET * (buffer_depth + 1);
+            align = vrt_align_create(num_stations, vrt_context[0]->sample_rate, align_depth);
+            if (align == NULL)
+                break;
 
-            for (size_t ch=0; ch < channel_nums.size(); ch++)
-                iq_samples[ch] = (std::complex<int16_t>*) calloc(buf_size, sizeof(std::complex<int16_t>));
+            fx = vrt_fx_create(num_stations, num_bins, true, precision, fft_batch, threads);
+            if (fx == NULL)
+                break;
 
-            for (size_t ch=0; ch < channel_nums.size(); ch++)
-                fft_result[ch] = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
+            // crosses first: with two channels xy, xx, yy
+            const std::vector<vrt_fx_baseline>& baselines = vrt_fx_baseline_list(fx);
+            for (uint32_t b = 0; b < baselines.size(); b++) {
+                if (baselines[b].a == baselines[b].b and (not all_hands or correlation))
+                    continue;
+                products.push_back(b);
+                if (num_stations == 2)
+                    product_names.push_back(std::string(1, "xy"[baselines[b].a]) + "xy"[baselines[b].b]);
+                else
+                    product_names.push_back(std::to_string(channel_nums[baselines[b].a]) + "-" + std::to_string(channel_nums[baselines[b].b]));
+            }
 
             xcorr_time = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
-
-            xcorr = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
             xcorr_integrated = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
-            fft_x_integrated = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
-            fft_y_integrated = (std::complex<double>*) fftw_malloc(sizeof(std::complex<double>) * num_bins);
-            signal_mag = (double*)calloc(num_bins, sizeof(double));
-
-            for (uint32_t i = 0; i < num_bins; i++) {
-                xcorr_integrated[i] = 0;
-                fft_x_integrated[i] = 0;
-                fft_y_integrated[i] = 0;
-                signal_mag[i] = 0;
-            }
 
-            for (size_t ch=0; ch < channel_nums.size(); ch++)
-                fft_plan[ch] = fftw_plan_dft_1d(
-                    num_bins,
-                    reinterpret_cast<fftw_complex*>(signal[ch]),
-                    reinterpret_cast<fftw_complex*>(fft_result[ch]),
-                    FFTW_FORWARD,
-                    FFTW_ESTIMATE
-                );
-
-            ifft_plan = fftw_plan_dft_1d(
-                num_bins,
+            ifft_plan = vrt_fft_plan(
+                num_bins, 1,
                 reinterpret_cast<fftw_complex*>(xcorr_integrated),
                 reinterpret_cast<fftw_complex*>(xcorr_time),
-                FFTW_BACKWARD,
-                FFTW_ESTIMATE
+                FFTW_BACKWARD
             );
 
             if (clock_offset == 0) {
                 clock_offset = -clock_offset_1 + clock_offset_2;
             }
 
-            if ((vrt_context[0].timestamp_calibration_time != 0) && (vrt_context[1].timestamp_calibration_time != 0)) {
-                int64_t seconds = vrt_context[0].integer_seconds_timestamp;
-                int64_t frac_seconds = vrt_context[0].fractional_seconds_timestamp;
+            // between the first two stations, like the fringe stopper
+            if ((vrt_context[0]->timestamp_calibration_time != 0) && (vrt_context[1]->timestamp_calibration_time != 0)) {
+                int64_t seconds = vrt_context[0]->integer_seconds_timestamp;
+                int64_t frac_seconds = vrt_context[0]->fractional_seconds_timestamp;
 
-                delay_correction = -clock_offset_1*(seconds+frac_seconds/1e12 - vrt_context[0].timestamp_calibration_time) +
-                                    clock_offset_2*(seconds+frac_seconds/1e12 - vrt_context[1].timestamp_calibration_time);       
+                delay_correction = -clock_offset_1*(seconds+frac_seconds/1e12 - vrt_context[0]->timestamp_calibration_time) +
+                                    clock_offset_2*(seconds+frac_seconds/1e12 - vrt_context[1]->timestamp_calibration_time);       
             }
 
-            bin_size = (double)vrt_context[0].sample_rate/(double)num_bins;
+            bin_size = (double)vrt_context[0]->sample_rate/(double)num_bins;
 
             if (!ecsv) {
                 printf("# Correlation parameters:\n");
                 printf("#    Mode: %s\n", correlation ? "cross-correlation" : "cross-spectrum");
                 printf("#    Bins: %u\n", num_bins);
-                printf("#    Bin size [Hz]: %.2f\n", ((double)vrt_context[0].sample_rate)/((double)num_bins));
+                printf("#    Bin size [Hz]: %.2f\n", ((double)vrt_context[0]->sample_rate)/((double)num_bins));
                 printf("#    Integrations: %u\n", integrations);
-                printf("#    Integration Time [sec]: %.2f\n", (double)integrations*(double)num_bins/(double)vrt_context[0].sample_rate);
+                printf("#    Integration Time [sec]: %.2f\n", (double)integrations*(double)num_bins/(double)vrt_context[0]->sample_rate);
+                printf("#    Stations: %u\n", num_stations);
+                printf("#    Products: %s\n", boost::algorithm::join(product_names, ", ").c_str());
             } else {
                 uint32_t first_col = 5;
                 printf("# %%ECSV 1.0\n");
                 printf("# ---\n");
 
                 uint32_t ch=0;
-                while(not (vrt_context[0].stream_id & (1 << ch) ) )
+                while(not (vrt_context[0]->stream_id & (1 << ch) ) )
                     ch++;
 
                 printf("# delimiter: \',\'\n");
                 printf("# meta: !!omap\n");
                 printf("# - vrt: !!omap\n");
-                printf("#   - {stream_id: %u}\n", vrt_context[0].stream_id);
+                printf("#   - {stream_id: %u}\n", vrt_context[0]->stream_id);
                 printf("#   - {channel: %u}\n", ch);
-                printf("#   - {sample_rate: %.1f}\n", (float)vrt_context[0].sample_rate);
-                printf("#   - {frequency: %.1f}\n", (double)vrt_context[0].rf_freq);
-                printf("#   - {bandwidth: %.1f}\n", (float)vrt_context[0].bandwidth);
-                printf("#   - {rx_gain_1: %.1f}\n", (float)vrt_context[0].gain);
-                printf("#   - {rx_gain_2: %.1f}\n", (float)vrt_context[1].gain);
-                printf("#   - {reference_1: %s}\n", vrt_context[0].reflock == 1 ? "external" : "internal");
-                printf("#   - {reference_2: %s}\n", vrt_context[1].reflock == 1 ? "external" : "internal");
-                printf("#   - {time_source_1: %s}\n", vrt_context[0].time_cal == 1? "pps" : "internal");
-                printf("#   - {time_source_2: %s}\n", vrt_context[1].time_cal == 1? "pps" : "internal");
-                if (vrt_context[0].timestamp_calibration_time != 0)
-                    printf("#   - {cal_time_1: %u}\n", vrt_context[0].timestamp_calibration_time);
-                if (vrt_context[1].timestamp_calibration_time != 0)
-                    printf("#   - {cal_time_2: %u}\n", vrt_context[1].timestamp_calibration_time);
-                if (vrt_context[0].timestamp_adjustment != 0)
-                    printf("#   - {time_adjust_1: %.9f}\n", (double)vrt_context[0].timestamp_adjustment/1e12);
-                if (vrt_context[1].timestamp_adjustment != 0)
-                    printf("#   - {time_adjust_2: %.9f}\n", (double)vrt_context[1].timestamp_adjustment/1e12);
+                printf("#   - {sample_rate: %.1f}\n", (float)vrt_context[0]->sample_rate);
+                printf("#   - {frequency: %.1f}\n", (double)vrt_context[0]->rf_freq);
+                printf("#   - {bandwidth: %.1f}\n", (float)vrt_context[0]->bandwidth);
+                for (uint32_t s = 0; s < num_stations; s++)
+                    printf("#   - {rx_gain_%u: %.1f}\n", s + 1, (float)vrt_context[s]->gain);
+                for (uint32_t s = 0; s < num_stations; s++)
+                    printf("#   - {reference_%u: %s}\n", s + 1, vrt_context[s]->reflock == 1 ? "external" : "internal");
+                for (uint32_t s = 0; s < num_stations; s++)
+                    printf("#   - {time_source_%u: %s}\n", s + 1, vrt_context[s]->time_cal == 1? "pps" : "internal");
+                for (uint32_t s = 0; s < num_stations; s++)
+                    if (vrt_context[s]->timestamp_calibration_time != 0)
+                        printf("#   - {cal_time_%u: %u}\n", s + 1, vrt_context[s]->timestamp_calibration_time);
+                for (uint32_t s = 0; s < num_stations; s++)
+                    if (vrt_context[s]->timestamp_adjustment != 0)
+                        printf("#   - {time_adjust_%u: %.9f}\n", s + 1, (double)vrt_context[s]->timestamp_adjustment/1e12);
                 printf("# - correlation: !!omap\n");
                 printf("#   - {object: %s}\n", object.c_str());
                 printf("#   - {site_1: %s}\n", site1.c_str());
@@ -483,11 +636,13 @@ int main(int argc, char* argv[])
                 printf("#   - {delay_correction: %.6e}\n", delay_correction);
                 printf("#   - {delay_offset: %.6e}\n", cable_delay);
                 printf("#   - {mode: %s}\n", correlation ? "cross-correlation" : "cross-spectrum");
+                printf("#   - {stations: %u}\n", num_stations);
+                printf("#   - {products: [%s]}\n", boost::algorithm::join(product_names, ", ").c_str());
                 printf("#   - {bins: %u}\n", num_bins);
                 printf("#   - {col_first_bin: %u}\n", first_col);
-                printf("#   - {bin_size: %.2f}\n", ((double)vrt_context[0].sample_rate)/((double)num_bins));
+                printf("#   - {bin_size: %.2f}\n", ((double)vrt_context[0]->sample_rate)/((double)num_bins));
                 printf("#   - {integrations: %u}\n", integrations);
-                printf("#   - {integration_time: %.2f}\n", (double)integrations*(double)num_bins/(double)vrt_context[0].sample_rate);
+                printf("#   - {integration_time: %.2f}\n", (double)integrations*(double)num_bins/(double)vrt_context[0]->sample_rate);
 
                 printf("# datatype:\n");
                 printf("# - {name: timestamp, datatype: float64}\n");
@@ -498,16 +653,77 @@ int main(int argc, char* argv[])
 
                 if (correlation) {
                     for (int32_t i = 0; i < num_bins; ++i) {
-                        printf("# - {name: \'%.4e\', datatype: complex128}\n", (double)(i - (double)num_bins / 2)/(double)vrt_context[0].sample_rate);
+                        printf("# - {name: \'%.4e\', datatype: complex128}\n", (double)(i - (double)num_bins / 2)/(double)vrt_context[0]->sample_rate);
                     }
                 } else {
                     for (int32_t i = 0; i < num_bins; ++i) {
-                        printf("# - {name: \'%.0f\', datatype: complex128}\n", (double)((double)vrt_context[0].rf_freq + (i*bin_size - vrt_context[0].sample_rate/2)));
+                        printf("# - {name: \'%.0f\', datatype: complex128}\n", (double)((double)vrt_context[0]->rf_freq + (i*bin_size - vrt_context[0]->sample_rate/2)));
                     }
                 }
                 printf("# schema: astropy-2.0\n");
             }
 
+            if (binary) {
+                vrt_spectral_layout layout;
+                layout.kind = "xcorr";
+                layout.columns = num_bins;
+                layout.complex = true;
+                layout.sample_rate = vrt_context[0]->sample_rate;
+                layout.center_freq = vrt_context[0]->rf_freq;
+                if (correlation) {
+                    layout.first_freq = -(double)(num_bins/2)/(double)vrt_context[0]->sample_rate;
+                    layout.column_step = 1.0/(double)vrt_context[0]->sample_rate;
+                } else {
+                    layout.first_freq = (double)vrt_context[0]->rf_freq - vrt_context[0]->sample_rate/2;
+                    layout.column_step = bin_size;
+                }
+                layout.integrations = integrations;
+                layout.integration_time = (double)integrations*(double)num_bins/(double)vrt_context[0]->sample_rate;
+                layout.traces.push_back({"product", ""});
+                layout.traces.push_back({"u", "m"});
+                layout.traces.push_back({"v", "m"});
+                layout.traces.push_back({"w", "m"});
+                layout.traces.push_back({"delay", "s"});
+                layout.traces.push_back({"phase", "deg"});
+                // the correlation metadata of the ECSV header
+                layout.meta.push_back({"mode", correlation ? "cross-correlation" : "cross-spectrum"});
+                // source of u, v, w (of the first baseline)
+                layout.meta.push_back({"geometry", use_delay_model ? "delay-model" : use_fringe_stopper ? "fringe-stopper"
+                    : geometry ? "delta-range" : "none"});
+                layout.meta.push_back({"stations", std::to_string(num_stations)});
+                std::vector<std::string> channels;
+                for (size_t ch : channel_nums)
+                    channels.push_back(std::to_string(ch));
+                layout.meta.push_back({"channels", "[" + boost::algorithm::join(channels, ", ") + "]"});
+                layout.meta.push_back({"products", "[" + boost::algorithm::join(product_names, ", ") + "]"});
+                layout.meta.push_back({"stream_id", std::to_string(vrt_context[0]->stream_id)});
+                char value[32];
+                snprintf(value, sizeof(value), "%.1f", (double)vrt_context[0]->bandwidth);
+                layout.meta.push_back({"bandwidth", value});
+                for (uint32_t s = 0; s < num_stations; s++) {
+                    std::string n = std::to_string(s + 1);
+                    snprintf(value, sizeof(value), "%.1f", (double)vrt_context[s]->gain);
+                    layout.meta.push_back({"rx_gain_" + n, value});
+                    layout.meta.push_back({"reference_" + n, vrt_context[s]->reflock == 1 ? "external" : "internal"});
+                    layout.meta.push_back({"time_source_" + n, vrt_context[s]->time_cal == 1 ? "pps" : "internal"});
+                }
+                if (use_fringe_stopper) {
+                    layout.meta.push_back({"object", object});
+                    layout.meta.push_back({"site_1", site1});
+                    layout.meta.push_back({"site_2", site2});
+                }
+                const std::pair<const char*, double> offsets[] = {
+                    {"clock_offset", clock_offset}, {"clock_offset_1", clock_offset_1}, {"clock_offset_2", clock_offset_2},
+                    {"delay_correction", delay_correction}, {"delay_offset", cable_delay}};
+                for (const auto& offset : offsets) {
+                    snprintf(value, sizeof(value), "%.6e", offset.second);
+                    layout.meta.push_back({offset.first, value});
+                }
+                outfile = vrt_spectral_file_create(file, layout);
+                if (outfile == NULL)
+                    break;
+            }
+
             cable_delay += delay_correction;    
             
             // Header
@@ -515,18 +731,17 @@ int main(int argc, char* argv[])
 
             if (correlation) {
                 for (int32_t i = 0; i < num_bins; i++) {
-                        printf(", %.4e", (double)(i - (double)num_bins / 2)/(double)vrt_context[0].sample_rate);
+                        printf(", %.4e", (double)(i - (double)num_bins / 2)/(double)vrt_context[0]->sample_rate);
                 }
             } else {
                 for (int32_t i = 0; i < num_bins; ++i) {
-                            printf(", %.0f", (double)((double)vrt_context[0].rf_freq + (i*bin_size - vrt_context[0].sample_rate/2)));
+                            printf(", %.0f", (double)((double)vrt_context[0]->rf_freq + (i*bin_size - vrt_context[0]->sample_rate/2)));
                 }
             }
             printf("\n");
 
-            current_delay = (double)vrt_context[0].sample_rate*(current_delta_range/c+cable_delay);
-            current_sample_delay = (int32_t)floor(current_delay+0.5);
-            fractional_delay = current_delay - (double)current_sample_delay;
+            station_model(stations, 0, current_delta_range/c + cable_delay, phase_offset, station_geometric, &station_delay, &station_phase);
+            vrt_fx_set_delays(fx, station_delay.data(), station_phase.data(), vrt_context[0]->sample_rate, vrt_context[0]->rf_freq);
 
         }
 
@@ -554,7 +769,7 @@ int main(int argc, char* argv[])
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &stream->context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
@@ -570,170 +785,132 @@ int main(int argc, char* argv[])
                 }
             }
 
-            if (first_block and (ch!=0) ) {
-                continue;
-            } else {
-                first_block = false;
-            }
+            // the packets of the streams may arrive in any order, they are placed by their timestamp
+            if ((uint32_t)vrt_packet.num_rx_samps * (buffer_depth + 1) > align_depth)
+                align_depth = (uint32_t)vrt_packet.num_rx_samps * (buffer_depth + 1);
+            vrt_align_push(align, ch, vrt_packet.integer_seconds_timestamp, vrt_packet.fractional_seconds_timestamp,
+                &buffer[vrt_packet.offset], vrt_packet.num_rx_samps);
 
             {
-                uint32_t space = buf_size - write_head[ch];
-                if ((uint32_t)vrt_packet.num_rx_samps <= space) {
-                    memcpy(&iq_samples[ch][write_head[ch]], &buffer[vrt_packet.offset],
-                           vrt_packet.num_rx_samps * sizeof(std::complex<int16_t>));
-                } else {
-                    memcpy(&iq_samples[ch][write_head[ch]], &buffer[vrt_packet.offset],
-                           space * sizeof(std::complex<int16_t>));
-                    memcpy(&iq_samples[ch][0], &buffer[vrt_packet.offset + space],
-                           (vrt_packet.num_rx_samps - space) * sizeof(std::complex<int16_t>));
-                }
-                write_head[ch] = (write_head[ch] + vrt_packet.num_rx_samps) & buf_mask;
-            }
-
-            if (ch==1) {
-                // both channels received (we assume they are in order)
-
-                int32_t ch0_shift = 0;
-                int32_t ch1_shift = 0;
-                if (current_sample_delay < 0) {
-                    ch1_shift = abs(current_sample_delay);
-                } else {
-                    ch0_shift = abs(current_sample_delay);
-                }
-
-                uint32_t base0 = (write_head[0] - vrt_packet.num_rx_samps - ch0_shift) & buf_mask;
-                uint32_t base1 = (write_head[1] - vrt_packet.num_rx_samps - ch1_shift) & buf_mask;
+                // the delayed stations are read further back
+                uint32_t shift[MAX_CHANNELS];
 
-                for (int32_t k = 0; k < vrt_packet.num_rx_samps; k++) {
+                while (true) {
 
-                    signal[0][signal_pointer] = std::complex<double>(
-                        amplitude * (double)iq_samples[0][(base0 + k) & buf_mask].real() / 32768.0,
-                        amplitude * (double)iq_samples[0][(base0 + k) & buf_mask].imag() / 32768.0
-                    );
-
-                    signal[1][signal_pointer] = std::complex<double>(
-                        (double)iq_samples[1][(base1 + k) & buf_mask].real() / 32768.0,
-                        (double)iq_samples[1][(base1 + k) & buf_mask].imag() / 32768.0
-                    );
+                    uint32_t max_shift = 0;
+                    for (uint32_t s = 0; s < num_stations; s++) {
+                        shift[s] = vrt_fx_shift(fx, s);
+                        max_shift = std::max(max_shift, shift[s]);
+                    }
+                    vrt_align_reserve(align, max_shift + align_depth);
+
+                    uint32_t n = vrt_align_ready(align, shift, num_bins - signal_pointer);
+                    if (n == 0)
+                        break;
+                    int64_t position = vrt_align_position(align);
+
+                    for (uint32_t s = 0; s < num_stations; s++) {
+                        double scale = (s == 0 ? amplitude : 1.0) / 32768.0;
+                        if (single)
+                            vrt_align_read(align, s, position - shift[s], n, vrt_fx_input_f(fx, s) + signal_pointer, (float)scale);
+                        else
+                            vrt_align_read(align, s, position - shift[s], n, vrt_fx_input(fx, s) + signal_pointer, scale);
+                    }
+                    vrt_align_advance(align, n);
 
-                    signal_pointer++;
+                    signal_pointer += n;
 
                     if (signal_pointer == num_bins) {
 
-                        int64_t seconds = vrt_packet.integer_seconds_timestamp;
-                        int64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
-                        frac_seconds += (k-num_bins/2)*1e12/vrt_context[0].sample_rate;
-                        if (frac_seconds > 1e12) {
-                            frac_seconds -= 1e12;
-                            seconds++;
-                        } else if (frac_seconds < 0) {
-                            frac_seconds += 1e12;
-                            seconds--;
-                        }
+                        // the middle of the FFT
+                        int64_t seconds, frac_seconds;
+                        vrt_align_time(align, position + n - 1 - num_bins/2, &seconds, &frac_seconds);
 
                         double t = (double)seconds + (double)frac_seconds/1e12;
 
                         signal_pointer = 0;
 
-                        fftw_execute(fft_plan[0]);
-                        fftw_execute(fft_plan[1]);
-
                         integration_counter++;
 
                         clock_delay = (-clock_offset_1 * (t-t0) + clock_offset_2 * (t-t0));       
 
-                        current_delta_range = delta_range + delta_range_dot * (t-t_ephem);
-                        current_delay = current_delta_range/c + cable_delay + clock_delay;
-
-                        current_delay_samples = (double)vrt_context[0].sample_rate*(current_delay);
-                        current_sample_delay = (int32_t)floor(current_delay_samples+0.5);
-                        fractional_delay = current_delay_samples - (double)current_sample_delay;
-
-                        std::complex<double> phase_correction = std::exp(complexi*-2.0*pi*( (double)vrt_context[0].rf_freq*current_delay + (double)phase_offset/360.0));
-
-                        // correlate and integrate
-                        // frac_corr is a linear phase ramp in fftshift bin order.
-                        // Split at the wrap point (i=N/2) so each half is a pure geometric
-                        // sequence: no branches inside either loop, compiler can vectorize freely.
-                        
-                        std::complex<double> frac_corr_step = std::exp(complexi * (-2.0 * pi * fractional_delay / (double)num_bins));
-                        std::complex<double> frac_corr_jump = std::exp(complexi * ( 2.0 * pi * fractional_delay));
-                        std::complex<double> frac_corr = 1.0; // theta(0) = 0
-
-                        for (int32_t i = 0; i < (int32_t)(num_bins / 2); i++) {
-                            fft_result[0][i] *= phase_correction * frac_corr;
-                            xcorr[i] = fft_result[0][i] * conj(fft_result[1][i]);
-                            xcorr_integrated[i] += xcorr[i];
-                            fft_x_integrated[i] += fft_result[0][i] * conj(fft_result[0][i]);
-                            fft_y_integrated[i] += fft_result[1][i] * conj(fft_result[1][i]);
-                            signal_mag[i] += std::abs(fft_result[0][i]) * std::abs(fft_result[1][i]);
-                            frac_corr *= frac_corr_step;
-                        }
-                        frac_corr *= frac_corr_jump;
-                        for (int32_t i = (int32_t)(num_bins / 2); i < (int32_t)num_bins; i++) {
-                            fft_result[0][i] *= phase_correction * frac_corr;
-                            xcorr[i] = fft_result[0][i] * conj(fft_result[1][i]);
-                            xcorr_integrated[i] += xcorr[i];
-                            fft_x_integrated[i] += fft_result[0][i] * conj(fft_result[0][i]);
-                            fft_y_integrated[i] += fft_result[1][i] * conj(fft_result[1][i]);
-                            signal_mag[i] += std::abs(fft_result[0][i]) * std::abs(fft_result[1][i]);
-                            frac_corr *= frac_corr_step;
+                        // the model at the exact time of this FFT, extrapolated from the last value outside it
+                        if (station_geometry) {
+                            bool covered = true;
+                            for (uint32_t s = 0; s < num_stations; s++) {
+                                if (vrt_delay_model_eval(&delay_model, seconds, frac_seconds, &station_value[s], s))
+                                    station_value_t[s] = t;
+                                else
+                                    covered = false;
+                                station_geometric[s] = (station_value[s].w + station_value[s].w_dot*(t - station_value_t[s]))/c;
+                            }
+                            if (not covered and delay_model_covered)
+                                printf("# WARNING: %.3f is not covered by the delay model of every station, extrapolating\n", t);
+                            delay_model_covered = covered;
+                        } else if (use_delay_model) {
+                            vrt_delay_value model_value;
+                            bool covered = vrt_delay_model_eval(&delay_model, seconds, frac_seconds, &model_value);
+                            if (covered) {
+                                delta_range = model_value.w;
+                                delta_range_dot = model_value.w_dot;
+                                range_u = model_value.u;
+                                range_v = model_value.v;
+                                t_ephem = t;
+                            } else if (delay_model_covered) {
+                                printf("# WARNING: %.3f is not covered by the delay model, extrapolating\n", t);
+                            }
+                            delay_model_covered = covered;
                         }
 
-                        if (integration_counter == integrations) {
+                        current_delta_range = delta_range + delta_range_dot * (t-t_ephem);
+                        current_delay = current_delta_range/c + cable_delay + clock_delay;
 
-                            if (normalize) {
-                                for (int32_t i = 0; i < num_bins; i++) {
-                                    if (signal_mag[i]>0) 
-                                        xcorr_integrated[i] = xcorr_integrated[i] / signal_mag[i];
-                                }
-                            }
+                        // fractional delays and fringe rotation of this FFT, whole samples from the next FFT on
+                        station_model(stations, t - t0, current_delay, phase_offset, station_geometric, &station_delay, &station_phase);
+                        vrt_fx_set_delays(fx, station_delay.data(), station_phase.data(), vrt_context[0]->sample_rate, vrt_context[0]->rf_freq);
 
-                            printf("%llu.%09lli", (long long unsigned int)seconds, (long long int)(frac_seconds/1e3));
-                            printf(",%s", "xy"); // no space(s)
-                            printf(", %.12e, %.12e, %.12e", range_u, range_v, current_delta_range);
+                        // transform each station once, correlate and integrate all baselines (batched)
+                        vrt_fx_push(fx);
 
-                            if (correlation) {
-                                // inverse FFT
-                                fftw_execute(ifft_plan);
+                        if (integration_counter == integrations) {
 
-                                for (uint32_t i = 0; i < num_bins; i++) {
-                                    printf(", (%.6e%s%.6ej)", xcorr_time[i].real(), (xcorr_time[i].imag() > 0) ? "+" : "-", abs(xcorr_time[i].imag()) );
-                                }
-                                printf("\n");
-                            } else {
-                                for (uint32_t i = 0; i < num_bins; i++) {
-                                    printf(", (%.6e%s%.6ej)", xcorr_integrated[i].real(), (xcorr_integrated[i].imag() > 0) ? "+" : "-", abs(xcorr_integrated[i].imag()) );
+                            vrt_fx_flush(fx);
+                            if (normalize)
+                                vrt_fx_normalize(fx);
+
+                            /* u, v, w are the differences of the stations with a per-station model,
+                             * else those of the first two stations: zero for the autos, NaN (not
+                             * modeled) for the other crosses */
+                            const std::vector<vrt_fx_baseline>& baselines = vrt_fx_baseline_list(fx);
+                            for (uint32_t p = 0; p < products.size(); p++) {
+                                const vrt_fx_baseline& baseline = baselines[products[p]];
+                                double sign = (baseline.a == 0 and baseline.b == 1) ? 1 : (baseline.a == baseline.b ? 0 : NAN);
+                                double u = sign*range_u, v = sign*range_v, w = sign*current_delta_range;
+                                if (station_geometry) {
+                                    u = station_value[baseline.a].u - station_value[baseline.b].u;
+                                    v = station_value[baseline.a].v - station_value[baseline.b].v;
+                                    w = (station_geometric[baseline.a] - station_geometric[baseline.b])*c;
                                 }
-                                printf("\n");
-                                if (all_hands) {
-                                    printf("%llu.%09lli", (long long unsigned int)seconds, (long long int)(frac_seconds/1e3));
-                                    printf(",%s", "xx"); // no space(s)
-                                    printf(", %.12e, %.12e, %.12e", range_u, range_v, current_delta_range);
-                                    for (uint32_t i = 0; i < num_bins; i++) {
-                                        printf(", (%.6e%s%.6ej)", fft_x_integrated[i].real(), (fft_x_integrated[i].imag() > 0) ? "+" : "-", abs(fft_x_integrated[i].imag()) );
-                                    }
-                                    printf("\n");
-                                    printf("%llu.%09lli", (long long unsigned int)seconds, (long long int)(frac_seconds/1e3));
-                                    printf(",%s", "yy"); // no space(s)
-                                    printf(", %.12e, %.12e, %.12e", range_u, range_v, current_delta_range);
-                                    for (uint32_t i = 0; i < num_bins; i++) {
-                                        printf(", (%.6e%s%.6ej)", fft_y_integrated[i].real(), (fft_y_integrated[i].imag() > 0) ? "+" : "-", abs(fft_y_integrated[i].imag()) );
-                                    }
-                                    printf("\n");
+                                const std::complex<double>* spectrum = vrt_fx_visibility(fx, products[p]);
+                                if (correlation) {
+                                    // inverse FFT
+                                    memcpy((void*)xcorr_integrated, spectrum, sizeof(std::complex<double>) * num_bins);
+                                    fftw_execute(ifft_plan);
+                                    spectrum = xcorr_time;
                                 }
+                                if (binary)
+                                    write_row(outfile, seconds, frac_seconds, p, u, v, w,
+                                        station_delay[baseline.a] - station_delay[baseline.b],
+                                        station_phase[baseline.a] - station_phase[baseline.b], spectrum, num_bins);
+                                else
+                                    print_row(seconds, frac_seconds, product_names[p], u, v, w,
+                                        spectrum, num_bins);
                             }
-
-                            fflush(stdout);
+                            if (not binary)
+                                fflush(stdout);
 
                             integration_counter = 0;
-
-                            for (uint32_t i = 0; i < num_bins; i++) {
-                                xcorr_integrated[i] = 0;
-                                fft_x_integrated[i] = 0;
-                                fft_y_integrated[i] = 0;
-                                signal_mag[i] = 0;
-                            }
+                            vrt_fx_reset(fx);
                         }
                     }
                 }
@@ -744,7 +921,18 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (outfile)
+        vrt_spectral_file_close(outfile);
+    // samples that did not arrive in time to be buffered
+    for (uint32_t s = 0; align and s < num_stations; s++)
+        if (vrt_align_missing(align, s) > 0)
+            printf("# Station %u: %llu samples missing (correlated as zeros)\n", s + 1,
+                (unsigned long long)vrt_align_missing(align, s));
+    vrt_fx_destroy(fx);
+    vrt_align_destroy(align);
     zmq_close(zmq_client);
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(shm);
     zmq_close(subscriber);
     // zmq_ctx_destroy(context);
 
@@ -0,0 +1,138 @@
+//
+// Copyright 2026 by Thomas Telkamp
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// VRT tools functions
+#include "vrt-fft.h"
+
+namespace po = boost::program_options;
+
+static bool parse_list(const std::string& list, std::vector<uint32_t>* values) {
+    std::vector<std::string> items;
+    boost::split(items, list, boost::is_any_of(","), boost::token_compress_on);
+    for (const std::string& item : items) {
+        if (item.empty())
+            continue;
+        try {
+            values->push_back(std::stoul(item));
+        } catch (...) {
+            printf("Invalid number %s.\n", item.c_str());
+            return false;
+        }
+        if (values->back() == 0) {
+            printf("Invalid number %s.\n", item.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static void destroy_plan(fftw_plan plan) { fftw_destroy_plan(plan); }
+static void destroy_plan(fftwf_plan plan) { fftwf_destroy_plan(plan); }
+
+/* Make the plans the tools make for one size: a single FFT (vrt_fftmax,
+ * vrt_pulsar, vrt_to_filterbank, vrt_rffft, vrt_correlate), the inverse FFT
+ * of vrt_correlate and the batched engine of vrt_spectrum */
+template <typename T>
+static void plan_size(uint32_t n, vrt_fft_precision precision, uint32_t batch, uint32_t threads) {
+
+    vrt_fft_destroy(vrt_fft_create(n, precision));
+
+    T* in = (T*) fftw_malloc(sizeof(T) * n);
+    T* out = (T*) fftw_malloc(sizeof(T) * n);
+    destroy_plan(vrt_fft_plan(n, 1, in, out, FFTW_BACKWARD));
+    fftw_free(in);
+    fftw_free(out);
+
+    vrt_fft_engine_destroy(vrt_fft_engine_create(n, batch, threads, false, precision));
+}
+
+int main(int argc, char* argv[])
+{
+    // variables to be set by po
+    std::string size_list, precision_name, effort_name, wisdom_dir;
+    uint32_t batch, threads;
+
+    // setup the program options
+    po::options_description desc("Allowed options");
+    // clang-format off
+    desc.add_options()
+        ("help", "help message")
+        ("sizes", po::value<std::string>(&size_list)->default_value("1024,2048,4096,8192,16384,32768,65536"), "comma separated FFT sizes")
+        ("precision", po::value<std::string>(&precision_name)->default_value("both"), "FFT precision: double, float or both")
+        ("fft-batch", po::value<uint32_t>(&batch)->default_value(VRT_FFT_BATCH), "FFT blocks per batch (as vrt_spectrum --fft-batch)")
+        ("threads", po::value<uint32_t>(&threads)->default_value(1), "FFT threads (as vrt_spectrum --threads)")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("measure"), "FFT planner effort: estimate, measure or patient")
+        ("wisdom-dir", po::value<std::string>(&wisdom_dir), "wisdom cache directory (default: $VRT_FFT_WISDOM or ~/.cache/vrt-iq-tools)")
+    ;
+    // clang-format on
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    // print the help message
+    if (vm.count("help")) {
+        std::cout << boost::format("FFT wisdom. %s") % desc << std::endl;
+        std::cout << std::endl
+                  << "This application plans the FFTs of the given sizes and stores the\n"
+                     "FFTW wisdom, so the FFT tools start with tuned plans.\n"
+                  << std::endl;
+        return ~0;
+    }
+
+    std::vector<vrt_fft_precision> precisions;
+    if (precision_name == "both") {
+        precisions.push_back(VRT_FFT_DOUBLE);
+        precisions.push_back(VRT_FFT_FLOAT);
+    } else {
+        vrt_fft_precision precision;
+        if (not vrt_parse_fft_precision(precision_name, &precision))
+            return 1;
+        precisions.push_back(precision);
+    }
+
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort, wisdom_dir);
+
+    std::vector<uint32_t> sizes;
+    if (not parse_list(size_list, &sizes) or sizes.empty())
+        return 1;
+
+    if (batch == 0 or threads == 0) {
+        printf("Invalid FFT batch or number of threads.\n");
+        return 1;
+    }
+
+    for (vrt_fft_precision precision : precisions) {
+        std::string file = vrt_fft_wisdom_file(precision);
+        if (file.empty()) {
+            printf("No wisdom cache directory, set --wisdom-dir or VRT_FFT_WISDOM.\n");
+            return 1;
+        }
+        for (uint32_t n : sizes) {
+            auto start = std::chrono::steady_clock::now();
+            if (precision == VRT_FFT_FLOAT)
+                plan_size<fftwf_complex>(n, precision, batch, threads);
+            else
+                plan_size<fftw_complex>(n, precision, batch, threads);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("%s %7u bins: %.2f s\n", precision == VRT_FFT_FLOAT ? "float " : "double", n, seconds);
+        }
+        printf("Wisdom stored in %s\n", file.c_str());
+    }
+
+    return 0;
+}
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -33,6 +34,13 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-fft.h"
+#include "vrt-convert.h"
+#include "vrt-zoom.h"
+#include "vrt-peak.h"
+#include "vrt-spectral-file.h"
 
 namespace po = boost::program_options;
 
@@ -66,15 +74,29 @@ int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_complex *signal, *result;
-    fftw_plan plan;
+    vrt_fft* fft = NULL;
     uint32_t num_points = 0;
     uint32_t fft_len = 1;
 
     int32_t min_bin, max_bin;
 
+    // zoom: band mixed to baseband and decimated before the FFT
+    vrt_zoom* zoom = NULL;
+    uint32_t zoom_decimation;
+    double fft_rate = 0, zoom_offset = 0;
+    std::vector<std::complex<float>> zoom_in, zoom_out;
+
+    // peaks
+    uint32_t num_peaks, track_hold;
+    double track_jump;
+    std::string interp_name;
+    std::vector<double> magnitudes;
+    std::vector<uint32_t> peak_bins;
+    std::vector<vrt_peak> peaks;
+    vrt_peak_tracker tracker;
+
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, metrics_target, precision_name, effort_name;
     uint16_t instance, main_port, port;
     uint32_t channel;
     int hwm;
@@ -92,18 +114,30 @@ int main(int argc, char* argv[])
         ("min-offset", po::value<double>(&min_offset), "min. freq. offset to track")
         ("max-offset", po::value<double>(&max_offset), "max. freq. offset to track")
         ("fft-duration", po::value<uint32_t>(&fft_len), "number of seconds to integrate")
+        ("zoom", "FFT only the band from min. to max. offset, mixed to baseband and decimated")
+        ("zoom-decimation", po::value<uint32_t>(&zoom_decimation), "decimation with --zoom (default: the largest that holds the band)")
         ("channel", po::value<uint32_t>(&channel)->default_value(0), "VRT channel")
         ("progress", "periodically display short-term bandwidth")
         // ("stats", "show average bandwidth on exit")
         ("int-second", "align start of reception to integer second")
+        ("bin-file", po::value<std::string>(&file), "output binary data to file")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("ignore-dc", "Ignore  DC bin")
+        ("interpolation", po::value<std::string>(&interp_name)->default_value("none"), "sub-bin peak interpolation: none, quadratic, gaussian or jacobsen")
+        ("peaks", po::value<uint32_t>(&num_peaks)->default_value(1), "number of peaks to track")
+        ("track-jump", po::value<double>(&track_jump)->default_value(10), "max. frequency change of a tracked peak between FFTs (Hz)")
+        ("track-hold", po::value<uint32_t>(&track_hold)->default_value(3), "FFTs a tracked peak can be missing before its track is dropped")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("zmq-split", "create a ZeroMQ stream per VRT channel, increasing port number for additional streams")
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -120,12 +154,43 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool null                   = vm.count("null") > 0;
     bool continue_on_bad_packet = vm.count("continue") > 0;
     bool int_second             = (bool)vm.count("int-second");
     bool ignore_dc              = (bool)vm.count("ignore-dc");
     bool zmq_split              = vm.count("zmq-split") > 0;
+    bool binary                 = vm.count("bin-file") > 0;
+    bool zoom_mode              = vm.count("zoom") > 0;
+
+    if (zoom_mode and (not vm.count("min-offset") or not vm.count("max-offset") or max_offset <= min_offset)) {
+        printf("--zoom needs a band: --min-offset below --max-offset.\n");
+        return 1;
+    }
+
+    vrt_spectral_file* outfile = NULL;
+
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_peak_interp interp;
+    if (not vrt_parse_peak_interp(interp_name, &interp))
+        return 1;
+    if (num_peaks == 0) {
+        printf("Track at least one peak.\n");
+        return 1;
+    }
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
 
     context_type vrt_context;
     init_context(&vrt_context);
@@ -154,6 +219,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -176,11 +243,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -193,31 +260,67 @@ int main(int argc, char* argv[])
         if (not start_rx and vrt_packet.context) {
             vrt_print_context(&vrt_context);
             start_rx = true;
-            num_points = fft_len*vrt_context.sample_rate;
+
+            fft_rate = vrt_context.sample_rate;
+            if (zoom_mode) {
+                zoom_offset = (min_offset + max_offset)/2;
+                if (not vm.count("zoom-decimation"))
+                    zoom_decimation = vrt_zoom_decimation(vrt_context.sample_rate, max_offset - min_offset);
+                zoom = vrt_zoom_create(vrt_context.sample_rate, zoom_offset, zoom_decimation);
+                if (zoom == NULL)
+                    break;
+                fft_rate = vrt_zoom_sample_rate(zoom);
+                printf("# Zoom: %.0f Hz, decimation %u, %.2f sps\n", zoom_offset, zoom_decimation, fft_rate);
+            }
+            num_points = round(fft_len*fft_rate);
+            double bin_hz = fft_rate/num_points;
 
             min_bin = 0;
             max_bin = num_points;
 
             if (vm.count("min-offset")) {
-                min_bin = min_offset+num_points/2;
+                min_bin = (min_offset - zoom_offset)/bin_hz + num_points/2;
                 min_bin = min_bin < 0 ? 0 : min_bin;
                 min_bin = min_bin > num_points ? num_points : min_bin;
             }
 
             if (vm.count("max-offset")) {
-                max_bin = max_offset+num_points/2;
+                max_bin = (max_offset - zoom_offset)/bin_hz + num_points/2;
                 max_bin = max_bin < 0 ? 0 : max_bin;
                 max_bin = max_bin > num_points ? num_points : max_bin;
             }
 
-            signal = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_points);
-            result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_points);
-            plan = fftw_plan_dft_1d(num_points, signal, result, FFTW_FORWARD, FFTW_ESTIMATE);
+            fft = vrt_fft_create(num_points, precision);
+            magnitudes.resize(num_points);
+            vrt_peak_tracker_init(&tracker, num_peaks, track_jump/bin_hz, track_hold);
+
+            if (binary) {
+                vrt_spectral_layout layout;
+                layout.kind = "fftmax";
+                layout.sample_rate = fft_rate;
+                layout.center_freq = vrt_context.rf_freq + zoom_offset;
+                layout.integration_time = fft_len;
+                if (num_peaks == 1) {
+                    layout.traces.push_back({"frequency", "Hz"});
+                    layout.traces.push_back({"power", "dB"});
+                } else {
+                    for (uint32_t p = 1; p <= num_peaks; p++) {
+                        layout.traces.push_back({"frequency_" + std::to_string(p), "Hz"});
+                        layout.traces.push_back({"power_" + std::to_string(p), "dB"});
+                    }
+                }
+                layout.meta.push_back({"stream_id", std::to_string(vrt_context.stream_id)});
+                if (zoom)
+                    layout.meta.push_back({"zoom_decimation", std::to_string(zoom_decimation)});
+                outfile = vrt_spectral_file_create(file, layout);
+                if (outfile == NULL)
+                    break;
+            }
         }
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
@@ -234,15 +337,29 @@ int main(int argc, char* argv[])
                 }
             }
 
-            int mult = 1;
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                signal[signal_pointer][REAL] = mult*re;
-                signal[signal_pointer][IMAG] = mult*img;
-                mult *= -1;
+            // with zoom the FFT input is the decimated band
+            uint32_t num_samps = vrt_packet.num_rx_samps;
+            if (zoom) {
+                zoom_in.resize(num_samps);
+                zoom_out.resize(num_samps/zoom_decimation + 1);
+                uint64_t stage_begin = vrt_metrics_stage_begin();
+                vrt_payload_to_cf32(&buffer[vrt_packet.offset], vrt_packet.sample_format, zoom_in.data(), num_samps);
+                num_samps = vrt_zoom_process(zoom, zoom_in.data(), num_samps, zoom_out.data());
+                vrt_metrics_stage_end(VRT_STAGE_CONVERT, stage_begin);
+            }
+
+            for (uint32_t i = 0; i < num_samps; i++) {
+                // fftshift sign of the position in the FFT
+                double mult = (signal_pointer & 1) ? -1 : 1;
+                if (zoom) {
+                    vrt_fft_set_input(fft, signal_pointer, mult*std::complex<double>(zoom_out[i]));
+                } else {
+                    int16_t re;
+                    memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
+                    int16_t img;
+                    memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
+                    vrt_fft_set_input(fft, signal_pointer, std::complex<double>(mult*re, mult*img));
+                }
 
                 signal_pointer++;
 
@@ -250,33 +367,70 @@ int main(int argc, char* argv[])
 
                     signal_pointer = 0;
 
-                    fftw_execute(plan);
-
-                    double max = 0;
-                    int32_t max_i = -1;
-
-                    uint32_t dc = num_points/2;
-
-                    for (uint32_t i = 0; i < num_points; ++i) {
-                        double mag = sqrt(result[i][REAL] * result[i][REAL] +
-                                  result[i][IMAG] * result[i][IMAG]);
-                        if ( (mag > max) and (i >= min_bin) and (i <= max_bin) and not (ignore_dc && i==dc)) {
-                            max = mag;
-                            max_i = i;
+                    uint64_t stage_begin = vrt_metrics_stage_begin();
+                    vrt_fft_execute(fft);
+                    vrt_metrics_stage_end(VRT_STAGE_FFT, stage_begin);
+
+                    for (uint32_t i = 0; i < num_points; ++i)
+                        magnitudes[i] = sqrt(vrt_fft_power(fft, i));
+                    if (ignore_dc)
+                        magnitudes[num_points/2] = 0;
+
+                    // strongest peaks, refined between the bins
+                    vrt_peak_find(magnitudes.data(), num_points, min_bin, max_bin, num_peaks, &peak_bins);
+                    peaks.clear();
+                    for (uint32_t bin : peak_bins) {
+                        vrt_peak peak = {(double)bin, magnitudes[bin]};
+                        if (bin > 0 and bin + 1 < num_points) {
+                            std::complex<double> X[3] = {vrt_fft_output(fft, bin - 1), vrt_fft_output(fft, bin), vrt_fft_output(fft, bin + 1)};
+                            peak.bin += vrt_peak_interpolate(interp, X, &peak.magnitude);
                         }
+                        peaks.push_back(peak);
+                    }
+                    if (num_peaks > 1) {
+                        vrt_peak_tracker_update(&tracker, peaks);
+                    } else if (peaks.empty()) {
+                        continue;
                     }
 
                     uint64_t seconds = vrt_packet.integer_seconds_timestamp;
                     uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
-                    frac_seconds += (i+1)*1e12/vrt_context.sample_rate;
+                    frac_seconds += (i+1)*1e12/fft_rate;
                     if (frac_seconds > 1e12) {
                         frac_seconds -= 1e12;
                         seconds++;
                     }
 
-                    double peak_hz = vrt_context.rf_freq + (double)max_i/(double)fft_len - vrt_context.sample_rate/2;
-                    printf("%lu.%09li, %.2f, %.3f\n", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3), peak_hz, 20*log10(max/(double)num_points));
-                    fflush(stdout);
+                    stage_begin = vrt_metrics_stage_begin();
+                    double* traces = binary ? vrt_spectral_file_traces(outfile) : NULL;
+                    if (not binary)
+                        printf("%lu.%09li", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3));
+                    for (uint32_t p = 0; p < num_peaks; p++) {
+                        // tracks without their peak in this FFT are NaN
+                        double peak_hz = NAN, power = NAN;
+                        const vrt_peak_track* track = num_peaks > 1 ? &tracker.tracks[p] : NULL;
+                        if (track == NULL or track->present) {
+                            double bin = track ? track->bin : peaks[0].bin;
+                            double magnitude = track ? track->magnitude : peaks[0].magnitude;
+                            peak_hz = vrt_context.rf_freq + zoom_offset + bin*fft_rate/num_points - fft_rate/2;
+                            power = 20*log10(magnitude/(double)num_points);
+                        }
+                        if (binary) {
+                            traces[2*p] = peak_hz;
+                            traces[2*p + 1] = power;
+                        } else {
+                            printf(", %.2f, %.3f", peak_hz, power);
+                        }
+                    }
+                    if (binary) {
+                        if (not vrt_spectral_file_write(outfile, seconds, frac_seconds))
+                            printf("Failed to write %s.\n", file.c_str());
+                    } else {
+                        printf("\n");
+                        fflush(stdout);
+                    }
+                    vrt_metrics_stage_end(VRT_STAGE_OUTPUT, stage_begin);
+                    vrt_metrics_latency(seconds, frac_seconds);
                 }
             }
 
@@ -292,7 +446,14 @@ int main(int argc, char* argv[])
                           << std::endl;
                 first_frame = false;
                 // Header
-                printf("timestamp, frequency, power\n");
+                if (not binary and num_peaks == 1) {
+                    printf("timestamp, frequency, power\n");
+                } else if (not binary) {
+                    printf("timestamp");
+                    for (uint32_t p = 1; p <= num_peaks; p++)
+                        printf(", frequency_%u, power_%u", p, p);
+                    printf("\n");
+                }
             }
         }
 
@@ -331,6 +492,13 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (outfile)
+        vrt_spectral_file_close(outfile);
+    vrt_fft_destroy(fft);
+    if (zoom)
+        vrt_zoom_destroy(zoom);
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
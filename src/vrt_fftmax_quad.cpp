@@ -11,12 +11,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <algorithm>
 #include <chrono>
 // #include <complex>
 #include <csignal>
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -33,6 +35,11 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
+#include "vrt-peak.h"
 
 namespace po = boost::program_options;
 
@@ -66,14 +73,22 @@ int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_complex *signal, *result;
-    fftw_plan plan;
+    vrt_fft* fft = NULL;
     uint32_t num_points = 0;
 
     int32_t min_bin, max_bin;
 
+    // peaks
+    uint32_t num_peaks, track_hold;
+    double track_jump;
+    std::string interp_name;
+    std::vector<double> magnitudes;
+    std::vector<uint32_t> peak_bins;
+    std::vector<vrt_peak> peaks;
+    vrt_peak_tracker tracker;
+
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, metrics_target, precision_name, effort_name;
     uint16_t port;
     uint32_t channel;
     int hwm;
@@ -97,10 +112,19 @@ int main(int argc, char* argv[])
         ("int-second", "align start of reception to integer second")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         // ("ignore-dc", "Ignore 10 perc. of bins around DC")
+        ("interpolation", po::value<std::string>(&interp_name)->default_value("none"), "sub-bin peak interpolation: none, quadratic, gaussian or jacobsen")
+        ("peaks", po::value<uint32_t>(&num_peaks)->default_value(1), "number of peaks to track")
+        ("track-jump", po::value<double>(&track_jump)->default_value(10), "max. frequency change of a tracked peak between FFTs (Hz)")
+        ("track-hold", po::value<uint32_t>(&track_hold)->default_value(3), "FFTs a tracked peak can be missing before its track is dropped")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("port", po::value<uint16_t>(&port)->default_value(50100), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -117,6 +141,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -125,8 +152,29 @@ int main(int argc, char* argv[])
     bool squared                = (bool)vm.count("squared");
     // bool ignore_dc              = (bool)vm.count("ignore-dc");
 
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+    vrt_peak_interp interp;
+    if (not vrt_parse_peak_interp(interp_name, &interp))
+        return 1;
+    if (num_peaks == 0) {
+        printf("Track at least one peak.\n");
+        return 1;
+    }
+
     context_type vrt_context;
     init_context(&vrt_context);
+    // cf32 payloads are converted without rounding to ci16
+    vrt_context.accept_formats |= 1 << VRT_FORMAT_CF32;
 
     packet_type vrt_packet;
 
@@ -141,6 +189,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -163,11 +213,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -192,14 +242,15 @@ int main(int argc, char* argv[])
                 max_bin = max_bin > num_points ? num_points : max_bin;
             }
 
-            signal = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_points);
-            result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_points);
-            plan = fftw_plan_dft_1d(num_points, signal, result, FFTW_FORWARD, FFTW_ESTIMATE);
+            fft = vrt_fft_create(num_points, precision);
+            magnitudes.resize(num_points);
+            // one second FFT: bins of 1 Hz
+            vrt_peak_tracker_init(&tracker, num_peaks, track_jump, track_hold);
         }
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
@@ -216,16 +267,13 @@ int main(int argc, char* argv[])
                 }
             }
 
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
+            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; ) {
 
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                signal[signal_pointer][REAL] = (float)re;
-                signal[signal_pointer][IMAG] = (float)img;
+                uint32_t n = std::min(vrt_packet.num_rx_samps - i, num_points - signal_pointer);
+                vrt_fft_load(fft, signal_pointer, &buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format), vrt_packet.sample_format, n);
 
-                signal_pointer++;
+                signal_pointer += n;
+                i += n;
 
                 if (signal_pointer >= num_points) {
 
@@ -235,49 +283,62 @@ int main(int argc, char* argv[])
                     // double square signal
                     for (uint32_t i = 0; i < num_points; i++) {
 
-                        double real = signal[i][REAL];
-                        double imag = signal[i][IMAG];
-
-                        double real2 = real * real - imag * imag;
-                        double imag2 = 2 * real * imag;
+                        std::complex<double> x = vrt_fft_input(fft, i);
+                        std::complex<double> x2 = x * x;
 
                         if (!squared) {
-                            signal[i][REAL] = mult * (real2 * real2 - imag2 * imag2);
-                            signal[i][IMAG] = mult * 2 * real2 * imag2;
+                            vrt_fft_set_input(fft, i, (double)mult * x2 * x2);
                         } else {
-                            signal[i][REAL] = mult * real2;
-                            signal[i][IMAG] = mult * imag2;
+                            vrt_fft_set_input(fft, i, (double)mult * x2);
                         }
 
                         mult *= -1;
                     }
 
-                    fftw_execute(plan);
+                    vrt_fft_execute(fft);
 
-                    double max = 0;
-                    int32_t max_i = -1;
+                    for (uint32_t i = 0; i < num_points; i++)
+                        magnitudes[i] = sqrt(vrt_fft_power(fft, i));
 
-                    for (uint32_t i = 0; i < num_points; i++) {
-                        double mag = sqrt(result[i][REAL] * result[i][REAL] +
-                                  result[i][IMAG] * result[i][IMAG]);
-                        // ignore 10% of bins around DC (exp.)
-                        // if ( (mag > max) and (not ignore_dc or (abs((int32_t)i-(int32_t)num_points/2) ) > num_points/10)  ) {
-                        if ( (mag > max) and (i >= min_bin) and (i <= max_bin)) {
-                            max = mag;
-                            max_i = i;
+                    // strongest peaks, refined between the bins
+                    vrt_peak_find(magnitudes.data(), num_points, min_bin, max_bin, num_peaks, &peak_bins);
+                    peaks.clear();
+                    for (uint32_t bin : peak_bins) {
+                        vrt_peak peak = {(double)bin, magnitudes[bin]};
+                        if (bin > 0 and bin + 1 < num_points) {
+                            std::complex<double> X[3] = {vrt_fft_output(fft, bin - 1), vrt_fft_output(fft, bin), vrt_fft_output(fft, bin + 1)};
+                            peak.bin += vrt_peak_interpolate(interp, X, &peak.magnitude);
                         }
+                        peaks.push_back(peak);
+                    }
+                    if (num_peaks > 1) {
+                        vrt_peak_tracker_update(&tracker, peaks);
+                    } else if (peaks.empty()) {
+                        continue;
                     }
 
                     uint64_t seconds = vrt_packet.integer_seconds_timestamp;
                     uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
-                    frac_seconds += (i+1)*1e12/vrt_context.sample_rate;
+                    frac_seconds += i*1e12/vrt_context.sample_rate;
                     if (frac_seconds > 1e12) {
                         frac_seconds -= 1e12;
                         seconds++;
                     }
 
-                    int64_t peak_hz = vrt_context.rf_freq + max_i - vrt_context.sample_rate/2;
-                    printf("%lu.%09li, %li, %.3f\n", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3), static_cast<long>(peak_hz), 20*log10(max/(double)num_points));
+                    printf("%lu.%09li", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3));
+                    for (uint32_t p = 0; p < num_peaks; p++) {
+                        // tracks without their peak in this FFT are NaN
+                        const vrt_peak_track* track = num_peaks > 1 ? &tracker.tracks[p] : NULL;
+                        if (track and not track->present) {
+                            printf(", nan, nan");
+                            continue;
+                        }
+                        double bin = track ? track->bin : peaks[0].bin;
+                        double magnitude = track ? track->magnitude : peaks[0].magnitude;
+                        double peak_hz = vrt_context.rf_freq + bin - vrt_context.sample_rate/2.0;
+                        printf(", %.2f, %.3f", peak_hz, 20*log10(magnitude/(double)num_points));
+                    }
+                    printf("\n");
                     fflush(stdout);
                 }
 
@@ -295,7 +356,14 @@ int main(int argc, char* argv[])
                           << std::endl;
                 first_frame = false;
                 // Header
-                printf("timestamp, frequency, power\n");
+                if (num_peaks == 1) {
+                    printf("timestamp, frequency, power\n");
+                } else {
+                    printf("timestamp");
+                    for (uint32_t p = 1; p <= num_peaks; p++)
+                        printf(", frequency_%u, power_%u", p, p);
+                    printf("\n");
+                }
             }
         }
 
@@ -320,7 +388,7 @@ int main(int argc, char* argv[])
                 //     datatype_max = 128.;
 
                 for (int i=0; i<vrt_packet.num_rx_samps; i++ ) {
-                    auto sample_i = get_abs_val((std::complex<int16_t>)buffer[vrt_packet.offset+i]);
+                    auto sample_i = get_abs_val((std::complex<int16_t>)vrt_payload_sample(&buffer[vrt_packet.offset], vrt_packet.sample_format, i));
                     sum_i += sample_i;
                     if (sample_i > datatype_max*0.99)
                         clip_i++;
@@ -336,6 +404,9 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_fft_destroy(fft);
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
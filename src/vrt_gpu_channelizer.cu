@@ -36,6 +36,7 @@
 #include <cufft.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
 #include "tracker-extended-context.h"
 
 struct complex_i16 {
@@ -130,7 +131,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, metrics_target;
     uint16_t pub_instance, instance, main_port, port, pub_port;
     uint32_t channel;
     int hwm, io_threads;
@@ -186,6 +187,7 @@ int main(int argc, char* argv[])
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("io-threads", po::value<int>(&io_threads)->default_value(1), "ZMQ IO threads")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
     ;
     // clang-format on
     po::variables_map vm;
@@ -201,6 +203,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -320,7 +325,7 @@ int main(int argc, char* argv[])
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(rx_buffer, sizeof(rx_buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(rx_buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -35,6 +35,7 @@
 #include <cufft.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
 
 namespace po = boost::program_options;
 
@@ -84,7 +85,7 @@ int main(int argc, char* argv[])
     int32_t min_bin, max_bin;
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, metrics_target;
     uint16_t instance, main_port, port;
     uint32_t channel;
     int hwm;
@@ -116,6 +117,7 @@ int main(int argc, char* argv[])
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
     ;
     // clang-format on
     po::variables_map vm;
@@ -132,6 +134,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -196,7 +201,7 @@ int main(int argc, char* argv[])
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -252,16 +257,16 @@ int main(int argc, char* argv[])
                 }
             }
 
-            int mult = 1;
             for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
                 
+                // fftshift sign of the position in the FFT block
+                int mult = (signal_pointer & 1) ? -1 : 1;
                 int16_t re;
                 memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
                 int16_t img;
                 memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
                 signal[signal_pointer].x = mult*re;
                 signal[signal_pointer].y = mult*img;
-                mult *= -1;
 
                 signal_pointer++;
 
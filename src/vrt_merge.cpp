@@ -33,6 +33,7 @@
 #include <complex>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
 #include "dt-extended-context.h"
 #include "tracker-extended-context.h"
 
@@ -63,7 +64,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address1, zmq_address2;
+    std::string file, type, zmq_address1, zmq_address2, metrics_target;
     uint16_t pub_instance, instance1, main_port1, port1, instance2, main_port2, port2, pub_port;
     uint32_t channel1, channel2;
     int hwm;
@@ -95,6 +96,7 @@ int main(int argc, char* argv[])
         ("pub-port", po::value<uint16_t>(&pub_port), "VRT ZMQ PUB port")
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
     ;
     // clang-format on
     po::variables_map vm;
@@ -110,6 +112,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -121,6 +126,9 @@ int main(int argc, char* argv[])
     context_type vrt_context2;
     init_context(&vrt_context1);
     init_context(&vrt_context2);
+    // packets are forwarded as they are
+    vrt_context1.accept_formats = ~0u;
+    vrt_context2.accept_formats = ~0u;
 
     packet_type vrt_packet1;
     packet_type vrt_packet2;
@@ -242,7 +250,7 @@ int main(int argc, char* argv[])
         }
 
         if (len1 > 0) {
-            if (not vrt_process(rx_buffer[0], sizeof(rx_buffer[0]), &vrt_context1, &vrt_packet1)) {
+            if (not vrt_process(rx_buffer[0], ZMQ_BUFFER_SIZE, &vrt_context1, &vrt_packet1)) {
                 printf("Not a Vita49 packet?\n");
                 continue;
             }
@@ -273,13 +281,13 @@ int main(int argc, char* argv[])
                     &last_update1,
                     &last_update_samps1,
                     &rx_buffer[0][vrt_packet1.offset],
-                    vrt_packet1.num_rx_samps, 0
+                    vrt_packet1.num_rx_samps, 0, vrt_packet1.sample_format
                 );
 
         }
 
         if (len2 > 0) {
-            if (not vrt_process(rx_buffer[1], sizeof(rx_buffer[1]), &vrt_context2, &vrt_packet2)) {
+            if (not vrt_process(rx_buffer[1], ZMQ_BUFFER_SIZE, &vrt_context2, &vrt_packet2)) {
                 printf("Not a Vita49 packet?\n");
                 continue;
             }
@@ -310,7 +318,7 @@ int main(int argc, char* argv[])
                     &last_update2,
                     &last_update_samps2,
                     &rx_buffer[1][vrt_packet2.offset],
-                    vrt_packet2.num_rx_samps, 1
+                    vrt_packet2.num_rx_samps, 1, vrt_packet2.sample_format
                 );
         }
 
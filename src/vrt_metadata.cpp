@@ -29,6 +29,9 @@
 #include <vrt/vrt_util.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-spectral-file.h"
 #include "dt-extended-context.h"
 
 namespace po = boost::program_options;
@@ -54,27 +57,10 @@ inline float get_abs_val(std::complex<int8_t> t)
     return std::fabs(t.real());
 }
 
-float haversine(float dec1, float dec2, float ra1, float ra2) {
-
-    float dec_delta = dec2 - dec1;
-    float ra_delta = ra2 - ra1;
-
-    float a =
-      pow(sin(dec_delta / 2), 2) + cos(dec1) * cos(dec2) * pow(sin(ra_delta / 2), 2);
-    float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-    return(c);
-}
-
-float bearing(float dec1, float dec2, float ra1, float ra2) {
-
-    float b = atan2(cos(dec1)*sin(dec2)-sin(dec1)*cos(dec2)*cos(ra2-ra1), sin(ra2-ra1)*cos(dec2));
-    return b;
-}
-
 int main(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string zmq_address;
+    std::string zmq_address, shm_name, metrics_target, file;
     size_t num_requested_samples;
     float update_time;
     double total_time;
@@ -102,6 +88,7 @@ int main(int argc, char* argv[])
         ("update-time", po::value<float>(&update_time)->default_value(1.0), "update time (seconds)")
         // ("ecsv", "output in ECSV format (Astropy)")
         ("temperature", "output temperature")
+        ("bin-file", po::value<std::string>(&file), "output binary data to file")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
         ("dt-trace", "use DT trace data in VRT stream")
@@ -110,6 +97,8 @@ int main(int argc, char* argv[])
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -126,6 +115,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -135,6 +127,9 @@ int main(int argc, char* argv[])
     bool dt_trace               = vm.count("dt-trace") > 0;
     bool log_temp               = vm.count("temperature") > 0;
     bool zmq_split              = vm.count("zmq-split") > 0;
+    bool binary                 = vm.count("bin-file") > 0;
+
+    vrt_spectral_file* outfile = NULL;
 
     context_type vrt_context;
     dt_ext_context_type dt_ext_context;
@@ -165,6 +160,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     bool first_frame = true;
 
     // time keeping
@@ -189,11 +186,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -259,6 +256,29 @@ int main(int argc, char* argv[])
             }
             printf("# schema: astropy-2.0\n");
 
+            if (binary) {
+                vrt_spectral_layout layout;
+                layout.kind = "metadata";
+                layout.sample_rate = vrt_context.sample_rate;
+                layout.center_freq = vrt_context.rf_freq;
+                layout.traces.push_back({"context_timestamp", ""});
+                layout.traces.push_back({"center_freq_hz", "Hz"});
+                layout.traces.push_back({"sample_rate", ""});
+                layout.traces.push_back({"rx_gain", "dB"});
+                if (log_temp)
+                    layout.traces.push_back({"temperature_deg_c", ""});
+                if (dt_trace) {
+                    layout.traces.push_back({"ext_context_timestamp", ""});
+                    for (uint32_t t = 0; t < DT_TRACE_COLUMNS; t++)
+                        layout.traces.push_back({dt_trace_names[t], dt_trace_units[t]});
+                }
+                layout.meta.push_back({"stream_id", std::to_string(vrt_context.stream_id)});
+                layout.meta.push_back({"update_time", std::to_string(update_time)});
+                outfile = vrt_spectral_file_create(file, layout);
+                if (outfile == NULL)
+                    break;
+            }
+
             // Header
             printf("data_timestamp, context_timestamp, center_freq_hz, sample_rate, rx_gain");
             if (log_temp)
@@ -305,37 +325,42 @@ int main(int argc, char* argv[])
                 uint64_t data_seconds = vrt_packet.integer_seconds_timestamp;
                 uint64_t data_frac_seconds = vrt_packet.fractional_seconds_timestamp;
 
-                printf("%lu.%09li", static_cast<unsigned long>(data_seconds), static_cast<long>(data_frac_seconds/1e3));
-                printf(", %lu.%09li", static_cast<unsigned long>(vrt_context.integer_seconds_timestamp), static_cast<long>(vrt_context.fractional_seconds_timestamp/1e3));
-                printf(", %li", static_cast<long>(vrt_context.rf_freq));
-                printf(", %li", static_cast<long>(vrt_context.sample_rate));
-                printf(", %li", static_cast<long>(vrt_context.gain));
-
-                if (log_temp)
-                    printf(", %.2f", vrt_context.temperature);
-                if (dt_trace) {
-                    printf(", %lu.%09li", static_cast<unsigned long>(dt_ext_context.integer_seconds_timestamp), static_cast<long>(dt_ext_context.fractional_seconds_timestamp/1e3));
-                    printf(", %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f",
-                        ((180.0/M_PI)*dt_ext_context.azimuth),
-                        ((180.0/M_PI)*dt_ext_context.elevation),
-                        ((180.0/M_PI)*dt_ext_context.azimuth_error),
-                        ((180.0/M_PI)*dt_ext_context.elevation_error),
-                        ((180.0/M_PI)*dt_ext_context.azimuth_speed),
-                        ((180.0/M_PI)*dt_ext_context.elevation_speed),
-                        ((180.0/M_PI)*dt_ext_context.azimuth_offset),
-                        ((180.0/M_PI)*dt_ext_context.elevation_offset),
-                        ((12.0/M_PI)*dt_ext_context.ra_current),
-                        ((180.0/M_PI)*dt_ext_context.dec_current),
-                        ((12.0/M_PI)*dt_ext_context.ra_setpoint),
-                        ((180.0/M_PI)*dt_ext_context.dec_setpoint),
-                        ((180.0/M_PI)*haversine(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current)),
-                        ((180.0/M_PI)*bearing(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current)),
-                        dt_ext_context.focusbox);
+                if (binary) {
+                    double* traces = vrt_spectral_file_traces(outfile);
+                    uint32_t num_traces = 0;
+                    traces[num_traces++] = (double)vrt_context.integer_seconds_timestamp + (double)vrt_context.fractional_seconds_timestamp/1e12;
+                    traces[num_traces++] = vrt_context.rf_freq;
+                    traces[num_traces++] = vrt_context.sample_rate;
+                    traces[num_traces++] = vrt_context.gain;
+                    if (log_temp)
+                        traces[num_traces++] = vrt_context.temperature;
+                    if (dt_trace) {
+                        traces[num_traces++] = (double)dt_ext_context.integer_seconds_timestamp + (double)dt_ext_context.fractional_seconds_timestamp/1e12;
+                        dt_trace_values(&dt_ext_context, &traces[num_traces]);
+                    }
+                    if (not vrt_spectral_file_write(outfile, data_seconds, data_frac_seconds))
+                        printf("Failed to write %s.\n", file.c_str());
+                } else {
+                    printf("%lu.%09li", static_cast<unsigned long>(data_seconds), static_cast<long>(data_frac_seconds/1e3));
+                    printf(", %lu.%09li", static_cast<unsigned long>(vrt_context.integer_seconds_timestamp), static_cast<long>(vrt_context.fractional_seconds_timestamp/1e3));
+                    printf(", %li", static_cast<long>(vrt_context.rf_freq));
+                    printf(", %li", static_cast<long>(vrt_context.sample_rate));
+                    printf(", %li", static_cast<long>(vrt_context.gain));
+
+                    if (log_temp)
+                        printf(", %.2f", vrt_context.temperature);
+                    if (dt_trace) {
+                        printf(", %lu.%09li", static_cast<unsigned long>(dt_ext_context.integer_seconds_timestamp), static_cast<long>(dt_ext_context.fractional_seconds_timestamp/1e3));
+                        double trace_values[DT_TRACE_COLUMNS];
+                        dt_trace_values(&dt_ext_context, trace_values);
+                        for (uint32_t t = 0; t < DT_TRACE_COLUMNS; t++)
+                            printf(", %.3f", trace_values[t]);
+                    }
+
+                    printf("\n");
+                    fflush(stdout);
                 }
 
-                printf("\n");
-                fflush(stdout);
-
                 samples_last_update = num_total_samps;
             }
 
@@ -376,6 +401,11 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (outfile)
+        vrt_spectral_file_close(outfile);
+
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
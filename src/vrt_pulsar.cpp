@@ -36,6 +36,11 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-receiver.h"
+#include "vrt-demux.h"
+#include "vrt-fft.h"
 
 #ifdef __APPLE__
 #define DEFAULT_GNUPLOT_TERMINAL "qt"
@@ -99,8 +104,7 @@ int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_complex **signal, *result;
-    fftw_plan plan[2];
+    vrt_fft* fft[2] = {NULL, NULL};
 
     float **mean_freq;
     float **mean_time;
@@ -124,7 +128,7 @@ int main(int argc, char* argv[])
     float t_threshold;
 
     // variables to be set by po
-    std::string file, type, zmq_address, channel_list, gnuplot_terminal, start_reception;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, channel_list, gnuplot_terminal, start_reception, metrics_target, precision_name, effort_name;
     size_t num_requested_samples;
     uint32_t bins;
     int gain;
@@ -132,6 +136,7 @@ int main(int argc, char* argv[])
     uint16_t instance, main_port, port, pub_port;
     uint32_t channel;
     int hwm;
+    uint32_t queue_slots, max_latency;
     float dm, period, agg_time;
     uint64_t seqno[] = {0, 0};
     float mean_block[] = {0, 0};
@@ -160,6 +165,8 @@ int main(int argc, char* argv[])
         ("period", po::value<float>(&period)->default_value(0.7145197), "PSR Period")
         ("agg-time", po::value<float>(&agg_time)->default_value(1), "Aggregation time in milliseconds")
         ("amplitude", po::value<float>(&amplitude)->default_value(1), "amplitude correction of second channel")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
         ("term", po::value<std::string>(&gnuplot_terminal)->default_value(DEFAULT_GNUPLOT_TERMINAL), "Gnuplot terminal (x11 or qt)")
         ("zmq-pub", "enable zmq pub")
         ("no-stdout", "disable stdout")
@@ -172,11 +179,16 @@ int main(int argc, char* argv[])
         ("gnuplot", "enable gnuplot mode")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("zmq-split", "create a ZeroMQ stream per VRT channel, increasing port number for additional streams")
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("queue-slots", po::value<uint32_t>(&queue_slots)->default_value(VRT_RECEIVER_SLOTS), "packets buffered by the receive thread")
+        ("max-latency", po::value<uint32_t>(&max_latency)->default_value(0), "drop packets that waited longer in the receive queue (ms), 0 keeps all")
 
     ;
     // clang-format on
@@ -194,6 +206,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -209,6 +224,18 @@ int main(int argc, char* argv[])
     bool no_stdout              = vm.count("no-stdout") > 0;
     bool zmq_pub                = vm.count("zmq-pub") > 0;
 
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+
     bool has_waited_for_start_time = false;
 
     boost::posix_time::ptime utc_time;
@@ -240,9 +267,7 @@ int main(int argc, char* argv[])
         }
     }
 
-    context_type vrt_context;
-    init_context(&vrt_context);
-
+    vrt_demux demux;
     packet_type vrt_packet;
 
     if (vm.count("port") > 0) {
@@ -251,8 +276,6 @@ int main(int argc, char* argv[])
         main_port = DEFAULT_MAIN_PORT + MAX_CHANNELS*instance;
     }
 
-    vrt_packet.channel_filt = 0;
-
      // detect which channels to use
     std::vector<std::string> channel_strings;
     std::vector<size_t> channel_nums;
@@ -260,7 +283,6 @@ int main(int argc, char* argv[])
     for (size_t ch = 0; ch < channel_strings.size(); ch++) {
         size_t chan = std::stoi(channel_strings[ch]);
         channel_nums.push_back(std::stoi(channel_strings[ch]));
-        vrt_packet.channel_filt |= 1<<std::stoi(channel_strings[ch]);
     }
 
     if (channel_nums.size() > 2) {
@@ -275,9 +297,11 @@ int main(int argc, char* argv[])
         }
         main_port += channel_nums[0];
         channel_nums[0] = 0;
-        vrt_packet.channel_filt = 1;
     }
 
+    if (not vrt_demux_init(&demux, channel_nums))
+        return EXIT_FAILURE;
+
     // FILE *write_ptr;
     // write_ptr = fopen("dedisp.fc32","wb");  // w for write, b for binary
 
@@ -292,6 +316,11 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+    vrt_receiver* receiver = vrt_receiver_start(subscriber, shm, queue_slots, max_latency);
+    if (receiver == NULL)
+        return 1;
+
     if (zmq_pub) {
         zmq_server = zmq_socket(context, ZMQ_PUB);
         rc = zmq_setsockopt(zmq_server, ZMQ_SNDHWM, &hwm, sizeof hwm);
@@ -328,11 +357,14 @@ int main(int argc, char* argv[])
     while (not stop_signal_called
            and (num_requested_samples > num_total_samps or num_requested_samples == 0) ) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_receiver_recv(receiver, buffer, ZMQ_BUFFER_SIZE);
+        if (len < 0)
+            continue;
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        vrt_stream_state* stream;
+        if (not vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -340,12 +372,9 @@ int main(int argc, char* argv[])
         if (not vrt_packet.context and not vrt_packet.data)
             continue;
 
-        uint32_t ch = 0;
-        for(ch = 0; ch<channel_nums.size(); ch++)
-            if (vrt_packet.stream_id & (1 << channel_nums[ch]) )
-                break;
-
-        uint32_t channel = channel_nums[ch];
+        uint32_t ch = vrt_demux_index(&demux, stream);
+        uint32_t channel = stream->channel;
+        context_type& vrt_context = stream->context;
 
         if (not start_rx and vrt_packet.context) {
             vrt_print_context(&vrt_context);
@@ -358,15 +387,8 @@ int main(int argc, char* argv[])
 
             time_integrations = agg_time*(vrt_context.sample_rate/num_bins)/1000;
 
-            signal = (fftw_complex **)malloc(sizeof(fftw_complex*)*channel_nums.size());
-
-            for (size_t ch=0; ch < channel_nums.size(); ch++)
-                signal[ch] = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-
-            result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-
             for (size_t ch=0; ch < channel_nums.size(); ch++)
-                plan[ch] = fftw_plan_dft_1d(num_bins, signal[ch], result, FFTW_FORWARD, FFTW_ESTIMATE);
+                fft[ch] = vrt_fft_create(num_bins, precision);
 
             data_block = (float ***)malloc(sizeof(float *)*channel_nums.size());
 
@@ -453,7 +475,7 @@ int main(int argc, char* argv[])
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
@@ -493,29 +515,26 @@ int main(int argc, char* argv[])
                 first_block = false;
             }
 
-            int mult = 1;
             for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
 
+                // fftshift sign of the position in the FFT block
+                int mult = (signal_pointer[ch] & 1) ? -1 : 1;
                 int16_t re;
                 memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
                 int16_t img;
                 memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
                 if (ch==1) {
-                    signal[ch][signal_pointer[ch]][REAL] = amplitude*mult*re;
-                    signal[ch][signal_pointer[ch]][IMAG] = amplitude*mult*img;
+                    vrt_fft_set_input(fft[ch], signal_pointer[ch], std::complex<double>(amplitude*mult*re, amplitude*mult*img));
                 } else {
-                    signal[ch][signal_pointer[ch]][REAL] = mult*re;
-                    signal[ch][signal_pointer[ch]][IMAG] = mult*img;
+                    vrt_fft_set_input(fft[ch], signal_pointer[ch], std::complex<double>(mult*re, mult*img));
                 }
-                mult *= -1; // fftshift
-
                 signal_pointer[ch]++;
 
                 if (signal_pointer[ch] >= num_bins) {
 
                     signal_pointer[ch] = 0;
 
-                    fftw_execute(plan[ch]);
+                    vrt_fft_execute(fft[ch]);
 
                     uint64_t seconds = vrt_packet.integer_seconds_timestamp;
                     uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
@@ -527,8 +546,7 @@ int main(int argc, char* argv[])
 
                     float sum_channels = 0;
                     for (uint32_t i = 0; i < num_bins; ++i) {
-                        float mag = sqrt(result[i][REAL] * result[i][REAL] +
-                                            result[i][IMAG] * result[i][IMAG]);
+                        float mag = sqrt(vrt_fft_power(fft[ch], i));
                         data_block[ch][i][block_size+block_counter[ch]] = mag;
                         mean_freq[ch][i] += mag/(float)block_size;
                         sum_channels += mag;
@@ -749,6 +767,11 @@ int main(int argc, char* argv[])
         }
     }
 
+    for (size_t ch=0; ch < 2; ch++)
+        vrt_fft_destroy(fft[ch]);
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     if (zmq_pub)
         zmq_close(zmq_server);
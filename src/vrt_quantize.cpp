@@ -17,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -33,6 +34,8 @@
 #include <complex>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
 #include "dt-extended-context.h"
 #include "tracker-extended-context.h"
 
@@ -63,7 +66,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, metrics_target;
     uint16_t pub_instance, instance, main_port, port, pub_port;
     uint32_t channel;
     int hwm;
@@ -92,6 +95,8 @@ int main(int argc, char* argv[])
         ("pub-port", po::value<uint16_t>(&pub_port), "VRT ZMQ PUB port")
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -107,6 +112,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -151,6 +159,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     void *responder = zmq_socket(context, ZMQ_PUB);
     rc = zmq_setsockopt (responder, ZMQ_SNDHWM, &hwm, sizeof hwm);
     assert(rc == 0);
@@ -163,7 +173,8 @@ int main(int argc, char* argv[])
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
 
     uint32_t buffer[ZMQ_BUFFER_SIZE];
-    uint32_t data_buffer[VRT_SAMPLES_PER_PACKET];
+    // sized from the received packets
+    std::vector<uint32_t> data_buffer;
 
     uint64_t num_total_samps = 0;
 
@@ -195,9 +206,9 @@ int main(int argc, char* argv[])
 
         const auto now = std::chrono::steady_clock::now();
 
-        len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -247,10 +258,10 @@ int main(int argc, char* argv[])
             );
 
         if (start_rx and vrt_packet.data) {
- 
-            if (!unpack) {
 
-                memset(data_buffer, 0, VRT_SAMPLES_PER_PACKET * sizeof(uint32_t));
+            data_buffer.assign(vrt_packet.num_rx_samps, 0);
+
+            if (!unpack) {
 
                 size_t word_idx;           // Which uint32_t
                 size_t bit_idx;            // Which bit in that uint32_t
@@ -282,13 +293,11 @@ int main(int argc, char* argv[])
                 }
 
                 size_t new_data_len_words = vrt_packet.num_rx_samps / 16;
-                memcpy((char*)&buffer[vrt_packet.offset], (char*)data_buffer, new_data_len_words * sizeof(uint32_t));
+                memcpy((char*)&buffer[vrt_packet.offset], (char*)data_buffer.data(), new_data_len_words * sizeof(uint32_t));
                 len = (vrt_packet.offset + new_data_len_words)*4;
 
             } else {
 
-                memset(data_buffer, 0, VRT_SAMPLES_PER_PACKET * sizeof(uint32_t));
-
                 size_t word_idx; // Which uint32_t
                 size_t bit_idx;  // Which bit in that uint32_t
 
@@ -309,7 +318,7 @@ int main(int argc, char* argv[])
                 }
 
                 size_t new_data_len_words = vrt_packet.num_rx_samps;
-                memcpy((char*)&buffer[vrt_packet.offset], (char*)data_buffer, new_data_len_words * sizeof(uint32_t));
+                memcpy((char*)&buffer[vrt_packet.offset], (char*)data_buffer.data(), new_data_len_words * sizeof(uint32_t));
                 len = (vrt_packet.offset + new_data_len_words)*4;
             }
 
@@ -322,6 +331,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_close(responder);
     zmq_ctx_destroy(context);
@@ -39,6 +39,9 @@
 #include <complex.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-fft.h"
 
 namespace po = boost::program_options;
 
@@ -110,7 +113,7 @@ int main(int argc, char* argv[])
   int sign=1,fac=1;
 
   // variables to be set by po
-  std::string zmq_address, path, output;
+  std::string zmq_address, shm_name, path, output, metrics_target, effort_name;
   uint16_t port, instance, main_port;
   uint32_t channel;
   int hwm;
@@ -144,6 +147,9 @@ int main(int argc, char* argv[])
       ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
       ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
       ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+      ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+      ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+      ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
   ;
   // clang-format on
   po::variables_map vm;
@@ -160,6 +166,14 @@ int main(int argc, char* argv[])
       return ~0;
   }
 
+  if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+      return 1;
+
+  vrt_fft_effort effort;
+  if (not vrt_parse_fft_effort(effort_name, &effort))
+      return 1;
+  vrt_fft_set_effort(effort);
+
   bool progress               = vm.count("progress") > 0;
   bool continue_on_bad_packet = vm.count("continue") > 0;
   bool int_second             = vm.count("int-second") > 0;
@@ -190,6 +204,8 @@ int main(int argc, char* argv[])
   assert(rc == 0);
   zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+  vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
   // time keeping
   auto start_time = std::chrono::steady_clock::now();
   auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -216,11 +232,11 @@ int main(int argc, char* argv[])
          and (num_requested_samples > num_total_samps or num_requested_samples == 0)
          and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-      int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+      int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
       const auto now = std::chrono::steady_clock::now();
 
-      if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+      if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
           printf("Not a Vita49 packet?\n");
           continue;
       }
@@ -277,7 +293,7 @@ int main(int argc, char* argv[])
             zw[i]=0.54-0.46*cos(2.0*M_PI*i/(nchan-1));
 
           // Plan
-          fft=fftwf_plan_dft_1d(nchan,c,d,FFTW_FORWARD,FFTW_ESTIMATE);
+          fft=vrt_fft_plan(nchan,1,c,d,FFTW_FORWARD);
 
       }
 
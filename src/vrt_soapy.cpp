@@ -5,6 +5,8 @@
 
 #include <zmq.h>
 #include "vrt-tools.h"
+#include "vrt-convert.h"
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -53,6 +55,21 @@ void* create_zmq_subscriber(void* zmq_ctx, int port, const int hwm = 10000)
     return subscriber;
 };
 
+template<typename T>
+void convert_samples(const uint32_t *in, std::complex<T> *out, size_t n);
+
+template<>
+void convert_samples<float>(const uint32_t *in, std::complex<float> *out, size_t n)
+{
+    vrt_ci16_to_cf32(in, out, n);
+}
+
+template<>
+void convert_samples<int16_t>(const uint32_t *in, std::complex<int16_t> *out, size_t n)
+{
+    memcpy(out, in, n * sizeof(uint32_t));
+}
+
 template<typename T>
 void iterate_packet_buffer(
     VrtStream *stream,
@@ -62,21 +79,21 @@ void iterate_packet_buffer(
     unsigned long &cur_buff_idx,
     const size_t numElems)
 {
-    int16_t re;
-    int16_t img;
     auto *buff0 = static_cast<std::complex<T>*>(buffer[0]);
-    for (; stream->cur_packet_idx < packet.num_rx_samps; stream->cur_packet_idx++) {
-        memcpy(&re, (char*)&stream->zmq_buffer[packet.offset+stream->cur_packet_idx], sizeof(int16_t));
-        memcpy(&img, (char*)&stream->zmq_buffer[packet.offset+stream->cur_packet_idx]+sizeof(int16_t), sizeof(int16_t));
-        buff0[cur_buff_idx] = std::complex<T>(re, img);
-        cur_buff_idx++;
-
-        // reached max elements to return in this call
-        if (cur_buff_idx >= numElems) {
-            start_rx = false;
-            return;
-        }
+    if (stream->cur_packet_idx >= packet.num_rx_samps)
+        return;
+
+    size_t n = std::min<size_t>(packet.num_rx_samps - stream->cur_packet_idx, numElems - cur_buff_idx);
+    convert_samples<T>(&stream->zmq_buffer[packet.offset+stream->cur_packet_idx], &buff0[cur_buff_idx], n);
+    cur_buff_idx += n;
+
+    // reached max elements to return in this call, cur_packet_idx stays at the last sample copied
+    if (cur_buff_idx >= numElems) {
+        stream->cur_packet_idx += n - 1;
+        start_rx = false;
+        return;
     }
+    stream->cur_packet_idx += n;
 }
 
 class VrtDevice : public SoapySDR::Device {
@@ -241,7 +258,7 @@ class VrtDevice : public SoapySDR::Device {
 
             if (!vrt_process(
                 stream->zmq_buffer,
-                sizeof(stream->zmq_buffer),
+                ZMQ_BUFFER_SIZE,
                 &stream->vrt_context, &cur_packet)
             ) {
                 std::cerr << "VrtDevice received and invalid Vita49 packet" << std::endl;
@@ -386,7 +403,7 @@ SoapySDR::KwargsList findVrtDevice(const SoapySDR::Kwargs &args) {
                     if (len <= 0) {
                         continue;
                     }
-                    if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+                    if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
                         std::cerr << "Not a Vita49 packet?" << std::endl;
                         break;
                     }
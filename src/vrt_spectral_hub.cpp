@@ -0,0 +1,682 @@
+//
+// Copyright 2026 by Thomas Telkamp
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <zmq.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// VRT
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vrt/vrt_read.h>
+#include <vrt/vrt_string.h>
+#include <vrt/vrt_types.h>
+#include <vrt/vrt_util.h>
+
+#include <math.h>
+#include <fftw3.h>
+
+#include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-receiver.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
+#include "vrt-wola.h"
+#include "vrt-spectral-file.h"
+#include "vrt-filterbank.h"
+
+namespace po = boost::program_options;
+
+static bool stop_signal_called = false;
+void sig_int_handler(int)
+{
+    stop_signal_called = true;
+}
+
+enum sink_type {
+    SINK_ECSV = 0,      // spectrum as ECSV text (vrt_spectrum --ecsv)
+    SINK_BIN,           // binary spectral file (vrt_spectrum --bin-file)
+    SINK_FILTERBANK,    // sigproc filterbank (vrt_to_filterbank)
+    SINK_RFFFT,         // STRF .bin files (vrt_rffft)
+    SINK_FFTMAX         // peak frequency and power (vrt_fftmax)
+};
+
+/* One output of the hub: the FFT power of the hub is added up over time
+ * seconds (blocks FFTs), then written in the format of the sink */
+struct sink {
+    sink_type type;
+    std::string file = "-";
+    std::string path = ".";
+    std::string source = "not defined";
+    double time = 1.0;
+    bool db = false;
+    bool negative_foff = false;
+    bool has_min_offset = false, has_max_offset = false;
+    double min_offset = 0, max_offset = 0;
+    uint32_t nsub = 60;
+
+    uint32_t blocks = 0;
+    uint32_t counter = 0;
+    std::vector<double> power;
+    FILE* fp = NULL;
+    vrt_spectral_file* bin = NULL;
+    uint32_t file_index = 0;
+    uint32_t subints = 0;
+    char prefix[32] = "";
+    uint64_t start_seconds = 0, start_frac_seconds = 0;
+};
+
+/* Parse type:key=value,key=value. Keys: file, time (all), db (ecsv, bin),
+ * source and negative-foff (filterbank), path and nsub (rffft), min-offset and max-offset (fftmax) */
+static bool parse_sink(const std::string& spec, sink* s) {
+
+    std::string type = spec.substr(0, spec.find(':'));
+    if (type == "ecsv")
+        s->type = SINK_ECSV;
+    else if (type == "bin")
+        s->type = SINK_BIN;
+    else if (type == "filterbank")
+        s->type = SINK_FILTERBANK;
+    else if (type == "rffft")
+        s->type = SINK_RFFFT;
+    else if (type == "fftmax")
+        s->type = SINK_FFTMAX;
+    else {
+        printf("Unknown sink %s (ecsv, bin, filterbank, rffft or fftmax).\n", type.c_str());
+        return false;
+    }
+    if (s->type == SINK_FILTERBANK)
+        s->file = "vrt.fil";
+
+    if (spec.find(':') == std::string::npos)
+        return true;
+
+    std::vector<std::string> options;
+    boost::split(options, spec.substr(spec.find(':') + 1), boost::is_any_of(","), boost::token_compress_on);
+    for (const std::string& option : options) {
+        if (option.empty())
+            continue;
+        size_t eq = option.find('=');
+        std::string key = option.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : option.substr(eq + 1);
+        try {
+            if (key == "file")
+                s->file = value;
+            else if (key == "path")
+                s->path = value;
+            else if (key == "source")
+                s->source = value;
+            else if (key == "time")
+                s->time = std::stod(value);
+            else if (key == "db")
+                s->db = true;
+            else if (key == "negative-foff")
+                s->negative_foff = true;
+            else if (key == "nsub")
+                s->nsub = std::stoul(value);
+            else if (key == "min-offset") {
+                s->min_offset = std::stod(value);
+                s->has_min_offset = true;
+            } else if (key == "max-offset") {
+                s->max_offset = std::stod(value);
+                s->has_max_offset = true;
+            } else {
+                printf("Unknown sink option %s.\n", key.c_str());
+                return false;
+            }
+        } catch (...) {
+            printf("Invalid value of sink option %s.\n", key.c_str());
+            return false;
+        }
+    }
+    if (s->time <= 0 or s->nsub == 0) {
+        printf("Invalid sink time or nsub.\n");
+        return false;
+    }
+    if ((s->type == SINK_BIN or s->type == SINK_FILTERBANK) and s->file == "-") {
+        printf("The %s sink needs a file.\n", type.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void rffft_open(sink* s) {
+    char name[512];
+    snprintf(name, sizeof(name), "%s/%s_%06u.bin", s->path.c_str(), s->prefix, s->file_index);
+    s->fp = fopen(name, "w");
+    if (s->fp == NULL)
+        printf("Failed to create %s.\n", name);
+}
+
+// Create the output and write its header, at the first block
+static bool sink_start(sink* s, const context_type* vrt_context, uint32_t num_bins, uint64_t seconds, uint64_t frac_seconds) {
+
+    double sample_rate = vrt_context->sample_rate;
+    double bin_size = sample_rate/num_bins;
+    double integration_time = (double)s->blocks*num_bins/sample_rate;
+
+    s->start_seconds = seconds;
+    s->start_frac_seconds = frac_seconds;
+
+    switch (s->type) {
+        case SINK_ECSV:
+        case SINK_FFTMAX:
+            s->fp = s->file == "-" ? stdout : fopen(s->file.c_str(), "w");
+            if (s->fp == NULL) {
+                printf("Failed to create %s.\n", s->file.c_str());
+                return false;
+            }
+            if (s->type == SINK_FFTMAX) {
+                fprintf(s->fp, "timestamp, frequency, power\n");
+                break;
+            }
+            fprintf(s->fp, "# %%ECSV 1.0\n");
+            fprintf(s->fp, "# ---\n");
+            fprintf(s->fp, "# delimiter: \',\'\n");
+            fprintf(s->fp, "# meta: !!omap\n");
+            fprintf(s->fp, "# - vrt: !!omap\n");
+            fprintf(s->fp, "#   - {stream_id: %u}\n", vrt_context->stream_id);
+            fprintf(s->fp, "#   - {sample_rate: %.1f}\n", sample_rate);
+            fprintf(s->fp, "#   - {frequency: %.2f}\n", (double)vrt_context->rf_freq);
+            fprintf(s->fp, "#   - {rx_gain: %.1f}\n", (float)vrt_context->gain);
+            fprintf(s->fp, "# - spectrum: !!omap\n");
+            fprintf(s->fp, "#   - {db: %s}\n", s->db ? "True" : "False");
+            fprintf(s->fp, "#   - {bins: %u}\n", num_bins);
+            fprintf(s->fp, "#   - {col_first_bin: 1}\n");
+            fprintf(s->fp, "#   - {bin_size: %.2f}\n", bin_size);
+            fprintf(s->fp, "#   - {integrations: %u}\n", s->blocks);
+            fprintf(s->fp, "#   - {integration_time: %.2f}\n", integration_time);
+            fprintf(s->fp, "# datatype:\n");
+            fprintf(s->fp, "# - {name: timestamp, datatype: float64}\n");
+            for (uint32_t i = 0; i < num_bins; i++)
+                fprintf(s->fp, "# - {name: \'%.0f\', datatype: float64}\n", (double)vrt_context->rf_freq + i*bin_size - sample_rate/2);
+            fprintf(s->fp, "# schema: astropy-2.0\n");
+            fprintf(s->fp, "timestamp");
+            for (uint32_t i = 0; i < num_bins; i++)
+                fprintf(s->fp, ", %.0f", (double)vrt_context->rf_freq + i*bin_size - sample_rate/2);
+            fprintf(s->fp, "\n");
+            break;
+
+        case SINK_BIN: {
+            vrt_spectral_layout layout;
+            layout.kind = "spectrum";
+            layout.columns = num_bins;
+            layout.sample_rate = sample_rate;
+            layout.center_freq = vrt_context->rf_freq;
+            layout.first_freq = (double)vrt_context->rf_freq - sample_rate/2;
+            layout.column_step = bin_size;
+            layout.integrations = s->blocks;
+            layout.integration_time = integration_time;
+            layout.meta.push_back({"stream_id", std::to_string(vrt_context->stream_id)});
+            layout.meta.push_back({"db", s->db ? "True" : "False"});
+            s->bin = vrt_spectral_file_create(s->file, layout);
+            if (s->bin == NULL)
+                return false;
+            break;
+        }
+
+        case SINK_FILTERBANK: {
+            s->fp = fopen(s->file.c_str(), "wb");
+            if (s->fp == NULL) {
+                printf("Failed to create %s.\n", s->file.c_str());
+                return false;
+            }
+            vrt_filterbank_header header;
+            header.source_name = s->source;
+            vrt_filterbank_set_band(&header, vrt_context->rf_freq, sample_rate, num_bins, s->negative_foff);
+            header.tstart = vrt_filterbank_mjd(seconds, frac_seconds);
+            header.tsamp = integration_time;
+            vrt_filterbank_write_header(s->fp, &header);
+            break;
+        }
+
+        case SINK_RFFFT: {
+            time_t start = seconds;
+            strftime(s->prefix, sizeof(s->prefix), "%Y-%m-%dT%T", gmtime(&start));
+            rffft_open(s);
+            if (s->fp == NULL)
+                return false;
+            break;
+        }
+    }
+    return true;
+}
+
+/* Write one integration, power is the sum of blocks FFTs ending at
+ * seconds, frac_seconds */
+static void sink_output(sink* s, const context_type* vrt_context, uint32_t num_bins, uint64_t seconds, uint64_t frac_seconds) {
+
+    double sample_rate = vrt_context->sample_rate;
+    double bin_size = sample_rate/num_bins;
+
+    switch (s->type) {
+        case SINK_ECSV:
+        case SINK_BIN: {
+            float* values = s->bin ? vrt_spectral_file_values(s->bin) : NULL;
+            if (s->type == SINK_ECSV)
+                fprintf(s->fp, "%lu.%09li", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3));
+            for (uint32_t i = 0; i < num_bins; i++) {
+                double value = s->power[i]/((double)s->blocks*(double)num_bins*sample_rate);
+                if (s->db)
+                    value = 10*log10(value);
+                if (values)
+                    values[i] = value;
+                else
+                    fprintf(s->fp, ", %.7e", value);
+            }
+            if (values) {
+                if (not vrt_spectral_file_write(s->bin, seconds, frac_seconds))
+                    printf("Failed to write %s.\n", s->file.c_str());
+            } else {
+                fprintf(s->fp, "\n");
+                fflush(s->fp);
+            }
+            break;
+        }
+
+        case SINK_FILTERBANK: {
+            // mean power per FFT, as vrt_to_filterbank, the fch1 channel first
+            std::vector<float> row(num_bins);
+            for (uint32_t i = 0; i < num_bins; i++)
+                row[s->negative_foff ? num_bins-1-i : i] = s->power[i]/s->blocks;
+            fwrite(row.data(), num_bins*sizeof(float), 1, s->fp);
+            fflush(s->fp);
+            break;
+        }
+
+        case SINK_RFFFT: {
+            // summed power of samples scaled to 1, divided by the number of channels, as vrt_rffft
+            std::vector<float> z(num_bins);
+            for (uint32_t i = 0; i < num_bins; i++)
+                z[i] = s->power[i]/(32768.0*32768.0*num_bins);
+
+            time_t start = s->start_seconds;
+            char tbuf[30], nfd[40], header[256];
+            strftime(tbuf, sizeof(tbuf), "%Y-%m-%dT%T", gmtime(&start));
+            snprintf(nfd, sizeof(nfd), "%s.%03ld", tbuf, (long)(s->start_frac_seconds/1000000000));
+            double length = (double)(seconds - s->start_seconds) + ((double)frac_seconds - (double)s->start_frac_seconds)/1e12;
+
+            memset(header, 0, sizeof(header));
+            snprintf(header, sizeof(header), "HEADER\nUTC_START    %s\nFREQ         %lf Hz\nBW           %lf Hz\nLENGTH       %f s\nNCHAN        %d\nNSUB         %d\nEND\n",
+                nfd, (double)vrt_context->rf_freq, sample_rate, length, num_bins, s->nsub);
+            fwrite(header, sizeof(char), 256, s->fp);
+            fwrite(z.data(), sizeof(float), num_bins, s->fp);
+            fflush(s->fp);
+
+            s->subints++;
+            if (s->subints >= s->nsub) {
+                fclose(s->fp);
+                s->file_index++;
+                s->subints = 0;
+                rffft_open(s);
+            }
+            break;
+        }
+
+        case SINK_FFTMAX: {
+            uint32_t min_bin = 0, max_bin = num_bins - 1;
+            if (s->has_min_offset)
+                min_bin = std::min<double>(std::max<double>(s->min_offset/bin_size + num_bins/2, 0), num_bins - 1);
+            if (s->has_max_offset)
+                max_bin = std::min<double>(std::max<double>(s->max_offset/bin_size + num_bins/2, 0), num_bins - 1);
+            uint32_t max_i = min_bin;
+            for (uint32_t i = min_bin; i <= max_bin; i++)
+                if (s->power[i] > s->power[max_i])
+                    max_i = i;
+            double peak_hz = (double)vrt_context->rf_freq + max_i*bin_size - sample_rate/2;
+            // mean |X|/N in dB, as vrt_fftmax
+            double power = 10*log10(s->power[max_i]/s->blocks) - 20*log10((double)num_bins);
+            fprintf(s->fp, "%lu.%09li, %.2f, %.3f\n", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3), peak_hz, power);
+            fflush(s->fp);
+            break;
+        }
+    }
+
+    // the next integration starts after this one
+    s->start_seconds = seconds;
+    s->start_frac_seconds = frac_seconds;
+}
+
+static void sink_stop(sink* s) {
+    if (s->bin)
+        vrt_spectral_file_close(s->bin);
+    if (s->fp and s->fp != stdout)
+        fclose(s->fp);
+}
+
+int main(int argc, char* argv[])
+{
+    // variables to be set by po
+    std::string zmq_address, shm_name, loss_policy_name, metrics_target, precision_name, effort_name, window_name;
+    std::vector<std::string> sink_specs;
+    uint16_t instance, main_port, port;
+    uint32_t channel, num_bins, threads, fft_batch, queue_slots, max_latency;
+    int hwm;
+    size_t num_requested_samples;
+    double total_time;
+    float bin_size;
+
+    // setup the program options
+    po::options_description desc("Allowed options");
+    // clang-format off
+    desc.add_options()
+        ("help", "help message")
+        ("nsamps", po::value<size_t>(&num_requested_samples)->default_value(0), "total number of samples to receive")
+        ("duration", po::value<double>(&total_time)->default_value(0), "total number of seconds to receive")
+        ("channel", po::value<uint32_t>(&channel)->default_value(0), "VRT channel")
+        ("int-second", "align start of reception to integer second")
+        ("num-bins", po::value<uint32_t>(&num_bins)->default_value(1000), "number of bins (shared by all sinks)")
+        ("bin-size", po::value<float>(&bin_size), "size of bin in Hz")
+        ("sink", po::value<std::vector<std::string>>(&sink_specs)->multitoken(), "output type:key=value,... with type ecsv, bin, filterbank, rffft or fftmax (see below)")
+        ("window", po::value<std::string>(&window_name)->default_value("rect"), "FFT window: rect, hann, blackman-harris or flat-top")
+        ("threads", po::value<uint32_t>(&threads)->default_value(1), "number of FFT threads")
+        ("fft-batch", po::value<uint32_t>(&fft_batch)->default_value(VRT_FFT_BATCH), "number of FFT blocks transformed at once")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float (accumulated in double)")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
+        ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
+        ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
+        ("zmq-split", "create a ZeroMQ stream per VRT channel, increasing port number for additional streams")
+        ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
+        ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
+        ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("queue-slots", po::value<uint32_t>(&queue_slots)->default_value(VRT_RECEIVER_SLOTS), "packets buffered by the receive thread")
+        ("max-latency", po::value<uint32_t>(&max_latency)->default_value(0), "drop packets that waited longer in the receive queue (ms), 0 keeps all")
+    ;
+    // clang-format on
+    po::variables_map vm;
+    auto parsed = po::command_line_parser(argc, argv).options(desc).style(po::command_line_style::unix_style ^ po::command_line_style::allow_short).run();
+    po::store(parsed, vm);
+    po::notify(vm);
+
+    // print the help message
+    if (vm.count("help")) {
+        std::cout << boost::format("VRT spectral hub. %s") % desc << std::endl;
+        std::cout << std::endl
+                  << "This application makes the FFTs of a VRT stream once and feeds them to\n"
+                     "several outputs, each with its own integration time:\n"
+                     "  ecsv:file=<file|->,time=<s>[,db]              spectra as ECSV (vrt_spectrum)\n"
+                     "  bin:file=<file>,time=<s>[,db]                 binary spectral file (vrt_spectrum --bin-file)\n"
+                     "  filterbank:file=<file>,time=<s>[,source=<name>][,negative-foff]  sigproc filterbank (vrt_to_filterbank),\n"
+                     "      negative-foff puts the highest channel first (vrt_to_filterbank --negative-foff)\n"
+                     "  rffft:path=<dir>,time=<s>[,nsub=<n>]          STRF files (vrt_rffft)\n"
+                     "  fftmax:file=<file|->,time=<s>[,min-offset=<Hz>,max-offset=<Hz>]  peak (vrt_fftmax)\n"
+                     "Example: --sink ecsv:file=spectra.csv,time=10 --sink fftmax:time=1\n"
+                  << std::endl;
+        return ~0;
+    }
+
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
+    bool continue_on_bad_packet = vm.count("continue") > 0;
+    bool int_second             = vm.count("int-second") > 0;
+    bool zmq_split              = vm.count("zmq-split") > 0;
+
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+    vrt_window window;
+    if (not vrt_parse_window(window_name, &window))
+        return 1;
+    bool single = precision == VRT_FFT_FLOAT;
+    bool windowed = window != VRT_WINDOW_RECT;
+
+    std::vector<sink> sinks(sink_specs.size());
+    for (size_t s = 0; s < sink_specs.size(); s++)
+        if (not parse_sink(sink_specs[s], &sinks[s]))
+            return 1;
+    if (sinks.empty()) {
+        printf("No outputs, add one or more --sink.\n");
+        return 1;
+    }
+
+    std::signal(SIGINT, &sig_int_handler);
+
+    context_type vrt_context;
+    init_context(&vrt_context);
+    // cf32 payloads are converted without rounding to ci16
+    vrt_context.accept_formats |= 1 << VRT_FORMAT_CF32;
+
+    packet_type vrt_packet;
+
+    if (vm.count("port") > 0) {
+        main_port = port;
+    } else {
+        main_port = DEFAULT_MAIN_PORT + MAX_CHANNELS*instance;
+    }
+
+    if (zmq_split) {
+        main_port += channel;
+        vrt_packet.channel_filt = 1;
+    } else {
+        vrt_packet.channel_filt = 1<<channel;
+    }
+
+    // ZMQ
+    void *context = zmq_ctx_new();
+    void *subscriber = zmq_socket(context, ZMQ_SUB);
+    int rc = zmq_setsockopt (subscriber, ZMQ_RCVHWM, &hwm, sizeof hwm);
+    std::string connect_string = "tcp://" + zmq_address + ":" + std::to_string(main_port);
+    rc = zmq_connect(subscriber, connect_string.c_str());
+    assert(rc == 0);
+    zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
+
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+    vrt_receiver* receiver = vrt_receiver_start(subscriber, shm, queue_slots, max_latency);
+    if (receiver == NULL)
+        return 1;
+
+    // time keeping
+    auto start_time = std::chrono::steady_clock::now();
+    auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+
+    unsigned long long num_total_samps = 0;
+
+    bool start_rx = false;
+    bool sinks_started = false;
+    uint64_t last_fractional_seconds_timestamp = 0;
+
+    vrt_fft_engine* fft_engine = NULL;
+    vrt_wola* wola_filter = NULL;
+    std::complex<double>* signal = NULL;
+    std::complex<float>* signal_f = NULL;
+    std::vector<double> magnitudes;
+
+    // the engine is reduced every base_blocks FFTs, the gcd of the sink integrations
+    uint32_t base_blocks = 0;
+    uint32_t signal_pointer = 0;
+    uint32_t block_counter = 0;
+
+    while (not stop_signal_called
+           and (num_requested_samples > num_total_samps or num_requested_samples == 0)
+           and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
+
+        int len = vrt_receiver_recv(receiver, buffer, ZMQ_BUFFER_SIZE);
+        if (len < 0)
+            continue;
+
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
+            printf("Not a Vita49 packet?\n");
+            continue;
+        }
+
+        if (not start_rx and vrt_packet.context) {
+            vrt_print_context(&vrt_context);
+            start_rx = true;
+
+            if (vm.count("bin-size"))
+                num_bins = (uint32_t)((float)vrt_context.sample_rate/(float)bin_size);
+            if (total_time > 0)
+                num_requested_samples = total_time * vrt_context.sample_rate;
+
+            for (sink& s : sinks) {
+                s.blocks = std::max<uint32_t>(1, (uint32_t)round(s.time*vrt_context.sample_rate/num_bins));
+                s.power.assign(num_bins, 0);
+                base_blocks = std::gcd(base_blocks, s.blocks);
+            }
+            magnitudes.assign(num_bins, 0);
+
+            fft_engine = vrt_fft_engine_create(num_bins, fft_batch, threads, false, precision);
+            if (fft_engine == NULL)
+                break;
+            signal = vrt_fft_engine_input(fft_engine);
+            signal_f = vrt_fft_engine_input_f(fft_engine);
+
+            if (windowed) {
+                std::vector<float> taps(num_bins);
+                vrt_wola_taps(taps.data(), num_bins, 1, window);
+                wola_filter = vrt_wola_create(num_bins, 1, num_bins, taps.data());
+                if (wola_filter == NULL)
+                    break;
+            }
+
+            printf("# Hub parameters:\n");
+            printf("#    Bins: %u\n", num_bins);
+            printf("#    Bin size [Hz]: %.2f\n", (double)vrt_context.sample_rate/num_bins);
+            for (size_t i = 0; i < sinks.size(); i++)
+                printf("#    Sink %s: %u integrations, %.4f s\n", sink_specs[i].c_str(), sinks[i].blocks,
+                    (double)sinks[i].blocks*num_bins/vrt_context.sample_rate);
+            fflush(stdout);
+        }
+
+        if (start_rx and vrt_packet.data) {
+
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
+               if (not continue_on_bad_packet)
+                    break;
+
+            if (int_second) {
+                // check if fractional second has wrapped
+                if (vrt_packet.fractional_seconds_timestamp > last_fractional_seconds_timestamp ) {
+                        last_fractional_seconds_timestamp = vrt_packet.fractional_seconds_timestamp;
+                        continue;
+                } else {
+                    int_second = false;
+                }
+            }
+
+            if (not sinks_started) {
+                for (sink& s : sinks)
+                    if (not sink_start(&s, &vrt_context, num_bins, vrt_packet.integer_seconds_timestamp, vrt_packet.fractional_seconds_timestamp))
+                        stop_signal_called = true;
+                sinks_started = true;
+                if (stop_signal_called)
+                    break;
+            }
+
+            // convert up to the end of the current FFT block at once,
+            // fftshift sign of the position in the FFT block
+            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; ) {
+
+                uint32_t n = std::min(vrt_packet.num_rx_samps - i, num_bins - signal_pointer);
+                float mult = (signal_pointer & 1) ? -1.0f : 1.0f;
+                const uint32_t* payload = &buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format);
+
+                uint64_t stage_begin = vrt_metrics_stage_begin();
+                if (windowed)
+                    vrt_payload_to_cf32(payload, vrt_packet.sample_format, vrt_wola_input(wola_filter) + signal_pointer, n, mult, true);
+                else if (single)
+                    vrt_payload_to_cf32(payload, vrt_packet.sample_format, &signal_f[signal_pointer], n, mult, true);
+                else
+                    vrt_payload_to_cf64(payload, vrt_packet.sample_format, &signal[signal_pointer], n, mult, true);
+                vrt_metrics_stage_end(VRT_STAGE_CONVERT, stage_begin);
+
+                signal_pointer += n;
+                i += n;
+
+                if (signal_pointer < num_bins)
+                    continue;
+                signal_pointer = 0;
+
+                if (windowed) {
+                    vrt_wola_push(wola_filter);
+                    if (single)
+                        vrt_wola_output(wola_filter, signal_f);
+                    else
+                        vrt_wola_output(wola_filter, signal);
+                }
+
+                vrt_fft_engine_push(fft_engine);
+                signal = vrt_fft_engine_input(fft_engine);
+                signal_f = vrt_fft_engine_input_f(fft_engine);
+
+                if (++block_counter < base_blocks)
+                    continue;
+                block_counter = 0;
+
+                std::fill(magnitudes.begin(), magnitudes.end(), 0);
+                vrt_fft_engine_reduce(fft_engine, magnitudes.data());
+
+                uint64_t seconds = vrt_packet.integer_seconds_timestamp;
+                uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
+                frac_seconds += i*1e12/vrt_context.sample_rate;
+                if (frac_seconds > 1e12) {
+                    frac_seconds -= 1e12;
+                    seconds++;
+                }
+
+                stage_begin = vrt_metrics_stage_begin();
+                for (sink& s : sinks) {
+                    for (uint32_t b = 0; b < num_bins; b++)
+                        s.power[b] += magnitudes[b];
+                    s.counter += base_blocks;
+                    if (s.counter >= s.blocks) {
+                        sink_output(&s, &vrt_context, num_bins, seconds, frac_seconds);
+                        std::fill(s.power.begin(), s.power.end(), 0);
+                        s.counter = 0;
+                    }
+                }
+                vrt_metrics_stage_end(VRT_STAGE_OUTPUT, stage_begin);
+                vrt_metrics_latency(seconds, frac_seconds);
+            }
+
+            num_total_samps += vrt_packet.num_rx_samps;
+        }
+    }
+
+    for (sink& s : sinks)
+        sink_stop(&s);
+
+    vrt_fft_engine_destroy(fft_engine);
+    vrt_wola_destroy(wola_filter);
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(shm);
+
+    zmq_close(subscriber);
+    zmq_ctx_destroy(context);
+
+    return 0;
+}
@@ -14,12 +14,14 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/posix_time_io.hpp>
 
+#include <algorithm>
 #include <chrono>
 // #include <complex>
 #include <csignal>
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -38,6 +40,14 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-receiver.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
+#include "vrt-wola.h"
+#include "vrt-zoom.h"
+#include "vrt-spectral-file.h"
 #include "dt-extended-context.h"
 #include "tracker-extended-context.h"
 
@@ -76,37 +86,53 @@ inline float get_abs_val(std::complex<int8_t> t)
     return std::fabs(t.real());
 }
 
-float haversine(float dec1, float dec2, float ra1, float ra2) {
-
-    float dec_delta = dec2 - dec1;
-    float ra_delta = ra2 - ra1;
-
-    float a =
-      pow(sin(dec_delta / 2), 2) + cos(dec1) * cos(dec2) * pow(sin(ra_delta / 2), 2);
-    float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-    return(c);
+// Square (or square-square) a block, the fftshift sign is applied again
+template <typename T>
+void square_signal(std::complex<T>* signal, uint32_t num_bins, bool flag_x4)
+{
+    int mult = 1;
+    for (uint32_t i = 0; i < num_bins; i++) {
+        std::complex<T> x2 = signal[i] * signal[i];
+        signal[i] = (T)mult * (flag_x4 ? x2 * x2 : x2);
+        mult *= -1;
+    }
 }
 
-float bearing(float dec1, float dec2, float ra1, float ra2) {
-
-    float b = atan2(cos(dec1)*sin(dec2)-sin(dec1)*cos(dec2)*cos(ra2-ra1), sin(ra2-ra1)*cos(dec2));
-    return b;
+// Zoomed samples into a block from position on, with the fftshift sign of their position
+template <typename T>
+void zoom_to_block(const std::complex<float>* in, std::complex<T>* out, uint32_t n, uint32_t position)
+{
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = std::complex<T>(((position + i) & 1) ? -in[i] : in[i]);
 }
 
 int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_complex *signal, *result;
-    fftw_plan plan;
-    double *magnitudes, *phases_r, *phases_i, *filter_out;
+    std::complex<double> *signal;
+    std::complex<float> *signal_f;
+    vrt_fft_engine* fft_engine = NULL;
+    double *magnitudes, *phases_r = NULL, *phases_i = NULL, *filter_out;
 
-    std::complex<float> *wola_buffer;
-    float *wola_taps;
+    vrt_wola* wola_filter = NULL;
+
+    // zoom: band mixed to baseband and decimated before the FFT
+    vrt_zoom* zoom = NULL;
+    uint32_t zoom_decimation;
+    double fft_rate = 0, zoom_offset = 0;
+    std::vector<std::complex<float>> zoom_in, zoom_out;
+
+    // extra output planes after the mean, from the statistics of the FFT engine
+    std::vector<std::string> planes;
+    std::vector<double> sum_power2, hold_max, hold_min, median;
+    vrt_fft_stats fft_stats;
 
     uint32_t num_points = 0;
     uint32_t num_bins = 0;
     uint32_t wola_partitions;
+    uint32_t block_size = 0;
+    float overlap;
 
     bool power2;
     float bin_size, integration_time = 0.0;
@@ -117,7 +143,7 @@ int main(int argc, char* argv[])
     int32_t min_bin, max_bin;
 
     // variables to be set by po
-    std::string file, type, zmq_address, gnuplot_terminal, gnuplot_commands, source;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, gnuplot_terminal, gnuplot_commands, source, metrics_target, precision_name, effort_name, window_name, planes_list;
     size_t num_requested_samples;
     uint32_t bins, updates_per_second;
     double total_time;
@@ -125,13 +151,15 @@ int main(int argc, char* argv[])
     uint16_t instance, main_port, port;
     uint32_t channel;
     int hwm;
+    uint32_t queue_slots, max_latency;
+    uint32_t threads, fft_batch;
 
     bool dt_trace_warning_given = false;
 
     float min_y = 1e10;
     float max_y = -1e10;
 
-    FILE *outfile;
+    vrt_spectral_file* outfile = NULL;
 
     std::vector<double> poly;
 
@@ -164,14 +192,23 @@ int main(int argc, char* argv[])
         ("phase", "output phase in fftmax mode")
         ("two", "square signal before processing (to detect BPSK signals)")
         ("four", "square-square signal before processing (to detect QPSK signals")
+        ("threads", po::value<uint32_t>(&threads)->default_value(1), "number of FFT threads")
+        ("fft-batch", po::value<uint32_t>(&fft_batch)->default_value(VRT_FFT_BATCH), "number of FFT blocks transformed at once")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float (accumulated in double)")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
         ("wola", "apply Weighted OverLap Add method")
         ("wola-partitions", po::value<uint32_t>(&wola_partitions)->default_value(4), "number of WOLA partitions")
+        ("window", po::value<std::string>(&window_name), "FFT window: rect, hann, blackman-harris or flat-top (default: rect, blackman-harris with --wola)")
+        ("overlap", po::value<float>(&overlap)->default_value(0), "overlap of consecutive FFT segments (fraction, 0 to 0.95)")
         ("min-offset", po::value<double>(&min_offset), "min. freq. offset to track (Hz)")
         ("max-offset", po::value<double>(&max_offset), "max. freq. offset to track (Hz)")
+        ("zoom", "FFT only the band from min. to max. offset, mixed to baseband and decimated")
+        ("zoom-decimation", po::value<uint32_t>(&zoom_decimation), "decimation with --zoom (default: the largest that holds the band)")
         ("gnuplot-commands", po::value<std::string>(&gnuplot_commands)->default_value(""), "Extra gnuplot commands like \"set yr [ymin:ymax];\"")
         ("term", po::value<std::string>(&gnuplot_terminal)->default_value(DEFAULT_GNUPLOT_TERMINAL), "Gnuplot terminal (x11 or qt)")
         ("minmax", "min/max hold for y-axis scale (gnuplot)")
         ("db", "output power in dB")
+        ("planes", po::value<std::string>(&planes_list), "extra output planes after the mean: kurtosis, max, min and/or median (comma separated)")
         ("dc", "suppress DC peak")
         ("ecsv", "output in ECSV format (Astropy)")
         ("bin-file", po::value<std::string>(&file), "output binary data to file")
@@ -179,12 +216,17 @@ int main(int argc, char* argv[])
         ("temperature", "output temperature")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("dt-trace", "use DT trace data in VRT stream")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("zmq-split", "create a ZeroMQ stream per VRT channel, increasing port number for additional streams")
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("queue-slots", po::value<uint32_t>(&queue_slots)->default_value(VRT_RECEIVER_SLOTS), "packets buffered by the receive thread")
+        ("max-latency", po::value<uint32_t>(&max_latency)->default_value(0), "drop packets that waited longer in the receive queue (ms), 0 keeps all")
     ;
     // clang-format on
     po::variables_map vm;
@@ -202,6 +244,9 @@ int main(int argc, char* argv[])
     }
     po::notify(vm);
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -226,6 +271,52 @@ int main(int argc, char* argv[])
     bool wola                   = vm.count("wola") > 0;
     bool flag_x2                = vm.count("two") > 0;
     bool flag_x4                = vm.count("four") > 0;  
+    bool zoom_mode              = vm.count("zoom") > 0;
+
+    if (zoom_mode and (not vm.count("min-offset") or not vm.count("max-offset") or max_offset <= min_offset)) {
+        printf("--zoom needs a band: --min-offset below --max-offset.\n");
+        return 1;
+    }
+
+    if (vm.count("planes")) {
+        boost::split(planes, planes_list, boost::is_any_of(","));
+        for (const std::string& plane : planes) {
+            if (plane != "kurtosis" and plane != "max" and plane != "min" and plane != "median") {
+                printf("Unknown plane %s (kurtosis, max, min or median).\n", plane.c_str());
+                return 1;
+            }
+        }
+        if (fftmax or gnuplot) {
+            printf("--planes needs spectrum output, not --fftmax or --gnuplot.\n");
+            return 1;
+        }
+    }
+    bool median_plane = std::find(planes.begin(), planes.end(), "median") != planes.end();
+
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+    bool single = precision == VRT_FFT_FLOAT;
+
+    vrt_window window = wola ? VRT_WINDOW_BLACKMAN_HARRIS : VRT_WINDOW_RECT;
+    if (vm.count("window") and not vrt_parse_window(window_name, &window))
+        return 1;
+    if (overlap < 0 or overlap > 0.95) {
+        printf("Overlap should be between 0 and 0.95.\n");
+        return 1;
+    }
+    // overlapped or windowed segments go through the WOLA ring with one partition
+    bool windowed = wola or overlap > 0 or window != VRT_WINDOW_RECT;
+    if (not wola)
+        wola_partitions = 1;
 
     if (iir) {
         alpha = (1.0 - exp(-1/(tau/integration_time)));
@@ -247,6 +338,8 @@ int main(int argc, char* argv[])
     dt_ext_context_type dt_ext_context;
     tracker_ext_context_type tracker_ext_context;
     init_context(&vrt_context);
+    // cf32 payloads are converted without rounding to ci16
+    vrt_context.accept_formats |= 1 << VRT_FORMAT_CF32;
 
     packet_type vrt_packet;
 
@@ -273,6 +366,11 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+    vrt_receiver* receiver = vrt_receiver_start(subscriber, shm, queue_slots, max_latency);
+    if (receiver == NULL)
+        return 1;
+
     bool first_frame = true;
 
     // time keeping
@@ -293,21 +391,20 @@ int main(int argc, char* argv[])
 
     uint32_t signal_pointer = 0;
     uint32_t integration_counter = 0;
+    bool integration_invalid = false;
     uint32_t num_integrations_counter = 0;
 
-    if (binary) {
-        outfile=fopen(file.c_str(),"w");
-    }
-
     while (not stop_signal_called
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_receiver_recv(receiver, buffer, ZMQ_BUFFER_SIZE);
+        if (len < 0)
+            continue;
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -317,18 +414,34 @@ int main(int argc, char* argv[])
                 vrt_print_context(&vrt_context);
             start_rx = true;
 
+            fft_rate = vrt_context.sample_rate;
+            if (zoom_mode) {
+                zoom_offset = (min_offset + max_offset)/2;
+                if (not vm.count("zoom-decimation"))
+                    zoom_decimation = vrt_zoom_decimation(vrt_context.sample_rate, max_offset - min_offset);
+                zoom = vrt_zoom_create(vrt_context.sample_rate, zoom_offset, zoom_decimation);
+                if (zoom == NULL)
+                    break;
+                fft_rate = vrt_zoom_sample_rate(zoom);
+            }
+
             if (vm.count("bin-size")) {
                 if (power2) {
-                    num_bins = (uint32_t)((float)vrt_context.sample_rate/(float)bin_size);
+                    num_bins = (uint32_t)((float)fft_rate/(float)bin_size);
                     uint32_t pow2 = (uint32_t)(log2(num_bins)+0.8);
                     num_bins = pow(2,pow2);
                 } else {
-                    num_bins = (uint32_t)((float)vrt_context.sample_rate/(float)bin_size);
+                    num_bins = (uint32_t)((float)fft_rate/(float)bin_size);
                 }
             }
 
+            // new samples per FFT, even to keep the fftshift sign of the segments
+            block_size = num_bins;
+            if (overlap > 0)
+                block_size = std::max<uint32_t>(2, (uint32_t)round(num_bins*(1.0 - overlap)) & ~1u);
+
             if (not vm.count("integrations")) {
-                integrations = (uint32_t)round((double)integration_time/((double)num_bins/(double)vrt_context.sample_rate));
+                integrations = (uint32_t)round((double)integration_time/((double)block_size/fft_rate));
             }
 
             if (total_time > 0)
@@ -337,23 +450,33 @@ int main(int argc, char* argv[])
             min_bin = 0;
             max_bin = num_bins;
 
-            binsize = ((double)vrt_context.sample_rate)/((double)num_bins);
+            binsize = fft_rate/((double)num_bins);
 
             if (vm.count("min-offset")) {
-                min_bin = (min_offset/binsize)+num_bins/2;
+                min_bin = ((min_offset - zoom_offset)/binsize)+num_bins/2;
                 min_bin = min_bin < 0 ? 0 : min_bin;
                 min_bin = min_bin > num_bins ? num_bins : min_bin;
             }
 
             if (vm.count("max-offset")) {
-                max_bin = (max_offset/binsize)+num_bins/2;
+                max_bin = ((max_offset - zoom_offset)/binsize)+num_bins/2;
                 max_bin = max_bin < 0 ? 0 : max_bin;
                 max_bin = max_bin > num_bins ? num_bins : max_bin;
             }
 
-            signal = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-            result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-            plan = fftw_plan_dft_1d(num_bins, signal, result, FFTW_FORWARD, FFTW_ESTIMATE);
+            fft_engine = vrt_fft_engine_create(num_bins, fft_batch, threads, fftmax_phase, precision);
+            if (fft_engine == NULL)
+                break;
+            signal = vrt_fft_engine_input(fft_engine);
+            signal_f = vrt_fft_engine_input_f(fft_engine);
+            if (not planes.empty()) {
+                vrt_fft_engine_enable_stats(fft_engine, median_plane);
+                sum_power2.assign(num_bins, 0);
+                hold_max.assign(num_bins, 0);
+                hold_min.assign(num_bins, 0);
+                median.assign(num_bins, 0);
+                fft_stats = {sum_power2.data(), hold_max.data(), hold_min.data(), median_plane ? median.data() : NULL};
+            }
             magnitudes = (double*)malloc(num_bins * sizeof(double));
             memset(magnitudes, 0, num_bins*sizeof(double));
             if (fftmax_phase) {
@@ -365,33 +488,55 @@ int main(int argc, char* argv[])
             filter_out = (double*)malloc(num_bins * sizeof(double));
             memset(filter_out, 0, num_bins*sizeof(double));
 
-            if (wola) {
-                int wola_len = wola_partitions*num_bins;
-                wola_buffer = (std::complex<float>*)malloc(sizeof(std::complex<float>) * wola_len);
-                wola_taps = (float*)malloc(sizeof(float) * wola_len);
-
-                for (uint32_t i = 0; i < wola_len; i++)
-                    wola_buffer[i] = std::complex<float>(0,0);
-
-                // Blackman-Harris window
-                double a0 = 0.35875;
-                double a1 = 0.48829;
-                double a2 = 0.14128;
-                double a3 = 0.01168;
-
-                for (int i=0;i<wola_len;i++) {
-                    int j = i - (wola_len)/2;
-
-                    double blackman_window = a0 - a1*cos(2*pi*(double)i/((double)wola_len-1)) + 
-                                                a2*cos(4*pi*(double)i/((double)wola_len-1)) + 
-                                                a3*cos(6*pi*(double)i/((double)wola_len-1));
-                 
-                    double x = ((double)wola_partitions*pi)*((double)j/(double)wola_len);
-                    if (x!=0)
-                        wola_taps[i] = blackman_window*sin(x)/(x);
-                    else
-                        wola_taps[i] = blackman_window*1.0;
+            if (windowed) {
+                std::vector<float> taps((size_t)wola_partitions*num_bins);
+                vrt_wola_taps(taps.data(), num_bins, wola_partitions, window);
+                wola_filter = vrt_wola_create(num_bins, wola_partitions, block_size, taps.data());
+                if (wola_filter == NULL)
+                    break;
+            }
+
+            if (binary) {
+                vrt_spectral_layout layout;
+                layout.kind = fftmax ? "fftmax" : "spectrum";
+                layout.columns = fftmax ? 0 : num_bins;
+                layout.sample_rate = fft_rate;
+                layout.center_freq = vrt_context.rf_freq + zoom_offset;
+                layout.first_freq = (double)vrt_context.rf_freq + zoom_offset - fft_rate/2/freq_div;
+                layout.column_step = binsize/freq_div;
+                layout.integrations = integrations;
+                layout.integration_time = (double)integrations*(double)block_size/fft_rate;
+                if (log_freq)
+                    layout.traces.push_back({"center_freq_hz", "Hz"});
+                if (log_temp)
+                    layout.traces.push_back({"temperature_deg_c", ""});
+                if (dt_trace)
+                    for (uint32_t t = 0; t < DT_TRACE_COLUMNS; t++)
+                        layout.traces.push_back({dt_trace_names[t], dt_trace_units[t]});
+                if (fftmax) {
+                    layout.traces.push_back({"max_frequency", "Hz"});
+                    layout.traces.push_back({"max_power", ""});
+                    if (fftmax_phase)
+                        layout.traces.push_back({"phase", "deg"});
+                }
+                layout.meta.push_back({"stream_id", std::to_string(vrt_context.stream_id)});
+                layout.meta.push_back({"rx_gain", std::to_string(vrt_context.gain)});
+                layout.meta.push_back({"db", db ? "True" : "False"});
+                if (zoom) {
+                    layout.meta.push_back({"zoom_offset", std::to_string(zoom_offset)});
+                    layout.meta.push_back({"zoom_decimation", std::to_string(zoom_decimation)});
+                }
+                if (not planes.empty()) {
+                    layout.planes.push_back("mean");
+                    layout.planes.insert(layout.planes.end(), planes.begin(), planes.end());
                 }
+                if (windowed)
+                    layout.meta.push_back({"window", window_name.empty() ? (wola ? "blackman-harris" : "rect") : window_name});
+                if (has_source)
+                    layout.meta.push_back({"source", source});
+                outfile = vrt_spectral_file_create(file, layout);
+                if (outfile == NULL)
+                    break;
             }
 
             if (!ecsv) {
@@ -399,7 +544,17 @@ int main(int argc, char* argv[])
                 printf("#    Bins: %u\n", num_bins);
                 printf("#    Bin size [Hz]: %.2f\n", binsize);
                 printf("#    Integrations: %u\n", integrations);
-                printf("#    Integration Time [sec]: %.2f\n", (double)integrations*(double)num_bins/(double)vrt_context.sample_rate);
+                printf("#    Integration Time [sec]: %.2f\n", (double)integrations*(double)block_size/fft_rate);
+                if (zoom) {
+                    printf("#    Zoom offset [Hz]: %.0f\n", zoom_offset);
+                    printf("#    Zoom decimation: %u\n", zoom_decimation);
+                }
+                if (windowed) {
+                    printf("#    Window: %s\n", window_name.empty() ? (wola ? "blackman-harris" : "rect") : window_name.c_str());
+                    printf("#    Overlap: %.2f\n", 1.0 - (double)block_size/num_bins);
+                }
+                if (not planes.empty())
+                    printf("#    Planes: mean, %s\n", boost::algorithm::join(planes, ", ").c_str());
             } else {
                 uint32_t first_col = 1;
                 if (log_freq) first_col++;
@@ -432,9 +587,20 @@ int main(int argc, char* argv[])
                 printf("#   - {db: %s}\n", db ? "True" : "False");
                 printf("#   - {bins: %u}\n", num_bins);
                 printf("#   - {col_first_bin: %u}\n", first_col);
-                printf("#   - {bin_size: %.2f}\n", ((double)vrt_context.sample_rate)/((double)num_bins));
+                printf("#   - {bin_size: %.2f}\n", fft_rate/((double)num_bins));
                 printf("#   - {integrations: %u}\n", integrations);
-                printf("#   - {integration_time: %.2f}\n", (double)integrations*(double)num_bins/(double)vrt_context.sample_rate);
+                printf("#   - {integration_time: %.2f}\n", (double)integrations*(double)block_size/fft_rate);
+                if (zoom) {
+                    printf("#   - {zoom_offset: %.1f}\n", zoom_offset);
+                    printf("#   - {zoom_decimation: %u}\n", zoom_decimation);
+                }
+                if (windowed) {
+                    printf("#   - {window: %s}\n", window_name.empty() ? (wola ? "blackman-harris" : "rect") : window_name.c_str());
+                    printf("#   - {overlap: %.2f}\n", 1.0 - (double)block_size/num_bins);
+                    printf("#   - {wola_partitions: %u}\n", wola_partitions);
+                }
+                if (not planes.empty())
+                    printf("#   - {planes: [mean, %s]}\n", boost::algorithm::join(planes, ", ").c_str());
                 if (has_source) {
                     printf("# - description: !!omap\n");
                     printf("#   - {source: %s}\n", source.c_str());
@@ -472,7 +638,11 @@ int main(int argc, char* argv[])
                         printf("# - {name: phase, unit: deg, datatype: float64}\n");
                 } else {
                     for (uint32_t i = 0; i < num_bins; ++i) {
-                            printf("# - {name: \'%.0f\', datatype: float64}\n", (double)((double)vrt_context.rf_freq + (i*binsize - vrt_context.sample_rate/2)/freq_div));
+                            printf("# - {name: \'%.0f\', datatype: float64}\n", (double)((double)vrt_context.rf_freq + zoom_offset + (i*binsize - fft_rate/2)/freq_div));
+                    }
+                    for (const std::string& plane : planes) {
+                        for (uint32_t i = 0; i < num_bins; ++i)
+                            printf("# - {name: %s_%.0f, datatype: float64}\n", plane.c_str(), (double)((double)vrt_context.rf_freq + zoom_offset + (i*binsize - fft_rate/2)/freq_div));
                     }
                 }
                 printf("# schema: astropy-2.0\n");
@@ -493,7 +663,11 @@ int main(int argc, char* argv[])
                         printf(", phase");
                 } else {
                     for (uint32_t i = 0; i < num_bins; ++i) {
-                            printf(", %.0f", (double)((double)vrt_context.rf_freq + (i*binsize - vrt_context.sample_rate/2)/freq_div));
+                            printf(", %.0f", (double)((double)vrt_context.rf_freq + zoom_offset + (i*binsize - fft_rate/2)/freq_div));
+                    }
+                    for (const std::string& plane : planes) {
+                        for (uint32_t i = 0; i < num_bins; ++i)
+                            printf(", %s_%.0f", plane.c_str(), (double)((double)vrt_context.rf_freq + zoom_offset + (i*binsize - fft_rate/2)/freq_div));
                     }
                 }
                 printf("\n");
@@ -503,10 +677,13 @@ int main(int argc, char* argv[])
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
+            if (vrt_packet.fill_samples > 0 and loss_policy == VRT_LOSS_INVALID)
+                integration_invalid = true;
+
             if (int_second) {
                 // check if fractional second has wrapped
                 if (vrt_packet.fractional_seconds_timestamp > last_fractional_seconds_timestamp ) {
@@ -522,32 +699,55 @@ int main(int argc, char* argv[])
                 }
             }
 
-            int mult = 1;
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
+            // convert up to the end of the current FFT block at once,
+            // fftshift sign alternates per sample within the packet
+            // with zoom the FFT input is the decimated band
+            uint32_t num_samps = vrt_packet.num_rx_samps;
+            if (zoom) {
+                zoom_in.resize(num_samps);
+                zoom_out.resize(num_samps/zoom_decimation + 1);
+                uint64_t stage_begin = vrt_metrics_stage_begin();
+                vrt_payload_to_cf32(&buffer[vrt_packet.offset], vrt_packet.sample_format, zoom_in.data(), num_samps);
+                num_samps = vrt_zoom_process(zoom, zoom_in.data(), num_samps, zoom_out.data());
+                vrt_metrics_stage_end(VRT_STAGE_CONVERT, stage_begin);
+            }
+
+            for (uint32_t i = 0; i < num_samps; ) {
 
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
+                uint32_t n = std::min(num_samps - i, block_size - signal_pointer);
+                // fftshift sign of the position in the FFT block
+                float mult = (signal_pointer & 1) ? -1.0f : 1.0f;
 
-                if (wola) {
-                    wola_buffer[signal_pointer+((wola_partitions-1)*num_bins)] = std::complex<float>(mult*re,mult*img);
-                    mult *= -1;
+                uint64_t stage_begin = vrt_metrics_stage_begin();
+                if (zoom) {
+                    if (windowed)
+                        zoom_to_block(&zoom_out[i], vrt_wola_input(wola_filter) + signal_pointer, n, signal_pointer);
+                    else if (single)
+                        zoom_to_block(&zoom_out[i], &signal_f[signal_pointer], n, signal_pointer);
+                    else
+                        zoom_to_block(&zoom_out[i], &signal[signal_pointer], n, signal_pointer);
+                } else if (windowed) {
+                    vrt_payload_to_cf32(&buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format), vrt_packet.sample_format,
+                        vrt_wola_input(wola_filter) + signal_pointer, n, mult, true);
+                } else if (single) {
+                    vrt_payload_to_cf32(&buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format), vrt_packet.sample_format,
+                        &signal_f[signal_pointer], n, mult, true);
                 } else {
-                    signal[signal_pointer][REAL] = mult*re;
-                    signal[signal_pointer][IMAG] = mult*img;
-                    mult *= -1;
+                    vrt_payload_to_cf64(&buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format), vrt_packet.sample_format,
+                        &signal[signal_pointer], n, mult, true);
                 }
+                vrt_metrics_stage_end(VRT_STAGE_CONVERT, stage_begin);
 
-                signal_pointer++;
+                signal_pointer += n;
+                i += n;
 
-                if (signal_pointer >= num_bins) {
+                if (signal_pointer >= block_size) {
 
                     signal_pointer = 0;
 
                     uint64_t seconds = vrt_packet.integer_seconds_timestamp;
                     uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp;
-                    frac_seconds += (i+1)*1e12/vrt_context.sample_rate;
+                    frac_seconds += i*1e12/fft_rate;
                     if (frac_seconds > 1e12) {
                         frac_seconds -= 1e12;
                         seconds++;
@@ -555,128 +755,72 @@ int main(int argc, char* argv[])
 
                     // (double) square signal
                     if (flag_x2 || flag_x4) {
-                        int mult = 1;
-                        for (uint32_t i = 0; i < num_bins; i++) {
-
-                            double real = signal[i][REAL];
-                            double imag = signal[i][IMAG];
-
-                            double real2 = real * real - imag * imag;
-                            double imag2 = 2 * real * imag;
-
-                            if (flag_x4) {
-                                signal[i][REAL] = mult*(real2 * real2 - imag2 * imag2);
-                                signal[i][IMAG] = mult*(2 * real2 * imag2);
-                            } else {
-                                signal[i][REAL] = mult*real2;
-                                signal[i][IMAG] = mult*imag2;
-                            }
-                            mult *= -1;
-                        }
+                        if (windowed)
+                            square_signal(vrt_wola_input(wola_filter), block_size, flag_x4);
+                        else if (single)
+                            square_signal(signal_f, num_bins, flag_x4);
+                        else
+                            square_signal(signal, num_bins, flag_x4);
                     }
 
-                    if (num_bins > 1) {
-                        if (wola) {
-                            for (int j=0; j < num_bins; j++) {
-                                signal[j][REAL] = 0;
-                                signal[j][IMAG] = 0;
-                            }
-                            for (int p=0; p<wola_partitions; p++) {
-                                for (int j=0; j < num_bins; j++) {
-                                    signal[j][REAL] += wola_taps[p*num_bins+j] * wola_buffer[p*num_bins+j].real();
-                                    signal[j][IMAG] += wola_taps[p*num_bins+j] * wola_buffer[p*num_bins+j].imag();
-                                }
-                            }
-                            fftw_execute(plan);
-
-                            // shift wola buffer
-                            memcpy(&wola_buffer[0], &wola_buffer[num_bins], (wola_partitions-1)*num_bins*sizeof(std::complex<float>));
-
-                        } else {
-                            fftw_execute(plan);
-                        }
-
-                        for (uint32_t i = 0; i < num_bins; ++i) {
-                            magnitudes[i] += (result[i][REAL] * result[i][REAL] +
-                                      result[i][IMAG] * result[i][IMAG]);
-                            if (fftmax_phase) {
-                                phases_r[i] += result[i][REAL];
-                                phases_i[i] += result[i][IMAG];
-                            }
-                        }
-                    } else {
-                        magnitudes[0] += (signal[0][REAL] * signal[0][REAL] +
-                                      signal[0][IMAG] * signal[0][IMAG]);
+                    if (windowed) {
+                        vrt_wola_push(wola_filter);
+                        // no FFT until the first frame is complete
+                        if (not vrt_wola_full(wola_filter))
+                            continue;
+                        if (single)
+                            vrt_wola_output(wola_filter, signal_f);
+                        else
+                            vrt_wola_output(wola_filter, signal);
                     }
 
-                    if (dc) {
-                        size_t dcbin = num_bins/2;
-                        magnitudes[dcbin] = (magnitudes[dcbin-1]+magnitudes[dcbin+1])/2;
-                    }
+                    // the FFT and power accumulation run once the batch is full
+                    vrt_fft_engine_push(fft_engine);
+                    signal = vrt_fft_engine_input(fft_engine);
+                    signal_f = vrt_fft_engine_input_f(fft_engine);
 
                     integration_counter++;
                     if (integration_counter == integrations) {
+                        vrt_fft_engine_reduce(fft_engine, magnitudes, phases_r, phases_i, planes.empty() ? NULL : &fft_stats);
+
+                        if (dc) {
+                            size_t dcbin = num_bins/2;
+                            magnitudes[dcbin] = (magnitudes[dcbin-1]+magnitudes[dcbin+1])/2;
+                            if (not planes.empty()) {
+                                for (std::vector<double>* stat : {&sum_power2, &hold_max, &hold_min, &median})
+                                    (*stat)[dcbin] = ((*stat)[dcbin-1]+(*stat)[dcbin+1])/2;
+                            }
+                        }
+
+                        stage_begin = vrt_metrics_stage_begin();
                         num_integrations_counter++;
                         if (!gnuplot) {
-                            if (binary) {
-                                double timestamp = (double)seconds + (double)(frac_seconds/1e12);
-                                fwrite(&timestamp,sizeof(double),1,outfile);
-                            } else {
+                            double* traces = binary ? vrt_spectral_file_traces(outfile) : NULL;
+                            float* values = binary ? vrt_spectral_file_values(outfile) : NULL;
+                            uint32_t num_traces = 0;
+                            if (not binary)
                                 printf("%lu.%09li", static_cast<unsigned long>(seconds), static_cast<long>(frac_seconds/1e3));
-                            }
                             if (log_freq) {
-                                if (not binary) {
+                                if (not binary)
                                     printf(", %li", static_cast<long>(vrt_context.rf_freq));
-                                }
-                                else {
-                                    double freq = vrt_context.rf_freq;
-                                    fwrite(&freq,sizeof(double),1,outfile);
-                                }
+                                else
+                                    traces[num_traces++] = vrt_context.rf_freq;
                             }
                             if (log_temp) {
-                                if (not binary) {
+                                if (not binary)
                                     printf(", %.2f", vrt_context.temperature);
-                                } else {
-                                    double temp = vrt_context.temperature;
-                                    fwrite(&temp,sizeof(double),1,outfile);
-                                }
+                                else
+                                    traces[num_traces++] = vrt_context.temperature;
                             }
                             if (dt_trace) {
                                 if (not binary) {
-                                    printf(", %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f",
-                                        ((180.0/M_PI)*dt_ext_context.azimuth),
-                                        ((180.0/M_PI)*dt_ext_context.elevation),
-                                        ((180.0/M_PI)*dt_ext_context.azimuth_error),
-                                        ((180.0/M_PI)*dt_ext_context.elevation_error),
-                                        ((180.0/M_PI)*dt_ext_context.azimuth_speed),
-                                        ((180.0/M_PI)*dt_ext_context.elevation_speed),
-                                        ((180.0/M_PI)*dt_ext_context.azimuth_offset),
-                                        ((180.0/M_PI)*dt_ext_context.elevation_offset),
-                                        ((12.0/M_PI)*dt_ext_context.ra_current),
-                                        ((180.0/M_PI)*dt_ext_context.dec_current),
-                                        ((12.0/M_PI)*dt_ext_context.ra_setpoint),
-                                        ((180.0/M_PI)*dt_ext_context.dec_setpoint),
-                                        ((180.0/M_PI)*haversine(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current)),
-                                        ((180.0/M_PI)*bearing(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current)),
-                                        dt_ext_context.focusbox);
+                                    double trace_values[DT_TRACE_COLUMNS];
+                                    dt_trace_values(&dt_ext_context, trace_values);
+                                    for (uint32_t t = 0; t < DT_TRACE_COLUMNS; t++)
+                                        printf(", %.3f", trace_values[t]);
                                 } else {
-                                    double trace_values[15];
-                                    trace_values[0] = ((180.0/M_PI)*dt_ext_context.azimuth);
-                                    trace_values[1] = ((180.0/M_PI)*dt_ext_context.elevation);
-                                    trace_values[2] = ((180.0/M_PI)*dt_ext_context.azimuth_error);
-                                    trace_values[3] = ((180.0/M_PI)*dt_ext_context.elevation_error);
-                                    trace_values[4] = ((180.0/M_PI)*dt_ext_context.azimuth_speed);
-                                    trace_values[5] = ((180.0/M_PI)*dt_ext_context.elevation_speed);
-                                    trace_values[6] = ((180.0/M_PI)*dt_ext_context.azimuth_offset);
-                                    trace_values[7] = ((180.0/M_PI)*dt_ext_context.elevation_offset);
-                                    trace_values[8] = ((12.0/M_PI)*dt_ext_context.ra_current);
-                                    trace_values[9] = ((180.0/M_PI)*dt_ext_context.dec_current);
-                                    trace_values[10] = ((12.0/M_PI)*dt_ext_context.ra_setpoint);
-                                    trace_values[11] = ((180.0/M_PI)*dt_ext_context.dec_setpoint);
-                                    trace_values[12] = ((180.0/M_PI)*haversine(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current));
-                                    trace_values[13] = ((180.0/M_PI)*bearing(dt_ext_context.dec_setpoint, dt_ext_context.dec_current, dt_ext_context.ra_setpoint, dt_ext_context.ra_current));
-                                    trace_values[14] = dt_ext_context.focusbox;
-                                    fwrite(&trace_values,15*sizeof(double),1,outfile);
+                                    dt_trace_values(&dt_ext_context, &traces[num_traces]);
+                                    num_traces += DT_TRACE_COLUMNS;
                                 }
                             }
 
@@ -690,16 +834,18 @@ int main(int argc, char* argv[])
                             // uint32_t dc = num_points/2;
 
                             for (uint32_t i = 0; i < num_bins; ++i) {
-                                magnitudes[i] /= (double)integrations*(double)num_bins*(double)vrt_context.sample_rate;
+                                magnitudes[i] /= (double)integrations*(double)num_bins*fft_rate;
 
-                                if (iir) {
+                                if (integration_invalid) {
+                                    // keep the filter state, the output is marked invalid
+                                } else if (iir) {
                                     double current_alpha = (1.0/(float)output_counter > alpha) ? 1.0/(float)output_counter : alpha;
                                     filter_out[i] += (double)current_alpha*(magnitudes[i]-filter_out[i]);
                                 } else {
                                     filter_out[i] = magnitudes[i];
                                 }
 
-                                double offset = i*binsize - vrt_context.sample_rate/2;
+                                double offset = zoom_offset + i*binsize - fft_rate/2;
 
                                 double correction = 1;
 
@@ -713,19 +859,16 @@ int main(int argc, char* argv[])
                                     if (db) {
                                         correction = 10*log10(correction);
                                         value = 10*log10(filter_out[i])-correction;
-                                        if (not binary) {
-                                            printf(", %.7e", value);
-                                        } else {
-                                            fwrite(&value,sizeof(double),1,outfile);
-                                        }
                                     } else {
                                         value = filter_out[i]/correction;
-                                        if (not binary) {
-                                            printf(", %.7e", value);
-                                        } else {
-                                            fwrite(&value,sizeof(double),1,outfile);
-                                        }
                                     }
+                                    // integration with filled gaps
+                                    if (integration_invalid)
+                                        value = NAN;
+                                    if (not binary)
+                                        printf(", %.7e", value);
+                                    else
+                                        values[i] = value;
                                 } else {
                                     if (db) {
                                         correction = 10*log10(correction);
@@ -740,16 +883,57 @@ int main(int argc, char* argv[])
                         
                                 }
                             }
+                            // extra planes: power per FFT, calibrated like the mean; kurtosis
+                            // (M+1)/(M-1)*(M*S2/S1^2 - 1) of the M power values is 1 for noise
+                            double fft_scale = (double)num_bins*fft_rate;
+                            double M = integrations;
+                            for (size_t p = 0; p < planes.size(); p++) {
+                                for (uint32_t i = 0; i < num_bins; ++i) {
+                                    if (planes[p] == "kurtosis") {
+                                        double s1 = magnitudes[i]*M;
+                                        double s2 = sum_power2[i]/(fft_scale*fft_scale);
+                                        value = (M > 1 and s1 > 0) ? (M+1)/(M-1)*(M*s2/(s1*s1) - 1) : NAN;
+                                    } else {
+                                        const std::vector<double>& stat = planes[p] == "max" ? hold_max : (planes[p] == "min" ? hold_min : median);
+                                        double correction = 1;
+                                        if (poly_calib) {
+                                            double offset = zoom_offset + i*binsize - fft_rate/2;
+                                            correction = 0;
+                                            for (int32_t c = 0; c < N; c++)
+                                                correction += poly[c] * pow(offset, int(N-c-1));
+                                        }
+                                        if (db)
+                                            value = 10*log10(stat[i]/fft_scale) - 10*log10(correction);
+                                        else
+                                            value = stat[i]/fft_scale/correction;
+                                    }
+                                    if (integration_invalid)
+                                        value = NAN;
+                                    if (not binary)
+                                        printf(", %.7e", value);
+                                    else
+                                        values[(p + 1)*num_bins + i] = value;
+                                }
+                            }
                             if (fftmax) {
-                                printf(", %.2f", (double)vrt_context.rf_freq + (max_i*binsize - vrt_context.sample_rate/2)/freq_div);
-                                printf(", %.3f", max_power);
-                                if (fftmax_phase) {
-                                    double phase = atan2(phases_i[max_i],phases_r[max_i]);
-                                    printf(", %.3f", 180*phase/M_PI);
+                                double max_freq = (double)vrt_context.rf_freq + zoom_offset + (max_i*binsize - fft_rate/2)/freq_div;
+                                double phase = fftmax_phase ? 180*atan2(phases_i[max_i],phases_r[max_i])/M_PI : 0;
+                                if (not binary) {
+                                    printf(", %.2f", max_freq);
+                                    printf(", %.3f", max_power);
+                                    if (fftmax_phase)
+                                        printf(", %.3f", phase);
+                                } else {
+                                    traces[num_traces++] = max_freq;
+                                    traces[num_traces++] = max_power;
+                                    if (fftmax_phase)
+                                        traces[num_traces++] = phase;
                                 }
                             }
                             if (not binary)
                                 printf("\n");
+                            else if (not vrt_spectral_file_write(outfile, seconds, frac_seconds))
+                                printf("Failed to write %s.\n", file.c_str());
                         } else {
                             // gnuplot
                             double max_power = -1e10; // change this to minimal double
@@ -757,7 +941,7 @@ int main(int argc, char* argv[])
 
                             float scale = 1e6; // MHz
 
-                            float ticks = (vrt_context.sample_rate/freq_div)/(4*scale);
+                            float ticks = (fft_rate/freq_div)/(4*scale);
                             printf("set term %s 1 noraise; set xtics %f; set xlabel \"Frequency (MHz)\"; set ylabel \"Power (dB)\"; ", gnuplot_terminal.c_str(), ticks);
                             printf("%s; ", gnuplot_commands.c_str());
                             if (has_source) {
@@ -768,7 +952,7 @@ int main(int argc, char* argv[])
                                     boost::posix_time::to_iso_extended_string(boost::posix_time::from_time_t(seconds)).c_str());
                             }
                                 
-                            if (vrt_context.sample_rate <= 100e3)
+                            if (fft_rate <= 100e3)
                                 printf("set format x \"%%.4f\";\n");
                             else
                                 printf("set format x \"%%.3f\";\n");
@@ -785,7 +969,7 @@ int main(int argc, char* argv[])
                             output_counter++;
 
                             for (uint32_t i = 0; i < num_bins; ++i) {
-                                magnitudes[i] /= (double)integrations*(double)num_bins*(double)vrt_context.sample_rate;
+                                magnitudes[i] /= (double)integrations*(double)num_bins*fft_rate;
 
                                 if (iir) {
                                     double current_alpha = (1.0/(float)output_counter > alpha) ? 1.0/(float)output_counter : alpha;
@@ -793,8 +977,8 @@ int main(int argc, char* argv[])
                                 } else {
                                     filter_out[i] = magnitudes[i];
                                 }
-                                double offset = i*binsize - vrt_context.sample_rate/2;
-                                double freq = ((double)vrt_context.rf_freq + offset/freq_div)/scale;
+                                double offset = zoom_offset + i*binsize - fft_rate/2;
+                                double freq = ((double)vrt_context.rf_freq + zoom_offset + (i*binsize - fft_rate/2)/freq_div)/scale;
 
                                 double correction = 0;
 
@@ -829,15 +1013,17 @@ int main(int argc, char* argv[])
                         }
 
                         integration_counter = 0;
+                        integration_invalid = false;
                         memset(magnitudes, 0, num_bins*sizeof(double));
+                        std::fill(sum_power2.begin(), sum_power2.end(), 0);
                         if (fftmax_phase) {
                             memset(phases_r, 0, num_bins*sizeof(double));
                             memset(phases_i, 0, num_bins*sizeof(double));
                         }
-                        if (binary)
-                            fflush(outfile);
-                        else
+                        if (not binary)
                             fflush(stdout);
+                        vrt_metrics_stage_end(VRT_STAGE_OUTPUT, stage_begin);
+                        vrt_metrics_latency(seconds, frac_seconds);
                     }
                     if ( (num_integrations > 0) && (num_integrations_counter == num_integrations))
                         stop_signal_called = true;
@@ -876,7 +1062,7 @@ int main(int argc, char* argv[])
                 double datatype_max = 32768.;
 
                 for (int i=0; i<vrt_packet.num_rx_samps; i++ ) {
-                    auto sample_i = get_abs_val((std::complex<int16_t>)buffer[vrt_packet.offset+i]);
+                    auto sample_i = get_abs_val((std::complex<int16_t>)vrt_payload_sample(&buffer[vrt_packet.offset], vrt_packet.sample_format, i));
                     sum_i += sample_i;
                     if (sample_i > datatype_max*0.99)
                         clip_i++;
@@ -892,8 +1078,15 @@ int main(int argc, char* argv[])
         }
     }
 
-    if (binary)
-        fclose(outfile);
+    if (outfile)
+        vrt_spectral_file_close(outfile);
+
+    vrt_fft_engine_destroy(fft_engine);
+    vrt_wola_destroy(wola_filter);
+    if (zoom)
+        vrt_zoom_destroy(zoom);
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(shm);
 
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
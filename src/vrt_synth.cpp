@@ -0,0 +1,372 @@
+//
+// Copyright 2025 by Thomas Telkamp
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <csignal>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/time.h>
+
+#include <zmq.h>
+#include <assert.h>
+
+// VRT tools functions
+#include "vrt-tools.h"
+#include "vrt-shm.h"
+
+// Dispersion constant (s MHz^2 pc^-1 cm^3)
+#define DISPERSION_CONSTANT 4.148808e3
+
+// Samples of pre-generated noise per channel, packets start at a random offset
+#define NOISE_TABLE_SIZE (1 << 18)
+
+namespace po = boost::program_options;
+
+static bool stop_signal_called = false;
+void sig_int_handler(int)
+{
+    stop_signal_called = true;
+}
+
+enum signal_type {SIGNAL_NOISE, SIGNAL_TONE, SIGNAL_CHIRP, SIGNAL_PULSAR};
+
+int main(int argc, char* argv[])
+{
+    // variables to be set by po
+    std::string signal_name, shm_name, format_name;
+    uint16_t port, instance;
+    uint32_t samples_per_packet, num_channels, seed;
+    int hwm;
+    double rate, freq, datarate, total_time, setup_time;
+    double amplitude, noise_level, tone_freq, chirp_rate, period, dm, duty;
+    size_t num_requested_samples;
+
+    // setup the program options
+    po::options_description desc("Allowed options");
+    // clang-format off
+    desc.add_options()
+        ("help", "help message")
+        ("signal", po::value<std::string>(&signal_name)->default_value("noise"), "signal: noise, tone, chirp or pulsar")
+        ("rate", po::value<double>(&rate)->default_value(1e6), "sample rate")
+        ("freq", po::value<double>(&freq)->default_value(1420e6), "center frequency")
+        ("channels", po::value<uint32_t>(&num_channels)->default_value(1), "number of channels (stream id 1<<channel)")
+        ("datarate", po::value<double>(&datarate)->default_value(0), "rate of outgoing samples per channel (default: sample rate)")
+        ("max-rate", "send as fast as possible")
+        ("nsamps", po::value<size_t>(&num_requested_samples)->default_value(0), "total number of samples per channel to send")
+        ("duration", po::value<double>(&total_time)->default_value(0), "total number of seconds of samples to send")
+        ("setup", po::value<double>(&setup_time)->default_value(1.0), "seconds of setup time")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per VRT data packet")
+        ("format", po::value<std::string>(&format_name)->default_value("ci16"), "payload sample format: ci16, ci8, ci12 or cf32")
+        ("amplitude", po::value<double>(&amplitude)->default_value(2000), "signal amplitude")
+        ("noise", po::value<double>(&noise_level)->default_value(500), "noise standard deviation (per component)")
+        ("tone-freq", po::value<double>(&tone_freq)->default_value(0), "tone frequency offset (Hz)")
+        ("chirp-rate", po::value<double>(&chirp_rate)->default_value(0), "chirp rate (Hz/s, default: one sweep of the band per second)")
+        ("period", po::value<double>(&period)->default_value(0.7145197), "pulsar period (s)")
+        ("dm", po::value<double>(&dm)->default_value(26.8), "pulsar dispersion measure")
+        ("duty", po::value<double>(&duty)->default_value(0.02), "pulsar pulse width as fraction of the period")
+        ("seed", po::value<uint32_t>(&seed)->default_value(0), "noise seed (default: random)")
+        ("progress", "periodically display short-term bandwidth")
+        ("stats", "show average bandwidth on exit")
+        ("instance", po::value<uint16_t>(&instance), "VRT ZMQ instance")
+        ("port", po::value<uint16_t>(&port)->default_value(DEFAULT_MAIN_PORT), "VRT ZMQ port")
+        ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("shm", po::value<std::string>(&shm_name), "also publish to this shared memory ring")
+    ;
+    // clang-format on
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    // print the help message
+    if (vm.count("help")) {
+        std::cout << boost::format("Synthetic VRT stream. %s") % desc << std::endl;
+        std::cout << std::endl
+                  << "This application generates a VRT stream with noise, a tone, a chirp\n"
+                     "or a dispersed pulsar signal, for testing and benchmarking.\n"
+                  << std::endl;
+        return ~0;
+    }
+
+    vrt_sample_format sample_format;
+    if (not vrt_parse_sample_format(format_name, &sample_format))
+        return 1;
+    if (not vrt_valid_packet_size(samples_per_packet, sample_format))
+        return 1;
+
+    bool progress = vm.count("progress") > 0;
+    bool stats    = vm.count("stats") > 0;
+    bool max_rate = vm.count("max-rate") > 0;
+
+    signal_type signal;
+    if (signal_name == "noise")
+        signal = SIGNAL_NOISE;
+    else if (signal_name == "tone")
+        signal = SIGNAL_TONE;
+    else if (signal_name == "chirp")
+        signal = SIGNAL_CHIRP;
+    else if (signal_name == "pulsar")
+        signal = SIGNAL_PULSAR;
+    else {
+        printf("Unknown signal %s (noise, tone, chirp or pulsar).\n", signal_name.c_str());
+        return 1;
+    }
+
+    if (num_channels < 1 or num_channels > MAX_CHANNELS) {
+        printf("Number of channels should be between 1 and %d.\n", MAX_CHANNELS);
+        return 1;
+    }
+
+    if (rate <= 0 or rate > UINT32_MAX) {
+        printf("Invalid sample rate.\n");
+        return 1;
+    }
+
+    if (datarate == 0)
+        datarate = rate;
+    if (chirp_rate == 0)
+        chirp_rate = rate;
+    if (total_time > 0)
+        num_requested_samples = total_time * rate;
+
+    // Noise table per channel, channels share the signal but not the noise
+    std::mt19937 generator(seed ? seed : std::random_device()());
+    std::normal_distribution<float> normal(0, noise_level);
+    std::uniform_int_distribution<uint32_t> noise_offset(0, NOISE_TABLE_SIZE-1);
+    std::vector<std::vector<std::complex<float>>> noise(num_channels);
+    for (uint32_t ch = 0; ch < num_channels; ch++) {
+        noise[ch].resize(NOISE_TABLE_SIZE + samples_per_packet);
+        for (uint32_t i = 0; i < NOISE_TABLE_SIZE; i++)
+            noise[ch][i] = std::complex<float>(normal(generator), normal(generator));
+        // packets never wrap around the end of the table
+        std::copy(noise[ch].begin(), noise[ch].begin() + samples_per_packet, noise[ch].begin() + NOISE_TABLE_SIZE);
+    }
+
+    std::vector<std::complex<float>> sig(samples_per_packet, 0);
+    std::vector<std::complex<int16_t>> samples(samples_per_packet);
+
+    // Tone and chirp: rotating phasor, step rotates per sample for the chirp
+    std::complex<double> phasor = 1;
+    std::complex<double> step = std::polar(1.0, 2*M_PI*tone_freq/rate);
+    double chirp_freq = -rate/2;
+    const std::complex<double> chirp_step = std::polar(1.0, 2*M_PI*chirp_rate/(rate*rate));
+    if (signal == SIGNAL_CHIRP)
+        step = std::polar(1.0, 2*M_PI*chirp_freq/rate);
+
+    // Pulsar: the pulse sweeps from the top to the bottom of the band
+    const double f_top = (freq + rate/2)/1e6;
+    const double f_bottom = (freq - rate/2)/1e6;
+    const double sweep_time = DISPERSION_CONSTANT*dm*(1/(f_bottom*f_bottom) - 1/(f_top*f_top));
+    const double pulse_width = duty*period;
+    double pulse_phase = 0;
+    if (signal == SIGNAL_PULSAR)
+        printf("# Dispersion sweep %.6f s over the band\n", sweep_time);
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet, sample_format);
+    std::vector<uint32_t> payload(vrt_payload_words(samples_per_packet, sample_format));
+    p.body = (sample_format == VRT_FORMAT_CI16) ? (const void*)samples.data() : (const void*)payload.data();
+
+    // ZMQ
+    if ((vm.count("instance") > 0)) {
+        port = DEFAULT_MAIN_PORT + MAX_CHANNELS*instance;
+    }
+
+    void *context = zmq_ctx_new();
+    void *zmq_server = zmq_socket(context, ZMQ_PUB);
+    int rc = zmq_setsockopt(zmq_server, ZMQ_SNDHWM, &hwm, sizeof hwm);
+    assert(rc == 0);
+
+    std::string connect_string = "tcp://*:" + std::to_string(port);
+    rc = zmq_bind(zmq_server, connect_string.c_str());
+    assert(rc == 0);
+
+    vrt_shm *shm_server = NULL;
+    if (vm.count("shm")) {
+        shm_server = vrt_shm_create(shm_name.c_str());
+        if (shm_server == NULL)
+            return EXIT_FAILURE;
+    }
+
+    // Sleep setup time
+    std::this_thread::sleep_for(std::chrono::milliseconds(int64_t(1000 * setup_time)));
+
+    std::signal(SIGINT, &sig_int_handler);
+    std::cout << "Press Ctrl + C to stop streaming..." << std::endl;
+
+    // Timestamps count samples from the current time
+    struct timeval time_now{};
+    gettimeofday(&time_now, nullptr);
+    const uint64_t sample_rate = (uint64_t)rate;
+    const uint64_t start_seconds = time_now.tv_sec;
+    const uint64_t start_sample = (uint64_t)time_now.tv_usec*sample_rate/1000000;
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto last_update = start_time;
+    auto last_context = start_time - std::chrono::milliseconds(4*VRT_CONTEXT_INTERVAL);
+    uint64_t last_update_samps = 0;
+
+    uint64_t frame_count = 0;
+    uint64_t num_total_samps = 0;
+    const double packet_interval = samples_per_packet/datarate;
+
+    while (not stop_signal_called
+           and (num_requested_samples == 0 or num_total_samps < num_requested_samples)) {
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (not max_rate) {
+            auto send_time = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(frame_count*packet_interval));
+            std::this_thread::sleep_until(send_time);
+            now = std::chrono::steady_clock::now();
+        }
+
+        uint64_t sample = start_sample + num_total_samps;
+        uint64_t integer_seconds = start_seconds + sample/sample_rate;
+        uint64_t fractional_seconds = (sample % sample_rate)*1000000000000/sample_rate;
+
+        if (now - last_context > std::chrono::milliseconds(VRT_CONTEXT_INTERVAL)) {
+            last_context = now;
+
+            for (uint32_t ch = 0; ch < num_channels; ch++) {
+                struct vrt_packet pc;
+                vrt_init_packet(&pc);
+                vrt_init_context_packet(&pc, sample_format);
+
+                pc.fields.stream_id = 1 << ch;
+                pc.fields.integer_seconds_timestamp = integer_seconds;
+                pc.fields.fractional_seconds_timestamp = fractional_seconds;
+
+                pc.if_context.bandwidth              = rate;
+                pc.if_context.sample_rate            = rate;
+                pc.if_context.rf_reference_frequency = freq;
+                pc.if_context.if_reference_frequency = 0; // Zero-IF
+
+                int32_t rv = vrt_write_packet(&pc, buffer, ZMQ_BUFFER_SIZE, true);
+                if (rv < 0) {
+                    fprintf(stderr, "Failed to write packet: %s\n", vrt_string_error(rv));
+                    continue;
+                }
+                zmq_send(zmq_server, buffer, rv*4, 0);
+                if (shm_server)
+                    vrt_shm_write(shm_server, buffer, rv*4);
+            }
+        }
+
+        // common signal of all channels
+        switch (signal) {
+            case SIGNAL_NOISE:
+                break;
+            case SIGNAL_TONE:
+                for (uint32_t i = 0; i < samples_per_packet; i++) {
+                    sig[i] = std::complex<float>(amplitude*phasor);
+                    phasor *= step;
+                }
+                break;
+            case SIGNAL_CHIRP:
+                for (uint32_t i = 0; i < samples_per_packet; i++) {
+                    sig[i] = std::complex<float>(amplitude*phasor);
+                    phasor *= step;
+                    step *= chirp_step;
+                }
+                chirp_freq += samples_per_packet*chirp_rate/rate;
+                if (chirp_freq >= rate/2)
+                    chirp_freq -= rate;
+                step = std::polar(1.0, 2*M_PI*chirp_freq/rate);
+                break;
+            case SIGNAL_PULSAR:
+                for (uint32_t i = 0; i < samples_per_packet; i++) {
+                    // time since the pulse left the top of the band
+                    double t = pulse_phase*period;
+                    if (t < sweep_time + pulse_width) {
+                        double t_sweep = std::min(std::max(t - pulse_width/2, 0.0), sweep_time);
+                        double f = dm > 0 ? 1/sqrt(t_sweep/(DISPERSION_CONSTANT*dm) + 1/(f_top*f_top)) : f_top;
+                        phasor *= std::polar(1.0, 2*M_PI*(f*1e6 - freq)/rate);
+                        sig[i] = std::complex<float>(amplitude*phasor);
+                    } else {
+                        sig[i] = 0;
+                    }
+                    pulse_phase += 1/(period*rate);
+                    if (pulse_phase >= 1)
+                        pulse_phase -= 1;
+                }
+                break;
+        }
+        phasor /= std::abs(phasor);
+        step /= std::abs(step);
+
+        for (uint32_t ch = 0; ch < num_channels; ch++) {
+            const std::complex<float>* n = &noise[ch][noise_offset(generator)];
+            for (uint32_t i = 0; i < samples_per_packet; i++) {
+                std::complex<float> s = sig[i] + n[i];
+                samples[i] = std::complex<int16_t>(
+                    (int16_t)std::min(std::max(s.real(), -32767.0f), 32767.0f),
+                    (int16_t)std::min(std::max(s.imag(), -32767.0f), 32767.0f));
+            }
+            if (sample_format != VRT_FORMAT_CI16)
+                vrt_ci16_to_payload((const uint32_t*)samples.data(), payload.data(), samples_per_packet, sample_format);
+
+            p.fields.stream_id = 1 << ch;
+            p.header.packet_count = (uint8_t)frame_count%16;
+            p.fields.integer_seconds_timestamp = integer_seconds;
+            p.fields.fractional_seconds_timestamp = fractional_seconds;
+
+            zmq_msg_t msg;
+            zmq_msg_init_size(&msg, p.header.packet_size*4);
+            int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), p.header.packet_size, true);
+            if (rv < 0) {
+                fprintf(stderr, "Failed to write packet: %s\n", vrt_string_error(rv));
+                zmq_msg_close(&msg);
+                continue;
+            }
+            if (shm_server)
+                vrt_shm_write(shm_server, zmq_msg_data(&msg), rv*4);
+            zmq_msg_send(&msg, zmq_server, 0);
+            zmq_msg_close(&msg);
+        }
+
+        frame_count++;
+        num_total_samps += samples_per_packet;
+
+        if (progress)
+            show_progress_stats(now, &last_update, &last_update_samps,
+                (uint32_t*)samples.data(), samples_per_packet, num_channels-1);
+    }
+
+    const auto actual_stop_time = std::chrono::steady_clock::now();
+
+    if (stats) {
+        std::cout << std::endl;
+        const double actual_duration_seconds =
+            std::chrono::duration<float>(actual_stop_time - start_time).count();
+
+        std::cout << boost::format("Sent %d samples per channel in %f seconds.") % num_total_samps
+                         % actual_duration_seconds
+                  << std::endl;
+        const double rate = (double)num_total_samps / actual_duration_seconds;
+        std::cout << (rate / 1e6) << " Msps per channel." << std::endl;
+    }
+
+    zmq_close(zmq_server);
+    zmq_ctx_destroy(context);
+    vrt_shm_close(shm_server);
+
+    // finished
+    std::cout << std::endl << "Done!" << std::endl << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -19,6 +19,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 #include <complex>
 
 // VRT
@@ -44,6 +45,9 @@
 // END DADA
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
 #include "dt-extended-context.h"
 
 namespace po = boost::program_options;
@@ -73,7 +77,7 @@ inline float get_abs_val(std::complex<int8_t> t)
 int main(int argc, char* argv[])
 {
     // variables to be set by po
-    std::string zmq_address, channel_list, sourcename, dadakey_str, start_reception;
+    std::string zmq_address, shm_name, channel_list, sourcename, dadakey_str, start_reception, metrics_target;
     uint16_t instance, main_port, port;
     uint32_t channel;
     int hwm;
@@ -105,6 +109,8 @@ int main(int argc, char* argv[])
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -121,6 +127,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool continue_on_bad_packet = vm.count("continue") > 0;
@@ -205,7 +214,9 @@ int main(int argc, char* argv[])
 
     dadakey = std::stoul(dadakey_str, nullptr, 16);
 
-    std::complex<float> dadabuffer[VRT_SAMPLES_PER_PACKET*MAX_CHANNELS] __attribute((aligned(32)));
+    // sized from the received packets
+    std::vector<std::complex<float>> dadabuffer;
+    std::vector<std::complex<float>> samples;
 
     // ZMQ
     void *context = zmq_ctx_new();
@@ -216,6 +227,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -244,11 +257,11 @@ int main(int argc, char* argv[])
     while (not stop_signal_called
            and (num_requested_samples*channel_nums.size() > num_total_samps or num_requested_samples == 0)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -365,26 +378,27 @@ int main(int argc, char* argv[])
             // Process data here
             // Assumes ci16_le
 
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                // Convert ci16_le to float
-                std::complex<float>sample(re,img);
-                if (channel_nums.size() > 1) {
+            if (dadabuffer.size() < channel_nums.size()*vrt_packet.num_rx_samps) {
+                dadabuffer.resize(channel_nums.size()*vrt_packet.num_rx_samps);
+                samples.resize(vrt_packet.num_rx_samps);
+            }
+
+            // Convert ci16_le to float
+            if (channel_nums.size() > 1) {
+                vrt_ci16_to_cf32(&buffer[vrt_packet.offset], samples.data(), vrt_packet.num_rx_samps);
+                for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
                     if (ch==1)
-                        dadabuffer[i*channel_nums.size()+ch] = correction*sample;
+                        dadabuffer[i*channel_nums.size()+ch] = correction*samples[i];
                     else
-                        dadabuffer[i*channel_nums.size()+ch] = sample;
-                } else {
-                    dadabuffer[i] = sample;
+                        dadabuffer[i*channel_nums.size()+ch] = samples[i];
                 }
+            } else {
+                vrt_ci16_to_cf32(&buffer[vrt_packet.offset], dadabuffer.data(), vrt_packet.num_rx_samps);
             }
 
             // send when all channels have been received
             if (ch == channel_nums.size()-1) {
-                if (ipcio_write(dada_hdu->data_block, (char*)dadabuffer, channel_nums.size()*vrt_packet.num_rx_samps*sizeof(std::complex<float>)) < 0) {
+                if (ipcio_write(dada_hdu->data_block, (char*)dadabuffer.data(), channel_nums.size()*vrt_packet.num_rx_samps*sizeof(std::complex<float>)) < 0) {
                     if (stop_signal_called) {
                         break;
                     }
@@ -473,6 +487,8 @@ int main(int argc, char* argv[])
     if (dada_hdu_disconnect (dada_hdu) < 0)
         throw std::runtime_error("could not unlock write on DADA hdu");
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
     std::cout<<"vrt_to_dada cleaned up properly after SIGINT\n";
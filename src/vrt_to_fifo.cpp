@@ -17,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -35,6 +36,9 @@
 #include <complex.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
 
 #define SCALE_MAX 32768.0
 
@@ -66,7 +70,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, metrics_target;
     uint16_t port;
     uint32_t channel;
     int hwm;
@@ -91,9 +95,12 @@ int main(int argc, char* argv[])
         ("delete", "delete fifo on exit")
         // ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("port", po::value<uint16_t>(&port)->default_value(50100), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -110,6 +117,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     // bool null                   = vm.count("null") > 0;
@@ -117,6 +127,10 @@ int main(int argc, char* argv[])
     bool continue_on_bad_packet = vm.count("continue") > 0;
     bool int_second             = (bool)vm.count("int-second");
 
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
     // if no fifo, create
     struct stat st;
     if (stat(file.c_str(), &st) != 0)
@@ -135,10 +149,13 @@ int main(int argc, char* argv[])
 
     write_ptr = fdopen(fd, "wb");
 
-    std::complex<float> fifobuffer[VRT_SAMPLES_PER_PACKET];
+    // sized from the received packets
+    std::vector<std::complex<float>> fifobuffer;
 
     context_type vrt_context;
     init_context(&vrt_context);
+    // cf32 payloads are converted without rounding to ci16
+    vrt_context.accept_formats |= 1 << VRT_FORMAT_CF32;
 
     packet_type vrt_packet;
 
@@ -153,6 +170,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -180,11 +199,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -198,7 +217,7 @@ int main(int argc, char* argv[])
 
         if (start_rx and vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet)
                     break;
 
@@ -216,19 +235,12 @@ int main(int argc, char* argv[])
             }
 
             // Process data here
-            // Assumes ci16_le
-
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                // Do something
-                std::complex<float>sample((float)re/SCALE_MAX,(float)img/SCALE_MAX);
-                fifobuffer[i] = sample;
-            }
 
-            fwrite(fifobuffer, vrt_packet.num_rx_samps*sizeof(std::complex<float>), 1, write_ptr);
+            if (fifobuffer.size() < vrt_packet.num_rx_samps)
+                fifobuffer.resize(vrt_packet.num_rx_samps);
+            vrt_payload_to_cf32(&buffer[vrt_packet.offset], vrt_packet.sample_format, fifobuffer.data(), vrt_packet.num_rx_samps, 1.0f/SCALE_MAX);
+
+            fwrite(fifobuffer.data(), vrt_packet.num_rx_samps*sizeof(std::complex<float>), 1, write_ptr);
 
             // data: (const char*)&buffer[vrt_packet.offset]
             // size (bytes): sizeof(uint32_t)*vrt_packet.num_rx_samps
@@ -265,7 +277,7 @@ int main(int argc, char* argv[])
                 double datatype_max = 32768.;
 
                 for (int i=0; i<vrt_packet.num_rx_samps; i++ ) {
-                    auto sample_i = get_abs_val((std::complex<int16_t>)buffer[vrt_packet.offset+i]);
+                    auto sample_i = get_abs_val((std::complex<int16_t>)vrt_payload_sample(&buffer[vrt_packet.offset], vrt_packet.sample_format, i));
                     sum_i += sample_i;
                     if (sample_i > datatype_max*0.99)
                         clip_i++;
@@ -281,6 +293,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
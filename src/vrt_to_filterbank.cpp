@@ -14,6 +14,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/posix_time_io.hpp>
 
+#include <algorithm>
 #include <chrono>
 // #include <complex>
 #include <csignal>
@@ -36,6 +37,11 @@
 #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
+#include "vrt-fft.h"
+#include "vrt-filterbank.h"
 #include "dt-extended-context.h"
 
 namespace po = boost::program_options;
@@ -70,15 +76,14 @@ int main(int argc, char* argv[])
 {
 
     // FFTW
-    fftw_complex *signal, *result;
-    fftw_plan plan;
+    vrt_fft* fft = NULL;
 
     float *magnitudes;
 
     FILE *write_ptr;
 
     // variables to be set by po
-    std::string file, type, zmq_address, source_name, coords, start_reception;
+    std::string file, type, zmq_address, shm_name, loss_policy_name, source_name, coords, start_reception, metrics_target, precision_name, effort_name;
     uint16_t instance, main_port, port;
     uint32_t channel;
     uint32_t integrations;
@@ -112,6 +117,8 @@ int main(int argc, char* argv[])
         ("integrations", po::value<uint32_t>(&integrations)->default_value(1), "number of integrations")
         ("integration-time", po::value<float>(&integration_time), "integration time (seconds)")
         ("threads", po::value<uint32_t>(&threads)->default_value(1), "enable multi-threading")
+        ("precision", po::value<std::string>(&precision_name)->default_value("double"), "FFT precision: double or float")
+        ("fft-effort", po::value<std::string>(&effort_name)->default_value("estimate"), "FFT planner effort: estimate, measure or patient (plans are cached as wisdom)")
         ("machine-id", po::value<int32_t>(&machine_id)->default_value(0), "set filterbank machine_id (0=FAKE)")
         ("telescope-id", po::value<int32_t>(&telescope_id)->default_value(0), "set filterbank telescope_id (0=FAKE)")
         ("data-type", po::value<int32_t>(&data_type)->default_value(1), "set filterbank data_type (1=filterbank)")
@@ -123,12 +130,15 @@ int main(int argc, char* argv[])
         ("dt-trace", "use coordinates from DT trace data in VRT stream")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         // ("ignore-dc", "Ignore  DC bin")
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("zmq-split", "create a ZeroMQ stream per VRT channel, increasing port number for additional streams")
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -145,6 +155,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -156,6 +169,18 @@ int main(int argc, char* argv[])
     bool start_at_timestamp     = vm.count("start-time") > 0;
     // bool ignore_dc              = (bool)vm.count("ignore-dc");
 
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
+    vrt_fft_precision precision;
+    if (not vrt_parse_fft_precision(precision_name, &precision))
+        return 1;
+    vrt_fft_effort effort;
+    if (not vrt_parse_fft_effort(effort_name, &effort))
+        return 1;
+    vrt_fft_set_effort(effort);
+
     boost::posix_time::ptime utc_time;
     if (start_at_timestamp) {
         // Check for unix time
@@ -205,6 +230,8 @@ int main(int argc, char* argv[])
     context_type vrt_context;
     dt_ext_context_type dt_ext_context;
     init_context(&vrt_context);
+    // cf32 payloads are converted without rounding to ci16
+    vrt_context.accept_formats |= 1 << VRT_FORMAT_CF32;
 
     packet_type vrt_packet;
 
@@ -230,6 +257,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
 
@@ -252,11 +281,11 @@ int main(int argc, char* argv[])
     while (not stop_signal_called
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -282,11 +311,15 @@ int main(int argc, char* argv[])
             if (total_time > 0)
                 num_requested_samples = total_time * vrt_context.sample_rate;
 
-            fftw_plan_with_nthreads(threads);
+            if (precision == VRT_FFT_FLOAT) {
+                fftwf_init_threads();
+                fftwf_plan_with_nthreads(threads);
+            } else {
+                fftw_init_threads();
+                fftw_plan_with_nthreads(threads);
+            }
 
-            signal = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-            result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * num_bins);
-            plan = fftw_plan_dft_1d(num_bins, signal, result, FFTW_FORWARD, FFTW_ESTIMATE);
+            fft = vrt_fft_create(num_bins, precision);
             magnitudes = (float*)malloc(num_bins * sizeof(float));
             memset(magnitudes, 0, num_bins*sizeof(float));
 
@@ -299,7 +332,7 @@ int main(int argc, char* argv[])
 
         if (start_rx and vrt_packet.data and (dt_ext_context.dt_ext_context_received or not dt_trace)) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy))
                if (not continue_on_bad_packet) {
                     exit_code = 1;
                     break;
@@ -339,208 +372,59 @@ int main(int argc, char* argv[])
                           << std::endl;
                 first_frame = false;
 
-                // Filterbank Header
-                const char* keyword;
-                const char* string;
-                int32_t len;
-                int32_t int_value;
-                double double_value;
-
-                keyword = "HEADER_START";
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-
-                keyword = "machine_id";
-                int_value = machine_id;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "telescope_id";
-                int_value = telescope_id;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "data_type";
-                int_value = data_type;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "ibeam";
-                int_value = 1;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "source_name";
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                len = strlen(source_name.c_str());
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)source_name.c_str(), len, 1, write_ptr);
-
-                keyword = "nchans";
-                int_value = num_bins;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "nbeams";
-                int_value = 1;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "nbits";
-                int_value = 32;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "nifs";
-                int_value = 1;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &int_value, sizeof(int_value), 1, write_ptr);
-
-                keyword = "fch1";
-                if (neg_foff)
-                    double_value = (double)vrt_context.rf_freq/1e6+(double)vrt_context.sample_rate/2e6;
-                else
-                    double_value = (double)vrt_context.rf_freq/1e6-(double)vrt_context.sample_rate/2e6;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                keyword = "foff";
-                if (neg_foff)
-                    double_value = -((double)vrt_context.sample_rate/1e6)/((double)num_bins);
-                else
-                    double_value = ((double)vrt_context.sample_rate/1e6)/((double)num_bins);
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                keyword = "tstart";
-                double_value = ((double)vrt_packet.integer_seconds_timestamp+(double)vrt_packet.fractional_seconds_timestamp/1e12)/86400.0 + 40587.0;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                keyword = "tsamp";
-                double_value = (double)integrations*(double)num_bins/(double)vrt_context.sample_rate;
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                fwrite( &double_value, sizeof(double_value), 1, write_ptr);
+                vrt_filterbank_header header;
+                header.machine_id = machine_id;
+                header.telescope_id = telescope_id;
+                header.data_type = data_type;
+                header.source_name = source_name;
+                vrt_filterbank_set_band(&header, vrt_context.rf_freq, vrt_context.sample_rate, num_bins, neg_foff);
+                header.tstart = vrt_filterbank_mjd(vrt_packet.integer_seconds_timestamp, vrt_packet.fractional_seconds_timestamp);
+                header.tsamp = (double)integrations*(double)num_bins/(double)vrt_context.sample_rate;
 
                 if (dt_trace) {
-                    keyword = "src_raj";
+                    header.position = true;
                     double ra_h = ((12.0/M_PI)*dt_ext_context.ra_current);
                     int ra_hours = (int)ra_h;
                     int ra_minutes = (int)(ra_h*60)%60;
                     double ra_seconds = fmod(ra_h*3600.0, 60.0);
-                    double_value = ra_hours*1e4 + ra_minutes*1e2 + ra_seconds;
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
+                    header.src_raj = ra_hours*1e4 + ra_minutes*1e2 + ra_seconds;
 
-                    keyword = "src_dej";
                     double dec_deg = ((180.0/M_PI)*dt_ext_context.dec_current);
                     int dec_degrees = (int)dec_deg;
                     int dec_minutes = (int)(dec_deg*60.0)%60;
                     double dec_seconds = fmod(dec_deg*3600, 60.0);
-                    double_value = dec_degrees*1e4 + dec_minutes*1e2 + dec_seconds;
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                    keyword = "az_start";
-                    double_value = ((180.0/M_PI)*dt_ext_context.azimuth);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                    keyword = "za_start";
-                    double_value = 90.0 - ((180.0/M_PI)*dt_ext_context.elevation);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
+                    header.src_dej = dec_degrees*1e4 + dec_minutes*1e2 + dec_seconds;
+
+                    header.az_start = ((180.0/M_PI)*dt_ext_context.azimuth);
+                    header.za_start = 90.0 - ((180.0/M_PI)*dt_ext_context.elevation);
 
                 } else if (vm.count("coordinates")) {
-                    keyword = "src_raj";
-                    double_value = strtod(coord_strings[0].c_str(), &ptr);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                    keyword = "src_dej";
-                    double_value = strtod(coord_strings[1].c_str(), &ptr);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                    keyword = "az_start";
-                    double_value = strtod(coord_strings[2].c_str(), &ptr);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
-
-                    keyword = "za_start";
-                    double_value = strtod(coord_strings[3].c_str(), &ptr);
-                    len = strlen(keyword);
-                    fwrite( &len, sizeof(len), 1, write_ptr);
-                    fwrite( (char*)keyword, len, 1, write_ptr);
-                    fwrite( &double_value, sizeof(double_value), 1, write_ptr);
+                    header.position = true;
+                    header.src_raj = strtod(coord_strings[0].c_str(), &ptr);
+                    header.src_dej = strtod(coord_strings[1].c_str(), &ptr);
+                    header.az_start = strtod(coord_strings[2].c_str(), &ptr);
+                    header.za_start = strtod(coord_strings[3].c_str(), &ptr);
                 }
 
-                keyword = "HEADER_END";
-                len = strlen(keyword);
-                fwrite( &len, sizeof(len), 1, write_ptr);
-                fwrite( (char*)keyword, len, 1, write_ptr);
-                // end header
+                vrt_filterbank_write_header(write_ptr, &header);
             }
 
-            int mult = 1;
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
+            // fftshift sign of the position in the FFT block
+            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; ) {
 
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                signal[signal_pointer][REAL] = mult*re;
-                signal[signal_pointer][IMAG] = mult*img;
-                mult *= -1;
+                uint32_t n = std::min(vrt_packet.num_rx_samps - i, num_bins - signal_pointer);
+                double mult = (signal_pointer & 1) ? -1.0 : 1.0;
+                vrt_fft_load(fft, signal_pointer, &buffer[vrt_packet.offset] + vrt_payload_words(i, vrt_packet.sample_format), vrt_packet.sample_format,
+                    n, mult, true);
 
-                signal_pointer++;
+                signal_pointer += n;
+                i += n;
 
                 if (signal_pointer >= num_bins) {
 
                     signal_pointer = 0;
 
-                    fftw_execute(plan);
+                    vrt_fft_execute(fft);
 
                     for (uint32_t i = 0; i < num_bins; ++i) {
                         size_t index;
@@ -548,8 +432,7 @@ int main(int argc, char* argv[])
                             index = num_bins-1-i;
                         else
                             index = i;
-                        magnitudes[index] += (result[i][REAL] * result[i][REAL] +
-                                  result[i][IMAG] * result[i][IMAG]);
+                        magnitudes[index] += vrt_fft_power(fft, i);
                     }
                     integration_counter++;
                     if (integration_counter == integrations) {
@@ -595,7 +478,7 @@ int main(int argc, char* argv[])
                 double datatype_max = 32768.;
 
                 for (int i=0; i<vrt_packet.num_rx_samps; i++ ) {
-                    auto sample_i = get_abs_val((std::complex<int16_t>)buffer[vrt_packet.offset+i]);
+                    auto sample_i = get_abs_val((std::complex<int16_t>)vrt_payload_sample(&buffer[vrt_packet.offset], vrt_packet.sample_format, i));
                     sum_i += sample_i;
                     if (sample_i > datatype_max*0.99)
                         clip_i++;
@@ -611,6 +494,9 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_fft_destroy(fft);
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
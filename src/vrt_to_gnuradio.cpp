@@ -30,6 +30,8 @@
 #include <vrt/vrt_util.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
 
 // gnuradio pmt
 #include <pmt/pmt.h>
@@ -76,7 +78,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, metrics_target;
     size_t num_requested_samples;
     double total_time;
     uint16_t instance, main_port, port, gnuradioport;
@@ -105,6 +107,8 @@ int main(int argc, char* argv[])
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("gnuradioport", po::value<uint16_t>(&gnuradioport)->default_value(0), "GNURadio ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
 
     ;
     // clang-format on
@@ -126,6 +130,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -159,6 +166,8 @@ int main(int argc, char* argv[])
     rc = zmq_connect(subscriber, connect_string.c_str());
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
+
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
     if (gnuradioport == 0) {
         gnuradioport = DEFAULT_GNURADIO_PORT + channel;
     }
@@ -206,11 +215,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -299,6 +308,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_close(zmq_gr_data);
     zmq_close(zmq_gr_rate);
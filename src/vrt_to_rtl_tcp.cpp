@@ -17,6 +17,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -100,6 +101,9 @@ enum RTL_TCP_COMMANDS {
 };
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
 
 namespace po = boost::program_options;
 
@@ -137,7 +141,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address, rtl_address;
+    std::string file, type, zmq_address, shm_name, rtl_address, metrics_target;
     uint16_t port, rtl_port, ctrl_port;
     uint32_t channel;
     float scale;
@@ -168,6 +172,8 @@ int main(int argc, char* argv[])
         ("rtl-port", po::value<uint16_t>(&rtl_port)->default_value(1234), "RTL-TCP port (default 1234)")
         ("control-port", po::value<uint16_t>(&ctrl_port)->default_value(50300), "VRT ZMQ control port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -184,6 +190,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -300,6 +309,8 @@ int main(int argc, char* argv[])
         assert(rc == 0);
         zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+        vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
         // Vita49 and ZMQ control
         void* control;
         struct vrt_packet pc;
@@ -342,7 +353,8 @@ int main(int argc, char* argv[])
 
         uint32_t buffer[ZMQ_BUFFER_SIZE];
 
-        uint8_t rtlbuffer[VRT_SAMPLES_PER_PACKET*2];
+        // sized from the received packets
+        std::vector<uint8_t> rtlbuffer;
 
         unsigned long long num_total_samps = 0;
 
@@ -362,11 +374,11 @@ int main(int argc, char* argv[])
                and (num_requested_samples > num_total_samps or num_requested_samples == 0)
                and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-            int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+            int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
             const auto now = std::chrono::steady_clock::now();
 
-            if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+            if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
                 printf("Not a Vita49 packet?\n");
                 continue;
             }
@@ -461,30 +473,9 @@ int main(int argc, char* argv[])
                 // Process data here
                 // Assumes ci16_le
 
-                for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-
-                    int16_t re;
-                    memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                    int16_t img;
-                    memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-
-                    re = std::lroundf((float)re/scale);
-                    img = std::lroundf((float)img/scale);
-
-                    re += 128;
-                    img += 128;
-
-                    // Clip
-                    re = re < 0 ? 0 : re;
-                    re = re > 255 ? 255 : re;
-
-                    img = img < 0 ? 0 : img;
-                    img = img > 255 ? 255 : img;
-
-                    rtlbuffer[i*2] = (uint8_t)re;
-                    rtlbuffer[i*2+1] = (uint8_t)img;
-
-                }
+                if (rtlbuffer.size() < 2*vrt_packet.num_rx_samps)
+                    rtlbuffer.resize(2*vrt_packet.num_rx_samps);
+                vrt_ci16_to_cu8(&buffer[vrt_packet.offset], rtlbuffer.data(), vrt_packet.num_rx_samps, 1.0f/scale);
 
                 int bytesleft,bytessent;
 
@@ -494,7 +485,7 @@ int main(int argc, char* argv[])
                 FD_SET(s, &writefds);
                 r = select(s+1, NULL, &writefds, NULL, &tv);
                 if(r) {
-                    bytessent = send(s,  (char*)rtlbuffer, bytesleft, 0);
+                    bytessent = send(s,  (char*)rtlbuffer.data(), bytesleft, 0);
                 }
                 if(bytessent == SOCKET_ERROR) {
                         printf("worker socket bye\n");
@@ -552,6 +543,7 @@ int main(int argc, char* argv[])
             }
         }
         zmq_close(control);
+        vrt_shm_close(shm);
         zmq_close(subscriber);
         zmq_ctx_destroy(context);
     }
@@ -33,6 +33,9 @@
 #include <vrt/vrt_util.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-demux.h"
 #include "dt-extended-context.h"
 #include "tracker-extended-context.h"
 
@@ -91,7 +94,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, auto_file, type, zmq_address, channel_list, author, description, start_reception;
+    std::string file, auto_file, type, zmq_address, shm_name, loss_policy_name, channel_list, author, description, start_reception, metrics_target;
     size_t num_requested_samples, total_time;
     uint16_t instance, main_port, port;
     int hwm;
@@ -120,6 +123,7 @@ int main(int argc, char* argv[])
         ("start-time", po::value<std::string>(&start_reception), "start reception at given timestamp")
         ("null", "run without writing to file")
         ("continue", "don't abort on a bad packet")
+        ("loss-policy", po::value<std::string>(&loss_policy_name)->default_value("abort"), "handle lost packets: abort, zero, hold or invalid")
         ("meta-only", "only create sigmf-meta file")
         ("dt-trace", "add DT trace data")
         ("tracking", "add tracking context data")
@@ -129,6 +133,8 @@ int main(int argc, char* argv[])
         ("instance", po::value<uint16_t>(&instance)->default_value(0), "VRT ZMQ instance")
         ("port", po::value<uint16_t>(&port), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -145,6 +151,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -160,6 +169,10 @@ int main(int argc, char* argv[])
     bool vrt                    = vm.count("vrt") > 0;
     bool zmq_split              = vm.count("zmq-split") > 0;
 
+    vrt_loss_policy loss_policy;
+    if (not vrt_parse_loss_policy(loss_policy_name, &loss_policy))
+        return 1;
+
     boost::posix_time::ptime utc_time;
     if (start_at_timestamp) {
         // Check for unix time
@@ -191,10 +204,9 @@ int main(int argc, char* argv[])
         std::cout << "UTC start time: " << utc_time << std::endl;
     }
 
-    context_type vrt_context;
+    vrt_demux demux;
     dt_ext_context_type dt_ext_context;
     tracker_ext_context_type tracker_ext_context;
-    init_context(&vrt_context);
 
     packet_type vrt_packet;
 
@@ -204,8 +216,6 @@ int main(int argc, char* argv[])
         main_port = DEFAULT_MAIN_PORT + MAX_CHANNELS*instance;
     }
 
-    vrt_packet.channel_filt = 0;
-
     // detect which channels to use
     std::vector<std::string> channel_strings;
     std::vector<size_t> channel_nums;
@@ -213,7 +223,6 @@ int main(int argc, char* argv[])
     for (size_t ch = 0; ch < channel_strings.size(); ch++) {
         size_t chan = std::stoi(channel_strings[ch]);
         channel_nums.push_back(std::stoi(channel_strings[ch]));
-        vrt_packet.channel_filt |= 1<<std::stoi(channel_strings[ch]);
     }
 
     if (zmq_split) {
@@ -223,9 +232,11 @@ int main(int argc, char* argv[])
         }
         main_port += channel_nums[0];
         channel_nums[0] = 0;
-        vrt_packet.channel_filt = 1;
     }
 
+    if (not vrt_demux_init(&demux, channel_nums))
+        exit(EXIT_FAILURE);
+
     std::vector<std::string> data_filenames;
     std::vector<std::shared_ptr<std::ofstream>> datafiles;
     std::vector<std::string> meta_filenames;
@@ -267,6 +278,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
 
@@ -299,29 +312,29 @@ int main(int argc, char* argv[])
     while (not stop_signal_called
            and ( num_requested_samples*channel_nums.size() > num_total_samps or num_requested_samples == 0)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         if (stop_signal_called)
             break;
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        vrt_stream_state* stream;
+        if (not vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
 
+        // packets of other streams are only recorded with --vrt
+        uint32_t ch = stream ? vrt_demux_index(&demux, stream) : channel_nums.size();
+        context_type& vrt_context = stream ? stream->context : demux.streams[0].context;
+
         if (vrt_packet.context and not first_frame and not continue_on_bad_packet and vrt_context.context_changed) {
             printf("Context changed, exiting.\n");
             break;
         }
 
-        uint32_t ch = 0;
-        for(ch = 0; ch<channel_nums.size(); ch++)
-            if (vrt_packet.stream_id & (1 << channel_nums[ch]) )
-                break;
-
-        std::string channel = std::to_string(channel_nums[ch]);
+        std::string channel = stream ? std::to_string(stream->channel) : channel_list;
         if (vrt) {
             channel = channel_list;
         }
@@ -517,7 +530,7 @@ int main(int argc, char* argv[])
 
         if (vrt_packet.data) {
 
-            if (vrt_packet.lost_frame)
+            if (vrt_packet.lost_frame and (vrt or not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, loss_policy)))
                if (not continue_on_bad_packet)
                     break;
 
@@ -556,9 +569,11 @@ int main(int argc, char* argv[])
                           << std::endl;
                 first_frame = false;
                 // last_update = now;
-                // update context starttime in case of int_second
-                vrt_context.starttime_integer = vrt_packet.integer_seconds_timestamp;
-                vrt_context.starttime_fractional = vrt_packet.fractional_seconds_timestamp;
+                // update context starttime in case of int_second, all channels start together
+                for (uint32_t i = 0; i < demux.num_streams; i++) {
+                    demux.streams[i].context.starttime_integer = vrt_packet.integer_seconds_timestamp;
+                    demux.streams[i].context.starttime_fractional = vrt_packet.fractional_seconds_timestamp;
+                }
             }
 
             // Write to file
@@ -585,6 +600,8 @@ int main(int argc, char* argv[])
     for (size_t i = 0; i < datafiles.size(); i++)
         datafiles[i]->close();
 
+    context_type& vrt_context = demux.streams[0].context;
+
     // Auto file
     if (context_recv and do_auto_file) {
         boost::format auto_format;
@@ -636,6 +653,8 @@ int main(int argc, char* argv[])
             }
     }
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
@@ -11,12 +11,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp>
 
+#include <algorithm>
 #include <chrono>
 // #include <complex>
 #include <csignal>
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -38,6 +40,9 @@
 // #include <fftw3.h>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
 
 namespace po = boost::program_options;
 
@@ -66,14 +71,15 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address, udp_forward;
+    std::string file, type, zmq_address, shm_name, udp_forward, metrics_target;
     uint16_t port, udp_port;
     uint32_t channel;
     int hwm;
     size_t num_requested_samples;
     double total_time;
 
-    float float_data[VRT_SAMPLES_PER_PACKET*2];
+    // sized from the received packets
+    std::vector<std::complex<float>> float_data;
 
     // setup the program options
     po::options_description desc("Allowed options");
@@ -95,6 +101,8 @@ int main(int argc, char* argv[])
         ("address", po::value<std::string>(&zmq_address)->default_value("localhost"), "VRT ZMQ address")
         ("port", po::value<uint16_t>(&port)->default_value(50100), "VRT ZMQ port")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
     ;
     // clang-format on
     po::variables_map vm;
@@ -111,6 +119,9 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -133,6 +144,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     int sockfd;
     struct sockaddr_in servaddr, cliaddr;
 
@@ -176,11 +189,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(buffer, sizeof(buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -211,20 +224,15 @@ int main(int argc, char* argv[])
                 }
             }
 
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&buffer[vrt_packet.offset+i]+2, 2);
-                // convert to float32
-                float_data[2*i] = (float)re / 65535;
-                float_data[2*i+1] = (float)img / 65535;
-            }
+            // convert to float32
+            if (float_data.size() < vrt_packet.num_rx_samps)
+                float_data.resize(vrt_packet.num_rx_samps);
+            vrt_ci16_to_cf32(&buffer[vrt_packet.offset], float_data.data(), vrt_packet.num_rx_samps, 1.0f/65535);
 
-            uint32_t blocks = VRT_SAMPLES_PER_PACKET/1000;
-
-            for (uint32_t i = 0; i < blocks; i++) {
-                if (sendto(sockfd, (char*)&float_data[i*1000*2], 1000*2*sizeof(float), 0,
+            // datagrams of 1000 samples, the last one holds the remainder
+            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i += 1000) {
+                uint32_t block = std::min<uint32_t>(1000, vrt_packet.num_rx_samps - i);
+                if (sendto(sockfd, (char*)&float_data[i], block*sizeof(std::complex<float>), 0,
                     (struct sockaddr *)&servaddr, sizeof(servaddr)) < 0)
                 {
                     printf("UDP fail\n");
@@ -279,6 +287,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_shm_close(shm);
+
     zmq_close(subscriber);
     zmq_ctx_destroy(context);
 
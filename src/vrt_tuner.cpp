@@ -18,6 +18,7 @@
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 // VRT
 #include <stdbool.h>
@@ -34,6 +35,9 @@
 #include <complex>
 
 #include "vrt-tools.h"
+#include "vrt-metrics.h"
+#include "vrt-shm.h"
+#include "vrt-convert.h"
 #include "tracker-extended-context.h"
 
 const double pi = std::acos(-1.0);
@@ -66,7 +70,7 @@ int main(int argc, char* argv[])
 {
 
     // variables to be set by po
-    std::string file, type, zmq_address;
+    std::string file, type, zmq_address, shm_name, pub_shm_name, metrics_target;
     uint16_t pub_instance, instance, main_port, port, pub_port;
     uint32_t channel;
     int hwm;
@@ -76,6 +80,7 @@ int main(int argc, char* argv[])
     double total_time;
 
     uint32_t decimation;
+    uint32_t samples_per_packet;
     uint32_t taps_per_decimation;
     uint32_t num_taps;
     double *taps;
@@ -89,9 +94,11 @@ int main(int argc, char* argv[])
     std::complex<double> step_dop;
     float polyfir_channel;
 
-    std::complex<float>*x;
-    std::complex<float>*y;
-    std::complex<float>*tmp_acc;
+    // filter buffers, sized from the received packets
+    std::complex<float>*x = NULL;
+    std::complex<float>*y = NULL;
+    std::complex<float>*tmp_acc = NULL;
+    uint32_t alloc_samples = 0;
 
     // setup the program options
     po::options_description desc("Allowed options");
@@ -110,6 +117,7 @@ int main(int argc, char* argv[])
         ("tracking", "use VRT tracking data")
         ("decimation", po::value<uint32_t>(&decimation)->default_value(2), "decimation factor")
         ("taps-per-decimation", po::value<uint32_t>(&taps_per_decimation)->default_value(20), "taps per decimation")
+        ("packet-size", po::value<uint32_t>(&samples_per_packet)->default_value(VRT_SAMPLES_PER_PACKET), "samples per output VRT data packet")
         ("bandwidth", po::value<float>(&bandwidth)->default_value(0), "bandwidth")
         ("doppler", po::value<float>(&doppler_rate)->default_value(0), "doppler rate in Hz/s")
         ("freq-offset", po::value<float>(&freq_offset)->default_value(0), "frequency offset")
@@ -121,6 +129,9 @@ int main(int argc, char* argv[])
         ("pub-port", po::value<uint16_t>(&pub_port), "VRT ZMQ PUB port")
         ("pub-instance", po::value<uint16_t>(&pub_instance)->default_value(1), "VRT ZMQ instance")
         ("hwm", po::value<int>(&hwm)->default_value(10000), "VRT ZMQ HWM")
+        ("metrics", po::value<std::string>(&metrics_target), "export metrics (Prometheus text format) on this TCP port or to this file")
+        ("shm", po::value<std::string>(&shm_name), "read VRT packets from this shared memory ring instead of ZMQ")
+        ("pub-shm", po::value<std::string>(&pub_shm_name), "also publish to a shared memory ring")
     ;
     // clang-format on
     po::variables_map vm;
@@ -136,6 +147,12 @@ int main(int argc, char* argv[])
         return ~0;
     }
 
+    if (vm.count("metrics") and not vrt_metrics_start(metrics_target, argv[0]))
+        return 1;
+
+    if (not vrt_valid_packet_size(samples_per_packet))
+        return 1;
+
     bool progress               = vm.count("progress") > 0;
     bool stats                  = vm.count("stats") > 0;
     bool null                   = vm.count("null") > 0;
@@ -177,6 +194,8 @@ int main(int argc, char* argv[])
     assert(rc == 0);
     zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
+    vrt_shm* shm = shm_name.empty() ? NULL : vrt_shm_open(shm_name.c_str());
+
     void *responder = zmq_socket(context, ZMQ_PUB);
     rc = zmq_setsockopt (responder, ZMQ_SNDHWM, &hwm, sizeof hwm);
     assert(rc == 0);
@@ -184,6 +203,13 @@ int main(int argc, char* argv[])
     rc = zmq_bind(responder, connect_string.c_str());
     assert (rc == 0);
 
+    vrt_shm* shm_server = NULL;
+    if (vm.count("pub-shm")) {
+        shm_server = vrt_shm_create(pub_shm_name.c_str());
+        if (shm_server == NULL)
+            return 1;
+    }
+
     // time keeping
     auto start_time = std::chrono::steady_clock::now();
     auto stop_time = start_time + std::chrono::milliseconds(int64_t(1000 * total_time));
@@ -208,10 +234,10 @@ int main(int argc, char* argv[])
     /* VRT init */
     struct vrt_packet p;
     vrt_init_packet(&p);
-    vrt_init_data_packet(&p);
+    vrt_init_data_packet(&p, samples_per_packet);
     p.fields.stream_id = 1;
 
-    std::complex<int16_t> iq_buff[VRT_SAMPLES_PER_PACKET];
+    std::vector<std::complex<int16_t>> iq_buff(samples_per_packet);
     uint32_t iq_counter = 0;
     uint32_t fir_pointer = 0;
     uint32_t frame_count = 0;
@@ -230,11 +256,11 @@ int main(int argc, char* argv[])
            and (num_requested_samples > num_total_samps or num_requested_samples == 0)
            and (total_time == 0.0 or std::chrono::steady_clock::now() <= stop_time)) {
 
-        int len = zmq_recv(subscriber, rx_buffer, ZMQ_BUFFER_SIZE, 0);
+        int len = vrt_recv(subscriber, shm, rx_buffer, ZMQ_BUFFER_SIZE);
 
         const auto now = std::chrono::steady_clock::now();
 
-        if (not vrt_process(rx_buffer, sizeof(rx_buffer), &vrt_context, &vrt_packet)) {
+        if (not vrt_process(rx_buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet)) {
             printf("Not a Vita49 packet?\n");
             continue;
         }
@@ -280,12 +306,6 @@ int main(int argc, char* argv[])
                 exit(1);
             }
 
-            // check for valid decimation
-            if (VRT_SAMPLES_PER_PACKET % decimation != 0) {
-                printf("decimation needs to be a divisor of %u.\n", VRT_SAMPLES_PER_PACKET);
-                exit(1);
-            }
-            
             // check for valid decimation
             if ((uint64_t)vrt_context.sample_rate % decimation != 0) {
                 printf("decimation needs to be a divisor of the sample rate (%u).\n", vrt_context.sample_rate);
@@ -361,17 +381,6 @@ int main(int argc, char* argv[])
             step = std::exp(alpha/(double)vrt_context.sample_rate);
             step_dop = std::exp(alpha_dop/pow((double)vrt_context.sample_rate,2));
             alpha2 = (std::complex<float>)complexi*polyfir_channel*2.0f*(float)pi/(float(decimation));
-
-            int M = decimation;
-            int L = VRT_SAMPLES_PER_PACKET;
-
-            x = (std::complex<float>*)malloc(sizeof(std::complex<float>)*(M+L+num_taps));
-            y = (std::complex<float>*)malloc(sizeof(std::complex<float>)*(L/M));
-            tmp_acc = (std::complex<float>*)malloc(sizeof(std::complex<float>)*(L/M));
-
-            for (uint32_t i = 0; i < M+L+num_taps; i++)
-                x[i] = std::complex<float>(0,0);
-            
         }
 
         if (start_rx and vrt_packet.context) {
@@ -424,6 +433,8 @@ int main(int argc, char* argv[])
 
             // ZMQ
             zmq_send (responder, tx_buffer, rv*4, 0);
+            if (shm_server)
+                vrt_shm_write(shm_server, tx_buffer, rv*4);
 
         }
 
@@ -449,19 +460,30 @@ int main(int argc, char* argv[])
             // Assumes ci16_le
 
             int M = decimation;
-            int L = vrt_packet.num_rx_samps;
+            uint32_t L = vrt_packet.num_rx_samps;
+
+            // check for valid decimation
+            if (L % M != 0) {
+                printf("decimation needs to be a divisor of the packet size (%u).\n", L);
+                exit(1);
+            }
+
+            // (re)size filter buffers, keeps the filter history in front of x
+            if (L > alloc_samples) {
+                x = (std::complex<float>*)realloc(x, sizeof(std::complex<float>)*(M+L+num_taps));
+                y = (std::complex<float>*)realloc(y, sizeof(std::complex<float>)*(L/M));
+                tmp_acc = (std::complex<float>*)realloc(tmp_acc, sizeof(std::complex<float>)*(L/M));
+                if (alloc_samples == 0) {
+                    for (uint32_t i = 0; i < M+num_taps; i++)
+                        x[i] = std::complex<float>(0,0);
+                }
+                alloc_samples = L;
+            }
 
             for (uint32_t i = 0; i < L/M; i++)
                 y[i] = std::complex<float>(0,0);
 
-            for (uint32_t i = 0; i < vrt_packet.num_rx_samps; i++) {
-                int16_t re;
-                memcpy(&re, (char*)&rx_buffer[vrt_packet.offset+i], 2);
-                int16_t img;
-                memcpy(&img, (char*)&rx_buffer[vrt_packet.offset+i]+2, 2);
-
-                x[M+i+num_taps] = std::complex<float>(re,img);
-            }
+            vrt_ci16_to_cf32(&rx_buffer[vrt_packet.offset], &x[M+num_taps], vrt_packet.num_rx_samps);
 
             // nomalize phasor and step (for doppler)
             phasor = phasor/std::abs(phasor);
@@ -509,16 +531,20 @@ int main(int argc, char* argv[])
             }
 
             for (uint32_t k = 0; k < L/M; k++) {
+
+                if (iq_counter == 0) {
+                    // timestamp of the first sample in the output packet
+                    uint64_t frac_seconds = vrt_packet.fractional_seconds_timestamp
+                        + (uint64_t)((double)k*M*1e12/(double)vrt_context.sample_rate);
+                    next_integer_seconds_timestamp = vrt_packet.integer_seconds_timestamp + frac_seconds/(uint64_t)1e12;
+                    next_fractional_seconds_timestamp = frac_seconds%(uint64_t)1e12;
+                }
+
                 iq_buff[iq_counter] = y[k];
                 iq_counter++;
-            }
 
-            if (next_integer_seconds_timestamp == 0) {
-                next_integer_seconds_timestamp = vrt_packet.integer_seconds_timestamp;
-                next_fractional_seconds_timestamp = vrt_packet.fractional_seconds_timestamp;
-            }
-
-            if (iq_counter==VRT_SAMPLES_PER_PACKET) {
+                if (iq_counter < samples_per_packet)
+                    continue;
 
                 iq_counter = 0;
                 t_samp = 0;
@@ -531,17 +557,19 @@ int main(int argc, char* argv[])
                 next_integer_seconds_timestamp = 0;
                 next_fractional_seconds_timestamp = 0;
 
-                p.body = (char*)iq_buff;
+                p.body = (char*)iq_buff.data();
                 p.fields.stream_id = 1;
 
                 zmq_msg_t msg;
-                int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_SIZE*4);
-                int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_SIZE, true);
+                int rc = zmq_msg_init_size (&msg, VRT_DATA_PACKET_WORDS(samples_per_packet)*4);
+                int32_t rv = vrt_write_packet(&p, zmq_msg_data(&msg), VRT_DATA_PACKET_WORDS(samples_per_packet), true);
 
+                if (shm_server)
+                    vrt_shm_write(shm_server, zmq_msg_data(&msg), rv*4);
                 zmq_msg_send(&msg, responder, 0);
                 zmq_msg_close(&msg);
 
-                num_total_samps += vrt_packet.num_rx_samps;
+                num_total_samps += samples_per_packet;
             }
 
             if (start_rx and first_frame) {
@@ -570,6 +598,8 @@ int main(int argc, char* argv[])
             memcpy (zmq_msg_data(&msg), rx_buffer, len);
             zmq_msg_send(&msg, responder, 0);
             zmq_msg_close(&msg);
+            if (shm_server)
+                vrt_shm_write(shm_server, rx_buffer, len);
         }
 
         if (progress) {
@@ -607,6 +637,9 @@ int main(int argc, char* argv[])
         }
     }
 
+    vrt_shm_close(shm);
+    vrt_shm_close(shm_server);
+
     zmq_close(subscriber);
     zmq_close(responder);
     zmq_ctx_destroy(context);
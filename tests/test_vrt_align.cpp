@@ -0,0 +1,120 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-align.h"
+
+static const double sample_rate = 1e6;
+static const uint64_t start = 1767225600;
+
+// Packet of n samples from sample index first on, each sample its index (real) and the stream (imag)
+static void push(vrt_align* align, uint32_t stream, int64_t first, uint32_t n) {
+    std::vector<std::complex<int16_t>> samples(n);
+    for (uint32_t i = 0; i < n; i++)
+        samples[i] = std::complex<int16_t>((int16_t)((first + i) % 30000), (int16_t)stream);
+    uint64_t picoseconds = (uint64_t)(first % (int64_t)sample_rate)*1000000;
+    vrt_align_push(align, stream, start + first/(int64_t)sample_rate, picoseconds,
+        reinterpret_cast<const uint32_t*>(samples.data()), n);
+}
+
+TEST_CASE( "Streams are aligned by timestamp in any arrival order", "[vrt-align]" ) {
+    vrt_align* align = vrt_align_create(2, sample_rate, 1024);
+    REQUIRE( align != NULL );
+    const uint32_t shift[2] = {0, 0};
+
+    // stream 1 starts later and runs ahead, stream 0 arrives in bursts
+    push(align, 1, 150, 100);
+    REQUIRE( vrt_align_ready(align, shift, 1000) == 0 );
+    push(align, 1, 250, 100);
+    push(align, 0, 100, 100);
+    push(align, 0, 200, 100);
+
+    // from the first sample both have
+    REQUIRE( vrt_align_ready(align, shift, 1000) == 150 );
+    REQUIRE( vrt_align_position(align) == 150 );
+
+    std::vector<std::complex<double>> out(150);
+    for (uint32_t s = 0; s < 2; s++) {
+        vrt_align_read(align, s, vrt_align_position(align), 150, out.data(), 1.0);
+        for (uint32_t i = 0; i < 150; i++) {
+            REQUIRE( out[i].real() == 150 + i );
+            REQUIRE( out[i].imag() == s );
+        }
+    }
+    vrt_align_advance(align, 150);
+    REQUIRE( vrt_align_ready(align, shift, 1000) == 0 );
+
+    int64_t seconds, picoseconds;
+    vrt_align_time(align, vrt_align_position(align) + 1000000, &seconds, &picoseconds);
+    REQUIRE( seconds == (int64_t)start + 1 );
+    REQUIRE( picoseconds == 300000000 );
+
+    REQUIRE( vrt_align_missing(align, 0) == 0 );
+    REQUIRE( vrt_align_missing(align, 1) == 0 );
+    vrt_align_destroy(align);
+}
+
+TEST_CASE( "Delayed streams are read further back", "[vrt-align]" ) {
+    vrt_align* align = vrt_align_create(2, sample_rate, 256);
+    const uint32_t shift[2] = {0, 700};
+
+    // a shift beyond the ring
+    vrt_align_reserve(align, 700 + 400);
+    for (int64_t first = 0; first < 2000; first += 100) {
+        push(align, 0, first, 100);
+        push(align, 1, first, 100);
+    }
+
+    uint32_t n = vrt_align_ready(align, shift, 64);
+    REQUIRE( n == 64 );
+    int64_t position = vrt_align_position(align);
+    REQUIRE( position == 700 );
+
+    std::vector<std::complex<float>> a(n), b(n);
+    vrt_align_read(align, 0, position - shift[0], n, a.data(), 1.0f);
+    vrt_align_read(align, 1, position - shift[1], n, b.data(), 1.0f);
+    REQUIRE( a[0].real() == 700 );
+    REQUIRE( b[0].real() == 0 );
+    REQUIRE( b[63].real() == 63 );
+    vrt_align_destroy(align);
+}
+
+TEST_CASE( "A stalled stream is released with zeros", "[vrt-align]" ) {
+    vrt_align* align = vrt_align_create(2, sample_rate, 512);
+    const uint32_t shift[2] = {0, 0};
+
+    push(align, 0, 0, 100);
+    push(align, 1, 0, 100);
+    // stream 1 stops, stream 0 goes on: the buffering stays bounded
+    for (int64_t first = 100; first < 5000; first += 100) {
+        push(align, 0, first, 100);
+        uint32_t n;
+        while ((n = vrt_align_ready(align, shift, 1000)) > 0) {
+            std::vector<std::complex<double>> a(n), b(n);
+            int64_t position = vrt_align_position(align);
+            vrt_align_read(align, 0, position, n, a.data(), 1.0);
+            vrt_align_read(align, 1, position, n, b.data(), 1.0);
+            REQUIRE( a[n - 1].real() == (position + n - 1) % 30000 );
+            if (position >= 100)
+                REQUIRE( b[0] == 0.0 );
+            vrt_align_advance(align, n);
+        }
+    }
+    REQUIRE( vrt_align_position(align) > 4000 );
+    REQUIRE( vrt_align_missing(align, 0) == 0 );
+    REQUIRE( vrt_align_missing(align, 1) == (uint64_t)vrt_align_position(align) - 100 );
+
+    // the stream comes back after a gap
+    push(align, 1, 5000, 100);
+    push(align, 0, 5000, 100);
+    REQUIRE( vrt_align_ready(align, shift, 1000) > 0 );
+    std::vector<std::complex<double>> b(1);
+    vrt_align_read(align, 1, 5000, 1, b.data(), 1.0);
+    REQUIRE( b[0].real() == 5000 );
+    vrt_align_destroy(align);
+}
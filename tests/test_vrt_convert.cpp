@@ -0,0 +1,213 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "vrt-convert.h"
+
+static std::vector<uint32_t> make_samples(size_t n) {
+    std::vector<uint32_t> in(n);
+    for (size_t i = 0; i < n; i++) {
+        int16_t re = (int16_t)(i * 7919 - 32768);
+        int16_t img = (int16_t)(32767 - i * 104729);
+        in[i] = (uint16_t)re | ((uint32_t)(uint16_t)img << 16);
+    }
+    return in;
+}
+
+static std::vector<vrt_simd_level> supported_levels() {
+    std::vector<vrt_simd_level> levels;
+    for (int l = VRT_SIMD_SCALAR; l <= VRT_SIMD_AVX512; l++)
+        if (vrt_convert_set_simd_level((vrt_simd_level)l))
+            levels.push_back((vrt_simd_level)l);
+    return levels;
+}
+
+TEST_CASE( "SIMD kernels match the scalar kernels", "[vrt-convert]" ) {
+    // odd length to exercise the scalar tails
+    const size_t n = 1003;
+    std::vector<uint32_t> in = make_samples(n);
+
+    REQUIRE( vrt_convert_set_simd_level(VRT_SIMD_SCALAR) );
+    std::vector<std::complex<float>> ref32(n), ref32_shift(n);
+    std::vector<std::complex<double>> ref64(n), ref64_shift(n);
+    std::vector<uint8_t> ref_u8(2*n);
+    std::vector<int8_t> ref_s8(2*n);
+    vrt_ci16_to_cf32(in.data(), ref32.data(), n, 1.0f/32768);
+    vrt_ci16_to_cf32(in.data(), ref32_shift.data(), n, -2.0f, true);
+    vrt_ci16_to_cf64(in.data(), ref64.data(), n);
+    vrt_ci16_to_cf64(in.data(), ref64_shift.data(), n, 1.0, true);
+    vrt_ci16_to_cu8(in.data(), ref_u8.data(), n, 1.0f/100);
+    vrt_ci16_to_cs8(in.data(), ref_s8.data(), n, 1.0f/100);
+    std::vector<double> ref_power(n, 1.0);
+    vrt_accumulate_power(ref64.data(), ref_power.data(), n);
+    vrt_accumulate_power(ref64_shift.data(), ref_power.data(), n);
+    std::vector<double> ref_power32(n, 1.0);
+    vrt_accumulate_power(ref32.data(), ref_power32.data(), n);
+    std::vector<float> weights(n);
+    for (size_t i = 0; i < n; i++)
+        weights[i] = (float)(i % 7) - 3;
+    std::vector<std::complex<float>> ref_weighted(n, 1.0f);
+    vrt_accumulate_weighted(weights.data(), ref32_shift.data(), ref_weighted.data(), n);
+    // small integer powers, so the sums of squares are exact as well
+    std::vector<double> block(n);
+    for (size_t i = 0; i < n; i++)
+        block[i] = (double)((i*7919) % 1000);
+    std::vector<double> ref_acc(n, 1.0), ref_acc2(n, 2.0), ref_max(n, 500.0), ref_min(n, 500.0);
+    vrt_accumulate_moments(block.data(), ref_acc.data(), ref_acc2.data(), ref_max.data(), ref_min.data(), n);
+    // small integers for exact products, also when the scalar kernel is fused
+    std::vector<std::complex<double>> cross_x(n), cross_y(n);
+    for (size_t i = 0; i < n; i++) {
+        cross_x[i] = std::complex<double>((double)(i % 101) - 50, (double)(i % 37));
+        cross_y[i] = std::complex<double>((double)(i % 13), 20 - (double)(i % 41));
+    }
+    std::vector<std::complex<double>> ref_cross(n, 1.0);
+    std::vector<double> ref_mag(n, 2.0);
+    vrt_accumulate_cross(cross_x.data(), cross_y.data(), ref_cross.data(), ref_mag.data(), n);
+    std::vector<std::complex<float>> cross_x32(cross_x.begin(), cross_x.end()), cross_y32(cross_y.begin(), cross_y.end());
+    std::vector<std::complex<double>> ref_cross32(n, 1.0);
+    std::vector<double> ref_mag32(n, 2.0);
+    vrt_accumulate_cross(cross_x32.data(), cross_y32.data(), ref_cross32.data(), ref_mag32.data(), n);
+
+    for (vrt_simd_level level : supported_levels()) {
+        INFO( "kernel set " << vrt_convert_simd_name(level) );
+        REQUIRE( vrt_convert_set_simd_level(level) );
+
+        std::vector<std::complex<float>> out32(n);
+        std::vector<std::complex<double>> out64(n);
+        std::vector<uint8_t> out_u8(2*n);
+        std::vector<int8_t> out_s8(2*n);
+
+        vrt_ci16_to_cf32(in.data(), out32.data(), n, 1.0f/32768);
+        REQUIRE( out32 == ref32 );
+        vrt_ci16_to_cf32(in.data(), out32.data(), n, -2.0f, true);
+        REQUIRE( out32 == ref32_shift );
+        vrt_ci16_to_cf64(in.data(), out64.data(), n);
+        REQUIRE( out64 == ref64 );
+        vrt_ci16_to_cf64(in.data(), out64.data(), n, 1.0, true);
+        REQUIRE( out64 == ref64_shift );
+        vrt_ci16_to_cu8(in.data(), out_u8.data(), n, 1.0f/100);
+        REQUIRE( out_u8 == ref_u8 );
+        vrt_ci16_to_cs8(in.data(), out_s8.data(), n, 1.0f/100);
+        REQUIRE( out_s8 == ref_s8 );
+        // integer valued, so the sums are exact
+        std::vector<double> power(n, 1.0);
+        vrt_accumulate_power(ref64.data(), power.data(), n);
+        vrt_accumulate_power(ref64_shift.data(), power.data(), n);
+        REQUIRE( power == ref_power );
+        std::vector<double> power32(n, 1.0);
+        vrt_accumulate_power(ref32.data(), power32.data(), n);
+        REQUIRE( power32 == ref_power32 );
+        std::vector<std::complex<float>> weighted(n, 1.0f);
+        vrt_accumulate_weighted(weights.data(), ref32_shift.data(), weighted.data(), n);
+        REQUIRE( weighted == ref_weighted );
+        std::vector<double> acc(n, 1.0), acc2(n, 2.0), max(n, 500.0), min(n, 500.0);
+        vrt_accumulate_moments(block.data(), acc.data(), acc2.data(), max.data(), min.data(), n);
+        REQUIRE( acc == ref_acc );
+        REQUIRE( acc2 == ref_acc2 );
+        REQUIRE( max == ref_max );
+        REQUIRE( min == ref_min );
+        std::vector<std::complex<double>> cross(n, 1.0);
+        std::vector<double> mag(n, 2.0);
+        vrt_accumulate_cross(cross_x.data(), cross_y.data(), cross.data(), mag.data(), n);
+        REQUIRE( cross == ref_cross );
+        REQUIRE( mag == ref_mag );
+        std::vector<std::complex<double>> cross32(n, 1.0);
+        std::vector<double> mag32(n, 2.0);
+        vrt_accumulate_cross(cross_x32.data(), cross_y32.data(), cross32.data(), mag32.data(), n);
+        REQUIRE( cross32 == ref_cross32 );
+        REQUIRE( mag32 == ref_mag32 );
+        // the same integer values
+        REQUIRE( cross32 == ref_cross );
+    }
+}
+
+TEST_CASE( "Scalar conversion values", "[vrt-convert]" ) {
+    uint32_t in[3];
+    int16_t s[6] = { 1000, -2000, 32767, -32768, -3, 5 };
+    memcpy(in, s, sizeof(in));
+
+    REQUIRE( vrt_convert_set_simd_level(VRT_SIMD_SCALAR) );
+
+    std::complex<double> c[3];
+    vrt_ci16_to_cf64(in, c, 3, 0.5, true);
+    REQUIRE( c[0] == std::complex<double>(500, -1000) );
+    REQUIRE( c[1] == std::complex<double>(-16383.5, 16384) );
+    REQUIRE( c[2] == std::complex<double>(-1.5, 2.5) );
+
+    uint8_t u8[6];
+    vrt_ci16_to_cu8(in, u8, 3, 1.0f);
+    REQUIRE( u8[0] == 255 );
+    REQUIRE( u8[1] == 0 );
+    REQUIRE( u8[4] == 125 );
+    REQUIRE( u8[5] == 133 );
+
+    std::complex<double> x[2] = {{3, 4}, {1, -2}}, y[2] = {{0, 2}, {-1, 1}};
+    std::complex<double> cross[2] = {0, 1};
+    double mag[2] = {0, 0};
+    vrt_accumulate_cross(x, y, cross, mag, 2);
+    REQUIRE( cross[0] == std::complex<double>(8, -6) );
+    REQUIRE( cross[1] == std::complex<double>(-2, 1) );
+    REQUIRE( mag[0] == 10 );
+    REQUIRE( mag[1] == sqrt(10.0) );
+
+    int8_t s8[6];
+    vrt_ci16_to_cs8(in, s8, 3, 1.0f/256);
+    REQUIRE( s8[0] == 4 );
+    REQUIRE( s8[1] == -8 );
+    REQUIRE( s8[2] == 127 );
+    REQUIRE( s8[3] == -128 );
+}
+
+TEST_CASE( "Compact payloads decode to ci16", "[vrt-convert]" ) {
+    const size_t n = 1003;
+    std::vector<uint32_t> in = make_samples(n);
+
+    // 8 and 12 bit values survive the round trip, larger ones saturate
+    std::vector<uint32_t> small(n);
+    for (size_t i = 0; i < n; i++) {
+        int16_t re = (int16_t)((int)(i % 4096) - 2048);
+        int16_t img = (int16_t)(2047 - (int)(i * 13 % 4096));
+        small[i] = (uint16_t)re | ((uint32_t)(uint16_t)img << 16);
+    }
+
+    for (vrt_simd_level level : supported_levels()) {
+        INFO( "kernel set " << vrt_convert_simd_name(level) );
+        REQUIRE( vrt_convert_set_simd_level(level) );
+
+        std::vector<uint32_t> payload(2*n), out(n);
+
+        REQUIRE( vrt_ci16_to_payload(small.data(), payload.data(), n, VRT_FORMAT_CI12) == vrt_payload_words(n, VRT_FORMAT_CI12) );
+        vrt_payload_to_ci16(payload.data(), VRT_FORMAT_CI12, out.data(), n);
+        REQUIRE( out == small );
+
+        REQUIRE( vrt_ci16_to_payload(in.data(), payload.data(), n, VRT_FORMAT_CF32) == 2*n );
+        vrt_payload_to_ci16(payload.data(), VRT_FORMAT_CF32, out.data(), n);
+        REQUIRE( out == in );
+
+        REQUIRE( vrt_ci16_to_payload(in.data(), payload.data(), n, VRT_FORMAT_CI8) == (n + 1)/2 );
+        vrt_payload_to_ci16(payload.data(), VRT_FORMAT_CI8, out.data(), n);
+        for (size_t i = 0; i < n; i++) {
+            int16_t re = (int16_t)(in[i] & 0xFFFF);
+            int16_t img = (int16_t)(in[i] >> 16);
+            re = re > 127 ? 127 : (re < -128 ? -128 : re);
+            img = img > 127 ? 127 : (img < -128 ? -128 : img);
+            REQUIRE( out[i] == ((uint16_t)re | ((uint32_t)(uint16_t)img << 16)) );
+        }
+
+        // cf32 payloads keep their precision as floats
+        float f[4] = { 0.25f, -1.5f, 40000.0f, -40000.0f };
+        std::complex<double> c[2];
+        vrt_payload_to_cf64((const uint32_t*)f, VRT_FORMAT_CF32, c, 2, 2.0, true);
+        REQUIRE( c[0] == std::complex<double>(0.5, -3.0) );
+        REQUIRE( c[1] == std::complex<double>(-80000.0, 80000.0) );
+        vrt_cf32_to_ci16((const uint32_t*)f, out.data(), 2);
+        REQUIRE( out[1] == ((uint16_t)32767 | ((uint32_t)(uint16_t)-32768 << 16)) );
+    }
+}
@@ -0,0 +1,176 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <string>
+
+#include "vrt-delay-model.h"
+
+static std::string write_model(const char* name, const char* text) {
+    std::string path = std::string("/tmp/vrt_test_delay_") + name + "_" + std::to_string(getpid()) + ".txt";
+    FILE* fp = fopen(path.c_str(), "w");
+    fputs(text, fp);
+    fclose(fp);
+    return path;
+}
+
+// w = 100 + 2t - 0.5t^2 + 0.01t^3, u = 10t, v = -5 (t after 1767225600)
+static double cubic(double t) {
+    return 100 + 2*t - 0.5*t*t + 0.01*t*t*t;
+}
+
+TEST_CASE( "A delay table is interpolated with a cubic", "[vrt-delay-model]" ) {
+    std::string text = "# time, w, u, v\n";
+    for (int t = 0; t <= 50; t += 10) {
+        char line[128];
+        snprintf(line, sizeof(line), "%d.000000000 %.12e %.12e -5\n", 1767225600 + t, cubic(t), 10.0*t);
+        text += line;
+    }
+    std::string path = write_model("table", text.c_str());
+
+    vrt_delay_model model;
+    REQUIRE( vrt_delay_model_load(path, &model) );
+    REQUIRE( model.epoch == 1767225600 );
+    REQUIRE( not model.per_station );
+    REQUIRE( model.tracks.size() == 1 );
+    REQUIRE( model.tracks[0].times.size() == 6 );
+
+    vrt_delay_value value;
+    for (double t : {0.0, 3.25, 17.5, 31.000001, 49.9, 50.0}) {
+        INFO( "t " << t );
+        int64_t seconds = 1767225600 + (int64_t)t;
+        uint64_t picoseconds = (uint64_t)((t - (int64_t)t)*1e12 + 0.5);
+        REQUIRE( vrt_delay_model_eval(&model, seconds, picoseconds, &value) );
+        REQUIRE( value.w == Catch::Approx(cubic(t)).epsilon(1e-12) );
+        REQUIRE( value.w_dot == Catch::Approx(2 - t + 0.03*t*t).epsilon(1e-9) );
+        REQUIRE( value.u == Catch::Approx(10*t).margin(1e-9) );
+        REQUIRE( value.v == Catch::Approx(-5) );
+    }
+
+    // outside the table
+    value.w = 1;
+    REQUIRE( not vrt_delay_model_eval(&model, 1767225651, 0, &value) );
+    REQUIRE( not vrt_delay_model_eval(&model, 1767225599, 0, &value) );
+    REQUIRE( value.w == 1 );
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Polynomial segments take precedence over the table", "[vrt-delay-model]" ) {
+    std::string path = write_model("poly",
+        "1767225600 0 0 0\n"
+        "1767225700 0 0 0\n"
+        "poly 1767225650.5 20 w 1000 3 0.25  # mid, span, quantity, coefficients\n"
+        "poly 1767225650.5 20 u 7\n"
+        "poly 1767225650.5 20 v 8 1\n");
+
+    vrt_delay_model model;
+    REQUIRE( vrt_delay_model_load(path, &model) );
+    REQUIRE( model.tracks[0].segments[VRT_DELAY_W].size() == 1 );
+
+    vrt_delay_value value;
+    REQUIRE( vrt_delay_model_eval(&model, 1767225652, 500000000000ull, &value) );
+    REQUIRE( value.w == Catch::Approx(1000 + 3*2 + 0.25*4) );
+    REQUIRE( value.w_dot == Catch::Approx(3 + 0.5*2) );
+    REQUIRE( value.u == 7 );
+    REQUIRE( value.v == Catch::Approx(10) );
+
+    // beyond the span the table is used
+    REQUIRE( vrt_delay_model_eval(&model, 1767225670, 0, &value) );
+    REQUIRE( value.w == 0 );
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Polycos of w only leave u and v unmodeled", "[vrt-delay-model]" ) {
+    std::string path = write_model("w", "poly 1767225650.5 20 w 1000 3\n");
+
+    vrt_delay_model model;
+    REQUIRE( vrt_delay_model_load(path, &model) );
+
+    vrt_delay_value value;
+    REQUIRE( vrt_delay_model_eval(&model, 1767225650, 500000000000ull, &value) );
+    REQUIRE( value.w == Catch::Approx(1000) );
+    REQUIRE( value.w_dot == Catch::Approx(3) );
+    REQUIRE( std::isnan(value.u) );
+    REQUIRE( std::isnan(value.v) );
+
+    REQUIRE( not vrt_delay_model_eval(&model, 1767225670, 0, &value) );
+    unlink(path.c_str());
+}
+
+TEST_CASE( "A per-station model has a track per station", "[vrt-delay-model]" ) {
+    std::string path = write_model("stations",
+        "station 0\n"
+        "poly 1767225650 100 w 0\n"
+        "station 2  # the third channel\n"
+        "1767225600 -10 100 5\n"
+        "1767225700 10 100 5\n"
+        "station 1\n"
+        "poly 1767225650 100 w 20 0.5\n"
+        "poly 1767225650 100 u -50\n"
+        "poly 1767225650 100 v 3\n");
+
+    vrt_delay_model model;
+    REQUIRE( vrt_delay_model_load(path, &model) );
+    REQUIRE( model.per_station );
+    REQUIRE( model.tracks.size() == 3 );
+
+    vrt_delay_value value;
+    REQUIRE( vrt_delay_model_eval(&model, 1767225660, 0, &value, 0) );
+    REQUIRE( value.w == 0 );
+    REQUIRE( std::isnan(value.u) );
+    REQUIRE( vrt_delay_model_eval(&model, 1767225660, 0, &value, 1) );
+    REQUIRE( value.w == Catch::Approx(25) );
+    REQUIRE( value.w_dot == Catch::Approx(0.5) );
+    REQUIRE( value.u == -50 );
+    REQUIRE( vrt_delay_model_eval(&model, 1767225660, 0, &value, 2) );
+    REQUIRE( value.w == Catch::Approx(2) );
+    REQUIRE( value.w_dot == Catch::Approx(0.2) );
+    REQUIRE( value.v == Catch::Approx(5) );
+    REQUIRE( not vrt_delay_model_eval(&model, 1767225660, 0, &value, 3) );
+    unlink(path.c_str());
+
+    // every station needs a w, and baseline lines do not mix with stations
+    path = write_model("gap", "station 0\npoly 1767225650 100 w 0\nstation 2\npoly 1767225650 100 w 1\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("mixed", "poly 1767225650 100 w 0\nstation 1\npoly 1767225650 100 w 1\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("station", "station one\npoly 1767225650 100 w 0\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Malformed delay models are rejected", "[vrt-delay-model]" ) {
+    vrt_delay_model model;
+    REQUIRE( not vrt_delay_model_load("/nonexistent/delay.txt", &model) );
+
+    std::string path = write_model("empty", "# nothing\n\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("order", "1767225610 0 0 0\n1767225600 0 0 0\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("fields", "1767225600 0 0\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("quantity", "poly 1767225600 10 x 1 2\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+
+    path = write_model("no_w", "poly 1767225600 10 u 1 2\npoly 1767225600 10 v 3\n");
+    REQUIRE( not vrt_delay_model_load(path, &model) );
+    unlink(path.c_str());
+}
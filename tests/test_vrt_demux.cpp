@@ -0,0 +1,115 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "vrt-demux.h"
+
+static int32_t write_data_packet(uint32_t* buffer, uint32_t stream_id, uint8_t counter) {
+    static uint32_t samples[100] = {0};
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p, 100);
+    p.fields.stream_id = stream_id;
+    p.header.packet_count = counter;
+    p.fields.integer_seconds_timestamp = 1700000000 + counter;
+    p.body = samples;
+    return vrt_write_packet(&p, buffer, VRT_DATA_PACKET_WORDS(100), true);
+}
+
+static void count_packets(vrt_stream_state* stream, const packet_type* vrt_packet, uint32_t* buffer, void* data) {
+    (*(uint32_t*)data)++;
+}
+
+TEST_CASE( "Demux routes packets to per-stream state", "[vrt-demux]" ) {
+    vrt_demux demux;
+    REQUIRE( vrt_demux_init(&demux, {2, 0}) );
+    REQUIRE( demux.num_streams == 2 );
+    REQUIRE( demux.channel_filt == 0x5 );
+
+    uint32_t handler_calls = 0;
+    vrt_demux_set_handler(&demux, 1, count_packets, &handler_calls);
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    packet_type vrt_packet;
+    vrt_stream_state* stream;
+
+    // streams are kept in the order they were given
+    REQUIRE( write_data_packet(buffer, 1 << 2, 0) > 0 );
+    REQUIRE( vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream) );
+    REQUIRE( vrt_packet.data );
+    REQUIRE( stream == &demux.streams[0] );
+    REQUIRE( stream->channel == 2 );
+    REQUIRE( vrt_packet.first_frame );
+    REQUIRE( stream->context.starttime_integer == 1700000000 );
+
+    REQUIRE( write_data_packet(buffer, 1 << 0, 1) > 0 );
+    REQUIRE( vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream) );
+    REQUIRE( vrt_demux_index(&demux, stream) == 1 );
+    REQUIRE( handler_calls == 1 );
+
+    // packet counters are checked per stream
+    REQUIRE( write_data_packet(buffer, 1 << 2, 1) > 0 );
+    REQUIRE( vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream) );
+    REQUIRE( not vrt_packet.lost_frame );
+    REQUIRE( not vrt_packet.first_frame );
+
+    REQUIRE( write_data_packet(buffer, 1 << 0, 4) > 0 );
+    REQUIRE( vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream) );
+    REQUIRE( vrt_packet.lost_frame );
+    REQUIRE( demux.streams[1].lost_frames == 1 );
+    REQUIRE( demux.streams[0].lost_frames == 0 );
+    REQUIRE( demux.streams[0].packets == 2 );
+    REQUIRE( demux.streams[0].samples == 200 );
+
+    // streams that are not selected are skipped
+    REQUIRE( write_data_packet(buffer, 1 << 1, 0) > 0 );
+    REQUIRE( vrt_demux_process(&demux, buffer, ZMQ_BUFFER_SIZE, &vrt_packet, &stream) );
+    REQUIRE( not vrt_packet.data );
+    REQUIRE( stream == NULL );
+    REQUIRE( handler_calls == 2 );
+}
+
+TEST_CASE( "Demux stores the context per stream", "[vrt-demux]" ) {
+    vrt_demux demux;
+    REQUIRE( vrt_demux_init(&demux, {0, 1}) );
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    packet_type vrt_packet;
+    vrt_stream_state* stream;
+
+    for (uint32_t ch = 0; ch < 2; ch++) {
+        struct vrt_packet pc;
+        vrt_init_packet(&pc);
+        vrt_init_context_packet(&pc);
+        pc.fields.stream_id = 1 << ch;
+        pc.if_context.sample_rate = 1e6 * (ch + 1);
+        pc.if_context.rf_reference_frequency = 1420e6;
+        int32_t rv = vrt_write_packet(&pc, buffer, ZMQ_BUFFER_SIZE, true);
+        REQUIRE( rv > 0 );
+        REQUIRE( vrt_demux_process(&demux, buffer, rv, &vrt_packet, &stream) );
+        REQUIRE( vrt_packet.context );
+        REQUIRE( stream == &demux.streams[ch] );
+    }
+
+    REQUIRE( demux.streams[0].context.context_received );
+    REQUIRE( demux.streams[0].context.sample_rate == 1000000 );
+    REQUIRE( demux.streams[1].context.sample_rate == 2000000 );
+    REQUIRE( demux.streams[1].context.rf_freq == 1420000000 );
+}
+
+TEST_CASE( "Demux rejects too many channels", "[vrt-demux]" ) {
+    vrt_demux demux;
+    std::vector<size_t> channels;
+    for (size_t ch = 0; ch <= MAX_CHANNELS; ch++)
+        channels.push_back(ch);
+    REQUIRE( not vrt_demux_init(&demux, channels) );
+    REQUIRE( not vrt_demux_init(&demux, {32}) );
+
+    // the highest channel is the sign bit of the stream id
+    REQUIRE( vrt_demux_init(&demux, {31, 0}) );
+    REQUIRE( demux.channel_filt == 0x80000001u );
+    REQUIRE( vrt_demux_stream(&demux, 0x80000000u) == &demux.streams[0] );
+}
@@ -0,0 +1,173 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-fft.h"
+
+// Tone in bin k, amplitude a
+template <typename T>
+static void fill_tone(std::complex<T>* block, uint32_t num_bins, uint32_t k, double a) {
+    for (uint32_t i = 0; i < num_bins; i++)
+        block[i] = std::complex<T>(std::polar(a, 2*M_PI*(double)(k*i)/num_bins));
+}
+
+TEST_CASE( "Batched FFT accumulates the power of all blocks", "[vrt-fft]" ) {
+    const uint32_t num_bins = 64;
+
+    for (vrt_fft_precision precision : {VRT_FFT_DOUBLE, VRT_FFT_FLOAT})
+    for (uint32_t threads : {1, 3}) {
+        INFO( "precision " << precision << ", threads " << threads );
+        vrt_fft_engine* engine = vrt_fft_engine_create(num_bins, 4, threads, true, precision);
+        REQUIRE( engine != NULL );
+
+        // 10 blocks: full batches and a partial one at the reduce
+        for (uint32_t b = 0; b < 10; b++) {
+            if (precision == VRT_FFT_FLOAT)
+                fill_tone(vrt_fft_engine_input_f(engine), num_bins, 5, 1.0 + b);
+            else
+                fill_tone(vrt_fft_engine_input(engine), num_bins, 5, 1.0 + b);
+            vrt_fft_engine_push(engine);
+        }
+
+        std::vector<double> magnitudes(num_bins, 0), phases_r(num_bins, 0), phases_i(num_bins, 0);
+        vrt_fft_engine_reduce(engine, magnitudes.data(), phases_r.data(), phases_i.data());
+
+        // sum of (N*a)^2 for a = 1..10
+        double expected = 0;
+        for (uint32_t b = 0; b < 10; b++)
+            expected += (double)num_bins*num_bins*(1.0 + b)*(1.0 + b);
+        REQUIRE( magnitudes[5] == Catch::Approx(expected) );
+        REQUIRE( phases_r[5] == Catch::Approx(55.0*num_bins) );
+        REQUIRE( fabs(phases_i[5]) < 1e-3 );
+        for (uint32_t i = 0; i < num_bins; i++)
+            if (i != 5)
+                REQUIRE( magnitudes[i] < 1e-9*expected );
+
+        // the partial sums are reset
+        std::vector<double> empty(num_bins, 0);
+        vrt_fft_engine_reduce(engine, empty.data());
+        REQUIRE( empty == std::vector<double>(num_bins, 0) );
+
+        vrt_fft_engine_destroy(engine);
+    }
+}
+
+TEST_CASE( "Batched FFT keeps the power statistics per bin", "[vrt-fft]" ) {
+    const uint32_t num_bins = 32, blocks = 600;
+
+    for (uint32_t threads : {1, 3}) {
+        INFO( "threads " << threads );
+        vrt_fft_engine* engine = vrt_fft_engine_create(num_bins, 8, threads, false, VRT_FFT_FLOAT);
+        REQUIRE( engine != NULL );
+        vrt_fft_engine_enable_stats(engine, true);
+
+        // amplitudes 1, 2, 3 in turn: powers of 1, 4 and 9 times N^2
+        for (uint32_t b = 0; b < blocks; b++) {
+            fill_tone(vrt_fft_engine_input_f(engine), num_bins, 5, 1.0 + b % 3);
+            vrt_fft_engine_push(engine);
+        }
+
+        std::vector<double> magnitudes(num_bins, 0), power2(num_bins, 0), max(num_bins), min(num_bins), median(num_bins);
+        vrt_fft_stats stats = {power2.data(), max.data(), min.data(), median.data()};
+        vrt_fft_engine_reduce(engine, magnitudes.data(), NULL, NULL, &stats);
+
+        double unit = (double)num_bins*num_bins;
+        REQUIRE( magnitudes[5] == Catch::Approx(blocks/3*14*unit) );
+        REQUIRE( power2[5] == Catch::Approx(blocks/3*98*unit*unit) );
+        REQUIRE( max[5] == Catch::Approx(9*unit) );
+        REQUIRE( min[5] == Catch::Approx(unit) );
+        REQUIRE( median[5] == Catch::Approx(4*unit).epsilon(0.2) );
+
+        // reset for the next integration
+        fill_tone(vrt_fft_engine_input_f(engine), num_bins, 5, 2.0);
+        vrt_fft_engine_push(engine);
+        std::fill(power2.begin(), power2.end(), 0);
+        vrt_fft_engine_reduce(engine, magnitudes.data(), NULL, NULL, &stats);
+        REQUIRE( power2[5] == Catch::Approx(16*unit*unit) );
+        REQUIRE( max[5] == Catch::Approx(4*unit) );
+        REQUIRE( min[5] == Catch::Approx(4*unit) );
+        REQUIRE( median[5] == Catch::Approx(4*unit) );
+
+        vrt_fft_engine_destroy(engine);
+    }
+}
+
+TEST_CASE( "Single FFT in both precisions", "[vrt-fft]" ) {
+    const uint32_t n = 32;
+    // ci16 samples of a constant (1000, -500)
+    std::vector<uint32_t> payload(n, (uint16_t)1000 | ((uint32_t)(uint16_t)-500 << 16));
+
+    for (vrt_fft_precision precision : {VRT_FFT_DOUBLE, VRT_FFT_FLOAT}) {
+        INFO( "precision " << precision );
+        vrt_fft* fft = vrt_fft_create(n, precision);
+        vrt_fft_load(fft, 0, payload.data(), VRT_FORMAT_CI16, n/2);
+        vrt_fft_load(fft, n/2, payload.data(), VRT_FORMAT_CI16, n/2);
+        REQUIRE( vrt_fft_input(fft, n-1) == std::complex<double>(1000, -500) );
+        vrt_fft_execute(fft);
+
+        // all power in the DC bin
+        REQUIRE( vrt_fft_power(fft, 0) == Catch::Approx(n*n*(1000.0*1000 + 500.0*500)) );
+        std::vector<double> acc(n, 0);
+        vrt_fft_accumulate_power(fft, acc.data());
+        REQUIRE( acc[0] == Catch::Approx(vrt_fft_power(fft, 0)) );
+        for (uint32_t i = 1; i < n; i++)
+            REQUIRE( acc[i] < 1e-6*acc[0] );
+        vrt_fft_destroy(fft);
+    }
+}
+
+TEST_CASE( "Planner effort names", "[vrt-fft]" ) {
+    vrt_fft_effort effort;
+    REQUIRE( vrt_parse_fft_effort("measure", &effort) );
+    REQUIRE( effort == VRT_FFT_MEASURE );
+    REQUIRE( vrt_parse_fft_effort("patient", &effort) );
+    REQUIRE( effort == VRT_FFT_PATIENT );
+    REQUIRE( vrt_parse_fft_effort("estimate", &effort) );
+    REQUIRE( effort == VRT_FFT_ESTIMATE );
+    REQUIRE_FALSE( vrt_parse_fft_effort("exhaustive", &effort) );
+}
+
+TEST_CASE( "Measured plans keep the arrays and are cached", "[vrt-fft]" ) {
+    char dir[] = "/tmp/vrt_test_wisdom_XXXXXX";
+    REQUIRE( mkdtemp(dir) != NULL );
+    std::string cache = std::string(dir) + "/cache";
+    vrt_fft_set_effort(VRT_FFT_MEASURE, cache);
+
+    // an unusual size, not in the wisdom of earlier plans
+    const int n = 96, howmany = 3;
+    std::complex<float>* in = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * n*howmany);
+    std::complex<float>* out = (std::complex<float>*) fftwf_malloc(sizeof(fftwf_complex) * n*howmany);
+    for (int i = 0; i < n*howmany; i++) {
+        in[i] = std::complex<float>(i, -i);
+        out[i] = 7;
+    }
+    fftwf_plan plan = vrt_fft_plan(n, howmany, reinterpret_cast<fftwf_complex*>(in),
+        reinterpret_cast<fftwf_complex*>(out), FFTW_FORWARD);
+    REQUIRE( plan != NULL );
+    for (int i = 0; i < n*howmany; i++) {
+        REQUIRE( in[i] == std::complex<float>(i, -i) );
+        REQUIRE( out[i] == std::complex<float>(7) );
+    }
+
+    std::string file = vrt_fft_wisdom_file(VRT_FFT_FLOAT);
+    REQUIRE( file == cache + "/wisdom-float" );
+    REQUIRE( access(file.c_str(), R_OK) == 0 );
+
+    vrt_fft_set_effort(VRT_FFT_ESTIMATE);
+    fftwf_destroy_plan(plan);
+    fftwf_free(in);
+    fftwf_free(out);
+    unlink(file.c_str());
+    rmdir(cache.c_str());
+    rmdir(dir);
+}
@@ -0,0 +1,103 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "vrt-filterbank.h"
+
+using Catch::Approx;
+
+static std::string read_keyword(FILE* fp) {
+    int32_t len = 0;
+    REQUIRE( fread(&len, sizeof(len), 1, fp) == 1 );
+    REQUIRE( len > 0 );
+    REQUIRE( len < 80 );
+    std::string keyword(len, ' ');
+    REQUIRE( fread(&keyword[0], len, 1, fp) == 1 );
+    return keyword;
+}
+
+template <typename T> static T read_value(FILE* fp) {
+    T value;
+    REQUIRE( fread(&value, sizeof(value), 1, fp) == 1 );
+    return value;
+}
+
+TEST_CASE( "Band edges follow the channel order", "[vrt-filterbank]" ) {
+    vrt_filterbank_header h;
+
+    vrt_filterbank_set_band(&h, 1420e6, 2e6, 1024, false);
+    REQUIRE( h.nchans == 1024 );
+    REQUIRE( h.fch1 == Approx(1419.0) );
+    REQUIRE( h.foff == Approx(2.0/1024) );
+
+    vrt_filterbank_set_band(&h, 1420e6, 2e6, 1024, true);
+    REQUIRE( h.fch1 == Approx(1421.0) );
+    REQUIRE( h.foff == Approx(-2.0/1024) );
+
+    REQUIRE( vrt_filterbank_mjd(0, 0) == Approx(40587.0) );
+    REQUIRE( vrt_filterbank_mjd(43200, 0) == Approx(40587.5) );
+}
+
+TEST_CASE( "The header is written as sigproc keywords", "[vrt-filterbank]" ) {
+    std::string name = "/tmp/vrt_test_filterbank_" + std::to_string(getpid()) + ".fil";
+
+    vrt_filterbank_header h;
+    h.source_name = "Sun";
+    vrt_filterbank_set_band(&h, 1420e6, 2e6, 256, true);
+    h.tstart = 60000.25;
+    h.tsamp = 0.01;
+    h.position = true;
+    h.src_raj = 123456.0;
+
+    FILE* fp = fopen(name.c_str(), "wb");
+    REQUIRE( fp != NULL );
+    vrt_filterbank_write_header(fp, &h);
+    fclose(fp);
+
+    fp = fopen(name.c_str(), "rb");
+    REQUIRE( fp != NULL );
+    REQUIRE( read_keyword(fp) == "HEADER_START" );
+
+    int keywords = 0;
+    bool seen_source = false, seen_foff = false, seen_raj = false;
+    for (std::string keyword = read_keyword(fp); keyword != "HEADER_END"; keyword = read_keyword(fp)) {
+        keywords++;
+        if (keyword == "source_name") {
+            REQUIRE( read_keyword(fp) == "Sun" );
+            seen_source = true;
+        } else if (keyword == "fch1") {
+            REQUIRE( read_value<double>(fp) == Approx(1421.0) );
+        } else if (keyword == "foff") {
+            REQUIRE( read_value<double>(fp) == Approx(-2.0/256) );
+            seen_foff = true;
+        } else if (keyword == "src_raj") {
+            REQUIRE( read_value<double>(fp) == 123456.0 );
+            seen_raj = true;
+        } else if (keyword == "nchans") {
+            REQUIRE( read_value<int32_t>(fp) == 256 );
+        } else if (keyword == "tstart" or keyword == "tsamp" or keyword == "src_dej"
+                or keyword == "az_start" or keyword == "za_start") {
+            read_value<double>(fp);
+        } else {
+            read_value<int32_t>(fp);
+        }
+    }
+    REQUIRE( keywords == 17 );
+    REQUIRE( seen_source );
+    REQUIRE( seen_foff );
+    REQUIRE( seen_raj );
+
+    // nothing follows the header
+    char c;
+    REQUIRE( fread(&c, 1, 1, fp) == 0 );
+    fclose(fp);
+    unlink(name.c_str());
+}
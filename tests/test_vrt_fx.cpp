@@ -0,0 +1,151 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-fx.h"
+
+// Tones at bins 3, 10 and -5 of n, arriving advance samples early
+static std::complex<double> tones(double k, uint32_t n, double advance) {
+    const double bins[] = {3, 10, -5};
+    const double amplitudes[] = {1, 0.5, 2};
+    std::complex<double> x = 0;
+    for (int j = 0; j < 3; j++)
+        x += std::polar(amplitudes[j], 2*M_PI*bins[j]*(k + advance)/n);
+    return x;
+}
+
+TEST_CASE( "FX baselines are the crosses, then the autos", "[vrt-fx]" ) {
+    std::vector<vrt_fx_baseline> baselines = vrt_fx_baselines(3);
+    REQUIRE( baselines.size() == 6 );
+    const uint32_t expected[6][2] = {{0, 1}, {0, 2}, {1, 2}, {0, 0}, {1, 1}, {2, 2}};
+    for (int b = 0; b < 6; b++) {
+        REQUIRE( baselines[b].a == expected[b][0] );
+        REQUIRE( baselines[b].b == expected[b][1] );
+    }
+    REQUIRE( vrt_fx_baselines(6, false).size() == 15 );
+}
+
+TEST_CASE( "FX correlator removes the station delays", "[vrt-fx]" ) {
+    const uint32_t n = 64, stations = 3;
+    const double sample_rate = 1e6;
+    // in samples: whole and fractional parts
+    const double advance[stations] = {3.3, -1.2, 0.4};
+    double delay[stations], phase[stations] = {0, 0, 0};
+    for (uint32_t s = 0; s < stations; s++)
+        delay[s] = advance[s]/sample_rate;
+
+    vrt_fx* fx = vrt_fx_create(stations, n);
+    REQUIRE( fx != NULL );
+    vrt_fx_set_delays(fx, delay, phase, sample_rate, 0);
+    REQUIRE( vrt_fx_shift(fx, 0) == 4 );
+    REQUIRE( vrt_fx_shift(fx, 1) == 0 );
+    REQUIRE( vrt_fx_shift(fx, 2) == 1 );
+
+    // each input taken shift samples further back
+    for (int block = 0; block < 2; block++) {
+        for (uint32_t s = 0; s < stations; s++)
+            for (uint32_t k = 0; k < n; k++)
+                vrt_fx_input(fx, s)[k] = tones((double)block*n + k - vrt_fx_shift(fx, s), n, advance[s]);
+        vrt_fx_push(fx);
+    }
+    vrt_fx_flush(fx);
+
+    // cross spectra in phase at the tones, autos the power
+    const std::vector<vrt_fx_baseline>& baselines = vrt_fx_baseline_list(fx);
+    for (uint32_t b = 0; b < baselines.size(); b++) {
+        INFO( "baseline " << baselines[b].a << "-" << baselines[b].b );
+        std::complex<double>* v = vrt_fx_visibility(fx, b);
+        REQUIRE( v[3].real() == Catch::Approx(2*n*n) );
+        REQUIRE( v[3].imag() == Catch::Approx(0).margin(1e-6*n*n) );
+        REQUIRE( v[n - 5].real() == Catch::Approx(2*4*n*n) );
+        REQUIRE( v[n - 5].imag() == Catch::Approx(0).margin(1e-6*n*n) );
+        REQUIRE( std::abs(v[20]) == Catch::Approx(0).margin(1e-6*n*n) );
+    }
+
+    vrt_fx_normalize(fx);
+    REQUIRE( vrt_fx_visibility(fx, 0)[10].real() == Catch::Approx(1) );
+    REQUIRE( vrt_fx_visibility(fx, 3)[10].real() == Catch::Approx(2*0.25*n*n) );
+
+    vrt_fx_reset(fx);
+    REQUIRE( vrt_fx_visibility(fx, 2)[3] == 0.0 );
+    vrt_fx_destroy(fx);
+}
+
+TEST_CASE( "FX station phases rotate the cross spectra", "[vrt-fx]" ) {
+    const uint32_t n = 32;
+    double delay[2] = {0, 0}, phase[2] = {0, 90};
+
+    vrt_fx* fx = vrt_fx_create(2, n, false);
+    REQUIRE( fx != NULL );
+    vrt_fx_set_delays(fx, delay, phase, 1e6, 100e6);
+    for (uint32_t s = 0; s < 2; s++)
+        for (uint32_t k = 0; k < n; k++)
+            vrt_fx_input(fx, s)[k] = tones(k, n, 0);
+    vrt_fx_push(fx);
+    vrt_fx_flush(fx);
+
+    // X0 conj(X1 e^-i90)
+    std::complex<double> v = vrt_fx_visibility(fx, 0)[3];
+    REQUIRE( std::arg(v) == Catch::Approx(M_PI/2) );
+    vrt_fx_destroy(fx);
+}
+
+TEST_CASE( "FX correlator gives the same spectra batched, threaded and in float", "[vrt-fx]" ) {
+    const uint32_t n = 1024, stations = 4, blocks = 11;
+    const double sample_rate = 1e6;
+    double delay[stations], phase[stations] = {0, 30, 0, -45};
+    const double advance[stations] = {0.25, 2.5, -3.75, 1};
+
+    vrt_fx* reference = vrt_fx_create(stations, n);
+    vrt_fx* threaded = vrt_fx_create(stations, n, true, VRT_FFT_DOUBLE, 4, 3);
+    vrt_fx* single = vrt_fx_create(stations, n, true, VRT_FFT_FLOAT, 4, 2);
+    REQUIRE( threaded != NULL );
+    REQUIRE( single != NULL );
+
+    for (uint32_t block = 0; block < blocks; block++) {
+        // a delay changing with every block
+        for (uint32_t s = 0; s < stations; s++)
+            delay[s] = (advance[s] + 0.1*block)/sample_rate;
+        for (vrt_fx* fx : {reference, threaded, single}) {
+            vrt_fx_set_delays(fx, delay, phase, sample_rate, 10e6);
+            for (uint32_t s = 0; s < stations; s++) {
+                for (uint32_t k = 0; k < n; k++) {
+                    std::complex<double> x = tones((double)block*n + k, n, s) + std::polar(0.1, 0.7*k*(s + 1));
+                    if (vrt_fx_input_f(fx, s))
+                        vrt_fx_input_f(fx, s)[k] = std::complex<float>(x);
+                    else
+                        vrt_fx_input(fx, s)[k] = x;
+                }
+            }
+            vrt_fx_push(fx);
+        }
+    }
+
+    for (vrt_fx* fx : {reference, threaded, single})
+        vrt_fx_flush(fx);
+
+    for (uint32_t b = 0; b < vrt_fx_baseline_list(reference).size(); b++) {
+        INFO( "baseline " << b );
+        const std::complex<double>* r = vrt_fx_visibility(reference, b);
+        const std::complex<double>* t = vrt_fx_visibility(threaded, b);
+        const std::complex<double>* f = vrt_fx_visibility(single, b);
+        double scale = vrt_fx_magnitude(reference, b)[3];
+        for (uint32_t i = 0; i < n; i++) {
+            REQUIRE( std::abs(t[i] - r[i]) <= 1e-9*scale );
+            REQUIRE( std::abs(f[i] - r[i]) <= 1e-4*scale );
+            REQUIRE( vrt_fx_magnitude(threaded, b)[i] == Catch::Approx(vrt_fx_magnitude(reference, b)[i]) );
+        }
+    }
+
+    vrt_fx_destroy(reference);
+    vrt_fx_destroy(threaded);
+    vrt_fx_destroy(single);
+}
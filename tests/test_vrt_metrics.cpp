@@ -0,0 +1,57 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "vrt-metrics.h"
+
+TEST_CASE( "Metrics are formatted as Prometheus text", "[vrt-metrics]" ) {
+    vrt_metrics metrics = {};
+    metrics.packets = 12;
+    metrics.lost_samples = 20000;
+    metrics.stage_ns[VRT_STAGE_FFT] = 1500000000;
+    metrics.latency_ns = 250000000;
+
+    std::string text = vrt_metrics_text(&metrics, "vrt_spectrum");
+    REQUIRE( text.find("# TYPE vrt_packets_total counter\n") != std::string::npos );
+    REQUIRE( text.find("vrt_packets_total{tool=\"vrt_spectrum\"} 12\n") != std::string::npos );
+    REQUIRE( text.find("vrt_lost_samples_total{tool=\"vrt_spectrum\"} 20000\n") != std::string::npos );
+    REQUIRE( text.find("vrt_stage_seconds_total{tool=\"vrt_spectrum\",stage=\"fft\"} 1.5\n") != std::string::npos );
+    REQUIRE( text.find("vrt_latency_seconds{tool=\"vrt_spectrum\"} 0.25\n") != std::string::npos );
+}
+
+TEST_CASE( "Metrics file is rewritten periodically", "[vrt-metrics]" ) {
+    std::string path = "/tmp/vrt_test_metrics_" + std::to_string(getpid()) + ".prom";
+    REQUIRE( vrt_metrics_start(path, "/usr/local/bin/vrt_to_void") );
+    REQUIRE( vrt_metrics_global != NULL );
+    REQUIRE( not vrt_metrics_start(path, "vrt_to_void") );
+
+    packet_type vrt_packet;
+    vrt_packet.num_rx_samps = 100;
+    vrt_packet.lost_packets = 0;
+    vrt_metrics_packet(&vrt_packet);
+
+    uint64_t begin = vrt_metrics_stage_begin();
+    REQUIRE( begin > 0 );
+    vrt_metrics_stage_end(VRT_STAGE_OUTPUT, begin);
+    REQUIRE( vrt_metrics_global->stage_calls[VRT_STAGE_OUTPUT] == 1 );
+
+    std::string text;
+    for (int i = 0; i < 30 and text.find("vrt_samples_total{tool=\"vrt_to_void\"} 100\n") == std::string::npos; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::ifstream file(path);
+        std::stringstream content;
+        content << file.rdbuf();
+        text = content.str();
+    }
+    REQUIRE( text.find("vrt_samples_total{tool=\"vrt_to_void\"} 100\n") != std::string::npos );
+    unlink(path.c_str());
+}
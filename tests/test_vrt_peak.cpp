@@ -0,0 +1,91 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-peak.h"
+
+// DFT bins k-1, k, k+1 of a tone of amplitude 1 at bin freq, n points (rectangular window)
+static void tone_bins(double freq, uint32_t n, uint32_t k, std::complex<double>* X) {
+    for (int m = -1; m <= 1; m++) {
+        std::complex<double> sum = 0;
+        for (uint32_t t = 0; t < n; t++)
+            sum += std::polar(1.0, 2*M_PI*(freq - (k + m))*t/n);
+        X[m + 1] = sum;
+    }
+}
+
+TEST_CASE( "Peak interpolation finds the tone between bins", "[vrt-peak]" ) {
+    const uint32_t n = 256, k = 40;
+    std::complex<double> X[3];
+
+    for (double delta : {-0.4, -0.25, 0.0, 0.1, 0.3, 0.45}) {
+        INFO( "delta " << delta );
+        tone_bins(k + delta, n, k, X);
+        double magnitude;
+
+        REQUIRE( vrt_peak_interpolate(VRT_PEAK_NONE, X, &magnitude) == 0 );
+        REQUIRE( magnitude == Catch::Approx(std::abs(X[1])) );
+
+        // Jacobsen is (nearly) exact for a rectangular window
+        REQUIRE( vrt_peak_interpolate(VRT_PEAK_JACOBSEN, X, &magnitude) == Catch::Approx(delta).margin(1e-3) );
+        REQUIRE( magnitude == Catch::Approx(n).epsilon(1e-3) );
+
+        // the parabolas have a bias, but are closer than the bin center
+        double quadratic = vrt_peak_interpolate(VRT_PEAK_QUADRATIC, X, &magnitude);
+        REQUIRE( fabs(quadratic - delta) <= fabs(delta) + 1e-12 );
+        REQUIRE( quadratic*delta >= 0 );
+        double gaussian = vrt_peak_interpolate(VRT_PEAK_GAUSSIAN, X, &magnitude);
+        REQUIRE( fabs(gaussian - delta) <= fabs(delta) + 1e-12 );
+        REQUIRE( gaussian*delta >= 0 );
+    }
+}
+
+TEST_CASE( "The strongest local maxima are found", "[vrt-peak]" ) {
+    std::vector<double> magnitude = {5, 1, 2, 1, 7, 3, 3, 9, 1, 4, 4, 0};
+    std::vector<uint32_t> bins;
+
+    vrt_peak_find(magnitude.data(), magnitude.size(), 0, 11, 1, &bins);
+    REQUIRE( bins == std::vector<uint32_t>{7} );
+
+    vrt_peak_find(magnitude.data(), magnitude.size(), 0, 11, 3, &bins);
+    REQUIRE( bins == std::vector<uint32_t>{7, 4, 0} );
+
+    // limited range, the plateau at 9-10 counts once
+    vrt_peak_find(magnitude.data(), magnitude.size(), 1, 10, 10, &bins);
+    REQUIRE( bins == std::vector<uint32_t>{7, 4, 9, 2} );
+}
+
+TEST_CASE( "Tracked peaks keep their slot", "[vrt-peak]" ) {
+    vrt_peak_tracker tracker;
+    vrt_peak_tracker_init(&tracker, 2, 2.0, 1);
+
+    vrt_peak_tracker_update(&tracker, {{100, 10}, {50, 5}});
+    REQUIRE( tracker.tracks[0].bin == 100 );
+    REQUIRE( tracker.tracks[1].bin == 50 );
+
+    // the weaker peak becomes the strongest, both drift
+    vrt_peak_tracker_update(&tracker, {{51.5, 20}, {101, 10}});
+    REQUIRE( tracker.tracks[0].bin == 101 );
+    REQUIRE( tracker.tracks[1].bin == 51.5 );
+
+    // one missing FFT is held, a far away peak does not take the slot
+    vrt_peak_tracker_update(&tracker, {{102, 10}, {200, 8}});
+    REQUIRE( tracker.tracks[0].bin == 102 );
+    REQUIRE( tracker.tracks[1].active );
+    REQUIRE( not tracker.tracks[1].present );
+    REQUIRE( tracker.tracks[1].bin == 51.5 );
+
+    // missing longer than hold: the slot goes to the new peak
+    vrt_peak_tracker_update(&tracker, {{103, 10}, {200, 8}});
+    REQUIRE( tracker.tracks[0].bin == 103 );
+    REQUIRE( tracker.tracks[1].present );
+    REQUIRE( tracker.tracks[1].bin == 200 );
+}
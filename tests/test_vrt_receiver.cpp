@@ -0,0 +1,72 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "vrt-receiver.h"
+
+static void wait_occupancy(vrt_receiver* receiver, uint32_t occupancy) {
+    for (int i = 0; i < 100 and vrt_receiver_occupancy(receiver) < occupancy; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+TEST_CASE( "Receive thread queues packets in order", "[vrt-receiver]" ) {
+    std::string name = "vrt_test_receiver_" + std::to_string(getpid());
+    vrt_shm* producer = vrt_shm_create(name.c_str(), 64, 16);
+    REQUIRE( producer != NULL );
+    vrt_shm* reader = vrt_shm_open(name.c_str());
+
+    vrt_receiver* receiver = vrt_receiver_start(NULL, reader, 4);
+    REQUIRE( receiver != NULL );
+
+    // the queue holds 4 packets, the rest waits in the ring
+    for (uint32_t i = 1; i <= 6; i++)
+        vrt_shm_write(producer, &i, sizeof(i));
+    wait_occupancy(receiver, 4);
+    REQUIRE( vrt_receiver_occupancy(receiver) == 4 );
+
+    uint32_t word;
+    for (uint32_t i = 1; i <= 6; i++) {
+        REQUIRE( vrt_receiver_recv(receiver, &word, sizeof(word)) == sizeof(word) );
+        REQUIRE( word == i );
+    }
+    REQUIRE( vrt_receiver_peak_occupancy(receiver) == 4 );
+    REQUIRE( vrt_receiver_dropped(receiver) == 0 );
+
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(reader);
+    vrt_shm_close(producer);
+}
+
+TEST_CASE( "Receive queue drops packets beyond the latency bound", "[vrt-receiver]" ) {
+    std::string name = "vrt_test_receiver_" + std::to_string(getpid());
+    vrt_shm* producer = vrt_shm_create(name.c_str(), 64, 16);
+    REQUIRE( producer != NULL );
+    vrt_shm* reader = vrt_shm_open(name.c_str());
+
+    vrt_receiver* receiver = vrt_receiver_start(NULL, reader, 8, 5);
+    REQUIRE( receiver != NULL );
+
+    for (uint32_t i = 1; i <= 3; i++)
+        vrt_shm_write(producer, &i, sizeof(i));
+    wait_occupancy(receiver, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // only the newest packet is kept
+    uint32_t word;
+    REQUIRE( vrt_receiver_recv(receiver, &word, sizeof(word)) == sizeof(word) );
+    REQUIRE( word == 3 );
+    REQUIRE( vrt_receiver_dropped(receiver) == 2 );
+    REQUIRE( vrt_receiver_occupancy(receiver) == 0 );
+
+    vrt_receiver_stop(receiver);
+    vrt_shm_close(reader);
+    vrt_shm_close(producer);
+}
@@ -0,0 +1,75 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <unistd.h>
+
+#include <string>
+
+#include "vrt-shm.h"
+
+TEST_CASE( "Shared memory ring delivers packets to every reader", "[vrt-shm]" ) {
+    std::string name = "vrt_test_" + std::to_string(getpid());
+    vrt_shm* producer = vrt_shm_create(name.c_str(), 64, 8);
+    REQUIRE( producer != NULL );
+
+    vrt_shm* reader1 = vrt_shm_open(name.c_str());
+    vrt_shm* reader2 = vrt_shm_open(name.c_str());
+
+    // readers start at the newest packet, attach before writing
+    uint32_t word = 0;
+    REQUIRE( vrt_shm_write(producer, &word, sizeof(word)) == sizeof(word) );
+    REQUIRE( vrt_shm_read(reader1, &word, sizeof(word)) == sizeof(word) );
+    REQUIRE( vrt_shm_read(reader2, &word, sizeof(word)) == sizeof(word) );
+
+    for (uint32_t i = 1; i <= 3; i++)
+        vrt_shm_write(producer, &i, sizeof(i));
+
+    for (uint32_t i = 1; i <= 3; i++) {
+        REQUIRE( vrt_shm_read(reader1, &word, sizeof(word)) == sizeof(word) );
+        REQUIRE( word == i );
+    }
+    for (uint32_t i = 1; i <= 3; i++) {
+        REQUIRE( vrt_shm_read(reader2, &word, sizeof(word)) == sizeof(word) );
+        REQUIRE( word == i );
+    }
+    REQUIRE( vrt_shm_overruns(reader1) == 0 );
+
+    // packets larger than a slot are refused
+    char big[128] = {};
+    REQUIRE( vrt_shm_write(producer, big, sizeof(big)) == -1 );
+
+    vrt_shm_close(reader2);
+    vrt_shm_close(reader1);
+    vrt_shm_close(producer);
+}
+
+TEST_CASE( "Shared memory ring reports overruns of slow readers", "[vrt-shm]" ) {
+    std::string name = "vrt_test_overrun_" + std::to_string(getpid());
+    vrt_shm* producer = vrt_shm_create(name.c_str(), 64, 8);
+    REQUIRE( producer != NULL );
+
+    vrt_shm* reader = vrt_shm_open(name.c_str());
+    uint32_t word = 0;
+    vrt_shm_write(producer, &word, sizeof(word));
+    REQUIRE( vrt_shm_read(reader, &word, sizeof(word)) == sizeof(word) );
+
+    for (uint32_t i = 1; i <= 20; i++)
+        vrt_shm_write(producer, &i, sizeof(i));
+
+    REQUIRE( vrt_shm_read(reader, &word, sizeof(word)) == sizeof(word) );
+    REQUIRE( vrt_shm_overruns(reader) > 0 );
+    REQUIRE( word == 1 + vrt_shm_overruns(reader) );
+
+    uint32_t last = word;
+    while (last < 20) {
+        REQUIRE( vrt_shm_read(reader, &word, sizeof(word)) == sizeof(word) );
+        REQUIRE( word == last + 1 );
+        last = word;
+    }
+
+    vrt_shm_close(reader);
+    vrt_shm_close(producer);
+}
@@ -0,0 +1,150 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "vrt-spectral-file.h"
+
+static vrt_spectral_layout test_layout() {
+    vrt_spectral_layout layout;
+    layout.kind = "spectrum";
+    layout.columns = 5;
+    layout.sample_rate = 1e6;
+    layout.center_freq = 1420e6;
+    layout.first_freq = 1420e6 - 5e5;
+    layout.column_step = 2e5;
+    layout.integration_time = 0.5;
+    layout.integrations = 100;
+    layout.traces.push_back({"center_freq_hz", "Hz"});
+    layout.traces.push_back({"temperature_deg_c", ""});
+    layout.meta.push_back({"source", "Sun"});
+    return layout;
+}
+
+static void write_rows(vrt_spectral_file* file, uint32_t rows) {
+    for (uint32_t r = 0; r < rows; r++) {
+        double* traces = vrt_spectral_file_traces(file);
+        float* values = vrt_spectral_file_values(file);
+        traces[0] = 1420e6;
+        traces[1] = 20 + r;
+        for (uint32_t i = 0; i < 5; i++)
+            values[i] = r*10 + i;
+        REQUIRE( vrt_spectral_file_write(file, 1000 + r, 500000000000) );
+    }
+}
+
+TEST_CASE( "Spectral file rows can be mapped and found", "[vrt-spectral-file]" ) {
+    std::string path = "/tmp/vrt_test_spectral_" + std::to_string(getpid()) + ".bin";
+
+    vrt_spectral_file* file = vrt_spectral_file_create(path, test_layout());
+    REQUIRE( file != NULL );
+    write_rows(file, 7);
+    vrt_spectral_file_close(file);
+
+    vrt_spectral_map* map = vrt_spectral_file_map(path);
+    REQUIRE( map != NULL );
+    const vrt_spectral_header* header = map->header;
+    REQUIRE( std::string(header->kind) == "spectrum" );
+    REQUIRE( header->columns == 5 );
+    REQUIRE( header->traces == 2 );
+    REQUIRE( header->header_size % 64 == 0 );
+    REQUIRE( header->row_size % 8 == 0 );
+    REQUIRE( header->integration_time == 0.5 );
+    REQUIRE( map->rows == 7 );
+    REQUIRE( map->index != NULL );
+
+    std::string metadata(map->metadata);
+    REQUIRE( metadata.find("# %ECSV 1.0") == 0 );
+    REQUIRE( metadata.find("{name: center_freq_hz, unit: Hz, datatype: float64}") != std::string::npos );
+    REQUIRE( metadata.find("{name: values, datatype: float32, shape: [5]}") != std::string::npos );
+    REQUIRE( metadata.find("{source: Sun}") != std::string::npos );
+
+    for (uint64_t r = 0; r < map->rows; r++) {
+        const vrt_spectral_row* row = vrt_spectral_map_row(map, r);
+        REQUIRE( row->seconds == (int64_t)(1000 + r) );
+        REQUIRE( row->picoseconds == 500000000000 );
+        REQUIRE( vrt_spectral_row_traces(row)[1] == 20 + r );
+        REQUIRE( vrt_spectral_row_values(map, row)[3] == r*10 + 3 );
+        REQUIRE( map->index[r].offset == (uint64_t)((const uint8_t*)row - map->data) );
+    }
+
+    REQUIRE( vrt_spectral_map_find(map, 0) == 0 );
+    REQUIRE( vrt_spectral_map_find(map, 1003.5) == 3 );
+    REQUIRE( vrt_spectral_map_find(map, 1003.6) == 4 );
+    REQUIRE( vrt_spectral_map_find(map, 2000) == 7 );
+
+    vrt_spectral_file_unmap(map);
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Spectral file rows are readable before close", "[vrt-spectral-file]" ) {
+    std::string path = "/tmp/vrt_test_spectral_open_" + std::to_string(getpid()) + ".bin";
+
+    vrt_spectral_layout layout = test_layout();
+    layout.kind = "xcorr";
+    layout.complex = true;
+    vrt_spectral_file* file = vrt_spectral_file_create(path, layout);
+    REQUIRE( file != NULL );
+    write_rows(file, 3);
+
+    // still written: no index, the rows follow from the file size
+    vrt_spectral_map* map = vrt_spectral_file_map(path);
+    REQUIRE( map != NULL );
+    REQUIRE( map->index == NULL );
+    REQUIRE( map->rows == 3 );
+    REQUIRE( map->header->complex == 1 );
+    REQUIRE( vrt_spectral_map_row(map, 2)->seconds == 1002 );
+    REQUIRE( vrt_spectral_map_find(map, 1001.5) == 1 );
+    vrt_spectral_file_unmap(map);
+
+    vrt_spectral_file_close(file);
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Spectral file rows hold all planes", "[vrt-spectral-file]" ) {
+    std::string path = "/tmp/vrt_test_spectral_planes_" + std::to_string(getpid()) + ".bin";
+
+    vrt_spectral_layout layout = test_layout();
+    layout.planes = {"mean", "kurtosis", "max"};
+    vrt_spectral_file* file = vrt_spectral_file_create(path, layout);
+    REQUIRE( file != NULL );
+    float* values = vrt_spectral_file_values(file);
+    for (uint32_t i = 0; i < 15; i++)
+        values[i] = i;
+    REQUIRE( vrt_spectral_file_write(file, 1000, 0) );
+    vrt_spectral_file_close(file);
+
+    vrt_spectral_map* map = vrt_spectral_file_map(path);
+    REQUIRE( map != NULL );
+    REQUIRE( map->header->columns == 5 );
+    REQUIRE( map->header->row_size == 16 + 2*8 + 15*4 + 4 );
+    std::string metadata(map->metadata);
+    REQUIRE( metadata.find("{planes: [mean, kurtosis, max]}") != std::string::npos );
+    REQUIRE( metadata.find("{name: values, datatype: float32, shape: [3, 5]}") != std::string::npos );
+    // the last plane
+    REQUIRE( vrt_spectral_row_values(map, vrt_spectral_map_row(map, 0))[2*5 + 4] == 14 );
+
+    vrt_spectral_file_unmap(map);
+    unlink(path.c_str());
+}
+
+TEST_CASE( "Other files are not mapped", "[vrt-spectral-file]" ) {
+    std::string path = "/tmp/vrt_test_spectral_bad_" + std::to_string(getpid()) + ".bin";
+    FILE* fp = fopen(path.c_str(), "wb");
+    REQUIRE( fp != NULL );
+    char zeros[256];
+    memset(zeros, 0, sizeof(zeros));
+    fwrite(zeros, sizeof(zeros), 1, fp);
+    fclose(fp);
+
+    REQUIRE( vrt_spectral_file_map(path) == NULL );
+    REQUIRE( vrt_spectral_file_map(path + ".missing") == NULL );
+    unlink(path.c_str());
+}
@@ -0,0 +1,308 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "vrt-tools.h"
+
+TEST_CASE( "Packet view references the payload in place", "[vrt-tools]" ) {
+    uint32_t samples[VRT_SAMPLES_PER_PACKET];
+    for (uint32_t i = 0; i < VRT_SAMPLES_PER_PACKET; i++)
+        samples[i] = i;
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p);
+    p.fields.stream_id = 2;
+    p.fields.integer_seconds_timestamp = 1700000000;
+    p.fields.fractional_seconds_timestamp = 123456789;
+    p.body = samples;
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    int32_t rv = vrt_write_packet(&p, buffer, VRT_DATA_PACKET_SIZE, true);
+    REQUIRE( rv == VRT_DATA_PACKET_SIZE );
+
+    vrt_packet_view view;
+    REQUIRE( vrt_view_parse(buffer, ZMQ_BUFFER_SIZE, &view) );
+    REQUIRE( view.header.packet_type == VRT_PT_IF_DATA_WITH_STREAM_ID );
+    REQUIRE( view.fields.stream_id == 2 );
+    REQUIRE( view.fields.integer_seconds_timestamp == 1700000000 );
+    REQUIRE( view.words == VRT_DATA_PACKET_SIZE );
+    REQUIRE( view.payload_words == VRT_SAMPLES_PER_PACKET );
+    REQUIRE( vrt_view_payload(&view) == buffer + view.payload_offset );
+    REQUIRE( vrt_view_payload(&view)[42] == 42 );
+}
+
+TEST_CASE( "vrt_process fills packet info from the view", "[vrt-tools]" ) {
+    uint32_t samples[VRT_SAMPLES_PER_PACKET] = {0};
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p);
+    p.fields.stream_id = 1;
+    p.body = samples;
+
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    REQUIRE( vrt_write_packet(&p, buffer, VRT_DATA_PACKET_SIZE, true) > 0 );
+
+    context_type vrt_context;
+    init_context(&vrt_context);
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.data );
+    REQUIRE( not vrt_packet.lost_frame );
+    REQUIRE( vrt_packet.num_rx_samps == VRT_SAMPLES_PER_PACKET );
+    REQUIRE( vrt_packet.offset == VRT_DATA_PACKET_SIZE - VRT_SAMPLES_PER_PACKET );
+}
+
+static void write_counted_packet(uint32_t* buffer, uint8_t counter, uint64_t fractional, uint32_t first_sample) {
+    uint32_t samples[100];
+    for (uint32_t i = 0; i < 100; i++)
+        samples[i] = first_sample + i;
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p, 100);
+    p.fields.stream_id = 1;
+    p.header.packet_count = counter;
+    p.fields.integer_seconds_timestamp = 1700000000;
+    p.fields.fractional_seconds_timestamp = fractional;
+    p.body = samples;
+    vrt_write_packet(&p, buffer, VRT_DATA_PACKET_WORDS(100), true);
+}
+
+// 100 samples at 1 MHz, 100 us per packet
+static const uint64_t PACKET_PS = 100000000;
+
+TEST_CASE( "Lost packets are detected from the counter", "[vrt-tools]" ) {
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    context_type vrt_context;
+    init_context(&vrt_context);
+    vrt_context.sample_rate = 1000000;
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    write_counted_packet(buffer, 15, 0, 0);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( not vrt_packet.lost_frame );
+
+    // counter wraps from 15 to 0
+    write_counted_packet(buffer, 0, PACKET_PS, 100);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( not vrt_packet.lost_frame );
+
+    write_counted_packet(buffer, 3, 4*PACKET_PS, 400);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.lost_frame );
+    REQUIRE( vrt_packet.lost_packets == 2 );
+    REQUIRE( vrt_packet.lost_samples == 200 );
+    REQUIRE( vrt_packet.previous_sample == 199 );
+    REQUIRE( vrt_context.lost_packets == 2 );
+    REQUIRE( vrt_context.lost_samples == 200 );
+}
+
+TEST_CASE( "A full counter cycle of lost packets is caught by the timestamp", "[vrt-tools]" ) {
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    context_type vrt_context;
+    init_context(&vrt_context);
+    vrt_context.sample_rate = 1000000;
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    write_counted_packet(buffer, 0, 0, 0);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+
+    // the counter looks consecutive, 16 packets are missing
+    write_counted_packet(buffer, 1, 17*PACKET_PS, 1700);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.lost_frame );
+    REQUIRE( vrt_packet.lost_packets == 16 );
+    REQUIRE( vrt_packet.lost_samples == 1600 );
+}
+
+TEST_CASE( "Loss policies fill the gap in front of the payload", "[vrt-tools]" ) {
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    context_type vrt_context;
+    init_context(&vrt_context);
+    vrt_context.sample_rate = 1000000;
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    vrt_loss_policy policy;
+    REQUIRE( vrt_parse_loss_policy("hold", &policy) );
+    REQUIRE( policy == VRT_LOSS_HOLD );
+    REQUIRE( not vrt_parse_loss_policy("ignore", &policy) );
+
+    write_counted_packet(buffer, 0, 0, 0);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+
+    write_counted_packet(buffer, 3, 3*PACKET_PS, 300);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.lost_frame );
+
+    packet_type aborted = vrt_packet;
+    REQUIRE( not vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &aborted, VRT_LOSS_ABORT) );
+
+    REQUIRE( vrt_fill_loss(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet, VRT_LOSS_HOLD) );
+    REQUIRE( vrt_packet.fill_samples == 200 );
+    REQUIRE( vrt_packet.num_rx_samps == 300 );
+    REQUIRE( vrt_packet.fractional_seconds_timestamp == PACKET_PS );
+    REQUIRE( buffer[vrt_packet.offset] == 99 );
+    REQUIRE( buffer[vrt_packet.offset+199] == 99 );
+    REQUIRE( buffer[vrt_packet.offset+200] == 300 );
+    REQUIRE( buffer[vrt_packet.offset+299] == 399 );
+
+    // gaps larger than the buffer are filled partially
+    write_counted_packet(buffer, 6, 6*PACKET_PS, 600);
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    uint32_t words = vrt_packet.offset + vrt_packet.num_rx_samps + 50;
+    REQUIRE( vrt_fill_loss(buffer, words, &vrt_context, &vrt_packet, VRT_LOSS_ZERO) );
+    REQUIRE( vrt_packet.fill_samples == 50 );
+    REQUIRE( buffer[vrt_packet.offset] == 0 );
+    REQUIRE( buffer[vrt_packet.offset+50] == 600 );
+}
+
+TEST_CASE( "Compact payloads are decoded from the advertised format", "[vrt-tools]" ) {
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    context_type vrt_context;
+    init_context(&vrt_context);
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    vrt_sample_format format;
+    REQUIRE( vrt_parse_sample_format("ci8", &format) );
+    REQUIRE( not vrt_valid_packet_size(101, format) );
+
+    struct vrt_packet pc;
+    vrt_init_packet(&pc);
+    vrt_init_context_packet(&pc, format);
+    pc.fields.stream_id = 1;
+    int32_t rv = vrt_write_packet(&pc, buffer, ZMQ_BUFFER_SIZE, true);
+    REQUIRE( rv > 0 );
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_context.sample_format == VRT_FORMAT_CI8 );
+
+    uint32_t samples[100], payload[50];
+    for (uint32_t i = 0; i < 100; i++)
+        samples[i] = (uint16_t)(int16_t)(i - 50) | ((uint32_t)(uint16_t)(int16_t)(50 - i) << 16);
+    REQUIRE( vrt_ci16_to_payload(samples, payload, 100, format) == 50 );
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p, 100, format);
+    REQUIRE( p.header.packet_size == VRT_DATA_PACKET_WORDS(50) );
+    p.fields.stream_id = 1;
+    p.body = payload;
+    REQUIRE( vrt_write_packet(&p, buffer, p.header.packet_size, true) > 0 );
+
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.data );
+    REQUIRE( vrt_packet.sample_format == VRT_FORMAT_CI16 );
+    REQUIRE( vrt_packet.num_rx_samps == 100 );
+    for (uint32_t i = 0; i < 100; i++)
+        REQUIRE( buffer[vrt_packet.offset+i] == samples[i] );
+}
+
+TEST_CASE( "Compact payloads decode into a buffer with just enough room", "[vrt-tools]" ) {
+    uint32_t buffer[ZMQ_BUFFER_SIZE];
+    context_type vrt_context;
+    init_context(&vrt_context);
+    packet_type vrt_packet;
+    vrt_packet.channel_filt = 1;
+    vrt_packet.first_frame = true;
+
+    vrt_sample_format format;
+    REQUIRE( vrt_parse_sample_format("ci12", &format) );
+
+    struct vrt_packet pc;
+    vrt_init_packet(&pc);
+    vrt_init_context_packet(&pc, format);
+    pc.fields.stream_id = 1;
+    REQUIRE( vrt_write_packet(&pc, buffer, ZMQ_BUFFER_SIZE, true) > 0 );
+    REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+
+    uint32_t samples[100], payload[75];
+    for (uint32_t i = 0; i < 100; i++)
+        samples[i] = (uint16_t)(int16_t)(16*i - 800) | ((uint32_t)(uint16_t)(int16_t)(800 - 16*i) << 16);
+    REQUIRE( vrt_ci16_to_payload(samples, payload, 100, format) == vrt_payload_words(100, format) );
+
+    struct vrt_packet p;
+    vrt_init_packet(&p);
+    vrt_init_data_packet(&p, 100, format);
+    p.fields.stream_id = 1;
+    p.body = payload;
+    REQUIRE( vrt_write_packet(&p, buffer, p.header.packet_size, true) > 0 );
+
+    vrt_packet_view view;
+    REQUIRE( vrt_view_parse(buffer, p.header.packet_size, &view) );
+
+    // the decoded payload ends exactly at the end of the buffer
+    std::vector<uint32_t> exact(buffer, buffer + view.payload_offset + 100);
+    REQUIRE( vrt_process(exact.data(), exact.size(), &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.sample_format == VRT_FORMAT_CI16 );
+    REQUIRE( vrt_packet.num_rx_samps == 100 );
+    for (uint32_t i = 0; i < 100; i++)
+        REQUIRE( exact[vrt_packet.offset+i] == samples[i] );
+
+    // one word less drops the last sample instead of writing past the buffer
+    std::vector<uint32_t> short_buffer(buffer, buffer + view.payload_offset + 99);
+    REQUIRE( vrt_process(short_buffer.data(), short_buffer.size(), &vrt_context, &vrt_packet) );
+    REQUIRE( vrt_packet.num_rx_samps == 99 );
+    REQUIRE( short_buffer[vrt_packet.offset+98] == samples[98] );
+}
+
+TEST_CASE( "Accepted compact payloads are kept within the packet", "[vrt-tools]" ) {
+    const char* names[] = {"ci8", "ci12"};
+    for (const char* name : names) {
+        uint32_t buffer[ZMQ_BUFFER_SIZE];
+        context_type vrt_context;
+        init_context(&vrt_context);
+        // forwarded as they are, as in vrt_buffer and vrt_merge
+        vrt_context.accept_formats = ~0u;
+        packet_type vrt_packet;
+        vrt_packet.channel_filt = 1;
+        vrt_packet.first_frame = true;
+
+        vrt_sample_format format;
+        REQUIRE( vrt_parse_sample_format(name, &format) );
+
+        struct vrt_packet pc;
+        vrt_init_packet(&pc);
+        vrt_init_context_packet(&pc, format);
+        pc.fields.stream_id = 1;
+        REQUIRE( vrt_write_packet(&pc, buffer, ZMQ_BUFFER_SIZE, true) > 0 );
+        REQUIRE( vrt_process(buffer, ZMQ_BUFFER_SIZE, &vrt_context, &vrt_packet) );
+
+        uint32_t samples[100], payload[75];
+        for (uint32_t i = 0; i < 100; i++)
+            samples[i] = (uint16_t)(int16_t)(i - 50) | ((uint32_t)(uint16_t)(int16_t)(50 - i) << 16);
+        uint32_t words = vrt_ci16_to_payload(samples, payload, 100, format);
+
+        struct vrt_packet p;
+        vrt_init_packet(&p);
+        vrt_init_data_packet(&p, 100, format);
+        p.fields.stream_id = 1;
+        p.body = payload;
+
+        // the buffer ends with the packet, as the received copies of vrt_buffer
+        std::vector<uint32_t> packet(p.header.packet_size);
+        REQUIRE( vrt_write_packet(&p, packet.data(), packet.size(), true) > 0 );
+        REQUIRE( vrt_process(packet.data(), packet.size(), &vrt_context, &vrt_packet) );
+        REQUIRE( vrt_packet.data );
+        REQUIRE( vrt_packet.sample_format == format );
+        REQUIRE( vrt_packet.num_rx_samps == 100 );
+        REQUIRE( vrt_packet.offset + words <= packet.size() );
+        for (uint32_t i = 0; i < words; i++)
+            REQUIRE( packet[vrt_packet.offset+i] == payload[i] );
+        // the last sample is only kept for ci16 and cf32
+        REQUIRE( vrt_context.last_sample == 0 );
+    }
+}
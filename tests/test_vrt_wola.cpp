@@ -0,0 +1,111 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-wola.h"
+
+// Weighted sum of the frame ending at sample end of the whole stream
+static std::vector<std::complex<float>> reference(const std::vector<std::complex<float>>& stream,
+    const std::vector<float>& taps, size_t end, uint32_t num_bins) {
+    std::vector<std::complex<float>> out(num_bins, 0);
+    size_t frame = taps.size();
+    for (size_t k = 0; k < frame; k++) {
+        // the stream starts after a frame of zeros
+        std::complex<float> x = end + k >= frame ? stream[end + k - frame] : 0;
+        out[k % num_bins] += taps[k]*x;
+    }
+    return out;
+}
+
+TEST_CASE( "WOLA ring buffer matches a sliding frame", "[vrt-wola]" ) {
+    const uint32_t num_bins = 16, partitions = 3;
+
+    std::vector<float> taps(partitions*num_bins);
+    for (size_t k = 0; k < taps.size(); k++)
+        taps[k] = (float)(k % 5) - 2;
+
+    // no overlap, an overlap of 4 and a hop that does not divide the frame
+    for (uint32_t hop : {num_bins, num_bins/4, 10u}) {
+        INFO( "hop " << hop );
+        vrt_wola* wola = vrt_wola_create(num_bins, partitions, hop, taps.data());
+        REQUIRE( wola != NULL );
+        REQUIRE( vrt_wola_hop(wola) == hop );
+
+        std::vector<std::complex<float>> stream;
+        std::vector<std::complex<float>> out(num_bins);
+        std::vector<std::complex<double>> out64(num_bins);
+        for (uint32_t block = 0; block < 20; block++) {
+            std::complex<float>* input = vrt_wola_input(wola);
+            for (uint32_t i = 0; i < hop; i++) {
+                float v = (float)stream.size();
+                input[i] = std::complex<float>(v, -2*v);
+                stream.push_back(input[i]);
+            }
+            vrt_wola_push(wola);
+
+            // integer valued, so the sums are exact
+            vrt_wola_output(wola, out.data());
+            REQUIRE( out == reference(stream, taps, stream.size(), num_bins) );
+            vrt_wola_output(wola, out64.data());
+            for (uint32_t i = 0; i < num_bins; i++)
+                REQUIRE( out64[i] == std::complex<double>(out[i]) );
+        }
+        vrt_wola_destroy(wola);
+    }
+}
+
+TEST_CASE( "Default WOLA taps pass DC", "[vrt-wola]" ) {
+    const uint32_t num_bins = 64, partitions = 4;
+    vrt_wola* wola = vrt_wola_create(num_bins, partitions);
+    REQUIRE( vrt_wola_hop(wola) == num_bins );
+
+    // DC fills the frame, the folded output is real and roughly flat
+    for (uint32_t p = 0; p < partitions; p++) {
+        std::complex<float>* input = vrt_wola_input(wola);
+        for (uint32_t i = 0; i < num_bins; i++)
+            input[i] = 1;
+        vrt_wola_push(wola);
+    }
+    std::vector<std::complex<float>> out(num_bins);
+    vrt_wola_output(wola, out.data());
+    REQUIRE( out[0].real() > 0 );
+    for (uint32_t i = 0; i < num_bins; i++) {
+        REQUIRE( out[i].imag() == 0 );
+        REQUIRE( out[i].real() > 0.8f*out[0].real() );
+        REQUIRE( out[i].real() < 1.2f*out[0].real() );
+    }
+
+    REQUIRE( vrt_wola_create(num_bins, 0) == NULL );
+    REQUIRE( vrt_wola_create(num_bins, partitions, num_bins + 1) == NULL );
+    vrt_wola_destroy(wola);
+}
+
+TEST_CASE( "Windows have unit mean power", "[vrt-wola]" ) {
+    const uint32_t num_bins = 256;
+    std::vector<float> taps(num_bins);
+
+    for (const char* name : {"rect", "hann", "blackman-harris", "flat-top"}) {
+        INFO( "window " << name );
+        vrt_window window;
+        REQUIRE( vrt_parse_window(name, &window) );
+        vrt_wola_taps(taps.data(), num_bins, 1, window);
+        double power = 0;
+        for (float w : taps)
+            power += (double)w*w;
+        REQUIRE( std::abs(power/num_bins - 1) < 1e-5 );
+        // symmetric, largest in the middle
+        REQUIRE( std::abs(taps[10] - taps[num_bins-11]) < 1e-5f );
+        REQUIRE( taps[num_bins/2] >= taps[10] );
+    }
+
+    vrt_window window;
+    REQUIRE( vrt_parse_window("hann", &window) );
+    vrt_wola_taps(taps.data(), num_bins, 1, window);
+    REQUIRE( std::abs(taps[0]) < 1e-6f );
+    REQUIRE_FALSE( vrt_parse_window("kaiser", &window) );
+}
@@ -0,0 +1,66 @@
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+#include "vrt-zoom.h"
+
+// Tone of amplitude 1000 at freq, zoomed in blocks of block samples
+static std::vector<std::complex<float>> zoom_tone(double sample_rate, double freq, double offset,
+    uint32_t decimation, uint32_t samples, uint32_t block) {
+    vrt_zoom* zoom = vrt_zoom_create(sample_rate, offset, decimation);
+    REQUIRE( zoom != NULL );
+    std::vector<std::complex<float>> in(block), out;
+    std::vector<std::complex<float>> part(block/decimation + 1);
+    for (uint32_t t = 0; t < samples; t += block) {
+        for (uint32_t i = 0; i < block; i++)
+            in[i] = std::polar(1000.0, 2*M_PI*freq*(t + i)/sample_rate);
+        uint32_t m = vrt_zoom_process(zoom, in.data(), block, part.data());
+        out.insert(out.end(), part.begin(), part.begin() + m);
+    }
+    vrt_zoom_destroy(zoom);
+    return out;
+}
+
+TEST_CASE( "Zoom decimation is a divisor that holds the band", "[vrt-zoom]" ) {
+    REQUIRE( vrt_zoom_decimation(2e6, 40e3) == 25 );
+    REQUIRE( vrt_zoom_decimation(2e6, 4e6) == 1 );
+    REQUIRE( vrt_zoom_decimation(2e6, 0) == 1 );
+    REQUIRE( vrt_zoom_decimation(1e6 + 0.5, 1e5) == 6 );
+}
+
+TEST_CASE( "Zoom shifts the band to baseband", "[vrt-zoom]" ) {
+    const double sample_rate = 100e3, offset = 20e3;
+    const uint32_t decimation = 10;
+
+    // 500 Hz above the offset, blocks that do not divide the decimation
+    std::vector<std::complex<float>> out = zoom_tone(sample_rate, offset + 500, offset, decimation, 20007*3, 20007);
+    REQUIRE( out.size() == (20007*3 + decimation - 1)/decimation );
+
+    // after the filter has settled: amplitude kept, rotating at 500 Hz
+    double rate = sample_rate/decimation;
+    for (size_t k = 100; k + 1 < out.size(); k += 97) {
+        REQUIRE( std::abs(out[k]) == Catch::Approx(1000).margin(1) );
+        double turn = std::arg(out[k + 1]/out[k]);
+        REQUIRE( turn == Catch::Approx(2*M_PI*500/rate).margin(1e-4) );
+    }
+}
+
+TEST_CASE( "Zoom suppresses tones outside the band", "[vrt-zoom]" ) {
+    const double sample_rate = 100e3, offset = -10e3;
+    const uint32_t decimation = 10;
+
+    // 8 kHz from the offset, would alias to -2 kHz at 10 kHz output rate
+    std::vector<std::complex<float>> out = zoom_tone(sample_rate, offset + 8e3, offset, decimation, 50000, 4096);
+    double peak = 0;
+    for (size_t k = 100; k < out.size(); k++)
+        peak = std::max<double>(peak, std::abs(out[k]));
+    REQUIRE( 20*log10(peak/1000) < -60 );
+}